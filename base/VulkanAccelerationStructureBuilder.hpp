@@ -0,0 +1,419 @@
+/*
+* Vulkan acceleration structure builder
+*
+* Builds multiple bottom level acceleration structures with a single command buffer submission
+* Storage and scratch memory is suballocated from shared buffers, structures can optionally be compacted and refit
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanTimestampQuery.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Batched builder for bottom level acceleration structures
+	* @note Add all inputs, then call build once. Inputs that are built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR can be refit afterwards
+	*/
+	class AccelerationStructureBuilder
+	{
+	public:
+		struct BottomLevelInput {
+			std::vector<VkAccelerationStructureGeometryKHR> geometries;
+			std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+			VkBuildAccelerationStructureFlagsKHR flags{ VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR };
+		};
+
+		struct AccelerationStructure {
+			VkAccelerationStructureKHR handle{ VK_NULL_HANDLE };
+			uint64_t deviceAddress{ 0 };
+			VkDeviceSize offset{ 0 };
+			VkDeviceSize size{ 0 };
+		};
+
+		struct Stats {
+			double buildTime{ 0.0 };						// Host time for building all structures in milliseconds
+			double compactionTime{ 0.0 };					// Host time for querying compacted sizes and copying in milliseconds
+			float refitTime{ 0.0f };						// GPU time of the last refit in milliseconds
+			VkDeviceSize memoryBeforeCompaction{ 0 };
+			VkDeviceSize memoryAfterCompaction{ 0 };
+			VkDeviceSize scratchSize{ 0 };
+			uint32_t batchCount{ 0 };
+		} stats;
+
+		std::vector<AccelerationStructure> accelerationStructures;
+
+	private:
+		struct Allocation {
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			VkDeviceSize size{ 0 };
+			uint64_t deviceAddress{ 0 };
+		};
+
+		// Acceleration structures need to be placed at 256 byte aligned offsets
+		static constexpr VkDeviceSize storageAlignment = 256;
+
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDevice device{ VK_NULL_HANDLE };
+		VkDeviceSize scratchAlignment{ 0 };
+		VkDeviceSize scratchBudget{ 0 };
+		std::vector<BottomLevelInput> inputs;
+		std::vector<VkAccelerationStructureBuildSizesInfoKHR> buildSizes;
+		Allocation storage;
+		Allocation updateScratch;
+		vks::TimestampQuery timestamps;
+
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR{ nullptr };
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR{ nullptr };
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR{ nullptr };
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR{ nullptr };
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR{ nullptr };
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR{ nullptr };
+		PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR{ nullptr };
+		PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR{ nullptr };
+
+		Allocation allocate(VkDeviceSize size, VkBufferUsageFlags usage)
+		{
+			Allocation allocation{};
+			allocation.size = size;
+			VkBufferCreateInfo bufferCreateInfo{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+				.size = size,
+				.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+			};
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &allocation.buffer));
+			VkMemoryRequirements memoryRequirements{};
+			vkGetBufferMemoryRequirements(device, allocation.buffer, &memoryRequirements);
+			VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+				.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR
+			};
+			VkMemoryAllocateInfo memoryAllocateInfo{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				.pNext = &memoryAllocateFlagsInfo,
+				.allocationSize = memoryRequirements.size,
+				.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			};
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &allocation.memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, allocation.buffer, allocation.memory, 0));
+			VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+				.buffer = allocation.buffer
+			};
+			allocation.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAddressInfo);
+			return allocation;
+		}
+
+		void release(Allocation& allocation)
+		{
+			if (allocation.buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device, allocation.buffer, nullptr);
+				vkFreeMemory(device, allocation.memory, nullptr);
+			}
+			allocation = {};
+		}
+
+		// Creates acceleration structures at the given offsets of a storage allocation
+		void createAccelerationStructures(std::vector<AccelerationStructure>& target, const Allocation& allocation, const std::vector<VkDeviceSize>& sizes)
+		{
+			target.resize(sizes.size());
+			VkDeviceSize offset = 0;
+			for (size_t i = 0; i < sizes.size(); i++) {
+				VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{
+					.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+					.buffer = allocation.buffer,
+					.offset = offset,
+					.size = sizes[i],
+					.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR
+				};
+				VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &target[i].handle));
+				VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{
+					.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+					.accelerationStructure = target[i].handle
+				};
+				target[i].deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+				target[i].offset = offset;
+				target[i].size = sizes[i];
+				offset += vks::tools::alignedVkSize(sizes[i], storageAlignment);
+			}
+		}
+
+		VkAccelerationStructureBuildGeometryInfoKHR getBuildGeometryInfo(uint32_t index, VkBuildAccelerationStructureModeKHR mode) const
+		{
+			return VkAccelerationStructureBuildGeometryInfoKHR{
+				.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+				.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+				.flags = inputs[index].flags,
+				.mode = mode,
+				.geometryCount = static_cast<uint32_t>(inputs[index].geometries.size()),
+				.pGeometries = inputs[index].geometries.data()
+			};
+		}
+
+		// Makes acceleration structure writes visible to following builds and reads, also required before reusing scratch memory
+		void buildBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR)
+		{
+			VkMemoryBarrier memoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+				.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
+			};
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+	public:
+		/**
+		* Prepare the builder for the given device
+		*
+		* @param vulkanDevice Device with VK_KHR_acceleration_structure enabled
+		* @param scratchBudget Upper limit for the shared scratch buffer, builds that don't fit are split into several batches that reuse the same scratch memory
+		* @param frameCount Number of frames in flight that refits are recorded for
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkDeviceSize scratchBudget = 64 * 1024 * 1024, uint32_t frameCount = 1)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->scratchBudget = scratchBudget;
+			device = vulkanDevice->logicalDevice;
+			vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR"));
+			vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
+			vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
+			vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR"));
+			vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR"));
+			vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
+			vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+			vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
+
+			VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR
+			};
+			VkPhysicalDeviceProperties2 deviceProperties2{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+				.pNext = &accelerationStructureProperties
+			};
+			vkGetPhysicalDeviceProperties2(vulkanDevice->physicalDevice, &deviceProperties2);
+			scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+			timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 1, frameCount);
+		}
+
+		/** @brief Add a bottom level acceleration structure to be built, returns its index in accelerationStructures */
+		uint32_t add(const BottomLevelInput& input)
+		{
+			assert(input.geometries.size() == input.buildRanges.size());
+			inputs.push_back(input);
+			return static_cast<uint32_t>(inputs.size() - 1);
+		}
+
+		/**
+		* Build all added acceleration structures using a single command buffer
+		*
+		* @param queue Queue to submit the builds to, this call waits for completion
+		* @param compact If true, structures are compacted after building and the uncompacted storage is released
+		*/
+		void build(VkQueue queue, bool compact = true)
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+
+			const uint32_t count = static_cast<uint32_t>(inputs.size());
+			if (count == 0) {
+				return;
+			}
+			if (compact) {
+				for (auto& input : inputs) {
+					input.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+				}
+			}
+
+			// Get sizes and suballocate storage for all structures from a single buffer
+			buildSizes.resize(count);
+			std::vector<VkDeviceSize> storageSizes(count);
+			VkDeviceSize storageSize = 0;
+			VkDeviceSize updateScratchSize = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = getBuildGeometryInfo(i, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+				std::vector<uint32_t> maxPrimitiveCounts;
+				for (auto& buildRange : inputs[i].buildRanges) {
+					maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+				}
+				buildSizes[i] = { .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
+				vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, maxPrimitiveCounts.data(), &buildSizes[i]);
+				storageSizes[i] = buildSizes[i].accelerationStructureSize;
+				storageSize += vks::tools::alignedVkSize(storageSizes[i], storageAlignment);
+				if (inputs[i].flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR) {
+					updateScratchSize += vks::tools::alignedVkSize(buildSizes[i].updateScratchSize, scratchAlignment);
+				}
+			}
+			storage = allocate(storageSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR);
+			createAccelerationStructures(accelerationStructures, storage, storageSizes);
+			stats.memoryBeforeCompaction = storageSize;
+
+			// Split into batches whose combined scratch memory fits into the budget, a single structure exceeding the budget gets a batch of its own
+			std::vector<uint32_t> batchStarts{ 0 };
+			VkDeviceSize batchScratchSize = 0;
+			VkDeviceSize scratchSize = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				const VkDeviceSize size = vks::tools::alignedVkSize(buildSizes[i].buildScratchSize, scratchAlignment);
+				if ((batchScratchSize > 0) && (batchScratchSize + size > scratchBudget)) {
+					batchStarts.push_back(i);
+					batchScratchSize = 0;
+				}
+				batchScratchSize += size;
+				scratchSize = std::max(scratchSize, batchScratchSize);
+			}
+			batchStarts.push_back(count);
+			stats.batchCount = static_cast<uint32_t>(batchStarts.size() - 1);
+			stats.scratchSize = scratchSize;
+			Allocation scratch = allocate(scratchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+			VkQueryPool queryPool{ VK_NULL_HANDLE };
+			if (compact) {
+				VkQueryPoolCreateInfo queryPoolCreateInfo{
+					.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+					.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+					.queryCount = count
+				};
+				VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+			}
+
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (size_t batch = 0; batch + 1 < batchStarts.size(); batch++) {
+				std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
+				std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos;
+				VkDeviceSize scratchOffset = 0;
+				for (uint32_t i = batchStarts[batch]; i < batchStarts[batch + 1]; i++) {
+					VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = getBuildGeometryInfo(i, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+					buildGeometryInfo.dstAccelerationStructure = accelerationStructures[i].handle;
+					buildGeometryInfo.scratchData.deviceAddress = scratch.deviceAddress + scratchOffset;
+					buildGeometryInfos.push_back(buildGeometryInfo);
+					buildRangeInfos.push_back(inputs[i].buildRanges.data());
+					scratchOffset += vks::tools::alignedVkSize(buildSizes[i].buildScratchSize, scratchAlignment);
+				}
+				vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildGeometryInfos.size()), buildGeometryInfos.data(), buildRangeInfos.data());
+				// The next batch reuses the scratch memory
+				buildBarrier(commandBuffer);
+			}
+			if (compact) {
+				std::vector<VkAccelerationStructureKHR> handles;
+				for (auto& accelerationStructure : accelerationStructures) {
+					handles.push_back(accelerationStructure.handle);
+				}
+				vkCmdResetQueryPool(commandBuffer, queryPool, 0, count);
+				vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, count, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+			}
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+			release(scratch);
+
+			stats.buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+			if (compact) {
+				tStart = std::chrono::high_resolution_clock::now();
+
+				std::vector<VkDeviceSize> compactedSizes(count);
+				VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, count, count * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				vkDestroyQueryPool(device, queryPool, nullptr);
+
+				VkDeviceSize compactedStorageSize = 0;
+				for (auto size : compactedSizes) {
+					compactedStorageSize += vks::tools::alignedVkSize(size, storageAlignment);
+				}
+				Allocation compactedStorage = allocate(compactedStorageSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR);
+				std::vector<AccelerationStructure> compactedAccelerationStructures;
+				createAccelerationStructures(compactedAccelerationStructures, compactedStorage, compactedSizes);
+
+				commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				for (uint32_t i = 0; i < count; i++) {
+					VkCopyAccelerationStructureInfoKHR copyInfo{
+						.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+						.src = accelerationStructures[i].handle,
+						.dst = compactedAccelerationStructures[i].handle,
+						.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR
+					};
+					vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+				}
+				vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+
+				for (auto& accelerationStructure : accelerationStructures) {
+					vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
+				}
+				release(storage);
+				storage = compactedStorage;
+				accelerationStructures = compactedAccelerationStructures;
+
+				stats.compactionTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+			stats.memoryAfterCompaction = storage.size;
+
+			// Scratch memory for refits is kept around for the lifetime of the builder
+			if (updateScratchSize > 0) {
+				updateScratch = allocate(updateScratchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			}
+		}
+
+		/**
+		* Record an in-place refit of all structures that were built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR
+		*
+		* @note The geometry buffers referenced by the inputs need to contain the updated vertex data, the topology must not change
+		* @note A top level acceleration structure referencing the refit structures needs to be rebuilt or refit afterwards
+		* @param commandBuffer Command buffer to record the refit to
+		* @param frame Frame in flight the command buffer belongs to (used for timing the refit)
+		*/
+		void refit(VkCommandBuffer commandBuffer, uint32_t frame = 0)
+		{
+			std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
+			std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos;
+			VkDeviceSize scratchOffset = 0;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(inputs.size()); i++) {
+				if (!(inputs[i].flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR)) {
+					continue;
+				}
+				VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = getBuildGeometryInfo(i, VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR);
+				buildGeometryInfo.srcAccelerationStructure = accelerationStructures[i].handle;
+				buildGeometryInfo.dstAccelerationStructure = accelerationStructures[i].handle;
+				buildGeometryInfo.scratchData.deviceAddress = updateScratch.deviceAddress + scratchOffset;
+				buildGeometryInfos.push_back(buildGeometryInfo);
+				buildRangeInfos.push_back(inputs[i].buildRanges.data());
+				scratchOffset += vks::tools::alignedVkSize(buildSizes[i].updateScratchSize, scratchAlignment);
+			}
+			if (buildGeometryInfos.empty()) {
+				return;
+			}
+			timestamps.reset(commandBuffer, frame);
+			timestamps.begin(commandBuffer, frame, 0, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+			vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildGeometryInfos.size()), buildGeometryInfos.data(), buildRangeInfos.data());
+			timestamps.end(commandBuffer, frame, 0, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+			buildBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+		}
+
+		/** @brief Update the refit time from the timestamps of the given frame, call after that frame's fence has been signaled */
+		void fetchRefitTime(uint32_t frame)
+		{
+			if (timestamps.fetch(frame)) {
+				stats.refitTime = timestamps.durations[0];
+			}
+		}
+
+		void destroy()
+		{
+			for (auto& accelerationStructure : accelerationStructures) {
+				vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
+			}
+			accelerationStructures.clear();
+			inputs.clear();
+			release(storage);
+			release(updateScratch);
+			timestamps.destroy();
+		}
+	};
+}
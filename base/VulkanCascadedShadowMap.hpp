@@ -0,0 +1,543 @@
+/*
+* Vulkan cascaded shadow map class
+*
+* Layered depth map for directional light shadows with stable cascade fitting, per-cascade culling and caching
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanTimestampQuery.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Cascaded shadow map for a directional light
+	* @note Owns the layered depth image, the render passes and framebuffers used to render the cascades
+	* @note Cascades are fitted to the camera frustum splits, snapped to the shadow map texel grid and their depth range is fitted to the scene bounds
+	* @note A cascade keeps its content and is not rendered again as long as its frustum split stays inside the area its layer was rendered for
+	* @note Without a guard band the projection follows every texel sized camera move, so with a moving camera cascades are only cached while the camera stands still
+	*/
+	class CascadedShadowMap
+	{
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkFramebuffer multiviewFrameBuffer{ VK_NULL_HANDLE };
+		// Light space volume the current content of a layer was rendered with
+		struct RenderedVolume {
+			glm::mat4 viewProjMatrix{ 1.0f };
+			glm::mat4 lightViewMatrix{ 1.0f };
+			glm::vec3 center{ 0.0f };
+			float halfExtent{ 0.0f };
+			float nearPlane{ 0.0f };
+			float farPlane{ 0.0f };
+		};
+		std::vector<RenderedVolume> renderedVolumes;
+		std::vector<bool> layerValid;
+		glm::mat4 lightViewMatrix{ 1.0f };
+
+		void markRendered(uint32_t index)
+		{
+			const Cascade& cascade = cascades[index];
+			renderedVolumes[index] = { cascade.viewProjMatrix, lightViewMatrix, cascade.center, cascade.halfExtent, cascade.nearPlane, cascade.farPlane };
+			layerValid[index] = true;
+		}
+
+		// True if the layer's content covers a split's light space bounding sphere and all casters in front of it at no lower resolution than a new projection
+		bool coversSplit(uint32_t index, const glm::vec3& center, float radius, float paddedRadius, float sceneNear) const
+		{
+			const RenderedVolume& volume = renderedVolumes[index];
+			if (!layerValid[index] || (volume.lightViewMatrix != lightViewMatrix) || (volume.halfExtent > paddedRadius * 1.001f)) {
+				return false;
+			}
+			return (std::abs(center.x - volume.center.x) + radius <= volume.halfExtent) && (std::abs(center.y - volume.center.y) + radius <= volume.halfExtent)
+				&& (volume.nearPlane <= sceneNear) && (-center.z + radius <= volume.farPlane);
+		}
+		TimestampQuery timestamps;
+
+		VkRenderPass createRenderPass(uint32_t viewMask)
+		{
+			VkAttachmentDescription attachmentDescription{
+				.format = depthFormat,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			};
+			VkAttachmentReference depthReference{ .attachment = 0, .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			VkSubpassDescription subpass{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.pDepthStencilAttachment = &depthReference
+			};
+			// Layout transitions and synchronization with the passes sampling the shadow map are done via subpass dependencies
+			std::array<VkSubpassDependency, 2> dependencies{};
+			dependencies[0] = {
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+			};
+			dependencies[1] = {
+				.srcSubpass = 0,
+				.dstSubpass = VK_SUBPASS_EXTERNAL,
+				.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+			};
+			VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+			renderPassCI.attachmentCount = 1;
+			renderPassCI.pAttachments = &attachmentDescription;
+			renderPassCI.subpassCount = 1;
+			renderPassCI.pSubpasses = &subpass;
+			renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderPassCI.pDependencies = dependencies.data();
+			// With multiview, each bit of the view mask renders the subpass to the corresponding layer of the attachment
+			VkRenderPassMultiviewCreateInfo renderPassMultiviewCI{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+				.subpassCount = 1,
+				.pViewMasks = &viewMask,
+				.correlationMaskCount = 1,
+				.pCorrelationMasks = &viewMask
+			};
+			if (viewMask != 0) {
+				renderPassCI.pNext = &renderPassMultiviewCI;
+			}
+			VkRenderPass pass{ VK_NULL_HANDLE };
+			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassCI, nullptr, &pass));
+			return pass;
+		}
+
+	public:
+		/** @brief Passed to the draw callback instead of a cascade index when all cascades are rendered in a single multiview pass */
+		static constexpr uint32_t AllCascades = UINT32_MAX;
+
+		struct Cascade {
+			// View space depth of the far end of the cascade's frustum split (negative)
+			float splitDepth{ 0.0f };
+			glm::mat4 viewProjMatrix{ 1.0f };
+			// Light space extents used for culling: center of the orthographic projection, its half size and the depth range
+			glm::vec3 center{ 0.0f };
+			float halfExtent{ 0.0f };
+			float nearPlane{ 0.0f };
+			float farPlane{ 0.0f };
+			// True if the cascade's projection changed since its layer was last rendered
+			bool dirty{ true };
+			// Statistics of the last recorded frame
+			bool rendered{ false };
+			uint32_t drawCount{ 0 };
+			float gpuTime{ 0.0f };
+			VkImageView view{ VK_NULL_HANDLE };
+			VkFramebuffer frameBuffer{ VK_NULL_HANDLE };
+		};
+		std::vector<Cascade> cascades;
+
+		uint32_t dim{ 0 };
+		VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+		VkImage image{ VK_NULL_HANDLE };
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		// View containing all cascade layers, used for sampling
+		VkImageView view{ VK_NULL_HANDLE };
+		VkSampler sampler{ VK_NULL_HANDLE };
+		// Render pass for rendering a single cascade layer
+		VkRenderPass renderPass{ VK_NULL_HANDLE };
+		// Render pass rendering all cascade layers at once with one view per cascade, only available if multiview is supported
+		VkRenderPass multiviewRenderPass{ VK_NULL_HANDLE };
+
+		// Blend factor between logarithmic and uniform frustum splits
+		float splitLambda{ 0.95f };
+		// Snap the cascades to the shadow map texel grid to avoid shimmering edges when the camera moves
+		bool stabilize{ true };
+		// Keep the content of cascades whose split is still covered by their layer instead of rendering them again
+		bool skipUnchanged{ true };
+		// Fraction of a split's radius added around a cascade while skipUnchanged is set, trades shadow resolution for cache hits with a moving camera
+		float cacheGuardBand{ 0.1f };
+		// Render all cascades in one multiview pass (only used if multiview was enabled at creation time)
+		bool useMultiview{ false };
+		bool multiviewSupported{ false };
+
+		// Total GPU time of the last fetched frame's shadow passes in milliseconds
+		float gpuTime{ 0.0f };
+
+		/**
+		* Create the layered depth map and the resources required to render it
+		*
+		* @param vulkanDevice Device to create the resources on
+		* @param queueFamilyIndex Queue family of the command buffers the cascades are rendered with (for timestamps)
+		* @param dim Width and height of each cascade's depth map
+		* @param cascadeCount Number of cascades (layers)
+		* @param frameCount Number of frames in flight
+		* @param multiview True if the multiview feature has been enabled on the device
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t dim, uint32_t cascadeCount, uint32_t frameCount, bool multiview)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->dim = dim;
+			VkDevice device = vulkanDevice->logicalDevice;
+			cascades.resize(cascadeCount);
+			renderedVolumes.resize(cascadeCount);
+			layerValid.resize(cascadeCount, false);
+			multiviewSupported = multiview && (cascadeCount <= 32);
+			useMultiview = multiviewSupported;
+			depthFormat = vulkanDevice->getSupportedDepthFormat(true);
+
+			renderPass = createRenderPass(0);
+			if (multiviewSupported) {
+				multiviewRenderPass = createRenderPass((1u << cascadeCount) - 1);
+			}
+
+			// Layered depth image with one layer per cascade
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.extent = { dim, dim, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = cascadeCount;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.format = depthFormat;
+			imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, image, memory, 0));
+
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			viewCI.format = depthFormat;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, cascadeCount };
+			viewCI.image = image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+
+			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+			framebufferCI.attachmentCount = 1;
+			framebufferCI.width = dim;
+			framebufferCI.height = dim;
+			framebufferCI.layers = 1;
+			// One view and framebuffer per cascade layer
+			for (uint32_t i = 0; i < cascadeCount; i++) {
+				viewCI.subresourceRange.baseArrayLayer = i;
+				viewCI.subresourceRange.layerCount = 1;
+				VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &cascades[i].view));
+				framebufferCI.renderPass = renderPass;
+				framebufferCI.pAttachments = &cascades[i].view;
+				VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &cascades[i].frameBuffer));
+			}
+			// The multiview framebuffer uses the view with all layers, the view mask selects the layers to render to
+			if (multiviewSupported) {
+				framebufferCI.renderPass = multiviewRenderPass;
+				framebufferCI.pAttachments = &view;
+				VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewFrameBuffer));
+			}
+
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_LINEAR;
+			samplerCI.minFilter = VK_FILTER_LINEAR;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = samplerCI.addressModeU;
+			samplerCI.addressModeW = samplerCI.addressModeU;
+			samplerCI.maxAnisotropy = 1.0f;
+			samplerCI.maxLod = 1.0f;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+
+			timestamps.create(vulkanDevice, queueFamilyIndex, cascadeCount, frameCount);
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& cascade : cascades) {
+				vkDestroyFramebuffer(device, cascade.frameBuffer, nullptr);
+				vkDestroyImageView(device, cascade.view, nullptr);
+			}
+			if (multiviewFrameBuffer != VK_NULL_HANDLE) {
+				vkDestroyFramebuffer(device, multiviewFrameBuffer, nullptr);
+			}
+			if (multiviewRenderPass != VK_NULL_HANDLE) {
+				vkDestroyRenderPass(device, multiviewRenderPass, nullptr);
+			}
+			vkDestroyRenderPass(device, renderPass, nullptr);
+			vkDestroySampler(device, sampler, nullptr);
+			vkDestroyImageView(device, view, nullptr);
+			vkDestroyImage(device, image, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+			timestamps.destroy();
+			vulkanDevice = nullptr;
+		}
+
+		/** @brief True if the cascades are rendered in a single multiview pass */
+		bool multiviewActive() const
+		{
+			return multiviewSupported && useMultiview;
+		}
+
+		/** @brief Force all cascades to be rendered again, e.g. after scene objects have moved */
+		void invalidate()
+		{
+			std::fill(layerValid.begin(), layerValid.end(), false);
+		}
+
+		/**
+		* Calculate split depths and light space matrices of all cascades
+		* Based on https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
+		*
+		* @param view Camera view matrix
+		* @param projection Camera projection matrix
+		* @param nearClip Camera near plane distance
+		* @param farClip Camera far plane distance
+		* @param lightDir Direction the light travels in
+		* @param sceneMin Minimum of the world space bounds of all shadow casters and receivers
+		* @param sceneMax Maximum of the world space bounds of all shadow casters and receivers
+		*/
+		void update(const glm::mat4& view, const glm::mat4& projection, float nearClip, float farClip, glm::vec3 lightDir, const glm::vec3& sceneMin, const glm::vec3& sceneMax)
+		{
+			const uint32_t cascadeCount = static_cast<uint32_t>(cascades.size());
+			const float clipRange = farClip - nearClip;
+			const float ratio = farClip / nearClip;
+
+			// All cascades share a light view matrix at the origin, so snapping to the texel grid only depends on the cascade's own center
+			lightDir = glm::normalize(lightDir);
+			const glm::vec3 up = (std::abs(lightDir.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			lightViewMatrix = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+
+			// Light space depth range of the scene bounds, casters outside of this range can't cast shadows onto any receiver
+			float sceneNear = FLT_MAX;
+			float sceneFar = -FLT_MAX;
+			for (uint32_t i = 0; i < 8; i++) {
+				const glm::vec3 corner((i & 1) ? sceneMax.x : sceneMin.x, (i & 2) ? sceneMax.y : sceneMin.y, (i & 4) ? sceneMax.z : sceneMin.z);
+				const float depth = -(lightViewMatrix * glm::vec4(corner, 1.0f)).z;
+				sceneNear = std::min(sceneNear, depth);
+				sceneFar = std::max(sceneFar, depth);
+			}
+
+			const glm::mat4 invCam = glm::inverse(projection * view);
+			float lastSplitDist = 0.0f;
+			for (uint32_t i = 0; i < cascadeCount; i++) {
+				// Blend between logarithmic and uniform split distribution
+				const float p = (i + 1) / static_cast<float>(cascadeCount);
+				const float log = nearClip * std::pow(ratio, p);
+				const float uniform = nearClip + clipRange * p;
+				const float d = splitLambda * (log - uniform) + uniform;
+				const float splitDist = (d - nearClip) / clipRange;
+
+				glm::vec3 frustumCorners[8] = {
+					glm::vec3(-1.0f,  1.0f, 0.0f),
+					glm::vec3( 1.0f,  1.0f, 0.0f),
+					glm::vec3( 1.0f, -1.0f, 0.0f),
+					glm::vec3(-1.0f, -1.0f, 0.0f),
+					glm::vec3(-1.0f,  1.0f, 1.0f),
+					glm::vec3( 1.0f,  1.0f, 1.0f),
+					glm::vec3( 1.0f, -1.0f, 1.0f),
+					glm::vec3(-1.0f, -1.0f, 1.0f),
+				};
+				for (uint32_t j = 0; j < 8; j++) {
+					glm::vec4 invCorner = invCam * glm::vec4(frustumCorners[j], 1.0f);
+					frustumCorners[j] = invCorner / invCorner.w;
+				}
+				for (uint32_t j = 0; j < 4; j++) {
+					glm::vec3 dist = frustumCorners[j + 4] - frustumCorners[j];
+					frustumCorners[j + 4] = frustumCorners[j] + (dist * splitDist);
+					frustumCorners[j] = frustumCorners[j] + (dist * lastSplitDist);
+				}
+
+				// Bounding sphere of the split, its radius doesn't change with camera rotation which keeps the texel size constant
+				glm::vec3 frustumCenter(0.0f);
+				for (uint32_t j = 0; j < 8; j++) {
+					frustumCenter += frustumCorners[j];
+				}
+				frustumCenter /= 8.0f;
+				float radius = 0.0f;
+				for (uint32_t j = 0; j < 8; j++) {
+					radius = std::max(radius, glm::length(frustumCorners[j] - frustumCenter));
+				}
+				radius = std::ceil(radius * 16.0f) / 16.0f;
+				const glm::vec3 splitCenter = glm::vec3(lightViewMatrix * glm::vec4(frustumCenter, 1.0f));
+
+				Cascade& cascade = cascades[i];
+				cascade.splitDepth = (nearClip + splitDist * clipRange) * -1.0f;
+				lastSplitDist = splitDist;
+
+				// The guard band lets the split move within the cached layer before the cascade needs to be rendered again
+				const float paddedRadius = skipUnchanged ? radius * (1.0f + cacheGuardBand) : radius;
+				if (skipUnchanged && coversSplit(i, splitCenter, radius, paddedRadius, sceneNear)) {
+					const RenderedVolume& volume = renderedVolumes[i];
+					cascade.center = volume.center;
+					cascade.halfExtent = volume.halfExtent;
+					cascade.nearPlane = volume.nearPlane;
+					cascade.farPlane = volume.farPlane;
+					cascade.viewProjMatrix = volume.viewProjMatrix;
+					cascade.dirty = false;
+					continue;
+				}
+
+				glm::vec3 center = splitCenter;
+				if (stabilize) {
+					// Move the projection in whole texel increments only
+					const float texelSize = (2.0f * paddedRadius) / static_cast<float>(dim);
+					center = glm::floor(center / texelSize) * texelSize;
+				}
+
+				// Tight depth range: everything between the nearest caster and the far end of the cascade's receivers
+				float nearPlane = sceneNear;
+				float farPlane = std::min(sceneFar, -center.z + paddedRadius);
+				if (farPlane <= nearPlane) {
+					nearPlane = -center.z - paddedRadius;
+					farPlane = -center.z + paddedRadius;
+				}
+
+				cascade.center = center;
+				cascade.halfExtent = paddedRadius;
+				cascade.nearPlane = nearPlane;
+				cascade.farPlane = farPlane;
+				cascade.viewProjMatrix = glm::ortho(center.x - paddedRadius, center.x + paddedRadius, center.y - paddedRadius, center.y + paddedRadius, nearPlane, farPlane) * lightViewMatrix;
+				cascade.dirty = !layerValid[i] || (cascade.viewProjMatrix != renderedVolumes[i].viewProjMatrix);
+			}
+		}
+
+		/** @brief Returns true if a world space bounding sphere overlaps the light space volume of the given cascade */
+		bool isVisible(uint32_t cascadeIndex, const glm::vec3& center, float radius) const
+		{
+			const Cascade& cascade = cascades[cascadeIndex];
+			const glm::vec3 pos = glm::vec3(lightViewMatrix * glm::vec4(center, 1.0f));
+			const float extent = cascade.halfExtent + radius;
+			if ((std::abs(pos.x - cascade.center.x) > extent) || (std::abs(pos.y - cascade.center.y) > extent)) {
+				return false;
+			}
+			return (-pos.z + radius >= cascade.nearPlane) && (-pos.z - radius <= cascade.farPlane);
+		}
+
+		/** @brief Returns true if a world space bounding sphere overlaps any cascade, used for culling when rendering all cascades in one pass */
+		bool isVisibleAny(const glm::vec3& center, float radius) const
+		{
+			for (uint32_t i = 0; i < cascades.size(); i++) {
+				if (isVisible(i, center, radius)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		* Read back the GPU times of the given frame's shadow passes
+		*
+		* @note Call after waiting on the frame's fence and before recording the frame's command buffer
+		*/
+		void fetchStats(uint32_t frame)
+		{
+			if (!timestamps.fetch(frame)) {
+				return;
+			}
+			gpuTime = 0.0f;
+			for (uint32_t i = 0; i < cascades.size(); i++) {
+				cascades[i].gpuTime = timestamps.durations[i];
+				gpuTime += timestamps.durations[i];
+			}
+		}
+
+		/**
+		* Record the shadow passes for all cascades that need to be updated
+		*
+		* @param commandBuffer Command buffer to record to, must be outside of a render pass
+		* @param frame Index of the frame in flight (for timestamps)
+		* @param drawCascade Callback that records the draws for a cascade and returns the number of draw calls,
+		* gets passed AllCascades if all cascades are rendered in a single multiview pass
+		*/
+		void render(VkCommandBuffer commandBuffer, uint32_t frame, const std::function<uint32_t(VkCommandBuffer, uint32_t)>& drawCascade)
+		{
+			const uint32_t cascadeCount = static_cast<uint32_t>(cascades.size());
+			timestamps.reset(commandBuffer, frame);
+
+			VkClearValue clearValue{};
+			clearValue.depthStencil = { 1.0f, 0 };
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderArea.extent = { dim, dim };
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = &clearValue;
+
+			VkViewport viewport = vks::initializers::viewport((float)dim, (float)dim, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(dim, dim, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			if (multiviewActive()) {
+				// All views of a multiview pass are rendered, so unchanged cascades can only be skipped if none of them changed
+				bool anyDirty = !skipUnchanged;
+				for (auto& cascade : cascades) {
+					anyDirty |= cascade.dirty;
+				}
+				uint32_t drawCount = 0;
+				timestamps.begin(commandBuffer, frame, 0);
+				if (anyDirty) {
+					renderPassBeginInfo.renderPass = multiviewRenderPass;
+					renderPassBeginInfo.framebuffer = multiviewFrameBuffer;
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					drawCount = drawCascade(commandBuffer, AllCascades);
+					vkCmdEndRenderPass(commandBuffer);
+				}
+				timestamps.end(commandBuffer, frame, 0, anyDirty ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				// Per-cascade times can't be separated within a multiview pass, the whole pass is accounted to the first scope
+				for (uint32_t i = 1; i < cascadeCount; i++) {
+					timestamps.begin(commandBuffer, frame, i);
+					timestamps.end(commandBuffer, frame, i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+				}
+				for (uint32_t i = 0; i < cascadeCount; i++) {
+					cascades[i].rendered = anyDirty;
+					cascades[i].drawCount = drawCount;
+					if (anyDirty) {
+						markRendered(i);
+					}
+				}
+				return;
+			}
+
+			renderPassBeginInfo.renderPass = renderPass;
+			for (uint32_t i = 0; i < cascadeCount; i++) {
+				Cascade& cascade = cascades[i];
+				cascade.rendered = cascade.dirty || !skipUnchanged;
+				cascade.drawCount = 0;
+				timestamps.begin(commandBuffer, frame, i);
+				if (cascade.rendered) {
+					renderPassBeginInfo.framebuffer = cascade.frameBuffer;
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					cascade.drawCount = drawCascade(commandBuffer, i);
+					vkCmdEndRenderPass(commandBuffer);
+					markRendered(i);
+				}
+				// Skipped cascades still write both timestamps so the frame's queries are always available
+				timestamps.end(commandBuffer, frame, i, cascade.rendered ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			}
+		}
+	};
+}
@@ -0,0 +1,491 @@
+/*
+* Vulkan clustered light culling class
+*
+* Assigns point lights to the clusters of a view frustum aligned grid (froxels) in a compute pass
+* Shading passes (deferred or forward) look up the cluster of a fragment and only evaluate the lights of that cluster
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanTimestampQuery.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Clustered light culling for point lights
+	* @note The grid is made of screen space tiles and exponentially distributed view space depth slices, cluster bounds are derived from the projection matrix
+	* @note Each cluster gets an (offset, count) entry into a compact light index list, which is allocated from a global counter
+	* @note Lights and parameters are written by the host for every frame in flight, the grid and the index list are shared by all frames
+	* @note Shaders: base/clustercull.comp, lookup and attenuation for shading passes in base/clusters.glsl
+	*/
+	class ClusteredLights
+	{
+	public:
+		/** @brief Point light, layout matches ClusterLight in base/clusters.glsl */
+		struct Light {
+			// xyz = world space position, w = range (the light has no influence past this distance)
+			glm::vec4 position;
+			// rgb = color, a = intensity
+			glm::vec4 color;
+		};
+
+		/** @brief Per frame parameters, layout matches the ClusterParams block in base/clusters.glsl */
+		struct Params {
+			glm::mat4 view;
+			glm::mat4 inverseProjection;
+			// xyz = number of clusters per axis, w = number of lights
+			glm::uvec4 gridSize;
+			// xy = size of the render target in pixels, z = near plane, w = far plane
+			glm::vec4 screenDepth;
+			// Capacity of the light index list
+			uint32_t indexCapacity;
+		};
+
+		/** @brief Lights per cluster of the last fetched frame */
+		struct Stats {
+			uint32_t lightCount{ 0 };
+			// Clusters with at least one light
+			uint32_t activeClusters{ 0 };
+			uint32_t maxLightsPerCluster{ 0 };
+			// Average over the active clusters
+			float averageLightsPerCluster{ 0.0f };
+			// Number of entries in the light index list
+			uint32_t indexCount{ 0 };
+			// The index list was full and lights have been dropped from clusters
+			bool overflow{ false };
+			// GPU time of the culling pass in milliseconds
+			float cullTime{ 0.0f };
+		};
+
+		/** @brief Result of comparing the GPU light lists against assignReference */
+		struct ValidationResult {
+			uint32_t clusterCount{ 0 };
+			uint32_t mismatchedClusters{ 0 };
+			// Lights that only one side assigned, but which touch the cluster bounds within floating point tolerance (not counted as a mismatch)
+			uint32_t borderlineLights{ 0 };
+			bool overflow{ false };
+		};
+
+		struct FrameResources {
+			// Uniform buffer with the parameters (Params)
+			vks::Buffer params;
+			// Storage buffer with the lights (Light)
+			vks::Buffer lights;
+			// Host visible copy of the counter and the grid for statistics
+			vks::Buffer readback;
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+			bool recorded{ false };
+		};
+
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		TimestampQuery timestamps;
+		// Number of allocated light indices and the overflow flag, layout matches the Counter block in base/clustercull.comp
+		struct Counter {
+			uint32_t indexCount;
+			uint32_t overflow;
+			uint32_t padding[2];
+		};
+		vks::Buffer counterBuffer;
+		// Must match the workgroup size of base/clustercull.comp
+		static constexpr uint32_t workgroupSize = 64;
+
+		static glm::vec3 unproject(const Params& params, glm::vec2 ndc, float viewDepth)
+		{
+			glm::vec4 p = params.inverseProjection * glm::vec4(ndc, 1.0f, 1.0f);
+			glm::vec3 ray = glm::vec3(p) / p.w;
+			return ray * (viewDepth / -ray.z);
+		}
+
+		// Squared distance between a view space point and the bounds of a cluster
+		static float distanceSquared(const Params& params, uint32_t cluster, const glm::vec3& point)
+		{
+			glm::vec3 aabbMin, aabbMax;
+			clusterBounds(params, cluster, aabbMin, aabbMax);
+			glm::vec3 d = point - glm::clamp(point, aabbMin, aabbMax);
+			return glm::dot(d, d);
+		}
+
+		void recordCull(VkCommandBuffer commandBuffer, uint32_t frame)
+		{
+			// Last frame's shading reads of the grid and the index list need to be finished before they're overwritten
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frames[frame].descriptorSet, 0, nullptr);
+			vkCmdDispatch(commandBuffer, (clusterCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+	public:
+		std::vector<FrameResources> frames;
+		/** @brief Offset and number of lights for each cluster (uvec2) */
+		vks::Buffer grid;
+		/** @brief Compact list of light indices, each cluster's lights are stored consecutively */
+		vks::Buffer indices;
+		glm::uvec3 gridSize{ 16, 9, 24 };
+		uint32_t clusterCount{ 0 };
+		uint32_t maxLights{ 0 };
+		uint32_t indexCapacity{ 0 };
+		Stats stats;
+
+		/**
+		* Create the buffers
+		*
+		* @param vulkanDevice Device to create the resources on
+		* @param queueFamilyIndex Queue family of the command buffers the culling is recorded to (for timestamps)
+		* @param maxLights Maximum number of lights
+		* @param frameCount Number of frames in flight
+		* @param gridSize (Optional) Number of clusters per axis
+		* @param averageLightsPerCluster (Optional) Size of the light index list relative to the number of clusters
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t maxLights, uint32_t frameCount, glm::uvec3 gridSize = { 16, 9, 24 }, uint32_t averageLightsPerCluster = 128)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->maxLights = maxLights;
+			this->gridSize = gridSize;
+			clusterCount = gridSize.x * gridSize.y * gridSize.z;
+			indexCapacity = clusterCount * averageLightsPerCluster;
+
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid, clusterCount * sizeof(glm::uvec2)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indices, indexCapacity * sizeof(uint32_t)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, sizeof(Counter)));
+			frames.resize(frameCount);
+			for (auto& frame : frames) {
+				// Lights are animated on the host, so they're read by the GPU straight from host visible memory
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.params, sizeof(Params)));
+				VK_CHECK_RESULT(frame.params.map());
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.lights, maxLights * sizeof(Light)));
+				VK_CHECK_RESULT(frame.lights.map());
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.readback, sizeof(Counter) + clusterCount * sizeof(glm::uvec2)));
+				VK_CHECK_RESULT(frame.readback.map());
+			}
+			timestamps.create(vulkanDevice, queueFamilyIndex, 1, frameCount);
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& frame : frames) {
+				frame.params.destroy();
+				frame.lights.destroy();
+				frame.readback.destroy();
+			}
+			frames.clear();
+			grid.destroy();
+			indices.destroy();
+			counterBuffer.destroy();
+			timestamps.destroy();
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vulkanDevice = nullptr;
+		}
+
+		/**
+		* Create the culling pipeline and the descriptor sets for all frames
+		*
+		* @param shaderStage Compute shader stage of base/clustercull.comp
+		* @param pipelineCache Optional pipeline cache
+		*/
+		void preparePipeline(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			const uint32_t frameCount = static_cast<uint32_t>(frames.size());
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount * 4),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, frameCount);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				// Binding 0 : Parameters
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				// Binding 1 : Lights
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				// Binding 2 : Grid
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				// Binding 3 : Light index list
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+				// Binding 4 : Index list counter
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			};
+			VkDescriptorSetLayoutCreateInfo setLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &descriptorSetLayout));
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			for (auto& frame : frames) {
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.descriptorSet));
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.params.descriptor),
+					vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &frame.lights.descriptor),
+					vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &grid.descriptor),
+					vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indices.descriptor),
+					vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &counterBuffer.descriptor),
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			}
+
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+		}
+
+		/** @brief Mapped light buffer of the given frame, holds up to maxLights lights */
+		Light* lights(uint32_t frame)
+		{
+			return static_cast<Light*>(frames[frame].lights.mapped);
+		}
+
+		/** @brief Parameters last written for the given frame */
+		const Params& params(uint32_t frame) const
+		{
+			return *static_cast<const Params*>(frames[frame].params.mapped);
+		}
+
+		/**
+		* Write the parameters of the given frame
+		*
+		* @param frame Index of the frame in flight
+		* @param view View matrix of the camera
+		* @param projection Projection matrix of the camera
+		* @param zNear Near plane of the projection
+		* @param zFar Far plane of the projection
+		* @param width Width of the render target in pixels
+		* @param height Height of the render target in pixels
+		* @param lightCount Number of lights written to the frame's light buffer
+		*/
+		void update(uint32_t frame, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, uint32_t width, uint32_t height, uint32_t lightCount)
+		{
+			Params params{
+				.view = view,
+				.inverseProjection = glm::inverse(projection),
+				.gridSize = glm::uvec4(gridSize, std::min(lightCount, maxLights)),
+				.screenDepth = glm::vec4((float)width, (float)height, zNear, zFar),
+				.indexCapacity = indexCapacity
+			};
+			memcpy(frames[frame].params.mapped, &params, sizeof(Params));
+		}
+
+		/**
+		* Record the culling pass, must be recorded outside of a render pass before the shading passes that read the clusters
+		*
+		* @param commandBuffer Command buffer to record to
+		* @param frame Index of the frame in flight (parameters, lights and timestamps)
+		*/
+		void cull(VkCommandBuffer commandBuffer, uint32_t frame)
+		{
+			timestamps.reset(commandBuffer, frame);
+			timestamps.begin(commandBuffer, frame, 0);
+			recordCull(commandBuffer, frame);
+			timestamps.end(commandBuffer, frame, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			VkBufferCopy copyRegions[2] = {
+				{ 0, 0, sizeof(Counter) },
+				{ 0, sizeof(Counter), clusterCount * sizeof(glm::uvec2) }
+			};
+			vkCmdCopyBuffer(commandBuffer, counterBuffer.buffer, frames[frame].readback.buffer, 1, &copyRegions[0]);
+			vkCmdCopyBuffer(commandBuffer, grid.buffer, frames[frame].readback.buffer, 1, &copyRegions[1]);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			frames[frame].recorded = true;
+		}
+
+		/**
+		* Update the statistics from the given frame's culling pass
+		*
+		* @note Call after waiting on the frame's fence and before recording the frame's command buffer, frames without a culling pass are skipped
+		*/
+		void fetchStats(uint32_t frame)
+		{
+			if (!frames[frame].recorded) {
+				return;
+			}
+			frames[frame].recorded = false;
+			if (timestamps.fetch(frame)) {
+				stats.cullTime = timestamps.durations[0];
+			}
+			const Counter* counter = static_cast<const Counter*>(frames[frame].readback.mapped);
+			const glm::uvec2* clusters = reinterpret_cast<const glm::uvec2*>(static_cast<const uint8_t*>(frames[frame].readback.mapped) + sizeof(Counter));
+			stats.lightCount = params(frame).gridSize.w;
+			stats.indexCount = std::min(counter->indexCount, indexCapacity);
+			stats.overflow = counter->overflow != 0;
+			stats.activeClusters = 0;
+			stats.maxLightsPerCluster = 0;
+			for (uint32_t i = 0; i < clusterCount; i++) {
+				if (clusters[i].y > 0) {
+					stats.activeClusters++;
+					stats.maxLightsPerCluster = std::max(stats.maxLightsPerCluster, clusters[i].y);
+				}
+			}
+			stats.averageLightsPerCluster = (stats.activeClusters > 0) ? (float)stats.indexCount / (float)stats.activeClusters : 0.0f;
+		}
+
+		/** @brief View space depth at the near side of a depth slice, slices are distributed exponentially between the near and the far plane */
+		static float clusterSliceDepth(const Params& params, uint32_t slice)
+		{
+			return params.screenDepth.z * std::pow(params.screenDepth.w / params.screenDepth.z, (float)slice / (float)params.gridSize.z);
+		}
+
+		/** @brief View space bounds of a cluster, same math as clusterBounds in base/clusters.glsl */
+		static void clusterBounds(const Params& params, uint32_t cluster, glm::vec3& aabbMin, glm::vec3& aabbMax)
+		{
+			const glm::uvec3 c(cluster % params.gridSize.x, (cluster / params.gridSize.x) % params.gridSize.y, cluster / (params.gridSize.x * params.gridSize.y));
+			const glm::vec2 ndcMin = glm::vec2(c.x, c.y) / glm::vec2(params.gridSize.x, params.gridSize.y) * 2.0f - 1.0f;
+			const glm::vec2 ndcMax = glm::vec2(c.x + 1, c.y + 1) / glm::vec2(params.gridSize.x, params.gridSize.y) * 2.0f - 1.0f;
+			const float depths[2] = { clusterSliceDepth(params, c.z), clusterSliceDepth(params, c.z + 1) };
+			aabbMin = glm::vec3(FLT_MAX);
+			aabbMax = glm::vec3(-FLT_MAX);
+			for (float depth : depths) {
+				for (uint32_t i = 0; i < 4; i++) {
+					glm::vec3 p = unproject(params, glm::vec2((i & 1) ? ndcMax.x : ndcMin.x, (i & 2) ? ndcMax.y : ndcMin.y), depth);
+					aabbMin = glm::min(aabbMin, p);
+					aabbMax = glm::max(aabbMax, p);
+				}
+			}
+		}
+
+		/**
+		* Assign lights to clusters on the host, reference for validating the culling shader
+		*
+		* @param params Parameters the GPU pass was recorded with
+		* @param lights Lights the GPU pass was recorded with (params.gridSize.w lights)
+		* @param grid Offset and number of lights per cluster
+		* @param indices Light index list, each cluster's lights are in ascending order like in the culling shader
+		*
+		* @note Clusters are stored in order, so offsets differ from the GPU's (which depend on the order clusters allocate from the counter)
+		*/
+		static void assignReference(const Params& params, const Light* lights, std::vector<glm::uvec2>& grid, std::vector<uint32_t>& indices)
+		{
+			const uint32_t clusterCount = params.gridSize.x * params.gridSize.y * params.gridSize.z;
+			std::vector<glm::vec4> viewLights(params.gridSize.w);
+			for (uint32_t i = 0; i < params.gridSize.w; i++) {
+				viewLights[i] = glm::vec4(glm::vec3(params.view * glm::vec4(glm::vec3(lights[i].position), 1.0f)), lights[i].position.w);
+			}
+			grid.resize(clusterCount);
+			indices.clear();
+			for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+				glm::vec3 aabbMin, aabbMax;
+				clusterBounds(params, cluster, aabbMin, aabbMax);
+				grid[cluster] = glm::uvec2(static_cast<uint32_t>(indices.size()), 0);
+				for (uint32_t i = 0; i < params.gridSize.w; i++) {
+					glm::vec3 center(viewLights[i]);
+					glm::vec3 d = center - glm::clamp(center, aabbMin, aabbMax);
+					if (glm::dot(d, d) <= viewLights[i].w * viewLights[i].w) {
+						indices.push_back(i);
+						grid[cluster].y++;
+					}
+				}
+			}
+		}
+
+		/**
+		* Run the culling pass for the given frame's parameters and lights and compare the light lists against assignReference
+		*
+		* @param queue Queue to run the pass on
+		* @param frame Frame in flight whose parameters and lights are used
+		*
+		* @note Overwrites the grid and the index list, the device must be idle
+		*/
+		ValidationResult validate(VkQueue queue, uint32_t frame)
+		{
+			const VkDeviceSize gridSize = clusterCount * sizeof(glm::uvec2);
+			const VkDeviceSize indicesSize = indexCapacity * sizeof(uint32_t);
+			vks::Buffer staging;
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, sizeof(Counter) + gridSize + indicesSize));
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			recordCull(commandBuffer, frame);
+			VkBufferCopy copyRegions[3] = {
+				{ 0, 0, sizeof(Counter) },
+				{ 0, sizeof(Counter), gridSize },
+				{ 0, sizeof(Counter) + gridSize, indicesSize }
+			};
+			vkCmdCopyBuffer(commandBuffer, counterBuffer.buffer, staging.buffer, 1, &copyRegions[0]);
+			vkCmdCopyBuffer(commandBuffer, grid.buffer, staging.buffer, 1, &copyRegions[1]);
+			vkCmdCopyBuffer(commandBuffer, indices.buffer, staging.buffer, 1, &copyRegions[2]);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+			VK_CHECK_RESULT(staging.map());
+			const uint8_t* data = static_cast<const uint8_t*>(staging.mapped);
+			const Counter* counter = reinterpret_cast<const Counter*>(data);
+			const glm::uvec2* gpuGrid = reinterpret_cast<const glm::uvec2*>(data + sizeof(Counter));
+			const uint32_t* gpuIndices = reinterpret_cast<const uint32_t*>(data + sizeof(Counter) + gridSize);
+
+			const Params& frameParams = params(frame);
+			std::vector<glm::uvec2> referenceGrid;
+			std::vector<uint32_t> referenceIndices;
+			assignReference(frameParams, lights(frame), referenceGrid, referenceIndices);
+
+			ValidationResult result{ .clusterCount = clusterCount, .overflow = counter->overflow != 0 };
+			for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+				// Both lists are sorted, lights missing on either side are found with a merge
+				const uint32_t* a = &gpuIndices[gpuGrid[cluster].x];
+				const uint32_t* b = referenceIndices.data() + referenceGrid[cluster].x;
+				uint32_t countA = gpuGrid[cluster].y, countB = referenceGrid[cluster].y;
+				uint32_t ia = 0, ib = 0;
+				bool mismatch = false;
+				while ((ia < countA) || (ib < countB)) {
+					uint32_t light;
+					if ((ib == countB) || ((ia < countA) && (a[ia] < b[ib]))) {
+						light = a[ia++];
+					} else if ((ia == countA) || (b[ib] < a[ia])) {
+						light = b[ib++];
+					} else {
+						ia++;
+						ib++;
+						continue;
+					}
+					// GPU and host transcendental functions differ in the last bits, so a light exactly touching the bounds may end up on either side
+					const Light& l = lights(frame)[light];
+					const float range = l.position.w;
+					const float distance = std::sqrt(distanceSquared(frameParams, cluster, glm::vec3(frameParams.view * glm::vec4(glm::vec3(l.position), 1.0f))));
+					if (std::abs(distance - range) <= 1e-3f * std::max(range, 1.0f)) {
+						result.borderlineLights++;
+					} else {
+						mismatch = true;
+					}
+				}
+				if (mismatch) {
+					result.mismatchedClusters++;
+				}
+			}
+			staging.destroy();
+			return result;
+		}
+	};
+}
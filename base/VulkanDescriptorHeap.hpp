@@ -0,0 +1,305 @@
+/*
+* Vulkan descriptor heap class
+*
+* A single update-after-bind descriptor set with large arrays of textures, sampled images, samplers and storage buffers
+* Resources are referenced in shaders by stable indices instead of per-object descriptor sets
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Bindless descriptor heap shared by everything an example renders
+	* @note The heap's set is bound once per command buffer, resources are selected with indices (e.g. passed as push constants) and nonuniformEXT in shaders
+	* @note Freed indices are only handed out again once all frames in flight that might still access them have completed (see beginFrame)
+	*/
+	class DescriptorHeap
+	{
+	public:
+		/** @brief Bindings of the heap's descriptor set, one unsized array per resource type */
+		enum Binding : uint32_t {
+			// layout (set = n, binding = 0) uniform sampler2D textures[];
+			Textures = 0,
+			// layout (set = n, binding = 1) uniform texture2D images[];
+			Images = 1,
+			// layout (set = n, binding = 2) uniform sampler samplers[];
+			Samplers = 2,
+			// layout (set = n, binding = 3) buffer Buffers { ... } buffers[];
+			StorageBuffers = 3,
+			BindingCount = 4
+		};
+		static constexpr uint32_t invalidIndex{ UINT32_MAX };
+
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+		struct Stats {
+			std::array<uint32_t, BindingCount> capacity{};
+			std::array<uint32_t, BindingCount> used{};
+			/** @brief Indices waiting for their frame to complete before being recycled */
+			uint32_t pendingFrees{ 0 };
+			/** @brief Descriptor writes since creation, with a heap this only happens when resources are added */
+			uint32_t descriptorWrites{ 0 };
+		} stats;
+
+	private:
+		struct Range {
+			uint32_t capacity{ 0 };
+			// Indices below this have been handed out at least once
+			uint32_t next{ 0 };
+			std::vector<uint32_t> freeList;
+		};
+		struct PendingFree {
+			Binding binding;
+			uint32_t index;
+		};
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		std::array<Range, BindingCount> ranges{};
+		// Frees are queued for the frame in flight they were issued in
+		std::vector<std::vector<PendingFree>> pendingFrees;
+		uint32_t currentFrame{ 0 };
+
+		static VkDescriptorType descriptorType(Binding binding)
+		{
+			switch (binding) {
+			case Textures:
+				return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case Images:
+				return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			case Samplers:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			default:
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+		}
+
+		uint32_t allocate(Binding binding)
+		{
+			Range& range = ranges[binding];
+			uint32_t index;
+			if (!range.freeList.empty()) {
+				index = range.freeList.back();
+				range.freeList.pop_back();
+			} else {
+				if (range.next >= range.capacity) {
+					vks::tools::exitFatal("Descriptor heap is out of descriptors for binding " + std::to_string(binding), -1);
+				}
+				index = range.next++;
+			}
+			stats.used[binding]++;
+			return index;
+		}
+
+		void write(Binding binding, uint32_t index, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo)
+		{
+			VkWriteDescriptorSet writeDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = descriptorSet,
+				.dstBinding = binding,
+				.dstArrayElement = index,
+				.descriptorCount = 1,
+				.descriptorType = descriptorType(binding),
+				.pImageInfo = imageInfo,
+				.pBufferInfo = bufferInfo
+			};
+			vkUpdateDescriptorSets(vulkanDevice->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+			stats.descriptorWrites++;
+		}
+
+	public:
+		/**
+		* Check if the device supports everything the heap needs and enable it
+		*
+		* @param supportedFeatures Vulkan 1.2 features supported by the physical device
+		* @param enabledFeatures Vulkan 1.2 features to be passed to device creation, the heap's features are added if supported
+		*
+		* @return True if the heap can be used on this device
+		*/
+		static bool getRequiredFeatures(const VkPhysicalDeviceVulkan12Features& supportedFeatures, VkPhysicalDeviceVulkan12Features& enabledFeatures)
+		{
+			const bool supported = supportedFeatures.runtimeDescriptorArray && supportedFeatures.descriptorBindingPartiallyBound && supportedFeatures.descriptorBindingUpdateUnusedWhilePending
+				&& supportedFeatures.descriptorBindingSampledImageUpdateAfterBind && supportedFeatures.descriptorBindingStorageBufferUpdateAfterBind
+				&& supportedFeatures.shaderSampledImageArrayNonUniformIndexing && supportedFeatures.shaderStorageBufferArrayNonUniformIndexing;
+			if (supported) {
+				enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+				enabledFeatures.runtimeDescriptorArray = VK_TRUE;
+				enabledFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+				enabledFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+				enabledFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+				enabledFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+				enabledFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+				enabledFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+			}
+			return supported;
+		}
+
+		/**
+		* Create the heap's descriptor pool, layout and set
+		*
+		* @param vulkanDevice Device to create the heap on, must have been created with the features from getRequiredFeatures
+		* @param frameCount Number of frames in flight, freed indices are recycled after this many frames
+		* @param maxTextures (Optional) Number of combined image sampler descriptors
+		* @param maxImages (Optional) Number of sampled image descriptors
+		* @param maxSamplers (Optional) Number of sampler descriptors
+		* @param maxStorageBuffers (Optional) Number of storage buffer descriptors
+		*
+		* @note Capacities are clamped to the device's update-after-bind limits
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t frameCount, uint32_t maxTextures = 4096, uint32_t maxImages = 1024, uint32_t maxSamplers = 64, uint32_t maxStorageBuffers = 4096)
+		{
+			this->vulkanDevice = vulkanDevice;
+
+			VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+			VkPhysicalDeviceProperties2 deviceProperties2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &indexingProperties };
+			vkGetPhysicalDeviceProperties2(vulkanDevice->physicalDevice, &deviceProperties2);
+			// Combined image samplers count against both the sampled image and the sampler limits
+			const uint32_t maxSampledImages = std::min(indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+			const uint32_t maxSamplerDescriptors = std::min(indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers);
+			ranges[Textures].capacity = std::max(std::min({ maxTextures, maxSampledImages / 2, maxSamplerDescriptors / 2 }), 1u);
+			ranges[Images].capacity = std::max(std::min(maxImages, maxSampledImages - ranges[Textures].capacity), 1u);
+			ranges[Samplers].capacity = std::max(std::min(maxSamplers, maxSamplerDescriptors - ranges[Textures].capacity), 1u);
+			ranges[StorageBuffers].capacity = std::max(std::min({ maxStorageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers }), 1u);
+
+			std::array<VkDescriptorPoolSize, BindingCount> poolSizes{};
+			std::array<VkDescriptorSetLayoutBinding, BindingCount> setLayoutBindings{};
+			std::array<VkDescriptorBindingFlags, BindingCount> bindingFlags{};
+			for (uint32_t i = 0; i < BindingCount; i++) {
+				const VkDescriptorType type = descriptorType(static_cast<Binding>(i));
+				poolSizes[i] = { type, ranges[i].capacity };
+				setLayoutBindings[i] = { .binding = i, .descriptorType = type, .descriptorCount = ranges[i].capacity, .stageFlags = VK_SHADER_STAGE_ALL };
+				// Not all indices are written, and descriptors not used by pending command buffers may be written while the set is bound
+				bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+				stats.capacity[i] = ranges[i].capacity;
+			}
+
+			VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+			descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+			VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+			VkDescriptorSetLayoutBindingFlagsCreateInfo setLayoutBindingFlags{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+				.bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+				.pBindingFlags = bindingFlags.data()
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			descriptorSetLayoutCI.pNext = &setLayoutBindingFlags;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
+
+			pendingFrees.resize(frameCount);
+		}
+
+		void destroy()
+		{
+			if (!valid()) {
+				return;
+			}
+			vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
+			descriptorSetLayout = VK_NULL_HANDLE;
+			descriptorPool = VK_NULL_HANDLE;
+			descriptorSet = VK_NULL_HANDLE;
+			ranges = {};
+			pendingFrees.clear();
+			stats = {};
+		}
+
+		/** @brief True if the heap has been created */
+		bool valid() const
+		{
+			return descriptorPool != VK_NULL_HANDLE;
+		}
+
+		/** @brief Add a combined image sampler and return its index in the textures array */
+		uint32_t addTexture(const VkDescriptorImageInfo& descriptor)
+		{
+			const uint32_t index = allocate(Textures);
+			write(Textures, index, &descriptor, nullptr);
+			return index;
+		}
+
+		/** @brief Add a sampled image (to be combined with one of the heap's samplers in the shader) and return its index in the images array */
+		uint32_t addImage(VkImageView view, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			const uint32_t index = allocate(Images);
+			const VkDescriptorImageInfo descriptor{ VK_NULL_HANDLE, view, imageLayout };
+			write(Images, index, &descriptor, nullptr);
+			return index;
+		}
+
+		/** @brief Add a sampler and return its index in the samplers array */
+		uint32_t addSampler(VkSampler sampler)
+		{
+			const uint32_t index = allocate(Samplers);
+			const VkDescriptorImageInfo descriptor{ sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+			write(Samplers, index, &descriptor, nullptr);
+			return index;
+		}
+
+		/** @brief Add a storage buffer (range) and return its index in the buffers array */
+		uint32_t addStorageBuffer(const VkDescriptorBufferInfo& descriptor)
+		{
+			const uint32_t index = allocate(StorageBuffers);
+			write(StorageBuffers, index, nullptr, &descriptor);
+			return index;
+		}
+
+		/**
+		* Release an index, the index is recycled once the current frame in flight has completed
+		*
+		* @note The resource itself may only be destroyed once the GPU no longer uses it, the heap does not track that
+		*/
+		void free(Binding binding, uint32_t index)
+		{
+			if (!valid() || index == invalidIndex) {
+				return;
+			}
+			assert(index < ranges[binding].next);
+			pendingFrees[currentFrame].push_back({ binding, index });
+			stats.used[binding]--;
+			stats.pendingFrees++;
+		}
+
+		/**
+		* Start a new frame, call after waiting on the frame's fence
+		*
+		* @param frame Index of the frame in flight, indices freed the last time this frame was active are recycled
+		*/
+		void beginFrame(uint32_t frame)
+		{
+			if (!valid()) {
+				return;
+			}
+			currentFrame = frame % static_cast<uint32_t>(pendingFrees.size());
+			// Fences signal in submission order, so everything submitted before this frame's fence has completed as well
+			for (const PendingFree& pendingFree : pendingFrees[currentFrame]) {
+				ranges[pendingFree.binding].freeList.push_back(pendingFree.index);
+			}
+			stats.pendingFrees -= static_cast<uint32_t>(pendingFrees[currentFrame].size());
+			pendingFrees[currentFrame].clear();
+		}
+
+		/** @brief Bind the heap's descriptor set, this is the only descriptor set bind needed for all resources in the heap */
+		void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+		}
+	};
+}
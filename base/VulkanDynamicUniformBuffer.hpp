@@ -0,0 +1,185 @@
+/*
+* Vulkan dynamic uniform buffer class
+*
+* Per-object uniform data stored with the device's dynamic offset alignment in persistently mapped buffers (one per frame in flight)
+* Objects are written directly to mapped memory, only objects marked as dirty are written and flushed
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Strided per-object uniform data for use with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+	* @note There is no host side copy of the data, dirty objects are written by a callback straight into the mapped buffer of the current frame
+	* @note As every frame in flight has its own buffer, an object marked as dirty is written once for each of them
+	*/
+	template <typename T>
+	class DynamicUniformBuffer
+	{
+	private:
+		std::vector<vks::Buffer> buffers;
+		// One bit per object and frame in flight
+		std::vector<std::vector<uint64_t>> dirtyMasks;
+		uint32_t count{ 0 };
+		VkDeviceSize nonCoherentAtomSize{ 1 };
+		bool coherent{ false };
+
+		// Flush a range of objects, aligned to the non coherent atom size as required by the spec
+		void flushRange(vks::Buffer& buffer, uint32_t first, uint32_t last)
+		{
+			VkDeviceSize offset = first * stride;
+			VkDeviceSize end = last * stride;
+			offset = offset - (offset % nonCoherentAtomSize);
+			end = ((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize;
+			VK_CHECK_RESULT(buffer.flush(end >= buffer.size ? VK_WHOLE_SIZE : end - offset, offset));
+			stats.bytesFlushed += std::min(end, buffer.size) - offset;
+			stats.flushCount++;
+		}
+	public:
+		/** @brief Distance between two objects in bytes, a multiple of minUniformBufferOffsetAlignment */
+		VkDeviceSize stride{ 0 };
+		/** @brief Dirty objects closer than this are flushed with a single range */
+		uint32_t mergeDistance{ 8 };
+
+		/** @brief Statistics of the last update */
+		struct Stats {
+			uint32_t objectsWritten{ 0 };
+			VkDeviceSize bytesWritten{ 0 };
+			VkDeviceSize bytesFlushed{ 0 };
+			uint32_t flushCount{ 0 };
+		} stats;
+
+		/**
+		* Create the per-frame buffers and map them persistently
+		*
+		* @param vulkanDevice Device to create the buffers on
+		* @param count Number of objects
+		* @param frameCount Number of frames in flight
+		* @param memoryPropertyFlags Memory properties, must include VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t count, uint32_t frameCount, VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			assert(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			this->count = count;
+			const VkDeviceSize minUboAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
+			stride = sizeof(T);
+			if (minUboAlignment > 0) {
+				stride = (stride + minUboAlignment - 1) & ~(minUboAlignment - 1);
+			}
+			nonCoherentAtomSize = std::max(vulkanDevice->properties.limits.nonCoherentAtomSize, (VkDeviceSize)1);
+			coherent = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+			buffers.resize(frameCount);
+			dirtyMasks.resize(frameCount);
+			for (uint32_t i = 0; i < frameCount; i++) {
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, memoryPropertyFlags, &buffers[i], count * stride));
+				VK_CHECK_RESULT(buffers[i].map());
+				// The descriptor covers a single object, the object is selected with the dynamic offset
+				buffers[i].descriptor.range = sizeof(T);
+				dirtyMasks[i].resize((count + 63) / 64, 0);
+			}
+			markAllDirty();
+		}
+
+		void destroy()
+		{
+			for (auto& buffer : buffers) {
+				buffer.destroy();
+			}
+			buffers.clear();
+			dirtyMasks.clear();
+		}
+
+		/** @brief Mark an object as changed, it will be written for every frame in flight */
+		void markDirty(uint32_t index)
+		{
+			assert(index < count);
+			for (auto& mask : dirtyMasks) {
+				mask[index / 64] |= (1ull << (index % 64));
+			}
+		}
+
+		void markAllDirty()
+		{
+			for (auto& mask : dirtyMasks) {
+				std::fill(mask.begin(), mask.end(), ~0ull);
+				if (count % 64 != 0) {
+					mask.back() = (1ull << (count % 64)) - 1;
+				}
+			}
+		}
+
+		/**
+		* Write all objects that are dirty for the given frame and flush the modified ranges
+		*
+		* @param frame Frame in flight whose buffer is updated, that frame's fence must have been signaled
+		* @param writer Called for each dirty object with the object's index and its location in mapped memory
+		*/
+		void update(uint32_t frame, const std::function<void(uint32_t index, T& data)>& writer)
+		{
+			stats = {};
+			vks::Buffer& buffer = buffers[frame];
+			std::vector<uint64_t>& mask = dirtyMasks[frame];
+			uint8_t* mapped = static_cast<uint8_t*>(buffer.mapped);
+			// Start and end (exclusive) of the range to be flushed next
+			int64_t rangeFirst = -1;
+			uint32_t rangeLast = 0;
+			for (uint32_t word = 0; word < static_cast<uint32_t>(mask.size()); word++) {
+				uint64_t bits = mask[word];
+				// Skip 64 clean objects at once
+				while (bits != 0) {
+					uint32_t bit = 0;
+					while ((bits & (1ull << bit)) == 0) {
+						bit++;
+					}
+					bits &= ~(1ull << bit);
+					const uint32_t index = word * 64 + bit;
+					writer(index, *reinterpret_cast<T*>(mapped + index * stride));
+					stats.objectsWritten++;
+					if (!coherent) {
+						if (rangeFirst >= 0 && index > rangeLast + mergeDistance) {
+							flushRange(buffer, static_cast<uint32_t>(rangeFirst), rangeLast);
+							rangeFirst = -1;
+						}
+						if (rangeFirst < 0) {
+							rangeFirst = index;
+						}
+						rangeLast = index + 1;
+					}
+				}
+				mask[word] = 0;
+			}
+			if (rangeFirst >= 0) {
+				flushRange(buffer, static_cast<uint32_t>(rangeFirst), rangeLast);
+			}
+			stats.bytesWritten = stats.objectsWritten * sizeof(T);
+		}
+
+		/** @brief Dynamic offset of an object for vkCmdBindDescriptorSets */
+		uint32_t dynamicOffset(uint32_t index) const
+		{
+			return static_cast<uint32_t>(index * stride);
+		}
+
+		vks::Buffer& buffer(uint32_t frame)
+		{
+			return buffers[frame];
+		}
+
+		uint32_t objectCount() const
+		{
+			return count;
+		}
+	};
+}
@@ -0,0 +1,388 @@
+/*
+* Vulkan hierarchical depth (Hi-Z) pyramid class
+*
+* Reduces a depth attachment to a mip chain of min and max depth in a single compute dispatch
+* Used for occlusion culling: bounds are projected with the matrix the pyramid was built with and tested against the farthest depth they cover
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Min/max depth pyramid built from a depth attachment
+	* @note Level 0 has half the resolution of the depth attachment, sizes are rounded up so odd sized levels (and non power of two attachments) are covered completely
+	* @note Each workgroup reduces a 64x64 tile of depth to the first six levels, the last workgroup to finish (tracked with an atomic counter) reduces the remaining levels
+	* @note The depth attachment needs to be created with VK_IMAGE_USAGE_SAMPLED_BIT, the pyramid images are kept in the general layout
+	* @note Shaders: base/hiz.comp (shared memory) and base/hiz_subgroup.comp (subgroup quad operations), culling helpers in base/hizcull.glsl
+	*/
+	class HiZPyramid
+	{
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		// Number of finished workgroups, reset by the last one
+		vks::Buffer counterBuffer;
+		VkSampler depthSampler{ VK_NULL_HANDLE };
+		// Depth only view of the source attachment, sampling requires a single aspect
+		VkImage depthImage{ VK_NULL_HANDLE };
+		VkImageView depthView{ VK_NULL_HANDLE };
+		VkImageAspectFlags depthAspect{ VK_IMAGE_ASPECT_DEPTH_BIT };
+		std::vector<uint32_t> queueFamilyIndices;
+		struct PushConstants {
+			int32_t depthWidth;
+			int32_t depthHeight;
+			uint32_t levelCount;
+			uint32_t groupCount;
+		};
+
+		void createPyramid(VkQueue queue)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			width = (depthWidth + 1) / 2;
+			height = (depthHeight + 1) / 2;
+			levelCount = 1;
+			for (uint32_t w = width, h = height; ((w > 1) || (h > 1)) && (levelCount < maxLevels); levelCount++) {
+				w = (w + 1) / 2;
+				h = (h + 1) / 2;
+			}
+
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+			for (Pyramid* pyramid : { &minDepth, &maxDepth }) {
+				VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+				imageCI.imageType = VK_IMAGE_TYPE_2D;
+				imageCI.format = format;
+				imageCI.extent = { width, height, 1 };
+				imageCI.mipLevels = levelCount;
+				imageCI.arrayLayers = 1;
+				imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+				// Culling may run on a dedicated compute queue
+				if (queueFamilyIndices.size() > 1) {
+					imageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+					imageCI.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+					imageCI.pQueueFamilyIndices = queueFamilyIndices.data();
+				}
+				VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &pyramid->image));
+				VkMemoryRequirements memReqs;
+				vkGetImageMemoryRequirements(device, pyramid->image, &memReqs);
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = memReqs.size;
+				memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &pyramid->memory));
+				VK_CHECK_RESULT(vkBindImageMemory(device, pyramid->image, pyramid->memory, 0));
+
+				VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+				viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCI.format = format;
+				viewCI.subresourceRange = subresourceRange;
+				viewCI.image = pyramid->image;
+				VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &pyramid->view));
+				// One view per level for storage writes
+				for (uint32_t i = 0; i < levelCount; i++) {
+					viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+					VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &pyramid->levelViews[i]));
+				}
+				vks::tools::insertImageMemoryBarrier(commandBuffer, pyramid->image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+			}
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = depthFormat;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+			viewCI.image = depthImage;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthView));
+		}
+
+		void destroyPyramid()
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (Pyramid* pyramid : { &minDepth, &maxDepth }) {
+				for (uint32_t i = 0; i < levelCount; i++) {
+					vkDestroyImageView(device, pyramid->levelViews[i], nullptr);
+				}
+				vkDestroyImageView(device, pyramid->view, nullptr);
+				vkDestroyImage(device, pyramid->image, nullptr);
+				vkFreeMemory(device, pyramid->memory, nullptr);
+				*pyramid = {};
+			}
+			vkDestroyImageView(device, depthView, nullptr);
+			depthView = VK_NULL_HANDLE;
+		}
+
+		void updateDescriptorSet()
+		{
+			VkDescriptorImageInfo depthDescriptor = vks::initializers::descriptorImageInfo(depthSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			// Slots past the last level are never written by the shader, but all array elements need a valid descriptor
+			std::array<VkDescriptorImageInfo, maxLevels> minDescriptors{}, maxDescriptors{};
+			for (uint32_t i = 0; i < maxLevels; i++) {
+				const uint32_t level = std::min(i, levelCount - 1);
+				minDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, minDepth.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+				maxDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, maxDepth.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &depthDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, minDescriptors.data(), maxLevels),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, maxDescriptors.data(), maxLevels),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &counterBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	public:
+		/** @brief Upper limit for the number of levels, enough for depth attachments of up to 65536 pixels */
+		static constexpr uint32_t maxLevels = 16;
+
+		struct Pyramid {
+			VkImage image{ VK_NULL_HANDLE };
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			// View of all levels, used for sampling
+			VkImageView view{ VK_NULL_HANDLE };
+			std::array<VkImageView, maxLevels> levelViews{};
+		};
+		Pyramid minDepth;
+		Pyramid maxDepth;
+		// Nearest filtering, culling reads single texels with texelFetch
+		VkSampler sampler{ VK_NULL_HANDLE };
+		// Single channel float format, storage writes for this format are supported by all implementations
+		VkFormat format{ VK_FORMAT_R32_SFLOAT };
+		VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+		uint32_t depthWidth{ 0 };
+		uint32_t depthHeight{ 0 };
+		/** @brief Size of the first level */
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t levelCount{ 0 };
+
+		/** @brief True if the device supports subgroup quad operations in compute shaders, selects base/hiz_subgroup.comp */
+		bool subgroupReduction{ false };
+		/** @brief True once the pyramid has been built for the current depth source */
+		bool valid{ false };
+		/** @brief View projection matrix the depth attachment of the last build was rendered with, use this to project bounds for culling */
+		glm::mat4 viewProjection{ 1.0f };
+
+		/**
+		* Check if the subgroup variant of the reduction can be used
+		*
+		* @note Requires an instance created with Vulkan 1.1 or newer
+		*/
+		static bool subgroupQuadSupported(vks::VulkanDevice* vulkanDevice)
+		{
+			if (vulkanDevice->properties.apiVersion < VK_API_VERSION_1_1) {
+				return false;
+			}
+			VkPhysicalDeviceSubgroupProperties subgroupProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES };
+			VkPhysicalDeviceProperties2 deviceProperties2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &subgroupProperties };
+			vkGetPhysicalDeviceProperties2(vulkanDevice->physicalDevice, &deviceProperties2);
+			return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) && (subgroupProperties.subgroupSize >= 4);
+		}
+
+		/** @brief Reduction shader used on a device, relative to the shaders path: base/hiz_subgroup.comp.spv if subgroup quads are supported, base/hiz.comp.spv otherwise */
+		static std::string shaderFile(vks::VulkanDevice* vulkanDevice)
+		{
+			return subgroupQuadSupported(vulkanDevice) ? "base/hiz_subgroup.comp.spv" : "base/hiz.comp.spv";
+		}
+
+		/**
+		* Create the sampler and the workgroup counter
+		*
+		* @param vulkanDevice Device to create the resources on
+		* @param queue Queue used for clearing the counter and for the initial layout transitions of the pyramid
+		* @param queueFamilyIndices (Optional) Queue families that access the pyramid, if there is more than one the images are shared concurrently
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue, std::vector<uint32_t> queueFamilyIndices = {})
+		{
+			this->vulkanDevice = vulkanDevice;
+			std::sort(queueFamilyIndices.begin(), queueFamilyIndices.end());
+			queueFamilyIndices.erase(std::unique(queueFamilyIndices.begin(), queueFamilyIndices.end()), queueFamilyIndices.end());
+			this->queueFamilyIndices = queueFamilyIndices;
+			subgroupReduction = subgroupQuadSupported(vulkanDevice);
+			VkDevice device = vulkanDevice->logicalDevice;
+
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_NEAREST;
+			samplerCI.minFilter = VK_FILTER_NEAREST;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.maxAnisotropy = 1.0f;
+			samplerCI.maxLod = static_cast<float>(maxLevels);
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+			samplerCI.maxLod = 0.0f;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &depthSampler));
+
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, sizeof(uint32_t)));
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			if (depthView != VK_NULL_HANDLE) {
+				destroyPyramid();
+			}
+			counterBuffer.destroy();
+			vkDestroySampler(device, sampler, nullptr);
+			vkDestroySampler(device, depthSampler, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vulkanDevice = nullptr;
+		}
+
+		/**
+		* Create the reduction pipeline and its descriptor set
+		*
+		* @param shaderStage Compute shader stage of the reduction (base/hiz_subgroup.comp if subgroupReduction is set, base/hiz.comp otherwise)
+		* @param pipelineCache Optional pipeline cache
+		*/
+		void preparePipeline(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxLevels * 2),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, maxLevels),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2, maxLevels),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			};
+			VkDescriptorSetLayoutCreateInfo setLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &descriptorSetLayout));
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+		}
+
+		/**
+		* Set the depth attachment the pyramid is built from, (re)creates the pyramid images
+		*
+		* @param queue Queue used for the initial layout transitions
+		* @param image Depth attachment, needs to be created with VK_IMAGE_USAGE_SAMPLED_BIT
+		* @param format Format of the depth attachment
+		* @param width Width of the depth attachment
+		* @param height Height of the depth attachment
+		*
+		* @note Call again after the depth attachment has been recreated (e.g. on window resize), the device must be idle
+		*/
+		void setDepthSource(VkQueue queue, VkImage image, VkFormat format, uint32_t width, uint32_t height)
+		{
+			if (depthView != VK_NULL_HANDLE) {
+				destroyPyramid();
+			}
+			depthImage = image;
+			depthFormat = format;
+			depthWidth = width;
+			depthHeight = height;
+			// Layout transitions of combined depth stencil images have to include both aspects
+			depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (vks::tools::formatHasStencil(format)) {
+				depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+			createPyramid(queue);
+			updateDescriptorSet();
+			valid = false;
+		}
+
+		/**
+		* Record the reduction, must be recorded outside of a render pass after the depth attachment has been written
+		*
+		* @param commandBuffer Command buffer to record to
+		* @param viewProjection View projection matrix the depth attachment has been rendered with
+		*
+		* @note The depth attachment is expected in the depth stencil attachment layout and is returned to it
+		*/
+		void build(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection)
+		{
+			VkImageSubresourceRange depthRange = { depthAspect, 0, 1, 0, 1 };
+			// Depth writes need to be finished before they're sampled, last frame's culling reads of the pyramid before it's overwritten
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			VkImageMemoryBarrier depthBarrier = vks::initializers::imageMemoryBarrier();
+			depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			depthBarrier.image = depthImage;
+			depthBarrier.subresourceRange = depthRange;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &depthBarrier);
+
+			const uint32_t groupCountX = (depthWidth + 63) / 64;
+			const uint32_t groupCountY = (depthHeight + 63) / 64;
+			PushConstants pushConstants{ static_cast<int32_t>(depthWidth), static_cast<int32_t>(depthHeight), levelCount, groupCountX * groupCountY };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			// The next frame's depth clear must not start before the reduction has finished reading
+			depthBarrier.srcAccessMask = 0;
+			depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &depthBarrier);
+
+			this->viewProjection = viewProjection;
+			valid = true;
+		}
+
+		/** @brief Descriptor for sampling the max depth pyramid, which is used for occlusion culling */
+		VkDescriptorImageInfo maxDescriptor() const
+		{
+			return vks::initializers::descriptorImageInfo(sampler, maxDepth.view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+
+		/** @brief Descriptor for sampling the min depth pyramid */
+		VkDescriptorImageInfo minDescriptor() const
+		{
+			return vks::initializers::descriptorImageInfo(sampler, minDepth.view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+	};
+}
@@ -0,0 +1,308 @@
+/*
+* Vulkan image cache class
+*
+* Stores images generated on the GPU as KTX files keyed by a hash of their inputs, so later runs can load them instead of generating them again
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include <ktx.h>
+
+namespace vks
+{
+	/**
+	* @brief Disk cache for GPU generated images (e.g. image based lighting maps)
+	* @note Generation command buffers are submitted without waiting, results are read back and written once their fence has been signaled
+	* @note Files are written in the KTX (version 1) format supported by the bundled libktx, so they can be loaded with the texture classes
+	*/
+	class ImageCache
+	{
+	private:
+		struct Readback {
+			std::string filename;
+			VkFormat format;
+			uint32_t width;
+			uint32_t height;
+			uint32_t mipLevels;
+			uint32_t faceCount;
+			vks::Buffer buffer;
+		};
+		struct Job {
+			VkFence fence;
+			VkCommandBuffer commandBuffer;
+			std::function<void()> onComplete;
+			std::vector<Readback> readbacks;
+		};
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		std::vector<Readback> pendingReadbacks;
+		std::vector<Job> jobs;
+		std::vector<std::future<bool>> writes;
+
+		static uint32_t glInternalFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM: return 0x8058; // GL_RGBA8
+			case VK_FORMAT_R16G16_SFLOAT: return 0x822F; // GL_RG16F
+			case VK_FORMAT_R16G16B16A16_SFLOAT: return 0x881A; // GL_RGBA16F
+			case VK_FORMAT_R32G32B32A32_SFLOAT: return 0x8814; // GL_RGBA32F
+			default: return 0;
+			}
+		}
+
+		static uint32_t formatSize(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM: return 4;
+			case VK_FORMAT_R16G16_SFLOAT: return 4;
+			case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+			case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+			default: return 0;
+			}
+		}
+
+		// Image data is tightly packed with all faces of a mip level following each other
+		static bool writeKTX(std::string filename, uint32_t glFormat, uint32_t bytesPerTexel, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, std::vector<uint8_t> data)
+		{
+			ktxTextureCreateInfo createInfo{
+				.glInternalformat = glFormat,
+				.baseWidth = width,
+				.baseHeight = height,
+				.baseDepth = 1,
+				.numDimensions = 2,
+				.numLevels = mipLevels,
+				.numLayers = 1,
+				.numFaces = faceCount,
+				.isArray = KTX_FALSE,
+				.generateMipmaps = KTX_FALSE
+			};
+			ktxTexture* texture{ nullptr };
+			if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) {
+				return false;
+			}
+			size_t offset = 0;
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				const size_t faceSize = static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * bytesPerTexel;
+				for (uint32_t face = 0; face < faceCount; face++) {
+					ktxTexture_SetImageFromMemory(texture, level, 0, face, data.data() + offset, faceSize);
+					offset += faceSize;
+				}
+			}
+			// Write to a temporary file first, so an interrupted write never leaves a truncated file in the cache
+			std::filesystem::create_directories(std::filesystem::path(filename).parent_path());
+			const std::string tempFilename = filename + ".tmp";
+			bool success = (ktxTexture_WriteToNamedFile(texture, tempFilename.c_str()) == KTX_SUCCESS);
+			ktxTexture_Destroy(texture);
+			if (success) {
+				std::error_code ec;
+				std::filesystem::rename(tempFilename, filename, ec);
+				success = !ec;
+			}
+			if (!success) {
+				std::cerr << "Could not write " << filename << " to the image cache" << std::endl;
+			}
+			return success;
+		}
+
+	public:
+		/** @brief Directory the cache files are stored in */
+		std::string directory;
+		/** @brief If false, nothing is read from or written to the cache */
+		bool enabled{ true };
+
+		void create(vks::VulkanDevice* vulkanDevice, const std::string& directory)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->directory = directory;
+#if defined(__ANDROID__)
+			// Assets are read from the apk, so there is no writable location next to them
+			enabled = false;
+#endif
+		}
+
+		/** @brief Wait for all outstanding jobs and file writes and release their resources */
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			for (auto& job : jobs) {
+				vkWaitForFences(vulkanDevice->logicalDevice, 1, &job.fence, VK_TRUE, UINT64_MAX);
+			}
+			update();
+			for (auto& write : writes) {
+				write.wait();
+			}
+			writes.clear();
+			vulkanDevice = nullptr;
+		}
+
+		/** @brief FNV-1a hash of a block of memory, can be chained by passing a previous hash as the seed */
+		static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++) {
+				seed = (seed ^ bytes[i]) * 0x100000001b3ull;
+			}
+			return seed;
+		}
+
+		/** @brief Combine a hash with a list of plain values (e.g. generation parameters) */
+		template<typename... T>
+		static uint64_t hashValues(uint64_t seed, const T&... values)
+		{
+			((seed = hash(&values, sizeof(T), seed)), ...);
+			return seed;
+		}
+
+		/** @brief Hash of a file's content, returns the seed if the file can't be read */
+		static uint64_t hashFile(const std::string& filename, uint64_t seed = 0xcbf29ce484222325ull)
+		{
+			std::ifstream file(filename, std::ios::binary);
+			std::vector<char> chunk(1 << 16);
+			while (file) {
+				file.read(chunk.data(), chunk.size());
+				seed = hash(chunk.data(), static_cast<size_t>(file.gcount()), seed);
+			}
+			return seed;
+		}
+
+		/** @brief Name of the cache file for an image with the given name and key */
+		std::string filename(const std::string& name, uint64_t key) const
+		{
+			std::stringstream ss;
+			ss << directory << name << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".ktx";
+			return ss.str();
+		}
+
+		bool contains(const std::string& filename) const
+		{
+			return enabled && vks::tools::fileExists(filename);
+		}
+
+		/**
+		* Record a copy of all mip levels and faces of an image into a host visible buffer, that is written to the cache once the next submitted job has finished
+		*
+		* @param commandBuffer Command buffer of the job that generates the image
+		* @param filename Cache file name (see filename())
+		* @param image Image to store
+		* @param format Format of the image
+		* @param width Width of the first mip level
+		* @param height Height of the first mip level
+		* @param mipLevels Number of mip levels to store
+		* @param faceCount Number of layers, 6 for cube maps
+		* @param layout Layout of the image at this point of the command buffer, the image is transitioned back to it after the copy
+		*/
+		void recordSave(VkCommandBuffer commandBuffer, const std::string& filename, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, VkImageLayout layout)
+		{
+			const uint32_t bytesPerTexel = formatSize(format);
+			if (!enabled || (bytesPerTexel == 0)) {
+				return;
+			}
+			Readback readback{ .filename = filename, .format = format, .width = width, .height = height, .mipLevels = mipLevels, .faceCount = faceCount };
+			std::vector<VkBufferImageCopy> copyRegions;
+			VkDeviceSize offset = 0;
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				const uint32_t levelWidth = std::max(width >> level, 1u);
+				const uint32_t levelHeight = std::max(height >> level, 1u);
+				for (uint32_t face = 0; face < faceCount; face++) {
+					copyRegions.push_back({
+						.bufferOffset = offset,
+						.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, face, 1 },
+						.imageExtent = { levelWidth, levelHeight, 1 }
+					});
+					offset += static_cast<VkDeviceSize>(levelWidth) * levelHeight * bytesPerTexel;
+				}
+			}
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback.buffer, offset));
+
+			VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, faceCount };
+			vks::tools::setImageLayout(commandBuffer, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+			vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+			vks::tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, subresourceRange);
+			// Make the copied data visible to the host
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = readback.buffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			pendingReadbacks.push_back(std::move(readback));
+		}
+
+		/**
+		* End and submit a command buffer without waiting for it to finish
+		*
+		* @param queue Queue to submit to, commands submitted later to the same queue are ordered after it by the barriers it contains
+		* @param commandBuffer Command buffer allocated from the device's default command pool, freed once the job has finished
+		* @param onComplete Called from update() once the GPU has finished the job, e.g. to release temporary resources
+		*/
+		void submit(VkQueue queue, VkCommandBuffer commandBuffer, std::function<void()> onComplete)
+		{
+			// As the host doesn't wait for the job, make its results visible to all work submitted to the queue after it
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			Job job{ .commandBuffer = commandBuffer, .onComplete = onComplete, .readbacks = std::move(pendingReadbacks) };
+			pendingReadbacks.clear();
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(0);
+			VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceInfo, nullptr, &job.fence));
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, job.fence));
+			jobs.push_back(std::move(job));
+		}
+
+		/**
+		* Finish all jobs whose fence has been signaled, the image data is written to disk on a background thread
+		*
+		* @return True if no jobs are outstanding
+		*/
+		bool update()
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto it = jobs.begin(); it != jobs.end();) {
+				if (vkGetFenceStatus(device, it->fence) != VK_SUCCESS) {
+					++it;
+					continue;
+				}
+				for (auto& readback : it->readbacks) {
+					std::vector<uint8_t> data(readback.buffer.size);
+					VK_CHECK_RESULT(readback.buffer.map());
+					memcpy(data.data(), readback.buffer.mapped, data.size());
+					readback.buffer.destroy();
+					writes.push_back(std::async(std::launch::async, writeKTX, readback.filename, glInternalFormat(readback.format), formatSize(readback.format), readback.width, readback.height, readback.mipLevels, readback.faceCount, std::move(data)));
+				}
+				if (it->onComplete) {
+					it->onComplete();
+				}
+				vkDestroyFence(device, it->fence, nullptr);
+				vkFreeCommandBuffers(device, vulkanDevice->commandPool, 1, &it->commandBuffer);
+				it = jobs.erase(it);
+			}
+			return jobs.empty();
+		}
+	};
+}
@@ -0,0 +1,376 @@
+/*
+* KTX2 container parsing and transcoding
+*
+* Reads the KTX2 header, level index and data format descriptor and decodes the mip levels into a staging buffer
+* Zstd supercompressed levels require VKS_KTX2_ZSTD (libzstd), Basis Universal (ETC1S/UASTC) payloads require VKS_KTX2_BASISU (basisu transcoder)
+* Levels are decoded in parallel, each worker writes straight into its level's region of the (mapped) destination
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+#if defined(VKS_KTX2_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(VKS_KTX2_BASISU)
+#include <basisu_transcoder.h>
+#endif
+
+namespace vks
+{
+	namespace ktx2
+	{
+		// File identifier: «KTX 20»\r\n\x1A\n
+		static const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		enum class Supercompression : uint32_t { None = 0, BasisLZ = 1, Zstd = 2, Zlib = 3 };
+
+		// Data format descriptor values (Khronos Data Format Specification)
+		static const uint8_t colorModelETC1S = 163;
+		static const uint8_t colorModelUASTC = 166;
+
+		struct Level {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		// Size of a texel block in bytes and its dimensions in texels, all zero for formats that can't be loaded
+		struct FormatBlock {
+			uint32_t bytes{ 0 };
+			uint32_t width{ 1 };
+			uint32_t height{ 1 };
+		};
+
+		/** @brief Texel block of the color formats that can be stored in a KTX2 file and loaded as a 2D texture */
+		inline FormatBlock formatBlock(VkFormat format)
+		{
+			auto inRange = [format](VkFormat first, VkFormat last) { return (format >= first) && (format <= last); };
+			if (format == VK_FORMAT_R4G4_UNORM_PACK8 || inRange(VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB)) {
+				return { 1 };
+			}
+			if (inRange(VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16) || inRange(VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB) || inRange(VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT)) {
+				return { 2 };
+			}
+			if (inRange(VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB)) {
+				return { 3 };
+			}
+			if (inRange(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32) || inRange(VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT) || inRange(VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT) || inRange(VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)) {
+				return { 4 };
+			}
+			if (inRange(VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT)) {
+				return { 6 };
+			}
+			if (inRange(VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT) || inRange(VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT) || inRange(VK_FORMAT_R64_UINT, VK_FORMAT_R64_SFLOAT)) {
+				return { 8 };
+			}
+			if (inRange(VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT)) {
+				return { 12 };
+			}
+			if (inRange(VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT) || inRange(VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64_SFLOAT)) {
+				return { 16 };
+			}
+			if (inRange(VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64_SFLOAT)) {
+				return { 24 };
+			}
+			if (inRange(VK_FORMAT_R64G64B64A64_UINT, VK_FORMAT_R64G64B64A64_SFLOAT)) {
+				return { 32 };
+			}
+			// BC1, BC4, ETC2 RGB(A1) and EAC R11 use 8 bytes per 4x4 block, all other BC, ETC2 and EAC formats 16 bytes
+			if (inRange(VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK) || inRange(VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK) || inRange(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) || inRange(VK_FORMAT_EAC_R11_UNORM_BLOCK, VK_FORMAT_EAC_R11_SNORM_BLOCK)) {
+				return { 8, 4, 4 };
+			}
+			if (inRange(VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK) || inRange(VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK) || inRange(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) || inRange(VK_FORMAT_EAC_R11G11_UNORM_BLOCK, VK_FORMAT_EAC_R11G11_SNORM_BLOCK)) {
+				return { 16, 4, 4 };
+			}
+			// ASTC formats come in UNORM/SRGB pairs ordered by block size, all blocks are 16 bytes
+			if (inRange(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK)) {
+				static const uint32_t astcBlocks[14][2] = { { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+				const uint32_t index = (format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2;
+				return { 16, astcBlocks[index][0], astcBlocks[index][1] };
+			}
+			return { 0, 0, 0 };
+		}
+
+		/** @brief Size in bytes of a mip level with tightly packed texel blocks, zero for unsupported formats */
+		inline VkDeviceSize levelSize(VkFormat format, uint32_t width, uint32_t height)
+		{
+			const FormatBlock block = formatBlock(format);
+			if (block.bytes == 0) {
+				return 0;
+			}
+			return VkDeviceSize((width + block.width - 1) / block.width) * ((height + block.height - 1) / block.height) * block.bytes;
+		}
+
+		class File
+		{
+		private:
+			template<typename T>
+			T read(size_t offset) const
+			{
+				T value;
+				memcpy(&value, data.data() + offset, sizeof(T));
+				return value;
+			}
+		public:
+			std::vector<uint8_t> data;
+			VkFormat vkFormat{ VK_FORMAT_UNDEFINED };
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			uint32_t layerCount{ 0 };
+			uint32_t faceCount{ 0 };
+			uint32_t levelCount{ 0 };
+			Supercompression supercompression{ Supercompression::None };
+			uint8_t colorModel{ 0 };
+			std::vector<Level> levels;
+
+			static bool isKTX2(const uint8_t* bytes, size_t size)
+			{
+				return (size >= sizeof(identifier)) && (memcmp(bytes, identifier, sizeof(identifier)) == 0);
+			}
+
+			/** @brief Level data needs to be transcoded by the Basis Universal transcoder */
+			bool isBasis() const
+			{
+				return (colorModel == colorModelETC1S) || (colorModel == colorModelUASTC);
+			}
+
+			/**
+			* Parse the header, level index and data format descriptor
+			*
+			* @param bytes Complete file contents, ownership is taken as level data is decoded from it later on
+			* @param error Reason the file was rejected
+			*
+			* @return False if the file is not a valid KTX2 file
+			*/
+			bool parse(std::vector<uint8_t>&& bytes, std::string& error)
+			{
+				data = std::move(bytes);
+				const size_t levelIndexOffset = 80;
+				if (!isKTX2(data.data(), data.size()) || data.size() < levelIndexOffset) {
+					error = "not a KTX2 file";
+					return false;
+				}
+				vkFormat = static_cast<VkFormat>(read<uint32_t>(12));
+				width = read<uint32_t>(20);
+				if (width == 0) {
+					error = "pixel width is zero";
+					return false;
+				}
+				height = std::max(read<uint32_t>(24), 1u);
+				layerCount = std::max(read<uint32_t>(32), 1u);
+				faceCount = read<uint32_t>(36);
+				// A level count of zero asks the loader to generate the mip chain, which is not supported here
+				levelCount = std::max(read<uint32_t>(40), 1u);
+				supercompression = static_cast<Supercompression>(read<uint32_t>(44));
+				const uint32_t dfdOffset = read<uint32_t>(48);
+				const uint32_t dfdLength = read<uint32_t>(52);
+				// Also keeps the level extents (width >> level) well defined
+				uint32_t maxLevelCount = 1;
+				while ((std::max(width, height) >> maxLevelCount) > 0) {
+					maxLevelCount++;
+				}
+				if (levelCount > maxLevelCount) {
+					error = "level count exceeds the full mip chain";
+					return false;
+				}
+				// Sizes and offsets are read from the file, so all checks are written in a way that can't overflow
+				if (levelCount > (data.size() - levelIndexOffset) / sizeof(Level)) {
+					error = "truncated level index";
+					return false;
+				}
+				levels.resize(levelCount);
+				for (uint32_t i = 0; i < levelCount; i++) {
+					levels[i] = read<Level>(levelIndexOffset + i * sizeof(Level));
+					if ((levels[i].byteLength > data.size()) || (levels[i].byteOffset > data.size() - levels[i].byteLength)) {
+						error = "level " + std::to_string(i) + " exceeds the file size";
+						return false;
+					}
+				}
+				// Basic descriptor block: total size (4), vendor/type (4), version/block size (4), color model
+				if ((dfdLength >= 16) && (uint64_t(dfdOffset) + 16 <= data.size())) {
+					colorModel = data[dfdOffset + 12];
+				}
+				if ((layerCount > 1) || (faceCount > 1)) {
+					error = "only single layer 2D textures are supported";
+					return false;
+				}
+				if ((vkFormat == VK_FORMAT_UNDEFINED) && !isBasis()) {
+					error = "no Vulkan format and no Basis Universal payload";
+					return false;
+				}
+				// Level sizes of transcoded files depend on the target format and are checked by the transcoder
+				if (!isBasis()) {
+					if (levelSize(vkFormat, width, height) == 0) {
+						error = "format " + std::to_string(vkFormat) + " is not supported";
+						return false;
+					}
+					for (uint32_t i = 0; i < levelCount; i++) {
+						const VkDeviceSize expectedSize = levelSize(vkFormat, std::max(1u, width >> i), std::max(1u, height >> i));
+						if (levels[i].uncompressedByteLength != expectedSize) {
+							error = "level " + std::to_string(i) + " has " + std::to_string(levels[i].uncompressedByteLength) + " bytes instead of " + std::to_string(expectedSize);
+							return false;
+						}
+						if ((supercompression == Supercompression::None) && (levels[i].byteLength != levels[i].uncompressedByteLength)) {
+							error = "level " + std::to_string(i) + " byte length doesn't match its uncompressed byte length";
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+		};
+
+		/**
+		* Select the best GPU format for Basis Universal payloads based on the enabled device features and format support
+		* BC7 and ASTC 4x4 keep the full quality of UASTC, ETC2 is the common mobile fallback, uncompressed RGBA8 is always available
+		*
+		* @param device Device the texture is created on, texture compression features need to be enabled by the example
+		* @param srgb Select the sRGB variant of the format
+		*/
+		inline VkFormat selectTranscodeFormat(vks::VulkanDevice* device, bool srgb)
+		{
+			auto supported = [device](VkFormat format) {
+				VkFormatProperties formatProperties;
+				vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+				return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+			};
+			const VkFormat bc7 = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+			const VkFormat astc = srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+			const VkFormat etc2 = srgb ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+			if (device->enabledFeatures.textureCompressionBC && supported(bc7)) {
+				return bc7;
+			}
+			if (device->enabledFeatures.textureCompressionASTC_LDR && supported(astc)) {
+				return astc;
+			}
+			if (device->enabledFeatures.textureCompressionETC2 && supported(etc2)) {
+				return etc2;
+			}
+			return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		/**
+		* Decode all mip levels into the destination memory, using one worker thread per level (up to the number of hardware threads)
+		*
+		* @param file Parsed KTX2 file
+		* @param targetFormat Format for Basis Universal payloads, ignored for files with a Vulkan format
+		* @param dst Destination memory (usually a mapped staging buffer)
+		* @param dstOffsets Offset of each level in the destination memory, in ascending order
+		* @param dstSize Size of the destination memory, a level is never written past the offset of the next level (or this size for the last level)
+		* @param error Reason decoding failed
+		*
+		* @return False if a level could not be decoded or the required decoder has not been compiled in
+		*/
+		inline bool decodeLevels(const File& file, [[maybe_unused]] VkFormat targetFormat, uint8_t* dst, const std::vector<VkDeviceSize>& dstOffsets, VkDeviceSize dstSize, std::string& error)
+		{
+			if (file.supercompression == Supercompression::Zlib) {
+				error = "zlib supercompression is not supported";
+				return false;
+			}
+#if !defined(VKS_KTX2_ZSTD)
+			if ((file.supercompression == Supercompression::Zstd) && !file.isBasis()) {
+				error = "Zstd supercompression requires building with VKS_KTX2_ZSTD";
+				return false;
+			}
+#endif
+#if defined(VKS_KTX2_BASISU)
+			basist::ktx2_transcoder transcoder;
+			basist::transcoder_texture_format transcodeFormat = basist::transcoder_texture_format::cTFRGBA32;
+			if (file.isBasis()) {
+				static std::once_flag initFlag;
+				std::call_once(initFlag, []() { basist::basisu_transcoder_init(); });
+				switch (targetFormat) {
+				case VK_FORMAT_BC7_UNORM_BLOCK:
+				case VK_FORMAT_BC7_SRGB_BLOCK:
+					transcodeFormat = basist::transcoder_texture_format::cTFBC7_RGBA;
+					break;
+				case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+				case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+					transcodeFormat = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+					break;
+				case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+				case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+					transcodeFormat = basist::transcoder_texture_format::cTFETC2_RGBA;
+					break;
+				default:
+					break;
+				}
+				// Global codebooks (ETC1S) are decoded once, the per level transcoding below is thread safe with a state per worker
+				if (!transcoder.init(file.data.data(), static_cast<uint32_t>(file.data.size())) || !transcoder.start_transcoding()) {
+					error = "Basis Universal transcoder could not be initialized";
+					return false;
+				}
+			}
+#else
+			if (file.isBasis()) {
+				error = "Basis Universal payloads require building with VKS_KTX2_BASISU";
+				return false;
+			}
+#endif
+
+			// Levels are ordered from largest to smallest, so the big levels are picked up first
+			std::atomic<uint32_t> nextLevel{ 0 };
+			std::atomic<bool> failed{ false };
+			auto worker = [&]() {
+#if defined(VKS_KTX2_BASISU)
+				basist::ktx2_transcoder_state transcoderState;
+#endif
+				for (uint32_t i = nextLevel++; i < file.levelCount; i = nextLevel++) {
+					const Level& level = file.levels[i];
+					const uint8_t* src = file.data.data() + level.byteOffset;
+					uint8_t* levelDst = dst + dstOffsets[i];
+					const VkDeviceSize regionSize = ((i + 1 < file.levelCount) ? dstOffsets[i + 1] : dstSize) - dstOffsets[i];
+					bool result = true;
+					if (file.isBasis()) {
+#if defined(VKS_KTX2_BASISU)
+						const uint32_t levelWidth = std::max(1u, file.width >> i);
+						const uint32_t levelHeight = std::max(1u, file.height >> i);
+						const uint32_t outputSize = (transcodeFormat == basist::transcoder_texture_format::cTFRGBA32) ? levelWidth * levelHeight : ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4);
+						result = (levelSize(targetFormat, levelWidth, levelHeight) <= regionSize) && transcoder.transcode_image_level(i, 0, 0, levelDst, outputSize, transcodeFormat, 0, 0, 0, -1, -1, &transcoderState);
+#endif
+					} else if (file.supercompression == Supercompression::Zstd) {
+#if defined(VKS_KTX2_ZSTD)
+						const size_t size = ZSTD_decompress(levelDst, std::min(level.uncompressedByteLength, regionSize), src, level.byteLength);
+						result = !ZSTD_isError(size) && (size == level.uncompressedByteLength);
+#endif
+					} else {
+						memcpy(levelDst, src, std::min(level.byteLength, regionSize));
+					}
+					if (!result) {
+						failed = true;
+					}
+				}
+			};
+
+			const uint32_t threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, file.levelCount);
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < threadCount; i++) {
+				threads.emplace_back(worker);
+			}
+			// The calling thread takes part in decoding
+			worker();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			if (failed) {
+				error = "level data could not be decoded";
+				return false;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,326 @@
+/*
+* Vulkan mip chain generator class
+*
+* Generates all levels of a texture's mip chain in a single compute dispatch, with blits as the fallback
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanTimestampQuery.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Mip chain generation for RGBA8 textures using a single pass downsampler
+	* @note Each workgroup reduces a 64x64 tile of level 0 to the next six levels using shared memory, the last workgroup to finish (tracked with an atomic counter) reduces the remaining levels
+	* @note Unlike blits, the compute path can filter sRGB data in linear space, weight colors by alpha and renormalize normal maps
+	* @note Images need to be created with imageUsage() and imageCreateFlags(), other formats or devices without storage support for them fall back to blits
+	* @note sRGB images only take the compute path with an instance created with Vulkan 1.1 or newer, as their UNORM storage views need VK_IMAGE_CREATE_EXTENDED_USAGE_BIT
+	* @note Shader: base/mipgen.comp
+	*/
+	class MipGenerator
+	{
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		// Number of finished workgroups, reset by the last one
+		vks::Buffer counterBuffer;
+		// A single scope for the chain that's currently generated
+		TimestampQuery timestamps;
+		struct PushConstants {
+			int32_t width;
+			int32_t height;
+			uint32_t levelCount;
+			uint32_t groupCount;
+			uint32_t filter;
+		};
+
+		// Format of the views the shader accesses the levels with, storage images don't support sRGB formats
+		static VkFormat storageFormat(VkFormat format)
+		{
+			return (format == VK_FORMAT_R8G8B8A8_SRGB) ? VK_FORMAT_R8G8B8A8_UNORM : format;
+		}
+
+		// Formats of images the compute path can write to, also decides if images are created with storage usage
+		bool storageSupported(VkFormat format) const
+		{
+			if (storageFormat(format) != VK_FORMAT_R8G8B8A8_UNORM) {
+				return false;
+			}
+			// Storage usage on an sRGB image is only valid with the extended usage flag, which is core in Vulkan 1.1 (VK_KHR_maintenance2)
+			if ((storageFormat(format) != format) && (vulkanDevice->properties.apiVersion < VK_API_VERSION_1_1)) {
+				return false;
+			}
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, storageFormat(format), &formatProperties);
+			return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+		}
+
+		void recordCompute(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t filter, VkImageLayout level0Layout, VkImageLayout finalLayout, std::vector<VkImageView>& levelViews)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = storageFormat(format);
+			viewCI.image = image;
+			levelViews.resize(levelCount);
+			for (uint32_t i = 0; i < levelCount; i++) {
+				viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &levelViews[i]));
+			}
+			// Slots past the last level are never accessed by the shader, but all array elements need a valid descriptor
+			std::array<VkDescriptorImageInfo, maxLevels> levelDescriptors{};
+			for (uint32_t i = 0; i < maxLevels; i++) {
+				levelDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, levelViews[std::min(i, levelCount - 1)], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, levelDescriptors.data(), maxLevels),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &counterBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// Level 0 is read, all other levels are overwritten, so their previous contents can be discarded
+			const bool level0Transfer = (level0Layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, level0Transfer ? VK_ACCESS_TRANSFER_WRITE_BIT : 0, VK_ACCESS_SHADER_READ_BIT, level0Layout, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+			if (levelCount > 1) {
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 1, levelCount - 1, 0, 1 });
+			}
+
+			const uint32_t groupCountX = (width + 63) / 64;
+			const uint32_t groupCountY = (height + 63) / 64;
+			PushConstants pushConstants{ static_cast<int32_t>(width), static_cast<int32_t>(height), levelCount, groupCountX * groupCountY, filter };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, finalLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 });
+		}
+
+		void recordBlit(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levelCount, VkImageLayout level0Layout, VkImageLayout finalLayout)
+		{
+			const bool level0Transfer = (level0Layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, level0Transfer ? VK_ACCESS_TRANSFER_WRITE_BIT : 0, VK_ACCESS_TRANSFER_READ_BIT, level0Layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+			// Copy down the chain doing a blit from level i - 1 to level i, each level has to wait for the previous one
+			for (uint32_t i = 1; i < levelCount; i++) {
+				VkImageBlit imageBlit{};
+				imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1 };
+				imageBlit.srcOffsets[1] = { std::max(int32_t(width >> (i - 1)), 1), std::max(int32_t(height >> (i - 1)), 1), 1 };
+				imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+				imageBlit.dstOffsets[1] = { std::max(int32_t(width >> i), 1), std::max(int32_t(height >> i), 1), 1 };
+				VkImageSubresourceRange levelRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, levelRange);
+				vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, levelRange);
+			}
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, finalLayout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 });
+		}
+	public:
+		/** @brief Upper limit for the number of levels, enough for textures of up to 32768 pixels */
+		static constexpr uint32_t maxLevels = 16;
+
+		/** @brief Filter flags for the compute path, blits always filter linearly in the format's space */
+		enum Filter : uint32_t {
+			/** @brief Texels are sRGB encoded, average them in linear space (also for sRGB data stored in UNORM images) */
+			FilterSRGB = 0x1,
+			/** @brief Weight colors by alpha, so colors of transparent texels don't bleed into their neighbours */
+			FilterAlphaWeighted = 0x2,
+			/** @brief Texels are normals mapped to [0, 1], renormalize them after averaging */
+			FilterNormalMap = 0x4,
+		};
+
+		enum class Method { Compute, Blit };
+
+		/** @brief Method for chains generated on behalf of the application (e.g. by the glTF loader), set to Blit for comparing both methods */
+		Method preferredMethod{ Method::Compute };
+
+		/** @brief Times accumulated for all chains generated with each method, the CPU time includes recording, submission and waiting for completion */
+		struct Stats {
+			uint32_t computeChainCount{ 0 };
+			uint32_t blitChainCount{ 0 };
+			double computeGpuTime{ 0.0 };
+			double blitGpuTime{ 0.0 };
+			double computeTime{ 0.0 };
+			double blitTime{ 0.0 };
+		} stats;
+
+		/** @brief Image usage required for generating chains of the given format, storage usage is only added if the compute path can write the format */
+		VkImageUsageFlags imageUsage(VkFormat format) const
+		{
+			return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | (storageSupported(format) ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
+		}
+
+		/**
+		* @brief Image create flags required by the compute path, sRGB images are written through UNORM views
+		* @note The storage usage isn't supported by the sRGB format itself, so it needs the extended usage flag (Vulkan 1.1) to be valid for the image
+		*/
+		VkImageCreateFlags imageCreateFlags(VkFormat format) const
+		{
+			return ((storageFormat(format) != format) && storageSupported(format)) ? (VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) : 0;
+		}
+
+		/** @brief Number of levels of a full mip chain */
+		static uint32_t levelCount(uint32_t width, uint32_t height)
+		{
+			uint32_t levels = 1;
+			while ((std::max(width, height) >> levels) > 0) {
+				levels++;
+			}
+			return levels;
+		}
+
+		/**
+		* Create the workgroup counter and the timestamp query
+		*
+		* @param vulkanDevice Device to create the resources on
+		* @param queue Queue used for clearing the counter, mip chains need to be generated on a queue of the same family
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue)
+		{
+			this->vulkanDevice = vulkanDevice;
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, sizeof(uint32_t)));
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+			timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 1, 1);
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			counterBuffer.destroy();
+			timestamps.destroy();
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			pipeline = VK_NULL_HANDLE;
+			vulkanDevice = nullptr;
+		}
+
+		/**
+		* Create the compute pipeline and its descriptor set, without a pipeline all chains are generated with blits
+		*
+		* @param shaderStage Compute shader stage (base/mipgen.comp)
+		* @param pipelineCache Optional pipeline cache
+		*/
+		void preparePipeline(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxLevels),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, maxLevels),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			};
+			VkDescriptorSetLayoutCreateInfo setLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &descriptorSetLayout));
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+		}
+
+		/** @brief True if chains of the given format and size can be generated with the compute path */
+		bool computeSupported(VkFormat format, uint32_t levelCount) const
+		{
+			return (pipeline != VK_NULL_HANDLE) && (levelCount <= maxLevels) && storageSupported(format);
+		}
+
+		/** @brief True if chains of the given format can be generated with blits */
+		bool blitSupported(VkFormat format) const
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, format, &formatProperties);
+			const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+			return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+		}
+
+		/**
+		* Generate levels 1 and up from level 0 and wait for completion
+		*
+		* @param queue Queue to submit to
+		* @param image Image to generate the chain for, created with imageUsage() and imageCreateFlags()
+		* @param format Format of the image
+		* @param width Width of level 0
+		* @param height Height of level 0
+		* @param levelCount Number of levels to generate, including level 0
+		* @param filter (Optional) Combination of Filter flags, only used by the compute path
+		* @param method (Optional) Preferred method, blits are used if the compute path doesn't support the format
+		* @param level0Layout (Optional) Current layout of level 0, the layouts of the other levels are discarded
+		* @param finalLayout (Optional) Layout all levels are transitioned to
+		*
+		* @return Method that has been used
+		*/
+		Method generate(VkQueue queue, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t filter = 0, Method method = Method::Compute, VkImageLayout level0Layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			if ((method == Method::Compute) && !computeSupported(format, levelCount)) {
+				method = Method::Blit;
+			}
+			if ((method == Method::Blit) && !blitSupported(format)) {
+				// Mip chain generation with blits requires support for blit source and destination and for linear filtering
+				vks::tools::exitFatal("Selected GPU can't generate mip maps for this format with the compute shader or with blits", VK_ERROR_FORMAT_NOT_SUPPORTED);
+			}
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			std::vector<VkImageView> levelViews;
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			timestamps.reset(commandBuffer, 0);
+			timestamps.begin(commandBuffer, 0, 0);
+			if (method == Method::Compute) {
+				recordCompute(commandBuffer, image, format, width, height, levelCount, filter, level0Layout, finalLayout, levelViews);
+			} else {
+				recordBlit(commandBuffer, image, width, height, levelCount, level0Layout, finalLayout);
+			}
+			timestamps.end(commandBuffer, 0, 0);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+			for (VkImageView view : levelViews) {
+				vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
+			}
+			const double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+			const double gpuTime = timestamps.fetch(0) ? timestamps.durations[0] : 0.0;
+			if (method == Method::Compute) {
+				stats.computeChainCount++;
+				stats.computeGpuTime += gpuTime;
+				stats.computeTime += time;
+			} else {
+				stats.blitChainCount++;
+				stats.blitGpuTime += gpuTime;
+				stats.blitTime += time;
+			}
+			return method;
+		}
+	};
+}
@@ -0,0 +1,229 @@
+/*
+* Vulkan multiview renderer class
+*
+* Records vkglTF scenes for N views (stereo, cube map faces, shadow cascades, mirrors) rendered in a single pass with VK_KHR_multiview
+* Primitives are culled once against a volume enclosing all views and recorded once, the implementation broadcasts the draws to all views
+* Can also cull and record each view separately, which is what rendering the views in separate passes costs on the CPU
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Culls and records the primitives of vkglTF models for all views of a multiview render pass
+	* @note The union volume is the frustum of the first view with each plane pushed out until it contains the frusta of all other views, it's tight for stereo views and conservative for views looking into different directions (e.g. cube map faces)
+	* @note Primitives are culled with their world space bounding spheres, models can't be animated
+	* @note Only descriptor set based models are supported, material images are bound to bindImageSet if RenderFlags::BindImages is passed to record
+	*/
+	class MultiviewRenderer
+	{
+	private:
+		struct Object {
+			const vkglTF::Model* model;
+			const vkglTF::Material* material;
+			glm::vec3 center;
+			float radius;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+		std::vector<Object> objects;
+		std::vector<uint32_t> visibleObjects;
+		std::vector<vks::Frustum> viewFrusta;
+		vks::Frustum unionFrustum;
+
+		static bool skipMaterial(const vkglTF::Material& material, uint32_t renderFlags)
+		{
+			if (renderFlags & vkglTF::RenderFlags::RenderOpaqueNodes) {
+				return material.alphaMode != vkglTF::Material::ALPHAMODE_OPAQUE;
+			}
+			if (renderFlags & vkglTF::RenderFlags::RenderAlphaMaskedNodes) {
+				return material.alphaMode != vkglTF::Material::ALPHAMODE_MASK;
+			}
+			if (renderFlags & vkglTF::RenderFlags::RenderAlphaBlendedNodes) {
+				return material.alphaMode != vkglTF::Material::ALPHAMODE_BLEND;
+			}
+			return false;
+		}
+
+		static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+	public:
+		/** @brief Every implementation supporting VK_KHR_multiview supports at least this many views */
+		static constexpr uint32_t maxViews = 6;
+		/** @brief Passed as the view index to cull against the union of all views */
+		static constexpr int32_t AllViews = -1;
+
+		struct View {
+			glm::mat4 projection{ 1.0f };
+			glm::mat4 view{ 1.0f };
+		};
+		/** @brief Views of the render pass, in the order of the view mask bits, call update after changing them */
+		std::vector<View> views;
+		/** @brief Device limit, set from VkPhysicalDeviceMultiviewPropertiesKHR::maxMultiviewViewCount before calling setViewCount */
+		uint32_t maxViewCount{ maxViews };
+
+		/** @brief If false, all primitives are recorded */
+		bool cullingEnabled{ true };
+
+		// CPU side cost of the calls since the last call to resetStats, times are in milliseconds
+		struct Stats {
+			uint32_t culled{ 0 };
+			uint32_t visible{ 0 };
+			uint32_t draws{ 0 };
+			uint32_t descriptorSetBinds{ 0 };
+			double cullTime{ 0.0 };
+			double recordTime{ 0.0 };
+		} stats;
+
+		/** @brief Number of primitives added with addModel */
+		uint32_t objectCount() const
+		{
+			return static_cast<uint32_t>(objects.size());
+		}
+
+		/** @brief View mask for VkRenderPassMultiviewCreateInfo that broadcasts to all views */
+		uint32_t viewMask() const
+		{
+			return (1u << static_cast<uint32_t>(views.size())) - 1;
+		}
+
+		/**
+		* Add the primitives of a model
+		*
+		* @param model Model to add, must outlive the renderer
+		* @param renderFlags Alpha mode filter (RenderOpaqueNodes, RenderAlphaMaskedNodes or RenderAlphaBlendedNodes), other flags are ignored
+		* @param transform Applied on top of the node matrices, e.g. to match the FlipY file loading flag
+		*/
+		void addModel(const vkglTF::Model& model, uint32_t renderFlags = 0, const glm::mat4& transform = glm::mat4(1.0f))
+		{
+			for (const vkglTF::Node* node : model.linearNodes) {
+				if (!node->mesh) {
+					continue;
+				}
+				// The node matrices also apply to pre-transformed vertices, primitive bounds are always stored in the node's space
+				const glm::mat4 matrix = transform * const_cast<vkglTF::Node*>(node)->getMatrix();
+				const float scale = std::max({ glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) });
+				for (const vkglTF::Primitive* primitive : node->mesh->primitives) {
+					if ((primitive->indexCount == 0) || skipMaterial(primitive->material, renderFlags)) {
+						continue;
+					}
+					objects.push_back({ &model, &primitive->material, glm::vec3(matrix * glm::vec4(primitive->dimensions.center, 1.0f)), primitive->dimensions.radius * scale, primitive->firstIndex, primitive->indexCount });
+				}
+			}
+			// Keep the primitives of a model and a material together to minimize buffer and descriptor set binds
+			std::stable_sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) { return (a.model != b.model) ? (a.model < b.model) : (a.material < b.material); });
+		}
+
+		/** @brief Resize the views, fails if the device can't render that many views in a single pass */
+		void setViewCount(uint32_t count)
+		{
+			if ((count == 0) || (count > maxViewCount)) {
+				vks::tools::exitFatal("Multiview renderer: " + std::to_string(count) + " views requested, the device supports up to maxMultiviewViewCount = " + std::to_string(maxViewCount), -1);
+			}
+			views.resize(count);
+		}
+
+		/** @brief Update the frusta of the views and the union volume enclosing all of them */
+		void update()
+		{
+			assert(!views.empty() && (views.size() <= maxViewCount));
+			viewFrusta.resize(views.size());
+			for (size_t i = 0; i < views.size(); i++) {
+				viewFrusta[i].update(views[i].projection * views[i].view);
+			}
+			unionFrustum = viewFrusta[0];
+			for (const View& view : views) {
+				const glm::mat4 invViewProj = glm::inverse(view.projection * view.view);
+				for (uint32_t corner = 0; corner < 8; corner++) {
+					const glm::vec4 ndc((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : 0.0f, 1.0f);
+					const glm::vec4 worldPos = invViewProj * ndc;
+					const glm::vec3 pos = glm::vec3(worldPos) / worldPos.w;
+					for (auto& plane : unionFrustum.planes) {
+						const float distance = glm::dot(glm::vec3(plane), pos) + plane.w;
+						if (distance < 0.0f) {
+							plane.w -= distance;
+						}
+					}
+				}
+			}
+		}
+
+		/**
+		* Select the primitives to record
+		*
+		* @param viewIndex Index of the view to cull against, or AllViews for the union of all views (single multiview pass)
+		* @return Number of visible primitives
+		*/
+		uint32_t cull(int32_t viewIndex = AllViews)
+		{
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			vks::Frustum& frustum = (viewIndex == AllViews) ? unionFrustum : viewFrusta[viewIndex];
+			visibleObjects.clear();
+			for (uint32_t i = 0; i < objects.size(); i++) {
+				if (!cullingEnabled || frustum.checkSphere(objects[i].center, objects[i].radius)) {
+					visibleObjects.push_back(i);
+				}
+			}
+			stats.culled += static_cast<uint32_t>(objects.size() - visibleObjects.size());
+			stats.visible += static_cast<uint32_t>(visibleObjects.size());
+			stats.cullTime += millisecondsSince(tStart);
+			return static_cast<uint32_t>(visibleObjects.size());
+		}
+
+		/**
+		* Record the primitives selected by the last call to cull
+		*
+		* @param commandBuffer Command buffer to record to, must be inside a render pass with a pipeline bound
+		* @param renderFlags If RenderFlags::BindImages is set, the material descriptor sets are bound to bindImageSet
+		* @param pipelineLayout Layout used for binding the material descriptor sets
+		* @param bindImageSet Set index of the material descriptor sets
+		*/
+		void record(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1)
+		{
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			const vkglTF::Model* boundModel{ nullptr };
+			const vkglTF::Material* boundMaterial{ nullptr };
+			const bool bindImages = (renderFlags & vkglTF::RenderFlags::BindImages) && (pipelineLayout != VK_NULL_HANDLE);
+			for (uint32_t index : visibleObjects) {
+				const Object& object = objects[index];
+				if (object.model != boundModel) {
+					const VkDeviceSize offsets[1] = { 0 };
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &object.model->vertices.buffer, offsets);
+					vkCmdBindIndexBuffer(commandBuffer, object.model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+					boundModel = object.model;
+				}
+				if (bindImages && (object.material != boundMaterial) && (object.material->descriptorSet != VK_NULL_HANDLE)) {
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &object.material->descriptorSet, 0, nullptr);
+					boundMaterial = object.material;
+					stats.descriptorSetBinds++;
+				}
+				vkCmdDrawIndexed(commandBuffer, object.indexCount, 1, object.firstIndex, 0, 0);
+				stats.draws++;
+			}
+			stats.recordTime += millisecondsSince(tStart);
+		}
+
+		void resetStats()
+		{
+			stats = {};
+		}
+	};
+}
@@ -0,0 +1,198 @@
+/*
+* Vulkan parallel command buffer recorder class
+*
+* Splits a list of draws into balanced chunks that are recorded into secondary command buffers on a thread pool and executed by one primary command buffer
+* Command pools are per thread and per frame in flight, they are reset at the start of a frame and their command buffers are reused instead of freed
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cassert>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Records chunks of a draw list into secondary command buffers in parallel
+	* @note Secondary command buffers don't inherit any state, the chunk callback has to bind pipelines, descriptor sets, buffers and set dynamic state itself
+	* @note For dynamic rendering, chain a VkCommandBufferInheritanceRenderingInfo to the inheritance info and begin rendering with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+	* @note For render passes, begin the (sub)pass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	*/
+	class ParallelRecorder
+	{
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		uint32_t queueFamilyIndex{ 0 };
+		uint32_t frameCount{ 0 };
+		struct ThreadFrame {
+			VkCommandPool commandPool{ VK_NULL_HANDLE };
+			// Command buffers allocated from the pool, reused in every frame the pool is reset
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t used{ 0 };
+		};
+		// Indexed by frame * threadCount + thread
+		std::vector<ThreadFrame> threadFrames;
+		vks::ThreadPool threadPool;
+		std::vector<VkCommandBuffer> recordedCommandBuffers;
+
+		ThreadFrame& getThreadFrame(uint32_t frame, uint32_t thread)
+		{
+			return threadFrames[frame * threadCount + thread];
+		}
+
+		// Must be called from the thread that calls record, as allocating from a pool needs to be externally synchronized
+		VkCommandBuffer acquireCommandBuffer(uint32_t frame, uint32_t thread)
+		{
+			ThreadFrame& threadFrame = getThreadFrame(frame, thread);
+			if (threadFrame.used == threadFrame.commandBuffers.size()) {
+				VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+				VkCommandBufferAllocateInfo allocateInfo = vks::initializers::commandBufferAllocateInfo(threadFrame.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &allocateInfo, &commandBuffer));
+				threadFrame.commandBuffers.push_back(commandBuffer);
+				stats.allocatedCommandBuffers++;
+			}
+			return threadFrame.commandBuffers[threadFrame.used++];
+		}
+
+		void createPools()
+		{
+			threadFrames.resize(frameCount * threadCount);
+			for (ThreadFrame& threadFrame : threadFrames) {
+				VkCommandPoolCreateInfo commandPoolCI = vks::initializers::commandPoolCreateInfo();
+				commandPoolCI.queueFamilyIndex = queueFamilyIndex;
+				// Command buffers are only reset together with their pool
+				commandPoolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &commandPoolCI, nullptr, &threadFrame.commandPool));
+			}
+			// The calling thread records the first chunks itself, so it only needs workers for the remaining threads
+			threadPool.setThreadCount(threadCount - 1);
+		}
+
+		void destroyPools()
+		{
+			threadPool.wait();
+			for (ThreadFrame& threadFrame : threadFrames) {
+				vkDestroyCommandPool(vulkanDevice->logicalDevice, threadFrame.commandPool, nullptr);
+			}
+			threadFrames.clear();
+		}
+
+	public:
+		/** @brief Number of threads recording, including the calling thread */
+		uint32_t threadCount{ 1 };
+		/** @brief Chunks per thread, more chunks balance uneven recording costs better but add secondary command buffers */
+		uint32_t chunksPerThread{ 1 };
+
+		struct Stats {
+			// Wall clock time of the last call to record, in milliseconds
+			double recordTime{ 0.0 };
+			uint32_t chunks{ 0 };
+			uint32_t allocatedCommandBuffers{ 0 };
+		} stats;
+
+		/**
+		* Create the per thread and per frame command pools
+		*
+		* @param vulkanDevice Device the pools are created on
+		* @param queueFamilyIndex Queue family the primary command buffers are submitted to
+		* @param threadCount Number of recording threads including the calling thread
+		* @param frameCount Number of frames in flight
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t frameCount)
+		{
+			assert(threadCount > 0);
+			this->vulkanDevice = vulkanDevice;
+			this->queueFamilyIndex = queueFamilyIndex;
+			this->threadCount = threadCount;
+			this->frameCount = frameCount;
+			createPools();
+		}
+
+		void destroy()
+		{
+			if (vulkanDevice) {
+				destroyPools();
+			}
+		}
+
+		/** @brief Change the number of recording threads, none of the recorded command buffers may be pending execution */
+		void setThreadCount(uint32_t count)
+		{
+			assert(count > 0);
+			if (count == threadCount) {
+				return;
+			}
+			destroyPools();
+			threadCount = count;
+			createPools();
+			stats.allocatedCommandBuffers = 0;
+		}
+
+		/** @brief Reset the command pools of a frame, call once the frame's previous command buffers have finished execution */
+		void beginFrame(uint32_t frame)
+		{
+			for (uint32_t thread = 0; thread < threadCount; thread++) {
+				ThreadFrame& threadFrame = getThreadFrame(frame, thread);
+				VK_CHECK_RESULT(vkResetCommandPool(vulkanDevice->logicalDevice, threadFrame.commandPool, 0));
+				threadFrame.used = 0;
+			}
+		}
+
+		/**
+		* Record items in parallel, each chunk of consecutive items goes into its own secondary command buffer
+		*
+		* @param frame Index of the frame in flight
+		* @param inheritanceInfo Render pass (or dynamic rendering) state the secondary command buffers are executed in
+		* @param itemCount Number of items (e.g. draw commands) to split
+		* @param recordChunk Called on the recording threads with the command buffer, the chunk index and the range of items to record
+		* @return Secondary command buffers in item order, to be passed to vkCmdExecuteCommands
+		*/
+		const std::vector<VkCommandBuffer>& record(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritanceInfo, uint32_t itemCount, std::function<void(VkCommandBuffer commandBuffer, uint32_t chunk, uint32_t firstItem, uint32_t itemCount)> recordChunk)
+		{
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			const uint32_t chunkCount = std::min(itemCount, threadCount * chunksPerThread);
+			recordedCommandBuffers.resize(chunkCount);
+			// Chunks are assigned to threads round robin, all command buffers are acquired up front so the threads never touch a pool another thread allocates from
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+				recordedCommandBuffers[chunk] = acquireCommandBuffer(frame, chunk % threadCount);
+			}
+			auto recordChunks = [this, &inheritanceInfo, &recordChunk, itemCount, chunkCount](uint32_t thread) {
+				VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				beginInfo.pInheritanceInfo = &inheritanceInfo;
+				for (uint32_t chunk = thread; chunk < chunkCount; chunk += threadCount) {
+					// Balanced split, chunk sizes differ by at most one item
+					const uint32_t firstItem = static_cast<uint32_t>((uint64_t)itemCount * chunk / chunkCount);
+					const uint32_t lastItem = static_cast<uint32_t>((uint64_t)itemCount * (chunk + 1) / chunkCount);
+					VkCommandBuffer commandBuffer = recordedCommandBuffers[chunk];
+					VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+					recordChunk(commandBuffer, chunk, firstItem, lastItem - firstItem);
+					VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+				}
+			};
+			const uint32_t activeThreads = std::min(threadCount, chunkCount);
+			for (uint32_t thread = 1; thread < activeThreads; thread++) {
+				threadPool.threads[thread - 1]->addJob([recordChunks, thread] { recordChunks(thread); });
+			}
+			if (activeThreads > 0) {
+				recordChunks(0);
+			}
+			threadPool.wait();
+			stats.chunks = chunkCount;
+			stats.recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return recordedCommandBuffers;
+		}
+	};
+}
@@ -0,0 +1,690 @@
+/*
+* Vulkan render graph class
+*
+* Passes declare the images they render to and the images they sample, the graph derives pass culling, load and store operations,
+* image layout transitions and barriers from that, and places transient images with non-overlapping lifetimes in shared memory
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanDebug.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Render graph for single queue, graphics only frames
+	* @note Passes are executed in the order they were added, a pass may only sample images written by an earlier pass
+	* @note compile() works without a device (using estimated memory sizes), so pass culling, barriers and memory aliasing can be inspected on the CPU
+	*/
+	class RenderGraph
+	{
+	public:
+		static constexpr uint32_t invalidHandle{ UINT32_MAX };
+
+		/** @brief Statistics of the last compilation */
+		struct Stats {
+			uint32_t passCount{ 0 };
+			uint32_t culledPassCount{ 0 };
+			/** @brief Image memory barriers recorded per frame */
+			uint32_t barrierCount{ 0 };
+			/** @brief Pipeline barrier commands recorded per frame, all barriers of a pass are batched into one */
+			uint32_t barrierBatchCount{ 0 };
+			/** @brief Images only used within a single pass that are backed by lazily allocated memory */
+			uint32_t lazyImageCount{ 0 };
+			/** @brief Memory required if every image had a dedicated allocation */
+			VkDeviceSize unaliasedMemory{ 0 };
+			/** @brief Memory required with images of non-overlapping lifetimes sharing memory */
+			VkDeviceSize aliasedMemory{ 0 };
+		} stats;
+
+	private:
+		// Layout, access and stages of an image for one use in a pass
+		struct ImageState {
+			VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkAccessFlags access{ 0 };
+			VkPipelineStageFlags stages{ 0 };
+		};
+		struct Image {
+			std::string name;
+			VkFormat format;
+			uint32_t width;
+			uint32_t height;
+			VkImageUsageFlags usage;
+			// Compiled state
+			uint32_t firstPass;
+			uint32_t lastPass;
+			// Only used within a single pass and never sampled, content does not need to be stored
+			bool transient;
+			bool lazy;
+			VkDeviceSize size;
+			VkDeviceSize alignment;
+			VkDeviceSize offset;
+			ImageState finalState;
+			// Vulkan objects
+			VkImage image{ VK_NULL_HANDLE };
+			VkImageView view{ VK_NULL_HANDLE };
+			VkDeviceMemory lazyMemory{ VK_NULL_HANDLE };
+		};
+		struct Attachment {
+			uint32_t image;
+			VkClearValue clearValue;
+			VkAttachmentLoadOp loadOp;
+			VkAttachmentStoreOp storeOp;
+		};
+		struct Transition {
+			uint32_t image;
+			ImageState src;
+			ImageState dst;
+		};
+		struct Pass {
+			std::string name;
+			std::function<void(VkCommandBuffer)> execute;
+			std::vector<Attachment> colorAttachments;
+			Attachment depthAttachment{ invalidHandle };
+			std::vector<uint32_t> sampledImages;
+			bool sideEffect{ false };
+			// Compiled state
+			bool culled{ false };
+			std::vector<Transition> transitions;
+			// Vulkan objects
+			VkRenderPass renderPass{ VK_NULL_HANDLE };
+			VkFramebuffer framebuffer{ VK_NULL_HANDLE };
+		};
+
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		std::vector<Image> images;
+		std::vector<Pass> passes;
+		// Indices of the passes that survived culling, in execution order
+		std::vector<uint32_t> passOrder;
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+
+		// Depth, depth/stencil and stencil only formats are used as depth/stencil attachments
+		static bool isDepthStencilFormat(VkFormat format)
+		{
+			return vks::tools::formatHasDepth(format) || vks::tools::formatHasStencil(format);
+		}
+
+		static VkImageAspectFlags aspectMask(VkFormat format, bool view)
+		{
+			if (!isDepthStencilFormat(format)) {
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+			const bool hasDepth = vks::tools::formatHasDepth(format);
+			const bool hasStencil = vks::tools::formatHasStencil(format);
+			// Layout transitions need to include all aspects, views used for sampling must select a single one (depth if present)
+			if (view) {
+				return hasDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+			return (hasDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : 0) | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+		}
+
+		// Estimated size of a texel, only used if compiled without a device
+		static VkDeviceSize estimatedTexelSize(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8_UNORM:
+			case VK_FORMAT_S8_UINT:
+				return 1;
+			case VK_FORMAT_R8G8_UNORM:
+			case VK_FORMAT_R16_SFLOAT:
+			case VK_FORMAT_D16_UNORM:
+				return 2;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+			case VK_FORMAT_R32G32_SFLOAT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return 8;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 16;
+			default:
+				return 4;
+			}
+		}
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Place images with overlapping lifetimes at non-overlapping memory ranges, largest images first
+		void computeAliasing()
+		{
+			std::vector<uint32_t> order;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(images.size()); i++) {
+				if (images[i].firstPass != invalidHandle && !images[i].lazy) {
+					order.push_back(i);
+				}
+			}
+			std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return images[a].size > images[b].size; });
+			std::vector<uint32_t> placed;
+			stats.aliasedMemory = 0;
+			for (uint32_t index : order) {
+				Image& image = images[index];
+				// Memory ranges of already placed images that are alive at the same time
+				std::vector<std::pair<VkDeviceSize, VkDeviceSize>> occupied;
+				for (uint32_t other : placed) {
+					if (images[other].firstPass <= image.lastPass && image.firstPass <= images[other].lastPass) {
+						occupied.push_back({ images[other].offset, images[other].offset + images[other].size });
+					}
+				}
+				std::sort(occupied.begin(), occupied.end());
+				VkDeviceSize offset = 0;
+				for (auto& range : occupied) {
+					if (offset + image.size <= range.first) {
+						break;
+					}
+					offset = std::max(offset, alignUp(range.second, image.alignment));
+				}
+				image.offset = offset;
+				placed.push_back(index);
+				stats.aliasedMemory = std::max(stats.aliasedMemory, offset + image.size);
+			}
+		}
+
+		// Images placed in the same memory at overlapping ranges
+		bool sharesMemory(const Image& a, const Image& b) const
+		{
+			return !a.lazy && !b.lazy && (a.offset < b.offset + b.size) && (b.offset < a.offset + a.size);
+		}
+
+		// Record the layout transitions and dependencies required before each pass
+		void computeBarriers()
+		{
+			stats.barrierCount = 0;
+			stats.barrierBatchCount = 0;
+			std::vector<ImageState> states(images.size());
+			std::vector<bool> used(images.size(), false);
+			for (uint32_t index : passOrder) {
+				Pass& pass = passes[index];
+				pass.transitions.clear();
+				auto use = [&](uint32_t imageIndex, const ImageState& dst) {
+					ImageState& state = states[imageIndex];
+					const Image& image = images[imageIndex];
+					if (!used[imageIndex]) {
+						// First use in the frame: The content is discarded, but the image (or an image sharing its memory) may still be accessed by the previous frame
+						ImageState src{ VK_IMAGE_LAYOUT_UNDEFINED, image.finalState.access, image.finalState.stages };
+						for (auto& other : images) {
+							if (other.firstPass != invalidHandle && &other != &image && sharesMemory(image, other)) {
+								src.access |= other.finalState.access;
+								src.stages |= other.finalState.stages;
+							}
+						}
+						src.stages = src.stages ? src.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+						pass.transitions.push_back({ imageIndex, src, dst });
+						used[imageIndex] = true;
+					} else {
+						// Reads following reads in the same layout need no barrier, everything else does
+						const VkAccessFlags writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+						const bool writes = (state.access & writeAccess) || (dst.access & writeAccess);
+						if (state.layout != dst.layout || writes) {
+							pass.transitions.push_back({ imageIndex, state, dst });
+						}
+					}
+					state = dst;
+				};
+				for (auto& attachment : pass.colorAttachments) {
+					use(attachment.image, { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT });
+				}
+				if (pass.depthAttachment.image != invalidHandle) {
+					use(pass.depthAttachment.image, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT });
+				}
+				for (uint32_t imageIndex : pass.sampledImages) {
+					use(imageIndex, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
+				}
+				stats.barrierCount += static_cast<uint32_t>(pass.transitions.size());
+				stats.barrierBatchCount += pass.transitions.empty() ? 0 : 1;
+			}
+		}
+
+		void createRenderPass(Pass& pass)
+		{
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			std::vector<VkImageView> views;
+			auto addAttachment = [&](const Attachment& attachment, VkImageLayout layout) {
+				const Image& image = images[attachment.image];
+				// Layout transitions are done by the graph's barriers, so the render pass keeps the attachment layout
+				attachmentDescriptions.push_back({
+					.format = image.format,
+					.samples = VK_SAMPLE_COUNT_1_BIT,
+					.loadOp = attachment.loadOp,
+					.storeOp = attachment.storeOp,
+					.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+					.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+					.initialLayout = layout,
+					.finalLayout = layout
+				});
+				views.push_back(image.view);
+			};
+			for (auto& attachment : pass.colorAttachments) {
+				colorReferences.push_back({ static_cast<uint32_t>(attachmentDescriptions.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+				addAttachment(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			}
+			VkAttachmentReference depthReference{ static_cast<uint32_t>(attachmentDescriptions.size()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			if (pass.depthAttachment.image != invalidHandle) {
+				addAttachment(pass.depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+			}
+			VkSubpassDescription subpass{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size()),
+				.pColorAttachments = colorReferences.data(),
+				.pDepthStencilAttachment = (pass.depthAttachment.image != invalidHandle) ? &depthReference : nullptr
+			};
+			VkRenderPassCreateInfo renderPassCI{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size()),
+				.pAttachments = attachmentDescriptions.data(),
+				.subpassCount = 1,
+				.pSubpasses = &subpass
+			};
+			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassCI, nullptr, &pass.renderPass));
+
+			const Image& first = images[pass.colorAttachments.empty() ? pass.depthAttachment.image : pass.colorAttachments[0].image];
+			VkFramebufferCreateInfo framebufferCI{
+				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+				.renderPass = pass.renderPass,
+				.attachmentCount = static_cast<uint32_t>(views.size()),
+				.pAttachments = views.data(),
+				.width = first.width,
+				.height = first.height,
+				.layers = 1
+			};
+			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferCI, nullptr, &pass.framebuffer));
+		}
+
+	public:
+		/**
+		* Declare an image owned by the graph
+		*
+		* @param name Name used for debugging
+		* @param format Image format, usage as color or depth attachment is derived from it
+		* @param width Width of the image
+		* @param height Height of the image
+		* @param usage (Optional) Additional usage flags, e.g. if the image is also accessed outside of the graph
+		*
+		* @return Handle of the image
+		*/
+		uint32_t addImage(const std::string& name, VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage = 0)
+		{
+			Image image{};
+			image.name = name;
+			image.format = format;
+			image.width = width;
+			image.height = height;
+			image.usage = usage;
+			images.push_back(image);
+			return static_cast<uint32_t>(images.size() - 1);
+		}
+
+		/**
+		* Declare a pass
+		*
+		* @param name Name used for debugging
+		* @param execute Records the pass' commands, called inside the pass' render pass if it has attachments
+		*
+		* @return Handle of the pass
+		*/
+		uint32_t addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute)
+		{
+			Pass pass{};
+			pass.name = name;
+			pass.execute = execute;
+			passes.push_back(pass);
+			return static_cast<uint32_t>(passes.size() - 1);
+		}
+
+		/** @brief Render to an image as a color attachment, the clear value is used if the pass is the first to write the image */
+		void addColorOutput(uint32_t pass, uint32_t image, VkClearColorValue clearValue = { { 0.0f, 0.0f, 0.0f, 0.0f } })
+		{
+			Attachment attachment{ image };
+			attachment.clearValue.color = clearValue;
+			passes[pass].colorAttachments.push_back(attachment);
+		}
+
+		/** @brief Render to an image as the depth attachment, the clear value is used if the pass is the first to write the image */
+		void setDepthOutput(uint32_t pass, uint32_t image, VkClearDepthStencilValue clearValue = { 1.0f, 0 })
+		{
+			Attachment attachment{ image };
+			attachment.clearValue.depthStencil = clearValue;
+			passes[pass].depthAttachment = attachment;
+		}
+
+		/** @brief Sample from an image in the fragment shader */
+		void addSampledInput(uint32_t pass, uint32_t image)
+		{
+			passes[pass].sampledImages.push_back(image);
+		}
+
+		/** @brief Mark a pass as producing results outside of the graph (e.g. rendering to the swapchain), such passes and the passes they depend on are never culled */
+		void setSideEffect(uint32_t pass)
+		{
+			passes[pass].sideEffect = true;
+		}
+
+		/**
+		* Cull passes that don't contribute to passes with side effects, and derive image lifetimes, load/store operations, barriers and memory placement
+		*
+		* @param lazyMemoryAvailable (Optional) Assume lazily allocated memory is available for images that are only used within a single pass
+		*
+		* @note Without a device, memory sizes are estimated from the image dimensions and formats
+		*/
+		void compile(bool lazyMemoryAvailable = false)
+		{
+			stats = {};
+			// Walk the passes back to front, a pass is required if it writes an image that a later required pass reads
+			std::vector<bool> required(images.size(), false);
+			std::vector<uint32_t> firstWriter(images.size(), invalidHandle);
+			for (uint32_t p = 0; p < static_cast<uint32_t>(passes.size()); p++) {
+				for (auto& attachment : passes[p].colorAttachments) {
+					firstWriter[attachment.image] = std::min(firstWriter[attachment.image], p);
+				}
+				if (passes[p].depthAttachment.image != invalidHandle) {
+					firstWriter[passes[p].depthAttachment.image] = std::min(firstWriter[passes[p].depthAttachment.image], p);
+				}
+				for (uint32_t image : passes[p].sampledImages) {
+					if (firstWriter[image] >= p) {
+						vks::tools::exitFatal("Render graph: Image \"" + images[image].name + "\" is sampled by pass \"" + passes[p].name + "\" before it has been written", -1);
+					}
+				}
+			}
+			for (int32_t p = static_cast<int32_t>(passes.size()) - 1; p >= 0; p--) {
+				Pass& pass = passes[p];
+				std::vector<Attachment*> attachments;
+				for (auto& attachment : pass.colorAttachments) {
+					attachments.push_back(&attachment);
+				}
+				if (pass.depthAttachment.image != invalidHandle) {
+					attachments.push_back(&pass.depthAttachment);
+				}
+				bool needed = pass.sideEffect;
+				for (auto attachment : attachments) {
+					needed |= required[attachment->image];
+				}
+				pass.culled = !needed;
+				if (pass.culled) {
+					stats.culledPassCount++;
+					continue;
+				}
+				// Attachments written by an earlier pass are loaded, so that pass is required too
+				for (auto attachment : attachments) {
+					required[attachment->image] = (firstWriter[attachment->image] < static_cast<uint32_t>(p));
+				}
+				for (uint32_t image : pass.sampledImages) {
+					required[image] = true;
+				}
+			}
+
+			passOrder.clear();
+			for (uint32_t p = 0; p < static_cast<uint32_t>(passes.size()); p++) {
+				if (!passes[p].culled) {
+					passOrder.push_back(p);
+				}
+			}
+			stats.passCount = static_cast<uint32_t>(passOrder.size());
+
+			// Lifetimes in execution order
+			std::vector<bool> sampled(images.size(), false);
+			for (auto& image : images) {
+				image.firstPass = invalidHandle;
+				image.lastPass = 0;
+			}
+			for (uint32_t i = 0; i < static_cast<uint32_t>(passOrder.size()); i++) {
+				Pass& pass = passes[passOrder[i]];
+				auto touch = [&](uint32_t image) {
+					images[image].firstPass = std::min(images[image].firstPass, i);
+					images[image].lastPass = std::max(images[image].lastPass, i);
+				};
+				for (auto& attachment : pass.colorAttachments) {
+					touch(attachment.image);
+				}
+				if (pass.depthAttachment.image != invalidHandle) {
+					touch(pass.depthAttachment.image);
+				}
+				for (uint32_t image : pass.sampledImages) {
+					touch(image);
+					sampled[image] = true;
+				}
+			}
+
+			// Attachments are cleared by their first writer and only stored if used later on
+			for (uint32_t i = 0; i < static_cast<uint32_t>(passOrder.size()); i++) {
+				Pass& pass = passes[passOrder[i]];
+				auto setOps = [&](Attachment& attachment) {
+					const Image& image = images[attachment.image];
+					attachment.loadOp = (image.firstPass == i) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+					attachment.storeOp = (image.lastPass > i) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				};
+				for (auto& attachment : pass.colorAttachments) {
+					setOps(attachment);
+				}
+				if (pass.depthAttachment.image != invalidHandle) {
+					setOps(pass.depthAttachment);
+				}
+			}
+
+			for (uint32_t i = 0; i < static_cast<uint32_t>(images.size()); i++) {
+				Image& image = images[i];
+				if (image.firstPass == invalidHandle) {
+					continue;
+				}
+				image.transient = (image.firstPass == image.lastPass) && !sampled[i] && (image.usage == 0);
+				image.lazy = image.transient && lazyMemoryAvailable;
+				if (!vulkanDevice) {
+					image.alignment = 65536;
+					image.size = alignUp(image.width * image.height * estimatedTexelSize(image.format), image.alignment);
+				}
+				stats.unaliasedMemory += image.size;
+				stats.lazyImageCount += image.lazy ? 1 : 0;
+			}
+
+			computeAliasing();
+
+			// The state each image is left in at the end of the frame, this is where the first barrier of the next frame starts from
+			for (auto& image : images) {
+				image.finalState = {};
+			}
+			for (uint32_t index : passOrder) {
+				Pass& pass = passes[index];
+				for (auto& attachment : pass.colorAttachments) {
+					images[attachment.image].finalState = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+				}
+				if (pass.depthAttachment.image != invalidHandle) {
+					images[pass.depthAttachment.image].finalState = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+				}
+				for (uint32_t image : pass.sampledImages) {
+					images[image].finalState = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+				}
+			}
+
+			computeBarriers();
+		}
+
+		/**
+		* Compile the graph and create all images, memory, render passes and framebuffers
+		*
+		* @param vulkanDevice Device to create the Vulkan objects on
+		*/
+		void create(vks::VulkanDevice* vulkanDevice)
+		{
+			this->vulkanDevice = vulkanDevice;
+			VkDevice device = vulkanDevice->logicalDevice;
+			// Compile once to find out which images are used and how, then create them to get their actual memory requirements
+			compile();
+			uint32_t memoryTypeBits = ~0u;
+			VkBool32 lazyMemoryAvailable = VK_FALSE;
+			for (auto& image : images) {
+				if (image.firstPass == invalidHandle) {
+					continue;
+				}
+				VkImageUsageFlags usage = image.usage | (isDepthStencilFormat(image.format) ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+				usage |= image.transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT;
+				VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+				imageCI.imageType = VK_IMAGE_TYPE_2D;
+				imageCI.format = image.format;
+				imageCI.extent = { image.width, image.height, 1 };
+				imageCI.mipLevels = 1;
+				imageCI.arrayLayers = 1;
+				imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCI.usage = usage;
+				VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image.image));
+				VkMemoryRequirements memReqs;
+				vkGetImageMemoryRequirements(device, image.image, &memReqs);
+				image.size = memReqs.size;
+				image.alignment = memReqs.alignment;
+				if (image.transient) {
+					vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemoryAvailable);
+				}
+				if (!image.transient || !lazyMemoryAvailable) {
+					memoryTypeBits &= memReqs.memoryTypeBits;
+				}
+			}
+			// Compile again with the actual memory requirements
+			compile(lazyMemoryAvailable);
+
+			// All non-lazy images are bound to a single allocation at their aliased offsets
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = stats.aliasedMemory;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			if (memAlloc.allocationSize > 0) {
+				VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+			}
+			for (auto& image : images) {
+				if (image.firstPass == invalidHandle) {
+					continue;
+				}
+				if (image.lazy) {
+					VkMemoryRequirements memReqs;
+					vkGetImageMemoryRequirements(device, image.image, &memReqs);
+					VkMemoryAllocateInfo lazyAlloc = vks::initializers::memoryAllocateInfo();
+					lazyAlloc.allocationSize = memReqs.size;
+					lazyAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+					VK_CHECK_RESULT(vkAllocateMemory(device, &lazyAlloc, nullptr, &image.lazyMemory));
+					VK_CHECK_RESULT(vkBindImageMemory(device, image.image, image.lazyMemory, 0));
+				} else {
+					VK_CHECK_RESULT(vkBindImageMemory(device, image.image, memory, image.offset));
+				}
+				VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+				imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				imageViewCI.format = image.format;
+				imageViewCI.subresourceRange = { aspectMask(image.format, true), 0, 1, 0, 1 };
+				imageViewCI.image = image.image;
+				VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &image.view));
+			}
+			for (uint32_t index : passOrder) {
+				Pass& pass = passes[index];
+				if (!pass.colorAttachments.empty() || pass.depthAttachment.image != invalidHandle) {
+					createRenderPass(pass);
+				}
+			}
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& pass : passes) {
+				if (pass.renderPass != VK_NULL_HANDLE) {
+					vkDestroyFramebuffer(device, pass.framebuffer, nullptr);
+					vkDestroyRenderPass(device, pass.renderPass, nullptr);
+				}
+			}
+			for (auto& image : images) {
+				if (image.image != VK_NULL_HANDLE) {
+					vkDestroyImageView(device, image.view, nullptr);
+					vkDestroyImage(device, image.image, nullptr);
+				}
+				if (image.lazyMemory != VK_NULL_HANDLE) {
+					vkFreeMemory(device, image.lazyMemory, nullptr);
+				}
+			}
+			if (memory != VK_NULL_HANDLE) {
+				vkFreeMemory(device, memory, nullptr);
+			}
+			images.clear();
+			passes.clear();
+			passOrder.clear();
+			memory = VK_NULL_HANDLE;
+		}
+
+		/** @brief Record all passes that survived culling along with their barriers */
+		void execute(VkCommandBuffer commandBuffer)
+		{
+			std::vector<VkImageMemoryBarrier> barriers;
+			for (uint32_t index : passOrder) {
+				Pass& pass = passes[index];
+				vks::debugutils::cmdBeginLabel(commandBuffer, pass.name, { 0.5f, 0.76f, 0.34f, 1.0f });
+				if (!pass.transitions.empty()) {
+					barriers.clear();
+					VkPipelineStageFlags srcStageMask = 0;
+					VkPipelineStageFlags dstStageMask = 0;
+					for (auto& transition : pass.transitions) {
+						const Image& image = images[transition.image];
+						VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+						barrier.srcAccessMask = transition.src.access;
+						barrier.dstAccessMask = transition.dst.access;
+						barrier.oldLayout = transition.src.layout;
+						barrier.newLayout = transition.dst.layout;
+						barrier.image = image.image;
+						barrier.subresourceRange = { aspectMask(image.format, false), 0, 1, 0, 1 };
+						barriers.push_back(barrier);
+						srcStageMask |= transition.src.stages;
+						dstStageMask |= transition.dst.stages;
+					}
+					vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+				}
+				if (pass.renderPass != VK_NULL_HANDLE) {
+					std::vector<VkClearValue> clearValues;
+					for (auto& attachment : pass.colorAttachments) {
+						clearValues.push_back(attachment.clearValue);
+					}
+					if (pass.depthAttachment.image != invalidHandle) {
+						clearValues.push_back(pass.depthAttachment.clearValue);
+					}
+					const Image& first = images[pass.colorAttachments.empty() ? pass.depthAttachment.image : pass.colorAttachments[0].image];
+					VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+					renderPassBeginInfo.renderPass = pass.renderPass;
+					renderPassBeginInfo.framebuffer = pass.framebuffer;
+					renderPassBeginInfo.renderArea.extent = { first.width, first.height };
+					renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+					renderPassBeginInfo.pClearValues = clearValues.data();
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					pass.execute(commandBuffer);
+					vkCmdEndRenderPass(commandBuffer);
+				} else {
+					pass.execute(commandBuffer);
+				}
+				vks::debugutils::cmdEndLabel(commandBuffer);
+			}
+		}
+
+		/** @brief Render pass of a pass with attachments, e.g. for pipeline creation (only valid after create) */
+		VkRenderPass renderPass(uint32_t pass) const
+		{
+			return passes[pass].renderPass;
+		}
+
+		/** @brief View of an image for sampling (only valid after create) */
+		VkImageView imageView(uint32_t image) const
+		{
+			return images[image].view;
+		}
+
+		bool isCulled(uint32_t pass) const
+		{
+			return passes[pass].culled;
+		}
+	};
+}
@@ -0,0 +1,528 @@
+/*
+* Vulkan shader cache class
+*
+* Stores implementation specific shader object binaries (VK_EXT_shader_object) and pipeline cache data on disk, so later runs can skip compiling SPIR-V
+* Also contains the dynamic state that replaces a monolithic pipeline when drawing with shader objects
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanImageCache.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Disk cache for shader object binaries and pipeline cache data
+	* @note Binaries are keyed by a hash of the device (vendor, device, driver version, pipeline cache and shader binary UUIDs), the SPIR-V and all other inputs of the shader (stage, entry point, flags, set layout bindings, specialization constants, push constant ranges)
+	* @note Set layouts are opaque handles, so their bindings have to be registered with addSetLayout, shaders using unregistered layouts are always compiled from SPIR-V
+	* @note Files carry a header with their key and a hash of their content, so stale or damaged files are detected before they are passed to the driver
+	* @note Files are written to a temporary file and renamed, the least recently used files are evicted once the cache grows beyond maxSize
+	*/
+	class ShaderCache
+	{
+	private:
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+		static constexpr uint32_t fileMagic = 0x43534B56; // "VKSC"
+		static constexpr uint32_t fileVersion = 1;
+
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		uint64_t deviceKey{ 0 };
+		PFN_vkCreateShadersEXT vkCreateShadersEXT{ nullptr };
+		PFN_vkDestroyShaderEXT vkDestroyShaderEXT{ nullptr };
+		PFN_vkGetShaderBinaryDataEXT vkGetShaderBinaryDataEXT{ nullptr };
+		// Hashes of the bindings of the set layouts registered with addSetLayout
+		std::unordered_map<VkDescriptorSetLayout, uint64_t> setLayoutHashes;
+
+		std::string filename(const std::string& name, uint64_t key) const
+		{
+			std::stringstream ss;
+			ss << directory << name << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+			return ss.str();
+		}
+
+		// Returns false if the file doesn't exist or its header doesn't match the key and content
+		bool readFile(const std::string& filename, uint64_t key, std::vector<char>& data, bool& damaged) const
+		{
+			damaged = false;
+			std::ifstream is(filename, std::ios::binary);
+			if (!is.is_open()) {
+				return false;
+			}
+			FileHeader header{};
+			is.read(reinterpret_cast<char*>(&header), sizeof(header));
+			damaged = !is || (header.magic != fileMagic) || (header.version != fileVersion) || (header.key != key);
+			if (!damaged) {
+				// Check the stored size against the actual file size before allocating, so a truncated or corrupted header can't request an arbitrary amount of memory
+				std::error_code ec;
+				const uintmax_t fileSize = std::filesystem::file_size(filename, ec);
+				damaged = ec || (fileSize < sizeof(header)) || (header.dataSize != fileSize - sizeof(header));
+			}
+			if (!damaged) {
+				data.resize(header.dataSize);
+				is.read(data.data(), data.size());
+				damaged = !is || (vks::ImageCache::hash(data.data(), data.size()) != header.dataHash);
+			}
+			return !damaged;
+		}
+
+		bool writeFile(const std::string& filename, uint64_t key, const void* data, size_t size)
+		{
+			FileHeader header{ .magic = fileMagic, .version = fileVersion, .key = key, .dataSize = size, .dataHash = vks::ImageCache::hash(data, size) };
+			std::error_code ec;
+			std::filesystem::create_directories(directory, ec);
+			// Write to a temporary file first, so an interrupted write never leaves a truncated file in the cache
+			const std::string tempFilename = filename + ".tmp";
+			{
+				std::ofstream os(tempFilename, std::ios::binary | std::ios::trunc);
+				os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				os.write(static_cast<const char*>(data), size);
+				if (!os) {
+					return false;
+				}
+			}
+			std::filesystem::rename(tempFilename, filename, ec);
+			return !ec;
+		}
+
+		void removeFile(const std::string& filename)
+		{
+			std::error_code ec;
+			std::filesystem::remove(filename, ec);
+		}
+
+		// Cache hits update the file time, so eviction removes the files that haven't been used for the longest time
+		void touch(const std::string& filename)
+		{
+			std::error_code ec;
+			std::filesystem::last_write_time(filename, std::filesystem::file_time_type::clock::now(), ec);
+		}
+
+		void evict()
+		{
+			std::error_code ec;
+			std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+			uint64_t totalSize = 0;
+			for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+				if (entry.is_regular_file() && (entry.path().extension() == ".bin")) {
+					files.push_back({ entry.last_write_time(ec), entry.path() });
+					totalSize += entry.file_size(ec);
+				}
+			}
+			std::sort(files.begin(), files.end());
+			for (const auto& [time, path] : files) {
+				if (totalSize <= maxSize) {
+					break;
+				}
+				totalSize -= std::filesystem::file_size(path, ec);
+				std::filesystem::remove(path, ec);
+				stats.evicted++;
+			}
+			stats.size = totalSize;
+		}
+
+		// Returns false if the shader can't be cached, as the bindings of one of its set layouts are unknown
+		bool shaderKey(const VkShaderCreateInfoEXT& createInfo, uint64_t& key) const
+		{
+			key = vks::ImageCache::hashValues(deviceKey, createInfo.flags, createInfo.stage, createInfo.nextStage, createInfo.codeType, createInfo.setLayoutCount);
+			for (uint32_t i = 0; i < createInfo.setLayoutCount; i++) {
+				auto setLayoutHash = setLayoutHashes.find(createInfo.pSetLayouts[i]);
+				if (setLayoutHash == setLayoutHashes.end()) {
+					return false;
+				}
+				key = vks::ImageCache::hashValues(key, setLayoutHash->second);
+			}
+			key = vks::ImageCache::hash(createInfo.pCode, createInfo.codeSize, key);
+			key = vks::ImageCache::hash(createInfo.pName, strlen(createInfo.pName), key);
+			key = vks::ImageCache::hash(createInfo.pPushConstantRanges, sizeof(VkPushConstantRange) * createInfo.pushConstantRangeCount, key);
+			if (createInfo.pSpecializationInfo) {
+				const VkSpecializationInfo* specializationInfo = createInfo.pSpecializationInfo;
+				key = vks::ImageCache::hash(specializationInfo->pMapEntries, sizeof(VkSpecializationMapEntry) * specializationInfo->mapEntryCount, key);
+				key = vks::ImageCache::hash(specializationInfo->pData, specializationInfo->dataSize, key);
+			}
+			return true;
+		}
+
+	public:
+		struct Stats {
+			// Shaders created from a cached binary
+			uint32_t hits{ 0 };
+			// Shaders compiled from SPIR-V
+			uint32_t misses{ 0 };
+			// Shaders compiled from SPIR-V without being cached, as the bindings of their set layouts are unknown
+			uint32_t uncached{ 0 };
+			// Cached files that were damaged or that the implementation refused to load (e.g. after a driver update)
+			uint32_t rejected{ 0 };
+			uint32_t written{ 0 };
+			uint32_t evicted{ 0 };
+			// Time spent in createShaders for calls served from the cache (warm) and calls that had to compile SPIR-V (cold), in milliseconds
+			double warmTime{ 0.0 };
+			double coldTime{ 0.0 };
+			bool pipelineCacheLoaded{ false };
+			uint64_t size{ 0 };
+		} stats;
+
+		/** @brief Directory the cache files are stored in */
+		std::string directory;
+		/** @brief Size limit in bytes for all files in the cache directory */
+		uint64_t maxSize{ 64ull * 1024 * 1024 };
+		/** @brief If false, nothing is read from or written to the cache */
+		bool enabled{ true };
+
+		/**
+		* Create the cache for a device
+		*
+		* @param instance Instance used to query the shader binary properties
+		* @param vulkanDevice Device the shaders are created for, shader object functions are only available if VK_EXT_shader_object has been enabled for it
+		* @param directory Cache directory
+		*/
+		void create(VkInstance instance, vks::VulkanDevice* vulkanDevice, const std::string& directory)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->directory = directory;
+			vkCreateShadersEXT = reinterpret_cast<PFN_vkCreateShadersEXT>(vkGetDeviceProcAddr(vulkanDevice->logicalDevice, "vkCreateShadersEXT"));
+			vkDestroyShaderEXT = reinterpret_cast<PFN_vkDestroyShaderEXT>(vkGetDeviceProcAddr(vulkanDevice->logicalDevice, "vkDestroyShaderEXT"));
+			vkGetShaderBinaryDataEXT = reinterpret_cast<PFN_vkGetShaderBinaryDataEXT>(vkGetDeviceProcAddr(vulkanDevice->logicalDevice, "vkGetShaderBinaryDataEXT"));
+
+			const VkPhysicalDeviceProperties& properties = vulkanDevice->properties;
+			deviceKey = vks::ImageCache::hashValues(vks::ImageCache::hash(properties.pipelineCacheUUID, VK_UUID_SIZE), properties.vendorID, properties.deviceID, properties.driverVersion);
+			// Shader binaries are only compatible with implementations reporting the same binary UUID and version
+			auto getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+			if (!getPhysicalDeviceProperties2) {
+				getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2"));
+			}
+			if (shaderObjectsSupported() && getPhysicalDeviceProperties2) {
+				VkPhysicalDeviceShaderObjectPropertiesEXT shaderObjectProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_PROPERTIES_EXT };
+				VkPhysicalDeviceProperties2 properties2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &shaderObjectProperties };
+				getPhysicalDeviceProperties2(vulkanDevice->physicalDevice, &properties2);
+				deviceKey = vks::ImageCache::hash(shaderObjectProperties.shaderBinaryUUID, VK_UUID_SIZE, deviceKey);
+				deviceKey = vks::ImageCache::hashValues(deviceKey, shaderObjectProperties.shaderBinaryVersion);
+			}
+#if defined(__ANDROID__)
+			// Assets are read from the apk, so there is no writable location next to them
+			enabled = false;
+#endif
+		}
+
+		/** @brief True if VK_EXT_shader_object has been enabled for the device */
+		bool shaderObjectsSupported() const
+		{
+			return vkCreateShadersEXT != nullptr;
+		}
+
+		/**
+		* Register the bindings of a descriptor set layout, shaders are only cached if all of their set layouts have been registered
+		*
+		* @param setLayout Set layout used in VkShaderCreateInfoEXT::pSetLayouts
+		* @param createInfo Create info the set layout was created with
+		* @note Immutable samplers are only hashed by their presence, layouts with different immutable sampler states need different bindings or must not be registered
+		*/
+		void addSetLayout(VkDescriptorSetLayout setLayout, const VkDescriptorSetLayoutCreateInfo& createInfo)
+		{
+			uint64_t hash = vks::ImageCache::hashValues(0xcbf29ce484222325ull, createInfo.flags, createInfo.bindingCount);
+			for (uint32_t i = 0; i < createInfo.bindingCount; i++) {
+				const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+				const bool immutableSamplers = (binding.pImmutableSamplers != nullptr);
+				hash = vks::ImageCache::hashValues(hash, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, immutableSamplers);
+			}
+			setLayoutHashes[setLayout] = hash;
+		}
+
+		/** @brief Read a SPIR-V file for use with VkShaderCreateInfoEXT */
+		static std::vector<char> readSpirv(const std::string& filename)
+		{
+			std::vector<char> code;
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			if (asset) {
+				code.resize(AAsset_getLength(asset));
+				AAsset_read(asset, code.data(), code.size());
+				AAsset_close(asset);
+			}
+#else
+			std::ifstream is(filename, std::ios::binary | std::ios::ate);
+			if (is.is_open()) {
+				code.resize(is.tellg());
+				is.seekg(0, std::ios::beg);
+				is.read(code.data(), code.size());
+			}
+#endif
+			if (code.empty()) {
+				vks::tools::exitFatal("Error: Could not open shader " + filename, VK_ERROR_UNKNOWN);
+			}
+			return code;
+		}
+
+		/**
+		* Create shader objects, loading the implementation specific binaries from the cache if possible
+		*
+		* @param count Number of shaders, linked stages (VK_SHADER_CREATE_LINK_STAGE_BIT_EXT) have to be created with a single call
+		* @param createInfos Create infos with SPIR-V code, used for the cache key and as the fallback if no valid binaries are cached
+		* @param shaders Receives the shader objects
+		*/
+		VkResult createShaders(uint32_t count, const VkShaderCreateInfoEXT* createInfos, VkShaderEXT* shaders)
+		{
+			assert(shaderObjectsSupported());
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			std::vector<uint64_t> keys(count);
+			std::vector<std::string> filenames(count);
+			bool cacheable = enabled;
+			for (uint32_t i = 0; i < count; i++) {
+				cacheable &= shaderKey(createInfos[i], keys[i]);
+				filenames[i] = filename("shader", keys[i]);
+			}
+
+			// All shaders of a call are loaded from binaries or none, as linked stages can't be mixed
+			if (cacheable) {
+				std::vector<std::vector<char>> binaries(count);
+				bool complete = true;
+				for (uint32_t i = 0; i < count; i++) {
+					bool damaged = false;
+					if (!readFile(filenames[i], keys[i], binaries[i], damaged)) {
+						if (damaged) {
+							stats.rejected++;
+							removeFile(filenames[i]);
+						}
+						complete = false;
+					}
+				}
+				if (complete) {
+					std::vector<VkShaderCreateInfoEXT> binaryCreateInfos(createInfos, createInfos + count);
+					for (uint32_t i = 0; i < count; i++) {
+						binaryCreateInfos[i].codeType = VK_SHADER_CODE_TYPE_BINARY_EXT;
+						binaryCreateInfos[i].pCode = binaries[i].data();
+						binaryCreateInfos[i].codeSize = binaries[i].size();
+					}
+					VkResult result = vkCreateShadersEXT(vulkanDevice->logicalDevice, count, binaryCreateInfos.data(), nullptr, shaders);
+					if (result == VK_SUCCESS) {
+						for (auto& filename : filenames) {
+							touch(filename);
+						}
+						stats.hits += count;
+						stats.warmTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+						return result;
+					}
+					// VK_INCOMPATIBLE_SHADER_BINARY_EXT: the binaries were created by a different implementation or driver version
+					for (uint32_t i = 0; i < count; i++) {
+						if (shaders[i] != VK_NULL_HANDLE) {
+							vkDestroyShaderEXT(vulkanDevice->logicalDevice, shaders[i], nullptr);
+							shaders[i] = VK_NULL_HANDLE;
+						}
+						removeFile(filenames[i]);
+					}
+					stats.rejected += count;
+				}
+			}
+
+			VkResult result = vkCreateShadersEXT(vulkanDevice->logicalDevice, count, createInfos, nullptr, shaders);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			stats.misses += count;
+			if (enabled && !cacheable) {
+				stats.uncached += count;
+			}
+			if (cacheable) {
+				for (uint32_t i = 0; i < count; i++) {
+					size_t dataSize{ 0 };
+					vkGetShaderBinaryDataEXT(vulkanDevice->logicalDevice, shaders[i], &dataSize, nullptr);
+					std::vector<char> data(dataSize);
+					if ((dataSize > 0) && (vkGetShaderBinaryDataEXT(vulkanDevice->logicalDevice, shaders[i], &dataSize, data.data()) == VK_SUCCESS) && writeFile(filenames[i], keys[i], data.data(), dataSize)) {
+						stats.written++;
+					}
+				}
+				evict();
+			}
+			stats.coldTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return result;
+		}
+
+		/**
+		* Load stored pipeline cache data
+		*
+		* @param name Name of the cache file, e.g. the example's name, as pipeline cache data isn't shared between applications
+		* @return Initial data for VkPipelineCacheCreateInfo, empty if there is no valid data for this device
+		*/
+		std::vector<char> loadPipelineCacheData(const std::string& name)
+		{
+			std::vector<char> data;
+			if (!enabled) {
+				return data;
+			}
+			const std::string cacheFile = filename(name, deviceKey);
+			bool damaged = false;
+			if (readFile(cacheFile, deviceKey, data, damaged)) {
+				// The implementation would ignore data for a different device, but that should never get here as the device is part of the key
+				VkPipelineCacheHeaderVersionOne header{};
+				if (data.size() >= sizeof(header)) {
+					memcpy(&header, data.data(), sizeof(header));
+				}
+				const VkPhysicalDeviceProperties& properties = vulkanDevice->properties;
+				if ((header.vendorID != properties.vendorID) || (header.deviceID != properties.deviceID) || (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+					damaged = true;
+				}
+			}
+			if (damaged) {
+				stats.rejected++;
+				removeFile(cacheFile);
+				data.clear();
+			}
+			if (!data.empty()) {
+				touch(cacheFile);
+			}
+			stats.pipelineCacheLoaded = !data.empty();
+			return data;
+		}
+
+		/** @brief Store the content of a pipeline cache, so pipelines created at the next start can be served from it */
+		void savePipelineCache(const std::string& name, VkPipelineCache pipelineCache)
+		{
+			if (!enabled || (pipelineCache == VK_NULL_HANDLE)) {
+				return;
+			}
+			size_t dataSize{ 0 };
+			vkGetPipelineCacheData(vulkanDevice->logicalDevice, pipelineCache, &dataSize, nullptr);
+			std::vector<char> data(dataSize);
+			if ((dataSize > 0) && (vkGetPipelineCacheData(vulkanDevice->logicalDevice, pipelineCache, &dataSize, data.data()) == VK_SUCCESS)) {
+				if (writeFile(filename(name, deviceKey), deviceKey, data.data(), dataSize)) {
+					stats.written++;
+				}
+				evict();
+			}
+		}
+	};
+
+	/**
+	* @brief Pipeline state that has to be set dynamically when drawing with shader objects instead of a monolithic pipeline
+	* @note The defaults match an opaque, depth tested pipeline with back face culling, record() sets all state that is required before drawing
+	*/
+	class ShaderObjectState
+	{
+	private:
+		PFN_vkCmdSetViewportWithCountEXT vkCmdSetViewportWithCountEXT{ nullptr };
+		PFN_vkCmdSetScissorWithCountEXT vkCmdSetScissorWithCountEXT{ nullptr };
+		PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT{ nullptr };
+		PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT{ nullptr };
+		PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT{ nullptr };
+		PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT{ nullptr };
+		PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT{ nullptr };
+		PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT{ nullptr };
+		PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT{ nullptr };
+		PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT{ nullptr };
+		PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamplesEXT{ nullptr };
+		PFN_vkCmdSetAlphaToCoverageEnableEXT vkCmdSetAlphaToCoverageEnableEXT{ nullptr };
+		PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT{ nullptr };
+		PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT{ nullptr };
+		PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT{ nullptr };
+		PFN_vkCmdSetSampleMaskEXT vkCmdSetSampleMaskEXT{ nullptr };
+		PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnableEXT{ nullptr };
+		PFN_vkCmdSetColorBlendEquationEXT vkCmdSetColorBlendEquationEXT{ nullptr };
+		PFN_vkCmdSetColorWriteMaskEXT vkCmdSetColorWriteMaskEXT{ nullptr };
+		PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT{ nullptr };
+		PFN_vkCmdBindShadersEXT vkCmdBindShadersEXT{ nullptr };
+
+	public:
+		VkCullModeFlags cullMode{ VK_CULL_MODE_BACK_BIT };
+		VkFrontFace frontFace{ VK_FRONT_FACE_COUNTER_CLOCKWISE };
+		VkBool32 depthTestEnable{ VK_TRUE };
+		VkBool32 depthWriteEnable{ VK_TRUE };
+		VkCompareOp depthCompareOp{ VK_COMPARE_OP_LESS_OR_EQUAL };
+		VkPrimitiveTopology topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		VkPolygonMode polygonMode{ VK_POLYGON_MODE_FILL };
+		VkSampleCountFlagBits rasterizationSamples{ VK_SAMPLE_COUNT_1_BIT };
+		uint32_t colorAttachmentCount{ 1 };
+		VkBool32 blendEnable{ VK_FALSE };
+		VkColorBlendEquationEXT blendEquation{ VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD };
+		VkColorComponentFlags colorWriteMask{ VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT };
+		std::vector<VkVertexInputBindingDescription2EXT> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes;
+
+		/** @brief Load the command functions, requires VK_EXT_shader_object (and VK_EXT_vertex_input_dynamic_state for vertex input) */
+		void create(VkDevice device)
+		{
+			vkCmdSetViewportWithCountEXT = reinterpret_cast<PFN_vkCmdSetViewportWithCountEXT>(vkGetDeviceProcAddr(device, "vkCmdSetViewportWithCountEXT"));
+			vkCmdSetScissorWithCountEXT = reinterpret_cast<PFN_vkCmdSetScissorWithCountEXT>(vkGetDeviceProcAddr(device, "vkCmdSetScissorWithCountEXT"));
+			vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
+			vkCmdSetFrontFaceEXT = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
+			vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
+			vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
+			vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
+			vkCmdSetPrimitiveTopologyEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
+			vkCmdSetRasterizerDiscardEnableEXT = reinterpret_cast<PFN_vkCmdSetRasterizerDiscardEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizerDiscardEnableEXT"));
+			vkCmdSetPolygonModeEXT = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT"));
+			vkCmdSetRasterizationSamplesEXT = reinterpret_cast<PFN_vkCmdSetRasterizationSamplesEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT"));
+			vkCmdSetAlphaToCoverageEnableEXT = reinterpret_cast<PFN_vkCmdSetAlphaToCoverageEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetAlphaToCoverageEnableEXT"));
+			vkCmdSetDepthBiasEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthBiasEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthBiasEnableEXT"));
+			vkCmdSetStencilTestEnableEXT = reinterpret_cast<PFN_vkCmdSetStencilTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetStencilTestEnableEXT"));
+			vkCmdSetPrimitiveRestartEnableEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT"));
+			vkCmdSetSampleMaskEXT = reinterpret_cast<PFN_vkCmdSetSampleMaskEXT>(vkGetDeviceProcAddr(device, "vkCmdSetSampleMaskEXT"));
+			vkCmdSetColorBlendEnableEXT = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
+			vkCmdSetColorBlendEquationEXT = reinterpret_cast<PFN_vkCmdSetColorBlendEquationEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEquationEXT"));
+			vkCmdSetColorWriteMaskEXT = reinterpret_cast<PFN_vkCmdSetColorWriteMaskEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT"));
+			vkCmdSetVertexInputEXT = reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT"));
+			vkCmdBindShadersEXT = reinterpret_cast<PFN_vkCmdBindShadersEXT>(vkGetDeviceProcAddr(device, "vkCmdBindShadersEXT"));
+		}
+
+		/** @brief Set all state a monolithic pipeline would have baked in */
+		void record(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height)
+		{
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetViewportWithCountEXT(commandBuffer, 1, &viewport);
+			vkCmdSetScissorWithCountEXT(commandBuffer, 1, &scissor);
+			vkCmdSetCullModeEXT(commandBuffer, cullMode);
+			vkCmdSetFrontFaceEXT(commandBuffer, frontFace);
+			vkCmdSetDepthTestEnableEXT(commandBuffer, depthTestEnable);
+			vkCmdSetDepthWriteEnableEXT(commandBuffer, depthWriteEnable);
+			vkCmdSetDepthCompareOpEXT(commandBuffer, depthCompareOp);
+			vkCmdSetPrimitiveTopologyEXT(commandBuffer, topology);
+			vkCmdSetRasterizerDiscardEnableEXT(commandBuffer, VK_FALSE);
+			vkCmdSetPolygonModeEXT(commandBuffer, polygonMode);
+			vkCmdSetRasterizationSamplesEXT(commandBuffer, rasterizationSamples);
+			vkCmdSetAlphaToCoverageEnableEXT(commandBuffer, VK_FALSE);
+			vkCmdSetDepthBiasEnableEXT(commandBuffer, VK_FALSE);
+			vkCmdSetStencilTestEnableEXT(commandBuffer, VK_FALSE);
+			vkCmdSetPrimitiveRestartEnableEXT(commandBuffer, VK_FALSE);
+			const uint32_t sampleMask = 0xFFFFFFFF;
+			vkCmdSetSampleMaskEXT(commandBuffer, rasterizationSamples, &sampleMask);
+			if (colorAttachmentCount > 0) {
+				std::vector<VkBool32> blendEnables(colorAttachmentCount, blendEnable);
+				std::vector<VkColorBlendEquationEXT> blendEquations(colorAttachmentCount, blendEquation);
+				std::vector<VkColorComponentFlags> writeMasks(colorAttachmentCount, colorWriteMask);
+				vkCmdSetColorBlendEnableEXT(commandBuffer, 0, colorAttachmentCount, blendEnables.data());
+				if (blendEnable) {
+					vkCmdSetColorBlendEquationEXT(commandBuffer, 0, colorAttachmentCount, blendEquations.data());
+				}
+				vkCmdSetColorWriteMaskEXT(commandBuffer, 0, colorAttachmentCount, writeMasks.data());
+			}
+			vkCmdSetVertexInputEXT(commandBuffer, static_cast<uint32_t>(vertexBindings.size()), vertexBindings.data(), static_cast<uint32_t>(vertexAttributes.size()), vertexAttributes.data());
+		}
+
+		void bindShaders(VkCommandBuffer commandBuffer, uint32_t count, const VkShaderStageFlagBits* stages, const VkShaderEXT* shaders)
+		{
+			vkCmdBindShadersEXT(commandBuffer, count, stages, shaders);
+		}
+	};
+}
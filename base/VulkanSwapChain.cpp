@@ -9,6 +9,9 @@
 */
 
 #include "VulkanSwapChain.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
 
 /** @brief Creates the platform specific surface abstraction of the native platform window used for presentation */	
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
@@ -194,12 +197,256 @@ void VulkanSwapChain::setContext(VkInstance instance, VkPhysicalDevice physicalD
 	this->device = device;
 }
 
+void VulkanSwapChain::initOffscreen(VkQueue queue, uint32_t queueFamilyIndex, const std::string& dumpPath, bool checksums)
+{
+	assert(device);
+	offscreen.enabled = true;
+	offscreen.queue = queue;
+	offscreen.dumpPath = dumpPath;
+	offscreen.checksums = checksums;
+	queueNodeIndex = queueFamilyIndex;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	// Use the format most commonly found with real swapchains, fall back to RGBA if not supported for rendering and copies
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+	colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProperties);
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	VkCommandPoolCreateInfo commandPoolCI{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = queueFamilyIndex
+	};
+	VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCI, nullptr, &offscreen.commandPool));
+	VkCommandBufferAllocateInfo commandBufferAI{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = offscreen.commandPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAI, &offscreen.commandBuffer));
+	VkFenceCreateInfo fenceCI{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &offscreen.fence));
+}
+
+// Find a memory type for the given type bits with all requested properties
+static uint32_t getOffscreenMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+			return i;
+		}
+	}
+	throw std::runtime_error("Could not find a matching memory type");
+}
+
+void VulkanSwapChain::createOffscreenImages(uint32_t width, uint32_t height)
+{
+	// Called on resize too, the application waits for the device to be idle before that
+	destroyOffscreenImages();
+	if (offscreen.readbackBuffer != VK_NULL_HANDLE) {
+		vkUnmapMemory(device, offscreen.readbackMemory);
+		vkDestroyBuffer(device, offscreen.readbackBuffer, nullptr);
+		vkFreeMemory(device, offscreen.readbackMemory, nullptr);
+		offscreen.readbackBuffer = VK_NULL_HANDLE;
+	}
+
+	offscreen.width = width;
+	offscreen.height = height;
+	offscreen.nextImage = 0;
+	// Same number of images as a triple buffered swapchain
+	imageCount = 3;
+	images.resize(imageCount);
+	imageViews.resize(imageCount);
+	offscreen.imageMemory.resize(imageCount);
+
+	VkCommandBufferBeginInfo commandBufferBI{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK_RESULT(vkBeginCommandBuffer(offscreen.commandBuffer, &commandBufferBI));
+
+	for (uint32_t i = 0; i < imageCount; i++) {
+		VkImageCreateInfo imageCI{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = colorFormat,
+			.extent = { width, height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			// Samples may copy to or blit into swapchain images, so transfer destination is supported too
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+		imageUsage = imageCI.usage;
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = memReqs.size,
+			.memoryTypeIndex = getOffscreenMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.imageMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreen.imageMemory[i], 0));
+
+		VkImageViewCreateInfo imageViewCI{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = images[i],
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = colorFormat,
+			.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A },
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &imageViews[i]));
+
+		// Swapchain images are expected to be in present layout after their first use, so we start with that layout
+		vks::tools::setImageLayout(offscreen.commandBuffer, images[i], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(offscreen.commandBuffer));
+	VkSubmitInfo submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &offscreen.commandBuffer
+	};
+	VK_CHECK_RESULT(vkQueueSubmit(offscreen.queue, 1, &submitInfo, offscreen.fence));
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &offscreen.fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &offscreen.fence));
+
+	// Host visible buffer the presented images are copied to
+	if (!offscreen.dumpPath.empty() || offscreen.checksums) {
+		VkBufferCreateInfo bufferCI{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = (VkDeviceSize)width * height * 4,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &offscreen.readbackBuffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, offscreen.readbackBuffer, &memReqs);
+		VkMemoryAllocateInfo memAlloc{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = memReqs.size,
+			.memoryTypeIndex = getOffscreenMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		};
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.readbackMemory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device, offscreen.readbackBuffer, offscreen.readbackMemory, 0));
+		VK_CHECK_RESULT(vkMapMemory(device, offscreen.readbackMemory, 0, VK_WHOLE_SIZE, 0, &offscreen.readbackMapped));
+	}
+}
+
+void VulkanSwapChain::destroyOffscreenImages()
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(offscreen.imageMemory.size()); i++) {
+		vkDestroyImageView(device, imageViews[i], nullptr);
+		vkDestroyImage(device, images[i], nullptr);
+		vkFreeMemory(device, offscreen.imageMemory[i], nullptr);
+	}
+	offscreen.imageMemory.clear();
+	images.clear();
+	imageViews.clear();
+}
+
+void VulkanSwapChain::captureOffscreenImage(uint32_t imageIndex, VkSemaphore waitSemaphore)
+{
+	VkCommandBufferBeginInfo commandBufferBI{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK_RESULT(vkBeginCommandBuffer(offscreen.commandBuffer, &commandBufferBI));
+	const VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vks::tools::setImageLayout(offscreen.commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	VkBufferImageCopy copyRegion{
+		.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.imageExtent = { offscreen.width, offscreen.height, 1 }
+	};
+	vkCmdCopyImageToBuffer(offscreen.commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, offscreen.readbackBuffer, 1, &copyRegion);
+	vks::tools::setImageLayout(offscreen.commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, subresourceRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	VkBufferMemoryBarrier bufferBarrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = offscreen.readbackBuffer,
+		.size = VK_WHOLE_SIZE
+	};
+	vkCmdPipelineBarrier(offscreen.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	VK_CHECK_RESULT(vkEndCommandBuffer(offscreen.commandBuffer));
+
+	const VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_TRANSFER_BIT };
+	VkSubmitInfo submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &waitSemaphore,
+		.pWaitDstStageMask = &waitStage,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &offscreen.commandBuffer
+	};
+	VK_CHECK_RESULT(vkQueueSubmit(offscreen.queue, 1, &submitInfo, offscreen.fence));
+	// Reading back stalls the frame, which is acceptable as this is only meant for validating output
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &offscreen.fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &offscreen.fence));
+
+	const uint8_t* data = static_cast<const uint8_t*>(offscreen.readbackMapped);
+	const size_t size = (size_t)offscreen.width * offscreen.height * 4;
+
+	if (offscreen.checksums) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		}
+		lastChecksum = hash;
+		std::cout << "Frame " << offscreen.frameIndex << " checksum: " << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << std::setfill(' ') << "\n";
+	}
+
+	if (!offscreen.dumpPath.empty()) {
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "frame_%05u.ppm", offscreen.frameIndex);
+		std::ofstream file(offscreen.dumpPath + "/" + fileName, std::ios::out | std::ios::binary);
+		if (file.is_open()) {
+			// PPM header
+			file << "P6\n" << offscreen.width << "\n" << offscreen.height << "\n" << 255 << "\n";
+			// PPM stores RGB, so BGR images need to be swizzled
+			const bool swizzle = (colorFormat == VK_FORMAT_B8G8R8A8_UNORM);
+			std::vector<uint8_t> row(offscreen.width * 3);
+			for (uint32_t y = 0; y < offscreen.height; y++) {
+				const uint8_t* src = data + (size_t)y * offscreen.width * 4;
+				for (uint32_t x = 0; x < offscreen.width; x++) {
+					row[x * 3 + 0] = src[x * 4 + (swizzle ? 2 : 0)];
+					row[x * 3 + 1] = src[x * 4 + 1];
+					row[x * 3 + 2] = src[x * 4 + (swizzle ? 0 : 2)];
+				}
+				file.write(reinterpret_cast<const char*>(row.data()), row.size());
+			}
+			file.close();
+		} else {
+			std::cerr << "Could not write frame dump to " << offscreen.dumpPath << "\n";
+		}
+	}
+}
+
 void VulkanSwapChain::create(uint32_t& width, uint32_t& height, bool vsync, bool fullscreen)
 {
 	assert(physicalDevice);
 	assert(device);
 	assert(instance);
 
+	if (offscreen.enabled) {
+		createOffscreenImages(width, height);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -310,6 +557,7 @@ void VulkanSwapChain::create(uint32_t& width, uint32_t& height, bool vsync, bool
 		swapchainCI.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	}
 	VK_CHECK_RESULT(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
+	imageUsage = swapchainCI.imageUsage;
 
 	// If an existing swap chain is re-created, destroy the old swap chain and the ressources owned by the application (image views, images are owned by the swap chain)
 	if (oldSwapchain != VK_NULL_HANDLE) { 
@@ -347,12 +595,70 @@ void VulkanSwapChain::create(uint32_t& width, uint32_t& height, bool vsync, bool
 
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t& imageIndex)
 {
+	if (offscreen.enabled) {
+		// Images are used in a fixed order, the semaphore is signaled right away to keep the same synchronization as with a real swapchain
+		imageIndex = offscreen.nextImage;
+		offscreen.nextImage = (offscreen.nextImage + 1) % imageCount;
+		VkSubmitInfo submitInfo{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &presentCompleteSemaphore
+		};
+		return vkQueueSubmit(offscreen.queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, &imageIndex);
 }
+
+VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
+{
+	if (offscreen.enabled) {
+		if (!offscreen.dumpPath.empty() || offscreen.checksums) {
+			captureOffscreenImage(imageIndex, waitSemaphore);
+			offscreen.frameIndex++;
+			return VK_SUCCESS;
+		}
+		// Nothing is presented, but the semaphore still needs to be waited on so it can be signaled again
+		const VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+		VkSubmitInfo submitInfo{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &waitSemaphore,
+			.pWaitDstStageMask = &waitStage
+		};
+		VkResult result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+		offscreen.frameIndex++;
+		return result;
+	}
+	VkPresentInfoKHR presentInfo{
+		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &waitSemaphore,
+		.swapchainCount = 1,
+		.pSwapchains = &swapChain,
+		.pImageIndices = &imageIndex
+	};
+	return vkQueuePresentKHR(queue, &presentInfo);
+}
+
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen.enabled) {
+		destroyOffscreenImages();
+		if (offscreen.readbackBuffer != VK_NULL_HANDLE) {
+			vkUnmapMemory(device, offscreen.readbackMemory);
+			vkDestroyBuffer(device, offscreen.readbackBuffer, nullptr);
+			vkFreeMemory(device, offscreen.readbackMemory, nullptr);
+			offscreen.readbackBuffer = VK_NULL_HANDLE;
+		}
+		if (offscreen.commandPool != VK_NULL_HANDLE) {
+			vkDestroyFence(device, offscreen.fence, nullptr);
+			vkDestroyCommandPool(device, offscreen.commandPool, nullptr);
+			offscreen.commandPool = VK_NULL_HANDLE;
+		}
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE) {
 		for (auto i = 0; i < images.size(); i++) {
 			vkDestroyImageView(device, imageViews[i], nullptr);
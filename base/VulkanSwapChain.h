@@ -34,9 +34,32 @@ private:
 	VkDevice device{ VK_NULL_HANDLE };
 	VkPhysicalDevice physicalDevice{ VK_NULL_HANDLE };
 	VkSurfaceKHR surface{ VK_NULL_HANDLE };
+	// Offscreen (headless) mode, images are created by the application and presenting only (optionally) reads them back
+	struct Offscreen {
+		bool enabled{ false };
+		VkQueue queue{ VK_NULL_HANDLE };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t nextImage{ 0 };
+		uint32_t frameIndex{ 0 };
+		std::vector<VkDeviceMemory> imageMemory{};
+		VkCommandPool commandPool{ VK_NULL_HANDLE };
+		VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+		VkFence fence{ VK_NULL_HANDLE };
+		VkBuffer readbackBuffer{ VK_NULL_HANDLE };
+		VkDeviceMemory readbackMemory{ VK_NULL_HANDLE };
+		void* readbackMapped{ nullptr };
+		std::string dumpPath{};
+		bool checksums{ false };
+	} offscreen;
+	void createOffscreenImages(uint32_t width, uint32_t height);
+	void destroyOffscreenImages();
+	void captureOffscreenImage(uint32_t imageIndex, VkSemaphore waitSemaphore);
 public:
 	VkFormat colorFormat{};
 	VkColorSpaceKHR colorSpace{};
+	// Usage flags the swapchain images were created with (transfer usage depends on the surface)
+	VkImageUsageFlags imageUsage{ 0 };
 	VkSwapchainKHR swapChain{ VK_NULL_HANDLE };
 	std::vector<VkImage> images{};
 	std::vector<VkImageView> imageViews{};
@@ -65,6 +88,17 @@ public:
 #elif defined(VK_USE_PLATFORM_SCREEN_QNX)
 	void initSurface(screen_context_t screen_context, screen_window_t screen_window);
 #endif
+	/**
+	* Use an internal ring of offscreen images instead of a surface and a swapchain, e.g. for running without a display server
+	*
+	* @param queue Queue used to signal acquire semaphores and to read back images
+	* @param queueFamilyIndex Family of the queue, will be used as the swapchain's queue node index
+	* @param dumpPath (Optional) If not empty, every presented image will be written to this directory as a PPM file
+	* @param checksums (Optional) Print a checksum of every presented image
+	*/
+	void initOffscreen(VkQueue queue, uint32_t queueFamilyIndex, const std::string& dumpPath = "", bool checksums = false);
+	/* Checksum (64 bit FNV-1a) of the last image read back in offscreen mode */
+	uint64_t lastChecksum{ 0 };
 	/* Set the Vulkan objects required for swapchain creation and management, must be called before swapchain creation */
 	void setContext(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	/**
@@ -86,6 +120,18 @@ public:
 	* @return VkResult of the image acquisition
 	*/
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t& imageIndex);
+	/**
+	* Queue an image for presentation
+	*
+	* @param queue Presentation queue for presenting the image
+	* @param imageIndex Index of the swapchain image to queue for presentation
+	* @param waitSemaphore Semaphore that is waited on before the image is presented
+	*
+	* @note In offscreen mode the semaphore is waited on by the queue, and the image is read back if frame dumps or checksums were requested
+	*
+	* @return VkResult of the queue presentation
+	*/
+	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore);
 	/* Free all Vulkan resources acquired by the swapchain */
 	void cleanup();
 };
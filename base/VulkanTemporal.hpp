@@ -0,0 +1,299 @@
+/*
+* Vulkan temporal accumulation class
+*
+* Sub-pixel camera jitter, ping-pong history images and a compute pass that reprojects and blends the history with the current frame
+* Effects can spread their samples over several frames, the history converges to the full sample count while the camera moves
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Temporal accumulation of a single screen space effect
+	* @note The effect renders into its own target, the resolve pass reprojects last frame's result using a velocity buffer, rejects history that left the screen or falls outside the current neighborhood and blends the rest
+	* @note Velocity is expected in uv units (current - previous) and has to be written from unjittered matrices, see viewProjection and previousViewProjection
+	* @note History images are kept in the general layout, they are written as storage images and read as sampled images
+	*/
+	class TemporalAccumulation
+	{
+	private:
+		vks::VulkanDevice* vulkanDevice{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		// One set per history image that is written, the other one is read as the history
+		std::array<VkDescriptorSet, 2> descriptorSets{};
+		uint32_t writeIndex{ 0 };
+		bool historyValid{ false };
+		struct PushConstants {
+			float historyWeight;
+			int32_t historyValid;
+		};
+	public:
+		struct History {
+			VkImage image{ VK_NULL_HANDLE };
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			VkImageView view{ VK_NULL_HANDLE };
+		};
+		std::array<History, 2> history{};
+		VkSampler sampler{ VK_NULL_HANDLE };
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+
+		/** @brief Offset the projection by a sub-pixel amount each frame, so accumulated samples also cover different positions within a pixel */
+		bool jitter{ true };
+		/** @brief Length of the Halton sequence the jitter offsets are taken from */
+		uint32_t jitterPhases{ 8 };
+		/** @brief Weight of the reprojected history, higher values converge to less noise but take longer to react */
+		float historyWeight{ 0.9f };
+
+		uint32_t frameIndex{ 0 };
+		/** @brief Jitter offset of the current frame in pixels */
+		glm::vec2 jitterOffset{ 0.0f };
+		/** @brief Projection with the jitter offset applied, use this for rasterization */
+		glm::mat4 jitteredProjection{ 1.0f };
+		/** @brief Unjittered view projection matrices of the current and the last frame, use these for velocity */
+		glm::mat4 viewProjection{ 1.0f };
+		glm::mat4 previousViewProjection{ 1.0f };
+
+		/** @brief Element of the Halton low discrepancy sequence for the given base, in the range [0, 1) */
+		static float halton(uint32_t index, uint32_t base)
+		{
+			float f = 1.0f;
+			float result = 0.0f;
+			while (index > 0) {
+				f /= static_cast<float>(base);
+				result += f * static_cast<float>(index % base);
+				index /= base;
+			}
+			return result;
+		}
+
+		/**
+		* Create the history images
+		*
+		* @param vulkanDevice Device to create the images on
+		* @param queue Queue used to clear the images and transition them to the general layout
+		* @param format Format of the history, needs to support storage image writes, a float format avoids exponential blending getting stuck on quantization steps
+		* @param width Width of the history (usually the resolution of the effect)
+		* @param height Height of the history
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue, VkFormat format, uint32_t width, uint32_t height)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->format = format;
+			this->width = width;
+			this->height = height;
+			VkDevice device = vulkanDevice->logicalDevice;
+
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			for (auto& image : history) {
+				VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+				imageCI.imageType = VK_IMAGE_TYPE_2D;
+				imageCI.format = format;
+				imageCI.extent = { width, height, 1 };
+				imageCI.mipLevels = 1;
+				imageCI.arrayLayers = 1;
+				imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+				VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image.image));
+				VkMemoryRequirements memReqs;
+				vkGetImageMemoryRequirements(device, image.image, &memReqs);
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = memReqs.size;
+				memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &image.memory));
+				VK_CHECK_RESULT(vkBindImageMemory(device, image.image, image.memory, 0));
+				VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+				viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCI.format = format;
+				viewCI.subresourceRange = subresourceRange;
+				viewCI.image = image.image;
+				VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &image.view));
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+				VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+				vkCmdClearColorImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+			}
+			// The first resolve reads the cleared image as history
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+			// Bilinear filtering for sampling the history at the reprojected position
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_LINEAR;
+			samplerCI.minFilter = VK_FILTER_LINEAR;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.maxAnisotropy = 1.0f;
+			samplerCI.maxLod = 1.0f;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& image : history) {
+				vkDestroyImageView(device, image.view, nullptr);
+				vkDestroyImage(device, image.image, nullptr);
+				vkFreeMemory(device, image.memory, nullptr);
+			}
+			vkDestroySampler(device, sampler, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vulkanDevice = nullptr;
+		}
+
+		/**
+		* Create the resolve pipeline and its descriptors
+		*
+		* @param shaderStage Compute shader stage of the resolve pass (samplerCurrent, samplerVelocity, samplerHistory and the storage image for the result)
+		* @param currentView Image view of the effect's result for the current frame, read in the shader read only layout
+		* @param velocityView Image view of the velocity buffer, read in the shader read only layout
+		* @param inputSampler Sampler for the current frame and the velocity buffer
+		* @param pipelineCache Optional pipeline cache
+		*/
+		void prepareResolvePipeline(VkPipelineShaderStageCreateInfo shaderStage, VkImageView currentView, VkImageView velocityView, VkSampler inputSampler, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			};
+			VkDescriptorSetLayoutCreateInfo setLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &descriptorSetLayout));
+
+			VkDescriptorImageInfo currentDescriptor = vks::initializers::descriptorImageInfo(inputSampler, currentView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo velocityDescriptor = vks::initializers::descriptorImageInfo(inputSampler, velocityView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			for (uint32_t i = 0; i < 2; i++) {
+				VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+				VkDescriptorImageInfo historyDescriptor = vks::initializers::descriptorImageInfo(sampler, history[1 - i].view, VK_IMAGE_LAYOUT_GENERAL);
+				VkDescriptorImageInfo outputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, history[i].view, VK_IMAGE_LAYOUT_GENERAL);
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &currentDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &velocityDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &historyDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &outputDescriptor),
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			}
+
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+		}
+
+		/**
+		* Advance to the next frame, call once per frame before updating the uniform buffers
+		*
+		* @param projection Unjittered projection matrix
+		* @param view View matrix
+		* @param renderWidth Width of the jittered render target in pixels
+		* @param renderHeight Height of the jittered render target in pixels
+		*/
+		void update(const glm::mat4& projection, const glm::mat4& view, uint32_t renderWidth, uint32_t renderHeight)
+		{
+			const glm::mat4 currentViewProjection = projection * view;
+			previousViewProjection = (frameIndex > 0) ? viewProjection : currentViewProjection;
+			viewProjection = currentViewProjection;
+			frameIndex++;
+			writeIndex = frameIndex % 2;
+			jitterOffset = glm::vec2(0.0f);
+			if (jitter) {
+				// Bases 2 and 3 give a well distributed 2D sequence, index 0 is skipped as it's always zero
+				const uint32_t phase = (frameIndex % jitterPhases) + 1;
+				jitterOffset = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+			}
+			// Translate in clip space, the third column is multiplied with view space z and then divided by w = -z, so this is a constant offset in ndc
+			jitteredProjection = projection;
+			jitteredProjection[2][0] += jitterOffset.x * 2.0f / static_cast<float>(renderWidth);
+			jitteredProjection[2][1] += jitterOffset.y * 2.0f / static_cast<float>(renderHeight);
+		}
+
+		/** @brief Discard the history, e.g. after toggling the effect or a camera cut */
+		void reset()
+		{
+			historyValid = false;
+		}
+
+		/** @brief Index of the history image that contains the resolved result of the current frame */
+		uint32_t outputIndex() const
+		{
+			return writeIndex;
+		}
+
+		/** @brief Descriptor for reading one of the history images in a fragment or compute shader */
+		VkDescriptorImageInfo descriptor(uint32_t index) const
+		{
+			return vks::initializers::descriptorImageInfo(sampler, history[index].view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+
+		/**
+		* Record the resolve pass, must be recorded outside of a render pass after the effect and the velocity buffer have been written
+		*
+		* @param commandBuffer Command buffer to record to
+		*/
+		void resolve(VkCommandBuffer commandBuffer)
+		{
+			// Makes the current frame's inputs visible and orders the write against last frame's reads of the same history image
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			PushConstants pushConstants{ historyWeight, historyValid ? 1 : 0 };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[writeIndex], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			historyValid = true;
+		}
+	};
+}
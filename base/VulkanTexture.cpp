@@ -10,6 +10,46 @@
 
 namespace vks
 {
+	// Size of a file on disk (or in the Android asset package) for the load statistics
+	static VkDeviceSize getFileSize(const std::string& filename)
+	{
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_UNKNOWN);
+		if (!asset) {
+			return 0;
+		}
+		VkDeviceSize size = AAsset_getLength(asset);
+		AAsset_close(asset);
+		return size;
+#else
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		return file.is_open() ? static_cast<VkDeviceSize>(file.tellg()) : 0;
+#endif
+	}
+
+	static std::vector<uint8_t> readFile(const std::string& filename)
+	{
+		std::vector<uint8_t> bytes;
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+		bytes.resize(AAsset_getLength(asset));
+		AAsset_read(asset, bytes.data(), bytes.size());
+		AAsset_close(asset);
+#else
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+		bytes.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+#endif
+		return bytes;
+	}
+
 	void Texture::updateDescriptor()
 	{
 		descriptor.sampler = sampler;
@@ -55,7 +95,7 @@ namespace vks
 	/**
 	* Load a 2D texture including all mip levels
 	*
-	* @param filename File to load (supports .ktx)
+	* @param filename File to load (supports .ktx and .ktx2)
 	* @param format Vulkan format of the image data stored in the file
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
@@ -65,6 +105,12 @@ namespace vks
 	*/
 	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+		if (filename.ends_with(".ktx2")) {
+			loadFromKTX2File(filename, format, device, copyQueue, imageUsageFlags, imageLayout);
+			return;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -235,6 +281,185 @@ namespace vks
 
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
+
+		loadStats.fileSize = getFileSize(filename);
+		loadStats.memorySize = memAllocInfo.allocationSize;
+		loadStats.format = format;
+		loadStats.transcoded = false;
+		loadStats.ktx2 = false;
+		loadStats.loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	/**
+	* Load a 2D texture including all mip levels from a KTX2 file
+	* Files with a Vulkan format are uploaded as is (after Zstd decompression if required)
+	* Basis Universal (ETC1S/UASTC) payloads are transcoded to the best compressed format supported by the device, see vks::ktx2::selectTranscodeFormat
+	* All levels are decoded in parallel into a single staging buffer and uploaded with one batched copy
+	*
+	* @param filename File to load
+	* @param format Requested format, for transcoded files only the color space (sRGB or linear) is taken from this
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*/
+	void Texture2D::loadFromKTX2File(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		ktx2::File ktx2File;
+		std::string error;
+		std::vector<uint8_t> fileData = readFile(filename);
+		loadStats.fileSize = fileData.size();
+		if (!ktx2File.parse(std::move(fileData), error)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + ": " + error, -1);
+		}
+
+		this->device = device;
+		width = ktx2File.width;
+		height = ktx2File.height;
+		mipLevels = ktx2File.levelCount;
+
+		// Transcoded files get the best format the device supports, others use the format stored in the file
+		loadStats.transcoded = ktx2File.isBasis();
+		if (loadStats.transcoded) {
+			const bool srgb = (format == VK_FORMAT_R8G8B8A8_SRGB) || (format == VK_FORMAT_B8G8R8A8_SRGB) || (format == VK_FORMAT_R8_SRGB);
+			format = ktx2::selectTranscodeFormat(device, srgb);
+		} else {
+			format = ktx2File.vkFormat;
+			// Formats stored in the file aren't selected based on device support, so they need to be checked before creating the image
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+			if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+				vks::tools::exitFatal("Could not load texture from " + filename + ": format " + std::to_string(format) + " can't be sampled or copied to on this device", -1);
+			}
+		}
+		loadStats.format = format;
+		loadStats.ktx2 = true;
+
+		// Levels are placed back to back in the staging buffer, copy offsets need to be a multiple of both the texel block size and 4
+		const VkDeviceSize offsetAlignment = std::lcm(VkDeviceSize(ktx2::formatBlock(format).bytes), VkDeviceSize(4));
+		std::vector<VkDeviceSize> levelOffsets(mipLevels);
+		VkDeviceSize stagingSize = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			levelOffsets[i] = stagingSize;
+			// Parsing made sure the level sizes stored in the file match the format
+			// Not necessarily a power of two (e.g. 12 for 3 byte formats)
+			stagingSize = (stagingSize + ktx2::levelSize(format, std::max(1u, width >> i), std::max(1u, height >> i)) + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+		}
+
+		// Create a host-visible staging buffer the levels are decoded into
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+		VkBufferCreateInfo bufferCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = stagingSize,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = memReqs.size,
+			.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		};
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+		// Decompress or transcode all levels on worker threads straight into the mapped staging buffer
+		uint8_t* data{ nullptr };
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
+		if (!ktx2::decodeLevels(ktx2File, format, data, levelOffsets, stagingSize, error)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + ": " + error, -1);
+		}
+		vkUnmapMemory(device->logicalDevice, stagingMemory);
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			VkBufferImageCopy bufferCopyRegion{
+				.bufferOffset = levelOffsets[i],
+				.imageSubresource = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = i,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.imageExtent = {
+					.width = std::max(1u, width >> i),
+					.height = std::max(1u, height >> i),
+					.depth = 1
+				}
+			};
+			bufferCopyRegions.push_back(bufferCopyRegion);
+		}
+
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = {.width = width, .height = height, .depth = 1 },
+			.mipLevels = mipLevels,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		loadStats.memorySize = memReqs.size;
+
+		// All levels are uploaded with a single copy command
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = mipLevels, .layerCount = 1, };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		this->imageLayout = imageLayout;
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+		device->flushCommandBuffer(copyCmd, copyQueue);
+
+		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+
+		VkSamplerCreateInfo samplerCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.mipLodBias = 0.0f,
+			.anisotropyEnable = device->enabledFeatures.samplerAnisotropy,
+			.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f,
+			.compareOp = VK_COMPARE_OP_NEVER,
+			.minLod = 0.0f,
+			.maxLod = (float)mipLevels,
+			.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE
+		};
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		VkImageViewCreateInfo viewCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = format,
+			.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = mipLevels, .baseArrayLayer = 0, .layerCount = 1 },
+		};
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+
+		updateDescriptor();
+
+		loadStats.loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
 
 	/**
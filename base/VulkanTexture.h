@@ -8,7 +8,9 @@
 
 #pragma once
 
+#include <chrono>
 #include <fstream>
+#include <numeric>
 #include <stdlib.h>
 #include <string>
 #include <vector>
@@ -21,6 +23,7 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTools.h"
+#include "VulkanKTX2.hpp"
 
 #if defined(__ANDROID__)
 #	include <android/asset_manager.h>
@@ -41,6 +44,17 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	// Filled by the file loaders to compare containers and compression schemes
+	struct LoadStats {
+		VkDeviceSize fileSize{ 0 };
+		VkDeviceSize memorySize{ 0 };
+		// Time in milliseconds from reading the file until the upload has finished
+		double       loadTime{ 0.0 };
+		VkFormat     format{ VK_FORMAT_UNDEFINED };
+		bool         transcoded{ false };
+		// True if the texture was loaded from a KTX2 container, false for KTX1
+		bool         ktx2{ false };
+	} loadStats;
 
 	void      updateDescriptor();
 	void      destroy();
@@ -57,6 +71,13 @@ class Texture2D : public Texture
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void loadFromKTX2File(
+	    std::string        filename,
+	    VkFormat           format,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
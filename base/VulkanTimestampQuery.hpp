@@ -0,0 +1,120 @@
+/*
+* Vulkan timestamp query class
+*
+* Measures GPU execution times for a fixed number of scopes with one set of queries per frame in flight
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Encapsulates a timestamp query pool for measuring GPU times of command buffer sections
+	* @note Results of a frame are fetched once the fence of that frame has been signaled, so reading never stalls
+	*/
+	class TimestampQuery
+	{
+	private:
+		VkDevice device{ VK_NULL_HANDLE };
+		VkQueryPool queryPool{ VK_NULL_HANDLE };
+		float timestampPeriod{ 0.0f };
+		uint32_t scopeCount{ 0 };
+		std::vector<bool> written;
+		std::vector<uint64_t> timestamps;
+	public:
+		/** @brief True if the queue family used for recording supports timestamps */
+		bool supported{ false };
+		/** @brief Last fetched durations per scope in milliseconds */
+		std::vector<float> durations;
+
+		/**
+		* Create the query pool
+		*
+		* @param vulkanDevice Device to create the query pool on
+		* @param queueFamilyIndex Queue family of the command buffers the timestamps are written to
+		* @param scopeCount Number of begin/end scopes per frame
+		* @param frameCount Number of frames in flight
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t scopeCount, uint32_t frameCount)
+		{
+			device = vulkanDevice->logicalDevice;
+			this->scopeCount = scopeCount;
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			supported = (timestampPeriod > 0.0f) && (vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0);
+			durations.resize(scopeCount, 0.0f);
+			if (!supported) {
+				return;
+			}
+			written.resize(frameCount, false);
+			timestamps.resize(scopeCount * 2);
+			VkQueryPoolCreateInfo queryPoolInfo{
+				.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				.queryType = VK_QUERY_TYPE_TIMESTAMP,
+				.queryCount = scopeCount * 2 * frameCount
+			};
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+		}
+
+		void destroy()
+		{
+			if (queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, queryPool, nullptr);
+				queryPool = VK_NULL_HANDLE;
+			}
+		}
+
+		/** @brief Reset all queries of the given frame, must be called outside of a render pass before writing any timestamps */
+		void reset(VkCommandBuffer commandBuffer, uint32_t frame)
+		{
+			if (!supported) {
+				return;
+			}
+			vkCmdResetQueryPool(commandBuffer, queryPool, frame * scopeCount * 2, scopeCount * 2);
+			written[frame] = true;
+		}
+
+		void begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+		{
+			if (supported) {
+				vkCmdWriteTimestamp(commandBuffer, stage, queryPool, (frame * scopeCount + scope) * 2);
+			}
+		}
+
+		void end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t scope, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+		{
+			if (supported) {
+				vkCmdWriteTimestamp(commandBuffer, stage, queryPool, (frame * scopeCount + scope) * 2 + 1);
+			}
+		}
+
+		/**
+		* Read back the timestamps of the given frame and update the durations
+		*
+		* @note Call after waiting on the frame's fence and before resetting the queries for the next use of that frame
+		* @return True if new results were available
+		*/
+		bool fetch(uint32_t frame)
+		{
+			if (!supported || !written[frame]) {
+				return false;
+			}
+			VkResult result = vkGetQueryPoolResults(device, queryPool, frame * scopeCount * 2, scopeCount * 2, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+			if (result != VK_SUCCESS) {
+				return false;
+			}
+			for (uint32_t i = 0; i < scopeCount; i++) {
+				durations[i] = (float)((double)(timestamps[i * 2 + 1] - timestamps[i * 2]) * timestampPeriod / 1000000.0);
+			}
+			return true;
+		}
+	};
+}
@@ -156,6 +156,19 @@ namespace vks
 			return std::find(stencilFormats.begin(), stencilFormats.end(), format) != std::end(stencilFormats);
 		}
 
+		VkBool32 formatHasDepth(VkFormat format)
+		{
+			std::vector<VkFormat> depthFormats = {
+				VK_FORMAT_D16_UNORM,
+				VK_FORMAT_X8_D24_UNORM_PACK32,
+				VK_FORMAT_D32_SFLOAT,
+				VK_FORMAT_D16_UNORM_S8_UINT,
+				VK_FORMAT_D24_UNORM_S8_UINT,
+				VK_FORMAT_D32_SFLOAT_S8_UINT,
+			};
+			return std::find(depthFormats.begin(), depthFormats.end(), format) != std::end(depthFormats);
+		}
+
 		// Returns if a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling)
 		{
@@ -89,6 +89,8 @@ namespace vks
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling);
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
+		// Returns true if a given format has a depth part
+		VkBool32 formatHasDepth(VkFormat format);
 
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
 		void setImageLayout(
@@ -0,0 +1,362 @@
+/*
+* Vulkan glTF GPU scene class
+*
+* Uploads a glTF model's primitive instances and materials into storage buffers, culls them in a compute pass and draws the result with indirect draws
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+namespace vkglTF
+{
+	/**
+	* @brief GPU side description of a glTF scene for GPU driven rendering
+	* @note Every primitive of every node becomes one instance with its own world matrix, world space bounding sphere and material index
+	* @note A compute pass culls the instances against the view frustum and writes the visible ones to an indirect command buffer, the number of draws recorded on the CPU is constant
+	* @note Shaders read the instance via gl_InstanceIndex (= firstInstance of the indirect command) and access textures through a bindless array
+	*/
+	class GpuScene
+	{
+	private:
+		vks::VulkanDevice* device{ nullptr };
+		vkglTF::Model* model{ nullptr };
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout cullDescriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet cullDescriptorSet{ VK_NULL_HANDLE };
+		VkPipelineLayout cullPipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline cullPipeline{ VK_NULL_HANDLE };
+		// Host visible copies of the draw count, one per frame in flight
+		std::vector<vks::Buffer> drawCountReadback;
+		vks::Frustum frustum;
+
+		struct CullPushConstants {
+			glm::vec4 frustumPlanes[6];
+			uint32_t instanceCount;
+			uint32_t compact;
+			uint32_t frustumCulling;
+		};
+
+		// Transforms a point the same way the model loader transforms vertices
+		glm::vec3 transformPoint(const glm::mat4& matrix, glm::vec3 point, uint32_t fileLoadingFlags)
+		{
+			const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+			const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+			if (preTransform) {
+				point = glm::vec3(matrix * glm::vec4(point, 1.0f));
+			}
+			if (flipY) {
+				point.y *= -1.0f;
+			}
+			if (!preTransform) {
+				point = glm::vec3(matrix * glm::vec4(point, 1.0f));
+			}
+			return point;
+		}
+
+		// Device local storage buffer initialized with data from a staging buffer
+		void createStorageBuffer(vks::Buffer& buffer, VkBufferUsageFlags usage, void* data, VkDeviceSize size, VkQueue queue)
+		{
+			vks::Buffer stagingBuffer;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, data));
+			VK_CHECK_RESULT(device->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+			device->copyBuffer(&stagingBuffer, &buffer, queue);
+			stagingBuffer.destroy();
+		}
+
+	public:
+		// Must match the layouts used in the shaders (std430)
+		struct InstanceData {
+			glm::mat4 model;
+			// World space bounding sphere (xyz = center, w = radius)
+			glm::vec4 boundingSphere;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t materialIndex;
+			uint32_t _pad;
+		};
+
+		struct MaterialData {
+			glm::vec4 baseColorFactor;
+			int32_t baseColorTexture;
+			int32_t normalTexture;
+			float alphaCutoff;
+			uint32_t alphaMode;
+		};
+
+		std::vector<InstanceData> instances;
+		std::vector<MaterialData> materials;
+
+		vks::Buffer instanceBuffer;
+		vks::Buffer materialBuffer;
+		// Compacted indirect draw commands and draw count written by the culling pass
+		vks::Buffer indirectCommandBuffer;
+		vks::Buffer drawCountBuffer;
+
+		// Descriptor set for the graphics shaders: instances (binding 0), materials (binding 1) and all textures of the model (binding 2)
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+		// If vkCmdDrawIndexedIndirectCount is not available, the culling pass writes all commands and sets the instance count of culled ones to zero
+		bool drawIndirectCount{ false };
+		bool multiDrawIndirect{ false };
+		bool frustumCulling{ true };
+		// Number of instances that passed culling in the last frame fetched with fetchDrawCount
+		uint32_t drawCount{ 0 };
+
+		/**
+		* Create the GPU scene description from a loaded glTF model
+		*
+		* @param device Pointer to the Vulkan device
+		* @param model glTF model that has been loaded with fileLoadingFlags
+		* @param queue Queue used for uploading the scene data
+		* @param fileLoadingFlags Flags the model has been loaded with, required to match the vertex transformations done by the loader
+		* @param frameCount Number of frames in flight
+		* @param drawIndirectCount Set to true if the drawIndirectCount feature has been enabled
+		* @param multiDrawIndirect Set to true if the multiDrawIndirect feature has been enabled
+		*/
+		void create(vks::VulkanDevice* device, vkglTF::Model* model, VkQueue queue, uint32_t fileLoadingFlags, uint32_t frameCount, bool drawIndirectCount, bool multiDrawIndirect)
+		{
+			this->device = device;
+			this->model = model;
+			this->drawIndirectCount = drawIndirectCount;
+			this->multiDrawIndirect = multiDrawIndirect;
+
+			// Flatten the node hierarchy into one instance per primitive
+			const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+			for (vkglTF::Node* node : model->linearNodes) {
+				if (!node->mesh) {
+					continue;
+				}
+				const glm::mat4 nodeMatrix = node->getMatrix();
+				for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+					if (primitive->indexCount == 0) {
+						continue;
+					}
+					InstanceData instance{};
+					// Pre-transformed vertices are already in world space
+					instance.model = preTransform ? glm::mat4(1.0f) : nodeMatrix;
+					instance.firstIndex = primitive->firstIndex;
+					instance.indexCount = primitive->indexCount;
+					instance.materialIndex = static_cast<uint32_t>(&primitive->material - model->materials.data());
+					// Fit a sphere around the world space corners of the primitive's bounding box
+					glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+					for (uint32_t i = 0; i < 8; i++) {
+						const glm::vec3 corner((i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x, (i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y, (i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+						const glm::vec3 point = transformPoint(nodeMatrix, corner, fileLoadingFlags);
+						min = glm::min(min, point);
+						max = glm::max(max, point);
+					}
+					instance.boundingSphere = glm::vec4((min + max) * 0.5f, glm::distance(min, max) * 0.5f);
+					instances.push_back(instance);
+				}
+			}
+
+			for (vkglTF::Material& material : model->materials) {
+				MaterialData materialData{};
+				materialData.baseColorFactor = material.baseColorFactor;
+				materialData.baseColorTexture = material.baseColorTexture ? static_cast<int32_t>(material.baseColorTexture - model->textures.data()) : -1;
+				materialData.normalTexture = material.normalTexture ? static_cast<int32_t>(material.normalTexture - model->textures.data()) : -1;
+				materialData.alphaCutoff = material.alphaCutoff;
+				materialData.alphaMode = static_cast<uint32_t>(material.alphaMode);
+				materials.push_back(materialData);
+			}
+			if (materials.empty()) {
+				materials.push_back({ glm::vec4(1.0f), -1, -1, 1.0f, 0 });
+			}
+
+			// Buffers
+			createStorageBuffer(instanceBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instances.data(), instances.size() * sizeof(InstanceData), queue);
+			createStorageBuffer(materialBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materials.data(), materials.size() * sizeof(MaterialData), queue);
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectCommandBuffer, instances.size() * sizeof(VkDrawIndexedIndirectCommand)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawCountBuffer, sizeof(uint32_t)));
+			drawCountReadback.resize(frameCount);
+			for (auto& buffer : drawCountReadback) {
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(uint32_t)));
+				VK_CHECK_RESULT(buffer.map());
+				memset(buffer.mapped, 0, sizeof(uint32_t));
+			}
+
+			// Descriptors
+			const uint32_t textureCount = std::max(static_cast<uint32_t>(model->textures.size()), 1u);
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			// Culling: instances (binding 0), indirect commands (binding 1), draw count (binding 2)
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &cullDescriptorSetLayout));
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &cullDescriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &cullDescriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirectCommandBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &drawCountBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// Rendering: the texture array is sized at allocation time and may contain unused entries
+			setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2, textureCount),
+			};
+			const std::array<VkDescriptorBindingFlags, 3> bindingFlags = { 0, 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT };
+			VkDescriptorSetLayoutBindingFlagsCreateInfo setLayoutBindingFlags{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO, .bindingCount = static_cast<uint32_t>(bindingFlags.size()), .pBindingFlags = bindingFlags.data() };
+			descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			descriptorLayoutCI.pNext = &setLayoutBindingFlags;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+			VkDescriptorSetVariableDescriptorCountAllocateInfo variableDescriptorCountAllocInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO, .descriptorSetCount = 1, .pDescriptorCounts = &textureCount };
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			allocInfo.pNext = &variableDescriptorCountAllocInfo;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+			std::vector<VkDescriptorImageInfo> textureDescriptors;
+			for (auto& texture : model->textures) {
+				textureDescriptors.push_back(texture.descriptor);
+			}
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &materialBuffer.descriptor),
+			};
+			if (!textureDescriptors.empty()) {
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, textureDescriptors.data(), static_cast<uint32_t>(textureDescriptors.size())));
+			}
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		/**
+		* Create the compute pipeline for the culling pass
+		*
+		* @param shaderStage Compute shader stage for the culling shader
+		* @param pipelineCache Pipeline cache to use (optional)
+		*/
+		void prepareCullPipeline(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE)
+		{
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullPushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&cullDescriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(cullPipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &cullPipeline));
+		}
+
+		/**
+		* Record the culling pass, must be recorded outside of a render pass
+		*
+		* @param commandBuffer Command buffer to record to
+		* @param frame Index of the frame in flight, selects the buffer the draw count is copied to
+		* @param viewProjection Combined projection and view matrix to cull against
+		*/
+		void cull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProjection)
+		{
+			// Previous indirect reads of the command and count buffers need to finish before they're overwritten
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdFillBuffer(commandBuffer, drawCountBuffer.buffer, 0, sizeof(uint32_t), 0);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			frustum.update(viewProjection);
+			CullPushConstants pushConstants{};
+			for (uint32_t i = 0; i < 6; i++) {
+				pushConstants.frustumPlanes[i] = frustum.planes[i];
+			}
+			pushConstants.instanceCount = static_cast<uint32_t>(instances.size());
+			pushConstants.compact = drawIndirectCount ? 1 : 0;
+			pushConstants.frustumCulling = frustumCulling ? 1 : 0;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.instanceCount + 63) / 64, 1, 1);
+
+			// Make the commands and the count visible to the indirect draw and the readback copy
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion{ 0, 0, sizeof(uint32_t) };
+			vkCmdCopyBuffer(commandBuffer, drawCountBuffer.buffer, drawCountReadback[frame].buffer, 1, &copyRegion);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/**
+		* Draw all instances that passed culling
+		* The pipeline and the descriptor sets (incl. descriptorSet of this class) need to be bound before
+		*
+		* @param commandBuffer Command buffer to record to
+		*/
+		void draw(VkCommandBuffer commandBuffer)
+		{
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &model->vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			const uint32_t maxDrawCount = static_cast<uint32_t>(instances.size());
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (drawIndirectCount) {
+				vkCmdDrawIndexedIndirectCount(commandBuffer, indirectCommandBuffer.buffer, 0, drawCountBuffer.buffer, 0, maxDrawCount, stride);
+			} else if (multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandBuffer.buffer, 0, maxDrawCount, stride);
+			} else {
+				// Without multi draw indirect, each command has to be issued separately
+				for (uint32_t i = 0; i < maxDrawCount; i++) {
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandBuffer.buffer, i * stride, 1, stride);
+				}
+			}
+		}
+
+		/**
+		* Get the number of instances that passed culling for a frame, only call once the fence of that frame has been signaled
+		*
+		* @param frame Index of the frame in flight
+		*/
+		uint32_t fetchDrawCount(uint32_t frame)
+		{
+			drawCount = *static_cast<uint32_t*>(drawCountReadback[frame].mapped);
+			return drawCount;
+		}
+
+		void destroy()
+		{
+			if (!device) {
+				return;
+			}
+			instanceBuffer.destroy();
+			materialBuffer.destroy();
+			indirectCommandBuffer.destroy();
+			drawCountBuffer.destroy();
+			for (auto& buffer : drawCountReadback) {
+				buffer.destroy();
+			}
+			vkDestroyPipeline(device->logicalDevice, cullPipeline, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, cullPipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, cullDescriptorSetLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			device = nullptr;
+		}
+	};
+}
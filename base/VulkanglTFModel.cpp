@@ -23,6 +23,8 @@ VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+vks::DescriptorHeap* vkglTF::descriptorHeap = nullptr;
+vks::MipGenerator* vkglTF::mipGenerator = nullptr;
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -68,7 +70,7 @@ void vkglTF::Texture::destroy()
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue, uint32_t mipFilter)
 {
 	this->device = device;
 
@@ -116,10 +118,12 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		height = gltfimage.height;
 		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		if (!vkglTF::mipGenerator) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		}
 
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
@@ -158,6 +162,10 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		};
+		if (vkglTF::mipGenerator) {
+			imageCreateInfo.usage |= vkglTF::mipGenerator->imageUsage(format);
+			imageCreateInfo.flags = vkglTF::mipGenerator->imageCreateFlags(format);
+		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -193,7 +201,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			}
 		};
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-		{
+		if (!vkglTF::mipGenerator) {
 			VkImageMemoryBarrier imageMemoryBarrier{
 				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
 				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
@@ -210,78 +218,83 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-			imageBlit.srcSubresource = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = i - 1,
-				.layerCount = 1,
-			};
-			imageBlit.srcOffsets[1] = {
-				.x = int32_t(width >> (i - 1)),
-				.y = int32_t(height >> (i - 1)),
-				.z = 1
-			};
-			imageBlit.dstSubresource = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = i,
-				.layerCount = 1,
-			};
-			imageBlit.dstOffsets[1] = {
-				.x = int32_t(width >> i),
-				.y = int32_t(height >> i),
-				.z = 1
-			};
-
-			VkImageSubresourceRange mipSubRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = i, .levelCount = 1, .layerCount = 1 };
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{
-					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-					.srcAccessMask = 0,
-					.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-					.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					.image = image,
-					.subresourceRange = mipSubRange
+		if (vkglTF::mipGenerator) {
+			// All levels are generated in a single compute dispatch, formats without storage support fall back to blits
+			vkglTF::mipGenerator->generate(copyQueue, image, format, width, height, mipLevels, mipFilter, vkglTF::mipGenerator->preferredMethod);
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		} else {
+			// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+			VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (uint32_t i = 1; i < mipLevels; i++) {
+				VkImageBlit imageBlit{};
+				imageBlit.srcSubresource = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = i - 1,
+					.layerCount = 1,
+				};
+				imageBlit.srcOffsets[1] = {
+					.x = int32_t(width >> (i - 1)),
+					.y = int32_t(height >> (i - 1)),
+					.z = 1
+				};
+				imageBlit.dstSubresource = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = i,
+					.layerCount = 1,
 				};
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageBlit.dstOffsets[1] = {
+					.x = int32_t(width >> i),
+					.y = int32_t(height >> i),
+					.z = 1
+				};
+
+				VkImageSubresourceRange mipSubRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = i, .levelCount = 1, .layerCount = 1 };
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{
+						.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+						.srcAccessMask = 0,
+						.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+						.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+						.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						.image = image,
+						.subresourceRange = mipSubRange
+					};
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
+				vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{
+						.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+						.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+						.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+						.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						.image = image,
+						.subresourceRange = mipSubRange
+					};
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 			}
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+			subresourceRange.levelCount = mipLevels;
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{
 					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-					.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-					.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+					.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+					.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 					.image = image,
-					.subresourceRange = mipSubRange
+					.subresourceRange = subresourceRange
 				};
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
+			device->flushCommandBuffer(blitCmd, copyQueue, true);
 		}
-
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-				.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				.image = image,
-				.subresourceRange = subresourceRange
-			};
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		if (deleteBuffer) {
+			delete[] buffer;
 		}
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -497,8 +510,9 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 	this->device = device;
 	this->uniformBlock.matrix = matrix;
+	// Also usable as a storage buffer, so it can be accessed through a descriptor heap
 	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		sizeof(uniformBlock),
 		&uniformBuffer.buffer,
@@ -743,6 +757,18 @@ vkglTF::Model::~Model()
 	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	// Heap indices are recycled once the current frames in flight have completed
+	if (heap) {
+		for (auto& texture : textures) {
+			heap->free(vks::DescriptorHeap::Textures, texture.heapIndex);
+		}
+		heap->free(vks::DescriptorHeap::Textures, emptyTexture.heapIndex);
+		for (auto& node : linearNodes) {
+			if (node->mesh) {
+				heap->free(vks::DescriptorHeap::StorageBuffers, node->mesh->uniformBuffer.heapIndex);
+			}
+		}
+	}
 	for (auto& texture : textures) {
 		texture.destroy();
 	}
@@ -1001,9 +1027,25 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
+	// The material slot an image is used in decides how its mip chain is filtered
+	std::vector<uint32_t> mipFilters(gltfModel.images.size(), 0);
+	auto addMipFilter = [&](tinygltf::ParameterMap& values, const std::string& name, uint32_t filter) {
+		if (values.find(name) != values.end()) {
+			int32_t source = gltfModel.textures[values[name].TextureIndex()].source;
+			if (source >= 0) {
+				mipFilters[source] |= filter;
+			}
+		}
+	};
+	for (tinygltf::Material &mat : gltfModel.materials) {
+		addMipFilter(mat.values, "baseColorTexture", vks::MipGenerator::FilterSRGB | vks::MipGenerator::FilterAlphaWeighted);
+		addMipFilter(mat.additionalValues, "emissiveTexture", vks::MipGenerator::FilterSRGB);
+		addMipFilter(mat.additionalValues, "normalTexture", vks::MipGenerator::FilterNormalMap);
+	}
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		tinygltf::Image &image = gltfModel.images[i];
 		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
+		texture.fromglTfImage(image, path, device, transferQueue, mipFilters[i]);
 		texture.index = static_cast<uint32_t>(textures.size());
 		textures.push_back(texture);
 	}
@@ -1339,8 +1381,28 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
 
+	if (fileLoadingFlags & FileLoadingFlags::KeepHostData) {
+		vertexData = std::move(vertexBuffer);
+		indexData = std::move(indexBuffer);
+	}
+
 	getSceneDimensions();
 
+	// With a descriptor heap, textures and mesh uniform buffers only need to be added to it, materials and meshes are then referenced by heap indices
+	if (descriptorHeap) {
+		heap = descriptorHeap;
+		for (auto& texture : textures) {
+			texture.heapIndex = heap->addTexture(texture.descriptor);
+		}
+		emptyTexture.heapIndex = heap->addTexture(emptyTexture.descriptor);
+		for (auto& node : linearNodes) {
+			if (node->mesh) {
+				node->mesh->uniformBuffer.heapIndex = heap->addStorageBuffer(node->mesh->uniformBuffer.descriptor);
+			}
+		}
+		return;
+	}
+
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
 	uint32_t imageCount{ 0 };
@@ -1420,26 +1482,55 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 	buffersBound = true;
 }
 
+bool vkglTF::Model::skipPrimitive(const Primitive* primitive, uint32_t renderFlags) const
+{
+	bool skip = false;
+	const vkglTF::Material& material = primitive->material;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+	}
+	return skip;
+}
+
+vkglTF::HeapIndices vkglTF::Model::getHeapIndices(const Material& material, uint32_t meshHeapIndex) const
+{
+	HeapIndices heapIndices{
+		.meshBuffer = meshHeapIndex,
+		.baseColorTexture = material.baseColorTexture ? material.baseColorTexture->heapIndex : emptyTexture.heapIndex,
+		.normalTexture = material.normalTexture ? material.normalTexture->heapIndex : emptyTexture.heapIndex
+	};
+	return heapIndices;
+}
+
+void vkglTF::Model::pushHeapIndices(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const HeapIndices& heapIndices, DrawStats& stats) const
+{
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(HeapIndices), &heapIndices);
+	stats.pushConstantUpdates++;
+}
+
+// Note: If the model uses a descriptor heap, the heap's descriptor set must have been bound before (draw does this if images are to be bound)
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
-			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+			if (!skipPrimitive(primitive, renderFlags)) {
+				if (heap && (renderFlags & RenderFlags::BindImages)) {
+					pushHeapIndices(commandBuffer, pipelineLayout, getHeapIndices(primitive->material, node->mesh->uniformBuffer.heapIndex), drawStats);
+					traversalStats.pushConstantUpdates++;
+				} else if (renderFlags & RenderFlags::BindImages) {
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &primitive->material.descriptorSet, 0, nullptr);
+					drawStats.descriptorSetBinds++;
+					traversalStats.descriptorSetBinds++;
 				}
 				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				drawStats.draws++;
+				traversalStats.draws++;
 			}
 		}
 	}
@@ -1448,6 +1539,73 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 	}
 }
 
+void vkglTF::Model::addNodeToDrawList(Node* node, uint32_t renderFlags, DrawList& drawList)
+{
+	if (node->mesh) {
+		for (Primitive* primitive : node->mesh->primitives) {
+			if (skipPrimitive(primitive, renderFlags) || primitive->indexCount == 0) {
+				continue;
+			}
+			const Material& material = primitive->material;
+			uint64_t sortKey = (uint64_t)material.alphaMode << 56;
+			if (material.alphaMode == Material::ALPHAMODE_BLEND) {
+				// Blended primitives keep their scene graph order, as reordering them would change the result
+				sortKey |= drawList.primitiveCount;
+			} else {
+				const uint64_t materialIndex = (&material >= materials.data() && &material < materials.data() + materials.size()) ? (uint64_t)(&material - materials.data()) : 0xFFFFFF;
+				sortKey |= (materialIndex & 0xFFFFFF) << 32;
+				sortKey |= primitive->firstIndex;
+			}
+			drawList.commands.push_back({ sortKey, primitive->firstIndex, primitive->indexCount, &material, node->mesh->uniformBuffer.heapIndex });
+			drawList.primitiveCount++;
+		}
+	}
+	for (auto& child : node->children) {
+		addNodeToDrawList(child, renderFlags, drawList);
+	}
+}
+
+vkglTF::DrawList& vkglTF::Model::getDrawList(uint32_t renderFlags)
+{
+	const uint32_t filterFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+	auto it = drawLists.find(filterFlags);
+	if (it != drawLists.end()) {
+		return it->second;
+	}
+	DrawList& drawList = drawLists[filterFlags];
+	for (auto& node : nodes) {
+		addNodeToDrawList(node, filterFlags, drawList);
+	}
+	// Sort by state, so primitives sharing a material end up next to each other
+	std::stable_sort(drawList.commands.begin(), drawList.commands.end(), [](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+	// Merge consecutive primitives with the same material and adjacent index ranges into a single draw
+	std::vector<DrawCommand> merged;
+	merged.reserve(drawList.commands.size());
+	for (const DrawCommand& command : drawList.commands) {
+		if (!merged.empty()) {
+			DrawCommand& last = merged.back();
+			if ((last.material == command.material) && (last.meshHeapIndex == command.meshHeapIndex) && (last.firstIndex + last.indexCount == command.firstIndex)) {
+				last.indexCount += command.indexCount;
+				continue;
+			}
+		}
+		merged.push_back(command);
+	}
+	drawList.commands = std::move(merged);
+	return drawList;
+}
+
+void vkglTF::Model::invalidateDrawLists()
+{
+	drawLists.clear();
+}
+
+void vkglTF::Model::resetDrawStats()
+{
+	drawStats = {};
+	traversalStats = {};
+}
+
 void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (!buffersBound) {
@@ -1455,9 +1613,84 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
-	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+	// With a descriptor heap, a single descriptor set bind covers all materials and meshes of the model
+	if (heap && (renderFlags & RenderFlags::BindImages)) {
+		heap->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet);
+		drawStats.descriptorSetBinds++;
+		traversalStats.descriptorSetBinds++;
+	}
+	if (!useDrawList) {
+		for (auto& node : nodes) {
+			drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		}
+		return;
 	}
+	const DrawList& drawList = getDrawList(renderFlags);
+	recordDrawCommands(commandBuffer, drawList, 0, static_cast<uint32_t>(drawList.commands.size()), renderFlags, pipelineLayout, bindImageSet, drawStats);
+	if (heap && (renderFlags & RenderFlags::BindImages)) {
+		traversalStats.pushConstantUpdates += drawList.primitiveCount;
+	} else if (renderFlags & RenderFlags::BindImages) {
+		traversalStats.descriptorSetBinds += drawList.primitiveCount;
+	}
+	traversalStats.draws += drawList.primitiveCount;
+}
+
+void vkglTF::Model::recordDrawCommands(VkCommandBuffer commandBuffer, const DrawList& drawList, uint32_t firstCommand, uint32_t commandCount, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, DrawStats& stats) const
+{
+	const Material* boundMaterial = nullptr;
+	HeapIndices pushedIndices{ vks::DescriptorHeap::invalidIndex, vks::DescriptorHeap::invalidIndex, vks::DescriptorHeap::invalidIndex };
+	for (uint32_t i = firstCommand; i < firstCommand + commandCount; i++) {
+		const DrawCommand& command = drawList.commands[i];
+		// Only push the heap indices if they differ from the previous ones
+		if (heap && (renderFlags & RenderFlags::BindImages)) {
+			const HeapIndices heapIndices = getHeapIndices(*command.material, command.meshHeapIndex);
+			if (memcmp(&heapIndices, &pushedIndices, sizeof(HeapIndices)) != 0) {
+				pushHeapIndices(commandBuffer, pipelineLayout, heapIndices, stats);
+				pushedIndices = heapIndices;
+			}
+			vkCmdDrawIndexed(commandBuffer, command.indexCount, 1, command.firstIndex, 0, 0);
+			stats.draws++;
+			continue;
+		}
+		// Only bind the material's descriptor set if it differs from the previous one
+		if ((renderFlags & RenderFlags::BindImages) && ((boundMaterial == nullptr) || (boundMaterial->descriptorSet != command.material->descriptorSet))) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &command.material->descriptorSet, 0, nullptr);
+			stats.descriptorSetBinds++;
+		}
+		boundMaterial = command.material;
+		vkCmdDrawIndexed(commandBuffer, command.indexCount, 1, command.firstIndex, 0, 0);
+		stats.draws++;
+	}
+}
+
+uint32_t vkglTF::Model::getDrawCommandCount(uint32_t renderFlags)
+{
+	return static_cast<uint32_t>(getDrawList(renderFlags).commands.size());
+}
+
+bool vkglTF::Model::drawRange(VkCommandBuffer commandBuffer, uint32_t firstCommand, uint32_t commandCount, DrawStats& stats, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet) const
+{
+	// Only reads the draw list, getDrawCommandCount must have built it before
+	// Building it here would modify the draw list map while other threads read it
+	const uint32_t filterFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+	const auto it = drawLists.find(filterFlags);
+	if (it == drawLists.end()) {
+		return false;
+	}
+	const DrawList& drawList = it->second;
+	if ((uint64_t)firstCommand + commandCount > drawList.commands.size()) {
+		return false;
+	}
+	// Each (secondary) command buffer starts without any bound state
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	if (heap && (renderFlags & RenderFlags::BindImages)) {
+		heap->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet);
+		stats.descriptorSetBinds++;
+	}
+	recordDrawCommands(commandBuffer, drawList, firstCommand, commandCount, renderFlags, pipelineLayout, bindImageSet, stats);
+	return true;
 }
 
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
@@ -19,9 +19,12 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <map>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanDescriptorHeap.hpp"
+#include "VulkanMipGenerator.hpp"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -53,6 +56,10 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	// If set before loading, textures and mesh uniform buffers are added to this heap instead of per-material and per-mesh descriptor sets
+	extern vks::DescriptorHeap* descriptorHeap;
+	// If set before loading, mip chains of images that don't come with mips are generated with this instead of one blit per level
+	extern vks::MipGenerator* mipGenerator;
 
 	struct Node;
 
@@ -71,9 +78,11 @@ namespace vkglTF
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
 		uint32_t index;
+		// Index in the descriptor heap's textures array
+		uint32_t heapIndex{ vks::DescriptorHeap::invalidIndex };
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, uint32_t mipFilter = 0);
 	};
 
 	/*
@@ -138,6 +147,8 @@ namespace vkglTF
 			VkDeviceMemory memory;
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			// Index in the descriptor heap's storage buffers array
+			uint32_t heapIndex{ vks::DescriptorHeap::invalidIndex };
 			void* mapped;
 		} uniformBuffer;
 
@@ -241,7 +252,8 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		KeepHostData = 0x00000010
 	};
 
 	enum RenderFlags {
@@ -251,6 +263,41 @@ namespace vkglTF
 		RenderAlphaBlendedNodes = 0x00000008
 	};
 
+	/*
+		Single entry of a flattened draw list
+		The sort key packs the alpha mode (bits 56..63), the material (bits 32..55) and the index offset or traversal order (bits 0..31)
+	*/
+	struct DrawCommand {
+		uint64_t sortKey;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		const Material* material;
+		uint32_t meshHeapIndex;
+	};
+
+	/*
+		Descriptor heap indices of a primitive, pushed as push constants (offset 0) before each draw if the model uses a descriptor heap
+		Pipeline layouts need a push constant range of this size for the vertex and fragment stage
+	*/
+	struct HeapIndices {
+		uint32_t meshBuffer;
+		uint32_t baseColorTexture;
+		uint32_t normalTexture;
+	};
+
+	struct DrawList {
+		std::vector<DrawCommand> commands;
+		// Number of primitives before merging, equals the number of draws issued by walking the node tree
+		uint32_t primitiveCount{ 0 };
+	};
+
+	// Number of descriptor set binds and draw calls recorded
+	struct DrawStats {
+		uint32_t descriptorSetBinds{ 0 };
+		uint32_t draws{ 0 };
+		uint32_t pushConstantUpdates{ 0 };
+	};
+
 	/*
 		glTF model loading and rendering class
 	*/
@@ -259,9 +306,19 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		// Draw lists are built on first use for each combination of render filter flags
+		std::map<uint32_t, DrawList> drawLists;
+		bool skipPrimitive(const Primitive* primitive, uint32_t renderFlags) const;
+		void addNodeToDrawList(Node* node, uint32_t renderFlags, DrawList& drawList);
+		DrawList& getDrawList(uint32_t renderFlags);
+		// Heap the model's resources were added to, null if it uses descriptor sets
+		vks::DescriptorHeap* heap{ nullptr };
+		HeapIndices getHeapIndices(const Material& material, uint32_t meshHeapIndex) const;
+		void pushHeapIndices(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const HeapIndices& heapIndices, DrawStats& stats) const;
+		void recordDrawCommands(VkCommandBuffer commandBuffer, const DrawList& drawList, uint32_t firstCommand, uint32_t commandCount, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, DrawStats& stats) const;
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
 
 		struct Vertices {
 			int count;
@@ -273,6 +330,9 @@ namespace vkglTF
 			VkBuffer buffer;
 			VkDeviceMemory memory;
 		} indices;
+		// Host side copies of the (pre-processed) vertex and index data, only kept if loaded with FileLoadingFlags::KeepHostData
+		std::vector<Vertex> vertexData;
+		std::vector<uint32_t> indexData;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
@@ -295,6 +355,12 @@ namespace vkglTF
 		bool buffersBound = false;
 		std::string path;
 
+		// If enabled, draw uses a flattened and state sorted list of primitives instead of walking the node tree
+		bool useDrawList = true;
+		// Commands recorded by draw since the last call to resetDrawStats, and the commands walking the node tree would have recorded
+		DrawStats drawStats;
+		DrawStats traversalStats;
+
 		Model() {};
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
@@ -305,7 +371,16 @@ namespace vkglTF
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		// Builds the draw list for the render flags on first use and updates drawStats, so it must not be called concurrently (use drawRange for recording from multiple threads)
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		// Number of commands in the draw list for the given render flags, builds the list if required and has to be called before recording ranges of it from multiple threads
+		uint32_t getDrawCommandCount(uint32_t renderFlags = 0);
+		// Records a range of the draw list including buffer and heap binds, so ranges can be recorded into separate (secondary) command buffers in parallel
+		// Stats are written to the passed structure instead of drawStats
+		// Never builds the draw list, returns false without recording anything if getDrawCommandCount hasn't built it or the range exceeds it
+		bool drawRange(VkCommandBuffer commandBuffer, uint32_t firstCommand, uint32_t commandCount, DrawStats& stats, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1) const;
+		void invalidateDrawLists();
+		void resetDrawStats();
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
@@ -32,6 +32,35 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		// Sample specific values (e.g. GPU timings or counters) reported along with the frame rate
+		struct Metric {
+			std::string name;
+			std::function<double()> value;
+		};
+		std::vector<Metric> metrics;
+
+		void addMetric(const std::string& name, std::function<double()> value) {
+			metrics.push_back({ name, value });
+		}
+
+		// Optional callbacks for deterministic runs (e.g. scripted camera paths)
+		// Called after the warm up phase, e.g. to reset the scene to its initial state
+		std::function<void()> onStart;
+		// If set, the benchmark phase ends once this returns true instead of after the given duration
+		std::function<bool()> finished;
+
+		// Optional per-segment frame statistics, e.g. for the segments of a camera path
+		struct Segment {
+			std::string name;
+			uint32_t frameCount{ 0 };
+			double time{ 0.0 };
+			double tMin{ std::numeric_limits<double>::max() };
+			double tMax{ 0.0 };
+		};
+		std::vector<Segment> segments;
+		// Returns the segment index of the frame about to be rendered
+		std::function<uint32_t()> currentSegment;
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -58,13 +87,24 @@ namespace vks
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				if (onStart) {
+					onStart();
+				}
+				while (finished ? !finished() : (runtime < (duration * 1000.0))) {
+					const uint32_t segmentIndex = currentSegment ? currentSegment() : 0;
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
 					frameCount++;
+					if (segmentIndex < segments.size()) {
+						Segment& segment = segments[segmentIndex];
+						segment.frameCount++;
+						segment.time += tDiff;
+						segment.tMin = std::min(segment.tMin, tDiff);
+						segment.tMax = std::max(segment.tMax, tDiff);
+					}
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
 				std::cout << std::fixed << std::setprecision(3);
@@ -73,6 +113,14 @@ namespace vks
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				for (auto& metric : metrics) {
+					std::cout << metric.name << ": " << metric.value() << "\n";
+				}
+				for (auto& segment : segments) {
+					if (segment.frameCount > 0) {
+						std::cout << "segment \"" << segment.name << "\": " << segment.frameCount << " frames, avg " << segment.time / segment.frameCount << " ms, min " << segment.tMin << " ms, max " << segment.tMax << " ms\n";
+					}
+				}
 			}
 		}
 
@@ -81,8 +129,25 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				result << "device,driverversion,duration (ms),frames,fps";
+				for (auto& metric : metrics) {
+					result << "," << metric.name;
+				}
+				result << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0);
+				for (auto& metric : metrics) {
+					result << "," << metric.value();
+				}
+				result << "\n";
+
+				if (!segments.empty()) {
+					result << "\n" << "segment,frames,avg (ms),min (ms),max (ms)" << "\n";
+					for (auto& segment : segments) {
+						if (segment.frameCount > 0) {
+							result << segment.name << "," << segment.frameCount << "," << segment.time / segment.frameCount << "," << segment.tMin << "," << segment.tMax << "\n";
+						}
+					}
+				}
 
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
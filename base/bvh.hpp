@@ -0,0 +1,383 @@
+/*
+* Bounding volume hierarchy builder for triangle meshes
+*
+* Builds a binary BVH on the CPU using a binned surface area heuristic (SAH)
+* Large subtrees are built in parallel, the result is flattened into a compact node layout that can be uploaded to a shader storage buffer as is
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cassert>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace bvh
+	{
+		struct Triangle {
+			glm::vec3 v0;
+			glm::vec3 v1;
+			glm::vec3 v2;
+		};
+
+		/*
+			Flattened node, matches the std430 layout of { vec3 aabbMin; uint offset; vec3 aabbMax; uint count; }
+			Inner nodes (count = 0) store their left child directly after them, offset is the index of the right child
+			Leaf nodes store the index of their first triangle in offset and the number of triangles in count
+		*/
+		struct Node {
+			glm::vec3 aabbMin;
+			uint32_t offset;
+			glm::vec3 aabbMax;
+			uint32_t count;
+		};
+
+		struct Hit {
+			float t{ FLT_MAX };
+			uint32_t triangle{ UINT32_MAX };
+			float u{ 0.0f };
+			float v{ 0.0f };
+		};
+
+		struct BuildStats {
+			double buildTime{ 0.0 };		// Milliseconds
+			uint32_t nodeCount{ 0 };
+			uint32_t leafCount{ 0 };
+			uint32_t maxDepth{ 0 };
+			float sahCost{ 0.0f };			// Expected traversal cost of the tree relative to the root bounds
+		};
+
+		// Möller-Trumbore ray/triangle intersection
+		inline bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const Triangle& triangle, float& t, float& u, float& v)
+		{
+			const glm::vec3 e1 = triangle.v1 - triangle.v0;
+			const glm::vec3 e2 = triangle.v2 - triangle.v0;
+			const glm::vec3 p = glm::cross(direction, e2);
+			const float det = glm::dot(e1, p);
+			if (std::fabs(det) < 1e-8f) {
+				return false;
+			}
+			const float invDet = 1.0f / det;
+			const glm::vec3 s = origin - triangle.v0;
+			u = glm::dot(s, p) * invDet;
+			if ((u < 0.0f) || (u > 1.0f)) {
+				return false;
+			}
+			const glm::vec3 q = glm::cross(s, e1);
+			v = glm::dot(direction, q) * invDet;
+			if ((v < 0.0f) || (u + v > 1.0f)) {
+				return false;
+			}
+			t = glm::dot(e2, q) * invDet;
+			return t > 0.0f;
+		}
+
+		// Slab test, returns the entry distance or FLT_MAX if the box is missed or farther away than tMax
+		inline float intersectAABB(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& aabbMin, const glm::vec3& aabbMax, float tMax)
+		{
+			const glm::vec3 t0 = (aabbMin - origin) * invDirection;
+			const glm::vec3 t1 = (aabbMax - origin) * invDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+			return (tEnter <= tExit) ? tEnter : FLT_MAX;
+		}
+
+		class BVH
+		{
+		private:
+			static constexpr uint32_t binCount = 16;
+			static constexpr uint32_t maxLeafSize = 4;
+			// Subtrees with less triangles than this are always built on the calling thread
+			static constexpr uint32_t parallelThreshold = 8192;
+			// Relative cost of a triangle intersection vs. a node traversal step
+			static constexpr float intersectionCost = 1.0f;
+			static constexpr float traversalCost = 1.0f;
+
+			struct AABB {
+				glm::vec3 min{ FLT_MAX };
+				glm::vec3 max{ -FLT_MAX };
+				void grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+				void grow(const AABB& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+				float area() const
+				{
+					if (min.x > max.x) {
+						return 0.0f;
+					}
+					const glm::vec3 e = max - min;
+					return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+				}
+			};
+
+			struct BuildNode {
+				AABB bounds;
+				uint32_t first{ 0 };
+				uint32_t count{ 0 };
+				std::unique_ptr<BuildNode> children[2];
+			};
+
+			std::vector<AABB> primitiveBounds;
+			std::vector<glm::vec3> centroids;
+
+			std::unique_ptr<BuildNode> buildRecursive(uint32_t first, uint32_t count, uint32_t depth, uint32_t parallelDepth)
+			{
+				auto node = std::make_unique<BuildNode>();
+				node->first = first;
+				node->count = count;
+				AABB centroidBounds;
+				for (uint32_t i = first; i < first + count; i++) {
+					node->bounds.grow(primitiveBounds[triangleIndices[i]]);
+					centroidBounds.grow(centroids[triangleIndices[i]]);
+				}
+				// Nodes at the last level the traversal stack can hold become leaves, however many triangles they contain
+				if ((count <= 1) || (depth + 1 >= maxStackSize)) {
+					return node;
+				}
+
+				// Find the best split using binned SAH along all three axes
+				const float leafCost = intersectionCost * count;
+				float bestCost = FLT_MAX;
+				int32_t bestAxis = -1;
+				uint32_t bestSplit = 0;
+				for (int32_t axis = 0; axis < 3; axis++) {
+					const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+					if (extent <= 0.0f) {
+						continue;
+					}
+					std::array<AABB, binCount> bins{};
+					std::array<uint32_t, binCount> binCounts{};
+					const float scale = binCount / extent;
+					for (uint32_t i = first; i < first + count; i++) {
+						const uint32_t index = triangleIndices[i];
+						const uint32_t bin = std::min(binCount - 1, (uint32_t)((centroids[index][axis] - centroidBounds.min[axis]) * scale));
+						bins[bin].grow(primitiveBounds[index]);
+						binCounts[bin]++;
+					}
+					// Sweep from both sides to get the areas and counts for every split plane
+					std::array<float, binCount - 1> leftArea{}, rightArea{};
+					std::array<uint32_t, binCount - 1> leftCount{}, rightCount{};
+					AABB leftBox, rightBox;
+					uint32_t leftSum = 0, rightSum = 0;
+					for (uint32_t i = 0; i < binCount - 1; i++) {
+						leftSum += binCounts[i];
+						leftBox.grow(bins[i]);
+						leftCount[i] = leftSum;
+						leftArea[i] = leftBox.area();
+						rightSum += binCounts[binCount - 1 - i];
+						rightBox.grow(bins[binCount - 1 - i]);
+						rightCount[binCount - 2 - i] = rightSum;
+						rightArea[binCount - 2 - i] = rightBox.area();
+					}
+					for (uint32_t i = 0; i < binCount - 1; i++) {
+						if ((leftCount[i] == 0) || (rightCount[i] == 0)) {
+							continue;
+						}
+						const float cost = traversalCost + intersectionCost * (leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i]) / node->bounds.area();
+						if (cost < bestCost) {
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplit = i;
+						}
+					}
+				}
+
+				// Stop if splitting is not cheaper than intersecting all triangles, unless the leaf would get too large
+				if ((bestAxis == -1) || ((bestCost >= leafCost) && (count <= maxLeafSize))) {
+					if ((bestAxis == -1) && (count > maxLeafSize)) {
+						// All centroids are coincident, fall back to a median split so leaves stay small
+						const uint32_t half = count / 2;
+						spawnChildren(*node, first, half, count - half, depth, parallelDepth);
+					}
+					return node;
+				}
+
+				// Partition the triangle indices in place
+				const float extent = centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis];
+				const float scale = binCount / extent;
+				auto middle = std::partition(triangleIndices.begin() + first, triangleIndices.begin() + first + count, [&](uint32_t index) {
+					const uint32_t bin = std::min(binCount - 1, (uint32_t)((centroids[index][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+					return bin <= bestSplit;
+				});
+				const uint32_t leftCount = static_cast<uint32_t>(middle - (triangleIndices.begin() + first));
+				spawnChildren(*node, first, leftCount, count - leftCount, depth, parallelDepth);
+				return node;
+			}
+
+			void spawnChildren(BuildNode& node, uint32_t first, uint32_t leftCount, uint32_t rightCount, uint32_t depth, uint32_t parallelDepth)
+			{
+				// The two subtrees work on disjoint ranges of the index array, so the left one can be built on another thread
+				if ((depth < parallelDepth) && (leftCount + rightCount >= parallelThreshold)) {
+					auto left = std::async(std::launch::async, &BVH::buildRecursive, this, first, leftCount, depth + 1, parallelDepth);
+					node.children[1] = buildRecursive(first + leftCount, rightCount, depth + 1, parallelDepth);
+					node.children[0] = left.get();
+				} else {
+					node.children[0] = buildRecursive(first, leftCount, depth + 1, parallelDepth);
+					node.children[1] = buildRecursive(first + leftCount, rightCount, depth + 1, parallelDepth);
+				}
+				node.count = 0;
+			}
+
+			// Depth first flattening, the left child always directly follows its parent
+			void flatten(const BuildNode& buildNode, uint32_t depth, float rootArea)
+			{
+				const uint32_t index = static_cast<uint32_t>(nodes.size());
+				nodes.push_back({ buildNode.bounds.min, buildNode.first, buildNode.bounds.max, buildNode.count });
+				stats.maxDepth = std::max(stats.maxDepth, depth);
+				const float relativeArea = buildNode.bounds.area() / rootArea;
+				if (buildNode.count > 0) {
+					stats.leafCount++;
+					stats.sahCost += relativeArea * intersectionCost * buildNode.count;
+					return;
+				}
+				stats.sahCost += relativeArea * traversalCost;
+				flatten(*buildNode.children[0], depth + 1, rootArea);
+				nodes[index].offset = static_cast<uint32_t>(nodes.size());
+				flatten(*buildNode.children[1], depth + 1, rootArea);
+			}
+
+		public:
+			/** @brief Number of traversal stack entries, the builder limits the tree depth so traversal never needs more */
+			static constexpr uint32_t maxStackSize = 64;
+
+			std::vector<Node> nodes;
+			// Leaves reference triangles through this array, use it to reorder triangle data to match the leaf layout
+			std::vector<uint32_t> triangleIndices;
+			BuildStats stats;
+
+			/**
+			* Build the hierarchy for the given triangles
+			*
+			* @param triangles Triangles to build the hierarchy for
+			* @param threadCount Maximum number of threads used for building subtrees (0 = number of hardware threads)
+			*/
+			void build(const std::vector<Triangle>& triangles, uint32_t threadCount = 0)
+			{
+				auto tStart = std::chrono::high_resolution_clock::now();
+
+				nodes.clear();
+				stats = {};
+				const uint32_t triangleCount = static_cast<uint32_t>(triangles.size());
+				if (triangleCount == 0) {
+					return;
+				}
+				primitiveBounds.resize(triangleCount);
+				centroids.resize(triangleCount);
+				triangleIndices.resize(triangleCount);
+				for (uint32_t i = 0; i < triangleCount; i++) {
+					AABB bounds;
+					bounds.grow(triangles[i].v0);
+					bounds.grow(triangles[i].v1);
+					bounds.grow(triangles[i].v2);
+					primitiveBounds[i] = bounds;
+					centroids[i] = (bounds.min + bounds.max) * 0.5f;
+					triangleIndices[i] = i;
+				}
+
+				if (threadCount == 0) {
+					threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+				}
+				// Each parallel level doubles the number of concurrently built subtrees
+				const uint32_t parallelDepth = static_cast<uint32_t>(std::ceil(std::log2((float)threadCount)));
+
+				std::unique_ptr<BuildNode> root = buildRecursive(0, triangleCount, 0, parallelDepth);
+				nodes.reserve(triangleCount * 2);
+				flatten(*root, 0, std::max(root->bounds.area(), FLT_MIN));
+				nodes.shrink_to_fit();
+				stats.nodeCount = static_cast<uint32_t>(nodes.size());
+
+				primitiveBounds.clear();
+				primitiveBounds.shrink_to_fit();
+				centroids.clear();
+				centroids.shrink_to_fit();
+
+				stats.buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+
+			/**
+			* Find the closest intersection by traversing the hierarchy
+			*
+			* @param triangles Triangles the hierarchy was built for (in their original order)
+			* @return True if a triangle was hit, hit.triangle is the index into the passed triangles
+			*/
+			bool intersect(const std::vector<Triangle>& triangles, const glm::vec3& origin, const glm::vec3& direction, Hit& hit) const
+			{
+				if (nodes.empty()) {
+					return false;
+				}
+				const glm::vec3 invDirection = 1.0f / direction;
+				std::array<uint32_t, maxStackSize> stack;
+				uint32_t stackSize = 0;
+				uint32_t nodeIndex = 0;
+				if (intersectAABB(origin, invDirection, nodes[0].aabbMin, nodes[0].aabbMax, hit.t) == FLT_MAX) {
+					return false;
+				}
+				bool found = false;
+				while (true) {
+					const Node& node = nodes[nodeIndex];
+					if (node.count > 0) {
+						for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+							float t, u, v;
+							if (intersectTriangle(origin, direction, triangles[triangleIndices[i]], t, u, v) && (t < hit.t)) {
+								hit = { t, triangleIndices[i], u, v };
+								found = true;
+							}
+						}
+					} else {
+						// Visit the closer child first and keep the other one for later
+						uint32_t nearChild = nodeIndex + 1;
+						uint32_t farChild = node.offset;
+						float tNear = intersectAABB(origin, invDirection, nodes[nearChild].aabbMin, nodes[nearChild].aabbMax, hit.t);
+						float tFar = intersectAABB(origin, invDirection, nodes[farChild].aabbMin, nodes[farChild].aabbMax, hit.t);
+						if (tFar < tNear) {
+							std::swap(nearChild, farChild);
+							std::swap(tNear, tFar);
+						}
+						if (tNear != FLT_MAX) {
+							if (tFar != FLT_MAX) {
+								assert(stackSize < maxStackSize);
+								if (stackSize < maxStackSize) {
+									stack[stackSize++] = farChild;
+								}
+							}
+							nodeIndex = nearChild;
+							continue;
+						}
+					}
+					if (stackSize == 0) {
+						break;
+					}
+					nodeIndex = stack[--stackSize];
+				}
+				return found;
+			}
+
+			// Reference implementation that tests against all triangles, used for validating the hierarchy
+			static bool intersectBruteForce(const std::vector<Triangle>& triangles, const glm::vec3& origin, const glm::vec3& direction, Hit& hit)
+			{
+				bool found = false;
+				for (uint32_t i = 0; i < static_cast<uint32_t>(triangles.size()); i++) {
+					float t, u, v;
+					if (intersectTriangle(origin, direction, triangles[i], t, u, v) && (t < hit.t)) {
+						hit = { t, i, u, v };
+						found = true;
+					}
+				}
+				return found;
+			}
+		};
+	}
+}
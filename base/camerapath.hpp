@@ -0,0 +1,149 @@
+/*
+* Scripted camera path
+*
+* Keyframed camera positions and rotations loaded from a text file, used to make benchmark runs repeatable
+*
+* File format (one entry per line, lines starting with # are ignored):
+*   segment <name>             Starts a new named segment at the next keyframe
+*   <time> <px py pz> <rx ry rz>   Keyframe with time in seconds, camera position and rotation (degrees)
+*
+* Rotations are interpolated along the shorter arc, so a path can turn from 350 to 10 degrees without spinning around
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <assert.h>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class CameraPath
+	{
+	public:
+		struct Keyframe {
+			float time;
+			glm::vec3 position;
+			glm::vec3 rotation;
+		};
+		struct Segment {
+			std::string name;
+			float start;
+		};
+		std::vector<Keyframe> keyframes;
+		std::vector<Segment> segments;
+		/** @brief Reason the last call to loadFromFile failed */
+		std::string error;
+
+		/**
+		* Load keyframes and segments from a text file
+		*
+		* @param filename Name of the camera path file
+		*
+		* @return False if the file could not be opened, contains a malformed line or no keyframes, error is set to the reason
+		*/
+		bool loadFromFile(const std::string& filename)
+		{
+			error.clear();
+			std::ifstream file(filename);
+			if (!file.is_open()) {
+				error = "file could not be opened";
+				return false;
+			}
+			keyframes.clear();
+			segments.clear();
+			std::string pendingSegment;
+			std::string line;
+			uint32_t lineNumber = 0;
+			while (std::getline(file, line)) {
+				lineNumber++;
+				if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos) {
+					continue;
+				}
+				std::istringstream stream(line);
+				if (line.compare(0, 7, "segment") == 0) {
+					std::string keyword;
+					if (!(stream >> keyword >> pendingSegment)) {
+						error = "missing segment name in line " + std::to_string(lineNumber) + ": " + line;
+						return false;
+					}
+					continue;
+				}
+				// Skipping a malformed keyframe would silently change the path, so it's reported instead
+				Keyframe keyframe{};
+				std::string trailing;
+				if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z) || (stream >> trailing)) {
+					error = "malformed keyframe in line " + std::to_string(lineNumber) + ": " + line;
+					return false;
+				}
+				// Paths without segment markers are reported as a single segment
+				if (!pendingSegment.empty() || segments.empty()) {
+					segments.push_back({ pendingSegment.empty() ? "path" : pendingSegment, keyframe.time });
+					pendingSegment.clear();
+				}
+				keyframes.push_back(keyframe);
+			}
+			std::sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+			if (keyframes.empty()) {
+				error = "no keyframes";
+				return false;
+			}
+			return true;
+		}
+
+		bool empty() const
+		{
+			return keyframes.empty();
+		}
+
+		/** @brief Time of the last keyframe in seconds */
+		float duration() const
+		{
+			return keyframes.empty() ? 0.0f : keyframes.back().time;
+		}
+
+		/** @brief Get the linearly interpolated camera position and rotation at the given time, rotations take the shorter arc and may leave the [0, 360) range */
+		void evaluate(float time, glm::vec3& position, glm::vec3& rotation) const
+		{
+			assert(!keyframes.empty());
+			size_t next = 0;
+			while (next < keyframes.size() && keyframes[next].time < time) {
+				next++;
+			}
+			if (next == 0 || next == keyframes.size()) {
+				const Keyframe& keyframe = keyframes[std::min(next, keyframes.size() - 1)];
+				position = keyframe.position;
+				rotation = keyframe.rotation;
+				return;
+			}
+			const Keyframe& a = keyframes[next - 1];
+			const Keyframe& b = keyframes[next];
+			const float t = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 1.0f;
+			position = glm::mix(a.position, b.position, t);
+			// Wrap the difference of each angle to [-180, 180]
+			glm::vec3 delta = b.rotation - a.rotation;
+			delta -= 360.0f * glm::floor((delta + 180.0f) / 360.0f);
+			rotation = a.rotation + delta * t;
+		}
+
+		/** @brief Index of the segment the given time falls into */
+		uint32_t segmentIndex(float time) const
+		{
+			uint32_t index = 0;
+			for (uint32_t i = 1; i < static_cast<uint32_t>(segments.size()); i++) {
+				if (time >= segments[i].start) {
+					index = i;
+				}
+			}
+			return index;
+		}
+	};
+}
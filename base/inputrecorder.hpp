@@ -0,0 +1,167 @@
+/*
+* Input recorder
+*
+* Records the per-frame input state (mouse, camera movement keys, key presses) to a text file and replays it,
+* so interactive sessions can be reproduced exactly, e.g. for benchmarks with a fixed time step
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+namespace vks
+{
+	class InputRecorder
+	{
+	public:
+		/** @brief Input state after all window events of a frame have been processed */
+		struct Frame {
+			int32_t mouseX{ 0 };
+			int32_t mouseY{ 0 };
+			bool mouseLeft{ false };
+			bool mouseRight{ false };
+			bool mouseMiddle{ false };
+			bool keyLeft{ false };
+			bool keyRight{ false };
+			bool keyUp{ false };
+			bool keyDown{ false };
+			bool paused{ false };
+			// Camera translation of all mouse wheel events since the last frame
+			float wheel{ 0.0f };
+			std::vector<uint32_t> keyPresses{};
+		};
+	private:
+		enum class Mode { none, record, replay };
+		Mode mode{ Mode::none };
+		std::ofstream output;
+		std::vector<Frame> frames;
+		size_t replayIndex{ 0 };
+		uint32_t recordedFrames{ 0 };
+		std::vector<uint32_t> pendingKeyPresses;
+		float pendingWheel{ 0.0f };
+	public:
+		/** @brief Reason the last call to replay failed */
+		std::string error;
+
+		bool recording() const
+		{
+			return mode == Mode::record;
+		}
+
+		bool replaying() const
+		{
+			return mode == Mode::replay;
+		}
+
+		/** @brief True once all recorded frames have been replayed */
+		bool finished() const
+		{
+			return replayIndex >= frames.size();
+		}
+
+		/** @brief Start recording to the given file, returns false if the file can't be written */
+		bool record(const std::string& filename)
+		{
+			output.open(filename, std::ios::out);
+			if (!output.is_open()) {
+				return false;
+			}
+			output << "# frame mousex mousey mousebuttons(l r m) keys(left right up down) paused wheel keypresses...\n";
+			// Wheel translations are written with enough digits to be read back exactly
+			output << std::setprecision(std::numeric_limits<float>::max_digits10);
+			mode = Mode::record;
+			return true;
+		}
+
+		/** @brief Load all frames from the given file for replay, returns false if the file can't be read or contains a malformed line, error is set to the reason */
+		bool replay(const std::string& filename)
+		{
+			error.clear();
+			std::ifstream file(filename);
+			if (!file.is_open()) {
+				error = "file could not be opened";
+				return false;
+			}
+			frames.clear();
+			std::string line;
+			uint32_t lineNumber = 0;
+			while (std::getline(file, line)) {
+				lineNumber++;
+				if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos) {
+					continue;
+				}
+				// Skipping a malformed frame would shift all following input, so it's reported instead
+				std::istringstream stream(line);
+				uint32_t index;
+				Frame frame{};
+				if (!(stream >> index >> frame.mouseX >> frame.mouseY >> frame.mouseLeft >> frame.mouseRight >> frame.mouseMiddle >> frame.keyLeft >> frame.keyRight >> frame.keyUp >> frame.keyDown >> frame.paused >> frame.wheel)) {
+					error = "malformed frame in line " + std::to_string(lineNumber) + ": " + line;
+					return false;
+				}
+				uint32_t key;
+				while (stream >> key) {
+					frame.keyPresses.push_back(key);
+				}
+				if (!stream.eof()) {
+					error = "malformed key press in line " + std::to_string(lineNumber) + ": " + line;
+					return false;
+				}
+				frames.push_back(frame);
+			}
+			mode = Mode::replay;
+			replayIndex = 0;
+			return true;
+		}
+
+		/** @brief Restart the replay from the first frame */
+		void rewind()
+		{
+			replayIndex = 0;
+		}
+
+		/** @brief Store a key press to be written with the current frame */
+		void addKeyPress(uint32_t key)
+		{
+			if (mode == Mode::record) {
+				pendingKeyPresses.push_back(key);
+			}
+		}
+
+		/** @brief Accumulate the camera translation of a mouse wheel event to be written with the current frame */
+		void addWheel(float translation)
+		{
+			if (mode == Mode::record) {
+				pendingWheel += translation;
+			}
+		}
+
+		/** @brief Write the input state of the current frame along with all wheel events and key presses since the last frame */
+		void recordFrame(const Frame& frame)
+		{
+			output << recordedFrames++ << " " << frame.mouseX << " " << frame.mouseY << " "
+				<< frame.mouseLeft << " " << frame.mouseRight << " " << frame.mouseMiddle << " "
+				<< frame.keyLeft << " " << frame.keyRight << " " << frame.keyUp << " " << frame.keyDown << " " << frame.paused << " " << pendingWheel;
+			for (auto key : pendingKeyPresses) {
+				output << " " << key;
+			}
+			output << "\n";
+			pendingKeyPresses.clear();
+			pendingWheel = 0.0f;
+		}
+
+		/** @brief Returns the next frame to replay or nullptr if all frames have been replayed */
+		const Frame* nextFrame()
+		{
+			return finished() ? nullptr : &frames[replayIndex++];
+		}
+	};
+}
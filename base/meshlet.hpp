@@ -0,0 +1,376 @@
+/*
+* Meshlet builder for indexed triangle meshes
+*
+* Partitions triangles into small clusters (meshlets) for rendering with task and mesh shaders
+* Triangles are added greedily to the current meshlet, preferring triangles that share vertices with it and that are close to its center
+* Each meshlet gets a bounding sphere and a normal cone, so whole clusters can be culled against the view frustum and for back facing
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace meshlet
+	{
+		/*
+			Packed meshlet, matches the std430 layout of { uint vertexOffset; uint triangleOffset; uint counts; }
+			vertexOffset is the index of the first entry in the meshlet vertex list, which stores indices into the mesh's vertex buffer
+			triangleOffset is the index of the first packed triangle, each triangle stores three 8 bit meshlet local vertex indices in one uint
+			counts stores the number of vertices in the lower and the number of triangles in the upper 16 bits
+		*/
+		struct Meshlet {
+			uint32_t vertexOffset;
+			uint32_t triangleOffset;
+			uint32_t counts;
+			uint32_t vertexCount() const { return counts & 0xFFFF; }
+			uint32_t triangleCount() const { return counts >> 16; }
+		};
+
+		/*
+			Culling data, matches the std430 layout of { vec4 sphere; vec4 cone; }
+			sphere: xyz = center, w = radius
+			cone: xyz = average normal (axis), w = sine of the cone's half angle, 1.0 if the meshlet can't be culled for back facing
+			A meshlet is back facing if dot(center - viewPos, axis) >= cone.w * length(center - viewPos) + radius
+		*/
+		struct Bounds {
+			glm::vec4 sphere;
+			glm::vec4 cone;
+		};
+
+		struct BuildStats {
+			double buildTime{ 0.0 };		// Milliseconds
+			uint32_t meshletCount{ 0 };
+			uint32_t triangleCount{ 0 };
+			// Number of vertices referenced by the input triangles vs. the number of vertices stored in all meshlets
+			uint32_t uniqueVertexCount{ 0 };
+			uint32_t meshletVertexCount{ 0 };
+			// Meshlets whose normal cone allows back face culling
+			uint32_t coneCullableCount{ 0 };
+			float averageVertices() const { return meshletCount > 0 ? (float)meshletVertexCount / (float)meshletCount : 0.0f; }
+			float averageTriangles() const { return meshletCount > 0 ? (float)triangleCount / (float)meshletCount : 0.0f; }
+			// Average number of triangles that reference a stored meshlet vertex (3.0 = no reuse at all)
+			float vertexReuse() const { return meshletVertexCount > 0 ? (float)(triangleCount * 3) / (float)meshletVertexCount : 0.0f; }
+			// Ratio of vertices stored in meshlets vs. unique input vertices (1.0 = no duplication across meshlet borders)
+			float vertexDuplication() const { return uniqueVertexCount > 0 ? (float)meshletVertexCount / (float)uniqueVertexCount : 0.0f; }
+		};
+
+		class Builder
+		{
+		private:
+			std::vector<glm::vec3> triangleCenters;
+			std::vector<glm::vec3> triangleNormals;
+			// Triangles adjacent to each vertex as offsets into a shared list
+			std::vector<uint32_t> adjacencyOffsets;
+			std::vector<uint32_t> adjacencyTriangles;
+
+			void buildAdjacency(uint32_t vertexCount, const uint32_t* indices, uint32_t triangleCount)
+			{
+				adjacencyOffsets.assign(vertexCount + 1, 0);
+				for (uint32_t i = 0; i < triangleCount * 3; i++) {
+					adjacencyOffsets[indices[i] + 1]++;
+				}
+				for (uint32_t i = 0; i < vertexCount; i++) {
+					adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+				}
+				adjacencyTriangles.resize(triangleCount * 3);
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (uint32_t i = 0; i < triangleCount * 3; i++) {
+					adjacencyTriangles[fill[indices[i]]++] = i / 3;
+				}
+			}
+
+			// Calculates the bounding sphere and normal cone for the last meshlet
+			void computeBounds(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& meshletTriangles, bool allowConeCulling)
+			{
+				const Meshlet& meshlet = meshlets.back();
+				glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+				for (uint32_t i = 0; i < meshlet.vertexCount(); i++) {
+					const glm::vec3& p = positions[vertices[meshlet.vertexOffset + i]];
+					min = glm::min(min, p);
+					max = glm::max(max, p);
+				}
+				const glm::vec3 center = (min + max) * 0.5f;
+				float radius = 0.0f;
+				for (uint32_t i = 0; i < meshlet.vertexCount(); i++) {
+					radius = std::max(radius, glm::distance(center, positions[vertices[meshlet.vertexOffset + i]]));
+				}
+
+				Bounds meshletBounds{ glm::vec4(center, radius), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) };
+				glm::vec3 axis(0.0f);
+				for (uint32_t triangle : meshletTriangles) {
+					axis += triangleNormals[triangle];
+				}
+				const float axisLength = glm::length(axis);
+				if (allowConeCulling && (axisLength > FLT_EPSILON)) {
+					axis /= axisLength;
+					float minDot = 1.0f;
+					for (uint32_t triangle : meshletTriangles) {
+						if (glm::dot(triangleNormals[triangle], triangleNormals[triangle]) > 0.0f) {
+							minDot = std::min(minDot, glm::dot(axis, triangleNormals[triangle]));
+						}
+					}
+					// Cones wider than a hemisphere can't be culled (cutoff stays 1.0, the culling test never passes)
+					if (minDot > 0.0f) {
+						meshletBounds.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+						stats.coneCullableCount++;
+					}
+				}
+				bounds.push_back(meshletBounds);
+			}
+
+		public:
+			static constexpr uint32_t maxVertices = 64;
+			static constexpr uint32_t maxTriangles = 124;
+
+			std::vector<Meshlet> meshlets;
+			std::vector<Bounds> bounds;
+			// Mesh vertex indices referenced by the meshlets
+			std::vector<uint32_t> vertices;
+			// Packed meshlet local triangle indices
+			std::vector<uint32_t> triangles;
+			BuildStats stats;
+
+			void clear()
+			{
+				meshlets.clear();
+				bounds.clear();
+				vertices.clear();
+				triangles.clear();
+				stats = {};
+			}
+
+			/**
+			* Partition a range of indexed triangles into meshlets, the result is appended to the existing meshlets
+			*
+			* @param positions Vertex positions of the mesh
+			* @param normals Vertex normals of the mesh (optional, used to orient the normal cones independent of the triangle winding)
+			* @param indices Pointer to the first index of the triangles to partition
+			* @param indexCount Number of indices (three per triangle)
+			* @param allowConeCulling False for double sided geometry that must not be culled for back facing
+			*/
+			void build(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>* normals, const uint32_t* indices, uint32_t indexCount, bool allowConeCulling = true)
+			{
+				auto tStart = std::chrono::high_resolution_clock::now();
+
+				const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+				const uint32_t triangleCount = indexCount / 3;
+				if (triangleCount == 0) {
+					return;
+				}
+
+				triangleCenters.resize(triangleCount);
+				triangleNormals.resize(triangleCount);
+				for (uint32_t i = 0; i < triangleCount; i++) {
+					const glm::vec3& p0 = positions[indices[i * 3]];
+					const glm::vec3& p1 = positions[indices[i * 3 + 1]];
+					const glm::vec3& p2 = positions[indices[i * 3 + 2]];
+					triangleCenters[i] = (p0 + p1 + p2) / 3.0f;
+					glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float length = glm::length(normal);
+					// Degenerate triangles don't contribute to the normal cone
+					normal = (length > FLT_EPSILON) ? normal / length : glm::vec3(0.0f);
+					// Orient towards the authored vertex normals, so the cone points outwards no matter the winding
+					if (normals) {
+						const glm::vec3 vertexNormal = (*normals)[indices[i * 3]] + (*normals)[indices[i * 3 + 1]] + (*normals)[indices[i * 3 + 2]];
+						if (glm::dot(normal, vertexNormal) < 0.0f) {
+							normal = -normal;
+						}
+					}
+					triangleNormals[i] = normal;
+				}
+				buildAdjacency(vertexCount, indices, triangleCount);
+
+				// Distances to the meshlet center are measured relative to the expected meshlet diameter of about eight average edge lengths
+				float edgeLength = 0.0f;
+				for (uint32_t i = 0; i < triangleCount; i++) {
+					edgeLength += glm::distance(positions[indices[i * 3]], positions[indices[i * 3 + 1]]);
+				}
+				const float distanceScale = 1.0f / std::max(8.0f * edgeLength / (float)triangleCount, FLT_EPSILON);
+
+				std::vector<bool> emitted(triangleCount, false);
+				std::vector<bool> referenced(vertexCount, false);
+				// Meshlet local index of each mesh vertex, 0xFF if not part of the current meshlet
+				std::vector<uint8_t> localIndex(vertexCount, 0xFF);
+				std::vector<uint32_t> meshletVertices;
+				std::vector<uint32_t> meshletTriangles;
+				std::vector<uint32_t> candidates;
+				std::vector<uint32_t> previousVertices;
+				// Number of not yet emitted triangles per vertex, low values mark the border of the already processed region
+				std::vector<uint32_t> liveTriangles(vertexCount);
+				for (uint32_t i = 0; i < vertexCount; i++) {
+					liveTriangles[i] = adjacencyOffsets[i + 1] - adjacencyOffsets[i];
+				}
+				glm::vec3 meshletCenter(0.0f);
+				uint32_t nextSeed = 0;
+				uint32_t remaining = triangleCount;
+
+				auto flush = [&]() {
+					if (meshletTriangles.empty()) {
+						return;
+					}
+					Meshlet meshlet{};
+					meshlet.vertexOffset = static_cast<uint32_t>(vertices.size());
+					meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+					meshlet.counts = static_cast<uint32_t>(meshletVertices.size()) | (static_cast<uint32_t>(meshletTriangles.size()) << 16);
+					vertices.insert(vertices.end(), meshletVertices.begin(), meshletVertices.end());
+					for (uint32_t triangle : meshletTriangles) {
+						const uint32_t a = localIndex[indices[triangle * 3]];
+						const uint32_t b = localIndex[indices[triangle * 3 + 1]];
+						const uint32_t c = localIndex[indices[triangle * 3 + 2]];
+						triangles.push_back(a | (b << 8) | (c << 16));
+					}
+					meshlets.push_back(meshlet);
+					computeBounds(positions, meshletTriangles, allowConeCulling);
+					stats.meshletVertexCount += static_cast<uint32_t>(meshletVertices.size());
+					for (uint32_t vertex : meshletVertices) {
+						localIndex[vertex] = 0xFF;
+					}
+					previousVertices.swap(meshletVertices);
+					meshletVertices.clear();
+					meshletTriangles.clear();
+					candidates.clear();
+				};
+
+				while (remaining > 0) {
+					// Pick the best triangle adjacent to the current meshlet: fewest new vertices first
+					// Ties are broken by preferring triangles with few remaining neighbours (closing gaps at the border of the processed region) and triangles close to the meshlet's center
+					uint32_t best = UINT32_MAX;
+					float bestScore = FLT_MAX;
+					for (uint32_t candidate : candidates) {
+						if (emitted[candidate]) {
+							continue;
+						}
+						uint32_t newVertices = 0;
+						for (uint32_t k = 0; k < 3; k++) {
+							newVertices += (localIndex[indices[candidate * 3 + k]] == 0xFF) ? 1 : 0;
+						}
+						if (meshletVertices.size() + newVertices > maxVertices) {
+							continue;
+						}
+						const uint32_t live = liveTriangles[indices[candidate * 3]] + liveTriangles[indices[candidate * 3 + 1]] + liveTriangles[indices[candidate * 3 + 2]];
+						const float score = (float)newVertices + 0.05f * (float)live + 0.5f * std::min(glm::distance(triangleCenters[candidate], meshletCenter) * distanceScale, 1.0f);
+						if (score < bestScore) {
+							bestScore = score;
+							best = candidate;
+						}
+					}
+					// No connected triangle fits, so start a new meshlet
+					if (best == UINT32_MAX) {
+						flush();
+						// Seed with a triangle next to the previous meshlet that has the fewest remaining neighbours, this avoids leaving small islands behind
+						uint32_t bestLive = UINT32_MAX;
+						for (uint32_t vertex : previousVertices) {
+							for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+								const uint32_t triangle = adjacencyTriangles[a];
+								if (emitted[triangle]) {
+									continue;
+								}
+								const uint32_t live = liveTriangles[indices[triangle * 3]] + liveTriangles[indices[triangle * 3 + 1]] + liveTriangles[indices[triangle * 3 + 2]];
+								if (live < bestLive) {
+									bestLive = live;
+									best = triangle;
+								}
+							}
+						}
+						// Otherwise continue with the next unused triangle in index order, which usually is spatially close
+						if (best == UINT32_MAX) {
+							while (emitted[nextSeed]) {
+								nextSeed++;
+							}
+							best = nextSeed;
+						}
+					}
+
+					// Add the triangle and its vertices
+					uint32_t newVertices = 0;
+					for (uint32_t k = 0; k < 3; k++) {
+						newVertices += (localIndex[indices[best * 3 + k]] == 0xFF) ? 1 : 0;
+					}
+					if ((meshletVertices.size() + newVertices > maxVertices) || (meshletTriangles.size() == maxTriangles)) {
+						flush();
+					}
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t vertex = indices[best * 3 + k];
+						if (localIndex[vertex] == 0xFF) {
+							localIndex[vertex] = static_cast<uint8_t>(meshletVertices.size());
+							meshletVertices.push_back(vertex);
+							if (!referenced[vertex]) {
+								referenced[vertex] = true;
+								stats.uniqueVertexCount++;
+							}
+							// Triangles sharing the new vertex become candidates
+							for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+								if (!emitted[adjacencyTriangles[a]]) {
+									candidates.push_back(adjacencyTriangles[a]);
+								}
+							}
+						}
+					}
+					meshletCenter = (meshletCenter * (float)meshletTriangles.size() + triangleCenters[best]) / (float)(meshletTriangles.size() + 1);
+					meshletTriangles.push_back(best);
+					emitted[best] = true;
+					for (uint32_t k = 0; k < 3; k++) {
+						liveTriangles[indices[best * 3 + k]]--;
+					}
+					remaining--;
+					stats.triangleCount++;
+
+					if (meshletTriangles.size() == maxTriangles) {
+						flush();
+					} else {
+						// Drop candidates that have been emitted, so the list doesn't grow with the meshlet's history
+						candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&emitted](uint32_t t) { return emitted[t]; }), candidates.end());
+					}
+				}
+				flush();
+
+				stats.meshletCount = static_cast<uint32_t>(meshlets.size());
+				triangleCenters.clear();
+				triangleNormals.clear();
+				adjacencyOffsets.clear();
+				adjacencyTriangles.clear();
+
+				stats.buildTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+
+			/**
+			* Check that all meshlets stay within the limits and only reference their own vertices
+			*
+			* @return True if the meshlet data is consistent
+			*/
+			bool validate() const
+			{
+				uint32_t triangleSum = 0;
+				for (const Meshlet& meshlet : meshlets) {
+					if ((meshlet.vertexCount() == 0) || (meshlet.vertexCount() > maxVertices) || (meshlet.triangleCount() == 0) || (meshlet.triangleCount() > maxTriangles)) {
+						return false;
+					}
+					if ((meshlet.vertexOffset + meshlet.vertexCount() > vertices.size()) || (meshlet.triangleOffset + meshlet.triangleCount() > triangles.size())) {
+						return false;
+					}
+					for (uint32_t i = 0; i < meshlet.triangleCount(); i++) {
+						const uint32_t packed = triangles[meshlet.triangleOffset + i];
+						for (uint32_t k = 0; k < 3; k++) {
+							if (((packed >> (k * 8)) & 0xFF) >= meshlet.vertexCount()) {
+								return false;
+							}
+						}
+					}
+					triangleSum += meshlet.triangleCount();
+				}
+				return (triangleSum == stats.triangleCount) && (bounds.size() == meshlets.size());
+			}
+		};
+	}
+}
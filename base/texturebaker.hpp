@@ -0,0 +1,798 @@
+/*
+* CPU texture baking
+*
+* Decodes source images, generates mip chains on the CPU and block compresses them to BC7, BC5 or ASTC 4x4 for storing in KTX files
+* Mip levels are filtered in linear space with a box or Kaiser windowed sinc kernel, texels are processed as four wide float vectors (SSE2 / NEON)
+* Block encoders fit endpoints along the principal axis of a block's colors and refine them with a least squares fit of the selected indices:
+*	BC7 uses mode 6 (single subset, RGBA endpoints with p-bits, 4 bit indices)
+*	BC5 stores two independent BC4 channels (e.g. tangent space normal x and y)
+*	ASTC 4x4 uses a single partition with LDR RGBA direct endpoints and 2 bit weights
+* Nothing in here requires a Vulkan device, so it can be used from offline tools on machines without a GPU
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include <ktx.h>
+#include "stb_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_BAKER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VKS_BAKER_NEON
+#endif
+
+namespace vks
+{
+	namespace baker
+	{
+		enum class Codec { RGBA8, BC7, BC5, ASTC4x4 };
+		enum class MipFilter { Box, Kaiser };
+
+		struct Settings {
+			Codec codec{ Codec::BC7 };
+			MipFilter mipFilter{ MipFilter::Kaiser };
+			// Color data is stored sRGB encoded, all filtering is done on linear values
+			bool srgb{ true };
+			// Colors are weighted by alpha while filtering, so fully transparent texels don't bleed into lower levels
+			bool alphaWeighted{ true };
+			// Filtered tangent space normals are renormalized on every level
+			bool normalMap{ false };
+			// Limits the number of mip levels, 0 = full chain down to 1x1
+			uint32_t maxLevels{ 0 };
+		};
+
+		// Linear RGBA image with four floats per texel
+		struct Image {
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			std::vector<float> texels;
+			void resize(uint32_t width, uint32_t height)
+			{
+				this->width = width;
+				this->height = height;
+				texels.resize(static_cast<size_t>(width) * height * 4);
+			}
+			float* row(uint32_t y) { return texels.data() + static_cast<size_t>(y) * width * 4; }
+			const float* row(uint32_t y) const { return texels.data() + static_cast<size_t>(y) * width * 4; }
+		};
+
+		struct StageStats {
+			double time{ 0.0 };		// Seconds
+			uint64_t pixels{ 0 };
+			double mpixelsPerSecond() const { return time > 0.0 ? (double)pixels / time / 1.0e6 : 0.0; }
+			void add(const StageStats& other)
+			{
+				time += other.time;
+				pixels += other.pixels;
+			}
+		};
+
+		struct Stats {
+			StageStats decode;
+			StageStats mips;
+			StageStats compress;
+			StageStats write;
+			void add(const Stats& other)
+			{
+				decode.add(other.decode);
+				mips.add(other.mips);
+				compress.add(other.compress);
+				write.add(other.write);
+			}
+		};
+
+		/** @brief Run fn(0..count-1) on up to threadCount threads, the calling thread takes part */
+		inline void parallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t)>& fn)
+		{
+			std::atomic<uint32_t> next{ 0 };
+			auto worker = [&]() {
+				for (uint32_t i = next++; i < count; i = next++) {
+					fn(i);
+				}
+			};
+			threadCount = std::clamp(threadCount, 1u, std::max(count, 1u));
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < threadCount; i++) {
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+
+		// Four wide float vector used for RGBA texels
+#if defined(VKS_BAKER_SSE2)
+		typedef __m128 float4;
+		inline float4 load4(const float* p) { return _mm_loadu_ps(p); }
+		inline void store4(float* p, float4 v) { _mm_storeu_ps(p, v); }
+		inline float4 set4(float s) { return _mm_set1_ps(s); }
+		inline float4 add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+		inline float4 mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+#elif defined(VKS_BAKER_NEON)
+		typedef float32x4_t float4;
+		inline float4 load4(const float* p) { return vld1q_f32(p); }
+		inline void store4(float* p, float4 v) { vst1q_f32(p, v); }
+		inline float4 set4(float s) { return vdupq_n_f32(s); }
+		inline float4 add4(float4 a, float4 b) { return vaddq_f32(a, b); }
+		inline float4 mul4(float4 a, float4 b) { return vmulq_f32(a, b); }
+#else
+		struct float4 { float v[4]; };
+		inline float4 load4(const float* p) { return { p[0], p[1], p[2], p[3] }; }
+		inline void store4(float* p, float4 v) { memcpy(p, v.v, sizeof(v.v)); }
+		inline float4 set4(float s) { return { s, s, s, s }; }
+		inline float4 add4(float4 a, float4 b) { return { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] }; }
+		inline float4 mul4(float4 a, float4 b) { return { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] }; }
+#endif
+
+		inline float srgbToLinear(float c)
+		{
+			return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		inline float linearToSrgb(float c)
+		{
+			return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+		}
+
+		inline uint32_t levelCount(uint32_t width, uint32_t height)
+		{
+			return static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+		}
+
+		/**
+		* Decode a source image (png, jpg, tga, bmp, ...) into a linear float image
+		*
+		* @param filename Image file to load
+		* @param settings Decides if the data is decoded from sRGB and if colors are premultiplied by alpha for filtering
+		* @param image Receives the decoded image
+		* @param error Receives a description if the image can't be decoded
+		*/
+		inline bool decode(const std::string& filename, const Settings& settings, Image& image, std::string& error)
+		{
+			int width, height, components;
+			stbi_uc* data = stbi_load(filename.c_str(), &width, &height, &components, STBI_rgb_alpha);
+			if (!data) {
+				error = stbi_failure_reason() ? stbi_failure_reason() : "unknown error";
+				return false;
+			}
+			float toLinear[256];
+			for (uint32_t i = 0; i < 256; i++) {
+				toLinear[i] = (settings.srgb && !settings.normalMap) ? srgbToLinear((float)i / 255.0f) : (float)i / 255.0f;
+			}
+			image.resize(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+			const bool premultiply = settings.alphaWeighted && !settings.normalMap;
+			const size_t texelCount = static_cast<size_t>(width) * height;
+			for (size_t i = 0; i < texelCount; i++) {
+				float* dst = &image.texels[i * 4];
+				const float alpha = (float)data[i * 4 + 3] / 255.0f;
+				for (uint32_t c = 0; c < 3; c++) {
+					dst[c] = toLinear[data[i * 4 + c]] * (premultiply ? alpha : 1.0f);
+				}
+				dst[3] = alpha;
+			}
+			stbi_image_free(data);
+			return true;
+		}
+
+		// Zeroth order modified Bessel function of the first kind (power series)
+		inline float besselI0(float x)
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			const float halfX = x * 0.5f;
+			for (uint32_t k = 1; k < 32; k++) {
+				term *= (halfX / (float)k) * (halfX / (float)k);
+				sum += term;
+				if (term < sum * 1.0e-7f) {
+					break;
+				}
+			}
+			return sum;
+		}
+
+		// Sinc windowed by a Kaiser window (alpha = 4) with a half width of 1.5 destination texels
+		inline float kaiserSinc(float x)
+		{
+			const float halfWidth = 1.5f;
+			const float alpha = 4.0f;
+			if (fabsf(x) >= halfWidth) {
+				return 0.0f;
+			}
+			const float sinc = (fabsf(x) < 1.0e-5f) ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+			const float t = x / halfWidth;
+			return sinc * besselI0(alpha * sqrtf(1.0f - t * t)) / besselI0(alpha);
+		}
+
+		/*
+			Per destination texel taps of a 1D resampling kernel
+			Used for the Kaiser filter and for box filtering odd sized levels, where each destination texel covers a fractional number of source texels
+		*/
+		struct Kernel {
+			uint32_t tapCount{ 0 };
+			std::vector<int32_t> first;
+			std::vector<float> weights;
+
+			Kernel(uint32_t srcSize, uint32_t dstSize, MipFilter filter)
+			{
+				const float scale = (float)srcSize / (float)dstSize;
+				// Support in destination texels
+				const float support = (filter == MipFilter::Kaiser) ? 1.5f : 0.5f;
+				tapCount = static_cast<uint32_t>(ceilf(support * scale * 2.0f)) + 1;
+				first.resize(dstSize);
+				weights.resize(static_cast<size_t>(dstSize) * tapCount);
+				for (uint32_t x = 0; x < dstSize; x++) {
+					const float center = ((float)x + 0.5f) * scale;
+					first[x] = static_cast<int32_t>(floorf(center - support * scale));
+					float sum = 0.0f;
+					for (uint32_t t = 0; t < tapCount; t++) {
+						// Distance between the source texel center and the destination texel center, in destination texels
+						const float d = ((float)(first[x] + (int32_t)t) + 0.5f - center) / scale;
+						float w;
+						if (filter == MipFilter::Kaiser) {
+							w = kaiserSinc(d);
+						} else {
+							// Box: coverage of the source texel by the destination texel
+							const float lo = std::max(d - 0.5f / scale, -0.5f);
+							const float hi = std::min(d + 0.5f / scale, 0.5f);
+							w = std::max(hi - lo, 0.0f);
+						}
+						weights[x * tapCount + t] = w;
+						sum += w;
+					}
+					for (uint32_t t = 0; t < tapCount; t++) {
+						weights[x * tapCount + t] /= sum;
+					}
+				}
+			}
+		};
+
+		/** @brief Downsample src into dst, which has to be sized to the next mip level */
+		inline void downsample(const Image& src, Image& dst, MipFilter filter, uint32_t threadCount)
+		{
+			// Fast path for the common case of a box filter on even sized levels: average 2x2 texels
+			if ((filter == MipFilter::Box) && (src.width == dst.width * 2) && (src.height == dst.height * 2)) {
+				parallelFor(dst.height, threadCount, [&](uint32_t y) {
+					const float* row0 = src.row(y * 2);
+					const float* row1 = src.row(y * 2 + 1);
+					float* out = dst.row(y);
+					const float4 quarter = set4(0.25f);
+					for (uint32_t x = 0; x < dst.width; x++) {
+						float4 sum = add4(add4(load4(row0 + x * 8), load4(row0 + x * 8 + 4)), add4(load4(row1 + x * 8), load4(row1 + x * 8 + 4)));
+						store4(out + x * 4, mul4(sum, quarter));
+					}
+				});
+				return;
+			}
+
+			// Separable resampling, horizontal into a temporary image, then vertical, edges are clamped
+			const Kernel horizontal(src.width, dst.width, filter);
+			const Kernel vertical(src.height, dst.height, filter);
+			Image temp;
+			temp.resize(dst.width, src.height);
+			parallelFor(src.height, threadCount, [&](uint32_t y) {
+				const float* in = src.row(y);
+				float* out = temp.row(y);
+				for (uint32_t x = 0; x < dst.width; x++) {
+					float4 sum = set4(0.0f);
+					const float* w = &horizontal.weights[x * horizontal.tapCount];
+					for (uint32_t t = 0; t < horizontal.tapCount; t++) {
+						const int32_t sx = std::clamp(horizontal.first[x] + (int32_t)t, 0, (int32_t)src.width - 1);
+						sum = add4(sum, mul4(load4(in + sx * 4), set4(w[t])));
+					}
+					store4(out + x * 4, sum);
+				}
+			});
+			parallelFor(dst.height, threadCount, [&](uint32_t y) {
+				float* out = dst.row(y);
+				const float* w = &vertical.weights[y * vertical.tapCount];
+				for (uint32_t x = 0; x < dst.width; x++) {
+					store4(out + x * 4, set4(0.0f));
+				}
+				for (uint32_t t = 0; t < vertical.tapCount; t++) {
+					const int32_t sy = std::clamp(vertical.first[y] + (int32_t)t, 0, (int32_t)src.height - 1);
+					const float* in = temp.row(sy);
+					const float4 weight = set4(w[t]);
+					for (uint32_t x = 0; x < dst.width; x++) {
+						store4(out + x * 4, add4(load4(out + x * 4), mul4(load4(in + x * 4), weight)));
+					}
+				}
+				// Negative lobes of the Kaiser kernel can overshoot
+				for (uint32_t x = 0; x < dst.width * 4; x++) {
+					out[x] = std::clamp(out[x], 0.0f, 1.0f);
+				}
+			});
+		}
+
+		inline void renormalize(Image& image)
+		{
+			const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+			for (size_t i = 0; i < texelCount; i++) {
+				float* n = &image.texels[i * 4];
+				float x = n[0] * 2.0f - 1.0f, y = n[1] * 2.0f - 1.0f, z = n[2] * 2.0f - 1.0f;
+				const float length = sqrtf(x * x + y * y + z * z);
+				if (length > 1.0e-6f) {
+					x /= length; y /= length; z /= length;
+				} else {
+					x = 0.0f; y = 0.0f; z = 1.0f;
+				}
+				n[0] = x * 0.5f + 0.5f;
+				n[1] = y * 0.5f + 0.5f;
+				n[2] = z * 0.5f + 0.5f;
+			}
+		}
+
+		/** @brief Generate the mip chain for a decoded image, the returned levels start with the image itself */
+		inline std::vector<Image> generateMips(Image&& image, const Settings& settings, uint32_t threadCount)
+		{
+			uint32_t mipLevels = levelCount(image.width, image.height);
+			if (settings.maxLevels > 0) {
+				mipLevels = std::min(mipLevels, settings.maxLevels);
+			}
+			std::vector<Image> levels(mipLevels);
+			levels[0] = std::move(image);
+			for (uint32_t i = 1; i < mipLevels; i++) {
+				levels[i].resize(std::max(levels[i - 1].width >> 1, 1u), std::max(levels[i - 1].height >> 1, 1u));
+				downsample(levels[i - 1], levels[i], settings.mipFilter, threadCount);
+				if (settings.normalMap) {
+					renormalize(levels[i]);
+				}
+			}
+			return levels;
+		}
+
+		/** @brief Convert a linear float image to 8 bit RGBA, undoing the alpha weighting and applying the sRGB encoding */
+		inline std::vector<uint8_t> quantize(const Image& image, const Settings& settings)
+		{
+			// The sRGB encoding is looked up from a table with a resolution fine enough for the steep part close to zero
+			static const std::vector<uint8_t> toSrgb = []() {
+				std::vector<uint8_t> table(16384 + 1);
+				for (uint32_t i = 0; i < table.size(); i++) {
+					table[i] = static_cast<uint8_t>(linearToSrgb((float)i / 16384.0f) * 255.0f + 0.5f);
+				}
+				return table;
+			}();
+			const bool premultiplied = settings.alphaWeighted && !settings.normalMap;
+			const bool srgb = settings.srgb && !settings.normalMap;
+			const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+			std::vector<uint8_t> rgba8(texelCount * 4);
+			for (size_t i = 0; i < texelCount; i++) {
+				const float* src = &image.texels[i * 4];
+				const float alpha = src[3];
+				const float invAlpha = (premultiplied && alpha > 0.0f) ? 1.0f / alpha : (premultiplied ? 0.0f : 1.0f);
+				for (uint32_t c = 0; c < 4; c++) {
+					const float value = std::clamp(c < 3 ? src[c] * invAlpha : src[c], 0.0f, 1.0f);
+					rgba8[i * 4 + c] = (srgb && c < 3) ? toSrgb[static_cast<uint32_t>(value * 16384.0f + 0.5f)] : static_cast<uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+			return rgba8;
+		}
+
+		// Writes bit fields into a 128 bit block, starting with the least significant bit
+		struct BlockWriter {
+			uint8_t* bytes;
+			uint32_t position{ 0 };
+			BlockWriter(uint8_t* bytes) : bytes(bytes) { memset(bytes, 0, 16); }
+			void write(uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; i++, position++) {
+					if ((value >> i) & 1) {
+						bytes[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+					}
+				}
+			}
+		};
+
+		/*
+			Endpoint fitting shared by the BC7 and ASTC encoders
+			Palette entries are interpolated as (e0 * (64 - w) + e1 * w + 32) >> 6 with a codec specific weight table
+		*/
+		struct BlockFit {
+			float texels[16][4];
+			const uint8_t* weights;
+			uint32_t weightCount;
+
+			BlockFit(const uint8_t* rgba8, const uint8_t* weights, uint32_t weightCount) : weights(weights), weightCount(weightCount)
+			{
+				for (uint32_t i = 0; i < 16; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						texels[i][c] = (float)rgba8[i * 4 + c];
+					}
+				}
+			}
+
+			// Initial endpoints at the extremes of the texels projected onto the principal axis
+			void principalAxis(float e0[4], float e1[4]) const
+			{
+				float mean[4]{};
+				for (uint32_t i = 0; i < 16; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						mean[c] += texels[i][c] / 16.0f;
+					}
+				}
+				float covariance[4][4]{};
+				for (uint32_t i = 0; i < 16; i++) {
+					for (uint32_t a = 0; a < 4; a++) {
+						for (uint32_t b = 0; b < 4; b++) {
+							covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+						}
+					}
+				}
+				// Power iteration
+				float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				for (uint32_t iteration = 0; iteration < 8; iteration++) {
+					float next[4]{};
+					for (uint32_t a = 0; a < 4; a++) {
+						for (uint32_t b = 0; b < 4; b++) {
+							next[a] += covariance[a][b] * axis[b];
+						}
+					}
+					const float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+					if (length < 1.0e-6f) {
+						break;
+					}
+					for (uint32_t c = 0; c < 4; c++) {
+						axis[c] = next[c] / length;
+					}
+				}
+				float tMin = FLT_MAX, tMax = -FLT_MAX;
+				for (uint32_t i = 0; i < 16; i++) {
+					float t = 0.0f;
+					for (uint32_t c = 0; c < 4; c++) {
+						t += (texels[i][c] - mean[c]) * axis[c];
+					}
+					tMin = std::min(tMin, t);
+					tMax = std::max(tMax, t);
+				}
+				for (uint32_t c = 0; c < 4; c++) {
+					e0[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+					e1[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+				}
+			}
+
+			/*
+				Pick the closest palette entry for every texel, returns the squared error
+				The weight tables are close to uniform, so only the entries next to the texel's projection onto the endpoint line are tested
+			*/
+			uint32_t selectIndices(const int32_t e0[4], const int32_t e1[4], uint8_t indices[16]) const
+			{
+				int32_t palette[16][4];
+				for (uint32_t i = 0; i < weightCount; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						palette[i][c] = (e0[c] * (64 - weights[i]) + e1[c] * weights[i] + 32) >> 6;
+					}
+				}
+				float direction[4];
+				float lengthSquared = 0.0f;
+				for (uint32_t c = 0; c < 4; c++) {
+					direction[c] = (float)(e1[c] - e0[c]);
+					lengthSquared += direction[c] * direction[c];
+				}
+				const float scale = lengthSquared > 0.0f ? (float)(weightCount - 1) / lengthSquared : 0.0f;
+				uint32_t error = 0;
+				for (uint32_t t = 0; t < 16; t++) {
+					float projection = 0.0f;
+					for (uint32_t c = 0; c < 4; c++) {
+						projection += (texels[t][c] - (float)e0[c]) * direction[c];
+					}
+					const int32_t nearest = std::clamp(static_cast<int32_t>(projection * scale + 0.5f), 0, (int32_t)weightCount - 1);
+					const uint32_t first = static_cast<uint32_t>(std::max(nearest - 1, 0));
+					const uint32_t last = static_cast<uint32_t>(std::min(nearest + 1, (int32_t)weightCount - 1));
+					uint32_t bestError = UINT32_MAX;
+					for (uint32_t i = first; i <= last; i++) {
+						uint32_t e = 0;
+						for (uint32_t c = 0; c < 4; c++) {
+							const int32_t d = palette[i][c] - (int32_t)texels[t][c];
+							e += d * d;
+						}
+						if (e < bestError) {
+							bestError = e;
+							indices[t] = static_cast<uint8_t>(i);
+						}
+					}
+					error += bestError;
+				}
+				return error;
+			}
+
+			// Least squares endpoints for a fixed set of indices
+			bool refine(const uint8_t indices[16], float e0[4], float e1[4]) const
+			{
+				float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+				float ax[4]{}, bx[4]{};
+				for (uint32_t t = 0; t < 16; t++) {
+					const float b = (float)weights[indices[t]] / 64.0f;
+					const float a = 1.0f - b;
+					aa += a * a;
+					ab += a * b;
+					bb += b * b;
+					for (uint32_t c = 0; c < 4; c++) {
+						ax[c] += a * texels[t][c];
+						bx[c] += b * texels[t][c];
+					}
+				}
+				const float determinant = aa * bb - ab * ab;
+				if (fabsf(determinant) < 1.0e-6f) {
+					return false;
+				}
+				for (uint32_t c = 0; c < 4; c++) {
+					e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+					e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+				}
+				return true;
+			}
+		};
+
+		/** @brief Encode 4x4 RGBA8 texels into a BC7 mode 6 block */
+		inline void encodeBC7Block(const uint8_t* rgba8, uint8_t* block)
+		{
+			static const uint8_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+			const BlockFit fit(rgba8, weights, 16);
+
+			// Endpoints are stored with 7 bits per channel plus a shared lowest bit (p-bit) per endpoint
+			uint32_t bestError = UINT32_MAX;
+			int32_t best[2][4]{};
+			uint32_t bestP[2]{};
+			uint8_t bestIndices[16]{};
+			float e[2][4];
+			fit.principalAxis(e[0], e[1]);
+			for (uint32_t iteration = 0; iteration < 2; iteration++) {
+				for (uint32_t p = 0; p < 4; p++) {
+					const uint32_t pBits[2] = { p & 1, p >> 1 };
+					int32_t q[2][4];
+					for (uint32_t i = 0; i < 2; i++) {
+						for (uint32_t c = 0; c < 4; c++) {
+							const int32_t q7 = std::clamp(static_cast<int32_t>(roundf((e[i][c] - (float)pBits[i]) / 2.0f)), 0, 127);
+							q[i][c] = (q7 << 1) | pBits[i];
+						}
+					}
+					uint8_t indices[16];
+					const uint32_t error = fit.selectIndices(q[0], q[1], indices);
+					if (error < bestError) {
+						bestError = error;
+						memcpy(best, q, sizeof(q));
+						bestP[0] = pBits[0];
+						bestP[1] = pBits[1];
+						memcpy(bestIndices, indices, sizeof(indices));
+					}
+				}
+				if ((bestError == 0) || !fit.refine(bestIndices, e[0], e[1])) {
+					break;
+				}
+			}
+
+			// The most significant index bit of the first texel is implicitly zero
+			if (bestIndices[0] & 8) {
+				std::swap(best[0], best[1]);
+				std::swap(bestP[0], bestP[1]);
+				for (uint32_t t = 0; t < 16; t++) {
+					bestIndices[t] = 15 - bestIndices[t];
+				}
+			}
+
+			BlockWriter writer(block);
+			writer.write(1 << 6, 7);
+			for (uint32_t c = 0; c < 4; c++) {
+				writer.write(best[0][c] >> 1, 7);
+				writer.write(best[1][c] >> 1, 7);
+			}
+			writer.write(bestP[0], 1);
+			writer.write(bestP[1], 1);
+			for (uint32_t t = 0; t < 16; t++) {
+				writer.write(bestIndices[t], t == 0 ? 3 : 4);
+			}
+		}
+
+		/** @brief Encode 16 single channel values into a BC4 block using the eight value mode */
+		inline void encodeBC4Block(const uint8_t* values, uint32_t stride, uint8_t* block)
+		{
+			uint8_t minValue = 255, maxValue = 0;
+			for (uint32_t t = 0; t < 16; t++) {
+				minValue = std::min(minValue, values[t * stride]);
+				maxValue = std::max(maxValue, values[t * stride]);
+			}
+			block[0] = maxValue;
+			block[1] = minValue;
+			uint64_t indices = 0;
+			if (maxValue > minValue) {
+				const float range = (float)(maxValue - minValue);
+				for (uint32_t t = 0; t < 16; t++) {
+					// Position between min (0) and max (7), palette index 0 is max, 1 is min and 2..7 are the interpolated values from max towards min
+					const uint32_t position = static_cast<uint32_t>(roundf((float)(values[t * stride] - minValue) / range * 7.0f));
+					const uint64_t index = (position == 0) ? 1 : (position == 7) ? 0 : 8 - position;
+					indices |= index << (t * 3);
+				}
+			}
+			for (uint32_t i = 0; i < 6; i++) {
+				block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+			}
+		}
+
+		/** @brief Encode the red and green channels of 4x4 RGBA8 texels into a BC5 block */
+		inline void encodeBC5Block(const uint8_t* rgba8, uint8_t* block)
+		{
+			encodeBC4Block(rgba8, 4, block);
+			encodeBC4Block(rgba8 + 1, 4, block + 8);
+		}
+
+		/** @brief Encode 4x4 RGBA8 texels into an ASTC 4x4 block (single partition, LDR RGBA direct, 4x4 grid of 2 bit weights) */
+		inline void encodeASTC4x4Block(const uint8_t* rgba8, uint8_t* block)
+		{
+			// Unquantized values of the 2 bit weight range
+			static const uint8_t weights[4] = { 0, 21, 43, 64 };
+			const BlockFit fit(rgba8, weights, 4);
+
+			uint32_t bestError = UINT32_MAX;
+			int32_t best[2][4]{};
+			uint8_t bestIndices[16]{};
+			float e[2][4];
+			fit.principalAxis(e[0], e[1]);
+			for (uint32_t iteration = 0; iteration < 3; iteration++) {
+				int32_t q[2][4];
+				for (uint32_t i = 0; i < 2; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						q[i][c] = std::clamp(static_cast<int32_t>(roundf(e[i][c])), 0, 255);
+					}
+				}
+				uint8_t indices[16];
+				const uint32_t error = fit.selectIndices(q[0], q[1], indices);
+				if (error < bestError) {
+					bestError = error;
+					memcpy(best, q, sizeof(q));
+					memcpy(bestIndices, indices, sizeof(indices));
+				}
+				if ((bestError == 0) || !fit.refine(bestIndices, e[0], e[1])) {
+					break;
+				}
+			}
+
+			// Decoders apply blue contraction if the second endpoint is darker than the first, so order the endpoints to avoid it
+			if (best[1][0] + best[1][1] + best[1][2] < best[0][0] + best[0][1] + best[0][2]) {
+				std::swap(best[0], best[1]);
+				for (uint32_t t = 0; t < 16; t++) {
+					bestIndices[t] = 3 - bestIndices[t];
+				}
+			}
+
+			BlockWriter writer(block);
+			// Block mode: 4x4 weight grid, weight range 0..3, single plane
+			writer.write(0x42, 11);
+			// Single partition
+			writer.write(0, 2);
+			// Color endpoint mode 12 (LDR RGBA direct)
+			writer.write(12, 4);
+			// Eight endpoint values with the full 0..255 range: r0, r1, g0, g1, b0, b1, a0, a1
+			for (uint32_t c = 0; c < 4; c++) {
+				writer.write(best[0][c], 8);
+				writer.write(best[1][c], 8);
+			}
+			// Weights are stored bit reversed from the top of the block downwards
+			for (uint32_t t = 0; t < 16; t++) {
+				for (uint32_t bit = 0; bit < 2; bit++) {
+					if ((bestIndices[t] >> bit) & 1) {
+						const uint32_t position = 127 - (t * 2 + bit);
+						block[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+					}
+				}
+			}
+		}
+
+		/** @brief Block compress an 8 bit RGBA level, edge texels are repeated for partial blocks */
+		inline std::vector<uint8_t> compress(const std::vector<uint8_t>& rgba8, uint32_t width, uint32_t height, Codec codec, uint32_t threadCount)
+		{
+			if (codec == Codec::RGBA8) {
+				return rgba8;
+			}
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint32_t blocksY = (height + 3) / 4;
+			std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * 16);
+			parallelFor(blocksY, threadCount, [&](uint32_t by) {
+				uint8_t texels[16 * 4];
+				for (uint32_t bx = 0; bx < blocksX; bx++) {
+					for (uint32_t t = 0; t < 16; t++) {
+						const uint32_t x = std::min(bx * 4 + (t & 3), width - 1);
+						const uint32_t y = std::min(by * 4 + (t >> 2), height - 1);
+						memcpy(&texels[t * 4], &rgba8[(static_cast<size_t>(y) * width + x) * 4], 4);
+					}
+					uint8_t* block = &blocks[(static_cast<size_t>(by) * blocksX + bx) * 16];
+					switch (codec) {
+					case Codec::BC7:
+						encodeBC7Block(texels, block);
+						break;
+					case Codec::BC5:
+						encodeBC5Block(texels, block);
+						break;
+					case Codec::ASTC4x4:
+						encodeASTC4x4Block(texels, block);
+						break;
+					default:
+						break;
+					}
+				}
+			});
+			return blocks;
+		}
+
+		/** @brief Format to pass to vks::Texture2D::loadFromFile for a baked texture */
+		inline VkFormat vkFormat(Codec codec, bool srgb)
+		{
+			switch (codec) {
+			case Codec::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+			case Codec::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+			case Codec::ASTC4x4: return srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+			default: return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+			}
+		}
+
+		inline uint32_t glInternalFormat(Codec codec, bool srgb)
+		{
+			switch (codec) {
+			case Codec::BC7: return srgb ? 0x8E8D : 0x8E8C; // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM / GL_COMPRESSED_RGBA_BPTC_UNORM
+			case Codec::BC5: return 0x8DBD; // GL_COMPRESSED_RG_RGTC2
+			case Codec::ASTC4x4: return srgb ? 0x93D0 : 0x93B0; // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR / GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+			default: return srgb ? 0x8C43 : 0x8058; // GL_SRGB8_ALPHA8 / GL_RGBA8
+			}
+		}
+
+		/**
+		* Write a mip chain to a KTX (version 1) file that can be loaded with vks::Texture2D::loadFromFile
+		*
+		* @param filename Output file, written to a temporary file first so an interrupted bake never leaves a truncated file
+		* @param levels Data of each mip level as returned by compress()
+		*/
+		inline bool writeKTX(const std::string& filename, Codec codec, bool srgb, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+		{
+			ktxTextureCreateInfo createInfo{
+				.glInternalformat = glInternalFormat(codec, srgb),
+				.baseWidth = width,
+				.baseHeight = height,
+				.baseDepth = 1,
+				.numDimensions = 2,
+				.numLevels = static_cast<uint32_t>(levels.size()),
+				.numLayers = 1,
+				.numFaces = 1,
+				.isArray = KTX_FALSE,
+				.generateMipmaps = KTX_FALSE
+			};
+			ktxTexture* texture{ nullptr };
+			if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) {
+				return false;
+			}
+			bool success = true;
+			for (uint32_t level = 0; level < levels.size(); level++) {
+				success &= (ktxTexture_SetImageFromMemory(texture, level, 0, 0, levels[level].data(), levels[level].size()) == KTX_SUCCESS);
+			}
+			const std::filesystem::path path(filename);
+			if (path.has_parent_path()) {
+				std::filesystem::create_directories(path.parent_path());
+			}
+			const std::string tempFilename = filename + ".tmp";
+			success = success && (ktxTexture_WriteToNamedFile(texture, tempFilename.c_str()) == KTX_SUCCESS);
+			ktxTexture_Destroy(texture);
+			if (success) {
+				std::error_code ec;
+				std::filesystem::rename(tempFilename, filename, ec);
+				success = !ec;
+			}
+			return success;
+		}
+	}
+}
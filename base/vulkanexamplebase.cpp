@@ -25,32 +25,35 @@ std::vector<const char*> VulkanExampleBase::args;
 
 VkResult VulkanExampleBase::createInstance()
 {
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, these are not required if rendering to offscreen images only
+	if (!settings.headless) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
-	instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_METAL_EXT)
-	instanceExtensions.push_back(VK_EXT_METAL_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_METAL_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_SCREEN_QNX)
-	instanceExtensions.push_back(VK_QNX_SCREEN_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_QNX_SCREEN_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -212,9 +215,30 @@ std::string VulkanExampleBase::getShadersPath() const
 	return getShaderBasePath() + shaderDir + "/";
 }
 
+std::string VulkanExampleBase::getPipelineCacheName() const
+{
+	// Pipeline cache data is stored per example, the title is what tells them apart
+	std::string cacheName = "pipelines_";
+	for (char c : title) {
+		if (std::isalnum(static_cast<unsigned char>(c))) {
+			cacheName += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+	}
+	return cacheName;
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	shaderCache.create(instance, vulkanDevice, "cache/shaders/");
+	// Nothing is written to disk unless the example opted in, --noshadercache forces a cold start for those that did
+	shaderCache.enabled = shaderCache.enabled && settings.shaderCache && !commandLineParser.isSet("noshadercache");
+	// Seed the pipeline cache with the data stored at the end of the last run
+	const std::vector<char> initialData = shaderCache.loadPipelineCacheData(getPipelineCacheName());
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = initialData.size(),
+		.pInitialData = initialData.empty() ? nullptr : initialData.data()
+	};
 	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 }
 
@@ -260,8 +284,57 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	return shaderStage;
 }
 
+void VulkanExampleBase::processInputRecording()
+{
+	if (inputRecorder.recording()) {
+		inputRecorder.recordFrame({
+			.mouseX = (int32_t)mouseState.position.x,
+			.mouseY = (int32_t)mouseState.position.y,
+			.mouseLeft = mouseState.buttons.left,
+			.mouseRight = mouseState.buttons.right,
+			.mouseMiddle = mouseState.buttons.middle,
+			.keyLeft = camera.keys.left,
+			.keyRight = camera.keys.right,
+			.keyUp = camera.keys.up,
+			.keyDown = camera.keys.down,
+			.paused = paused
+		});
+	}
+	if (inputRecorder.replaying()) {
+		const vks::InputRecorder::Frame* frame = inputRecorder.nextFrame();
+		if (!frame) {
+			return;
+		}
+		mouseState.buttons.left = frame->mouseLeft;
+		mouseState.buttons.right = frame->mouseRight;
+		mouseState.buttons.middle = frame->mouseMiddle;
+		camera.keys.left = frame->keyLeft;
+		camera.keys.right = frame->keyRight;
+		camera.keys.up = frame->keyUp;
+		camera.keys.down = frame->keyDown;
+		paused = frame->paused;
+		// Camera rotation and translation are proportional to the mouse movement, so a single move per frame gives the same result as the original events
+		if ((frame->mouseX != (int32_t)mouseState.position.x) || (frame->mouseY != (int32_t)mouseState.position.y)) {
+			handleMouseMove(frame->mouseX, frame->mouseY);
+		}
+		if (frame->wheel != 0.0f) {
+			camera.translate(glm::vec3(0.0f, 0.0f, frame->wheel));
+		}
+		for (auto key : frame->keyPresses) {
+			keyPressed(key);
+		}
+	}
+}
+
 void VulkanExampleBase::nextFrame()
 {
+	processInputRecording();
+	if (!cameraPath.empty()) {
+		glm::vec3 position, rotation;
+		cameraPath.evaluate(cameraPathTime, position, rotation);
+		camera.setPosition(position);
+		camera.setRotation(rotation);
+	}
 	auto tStart = std::chrono::high_resolution_clock::now();
 	render();
 	frameCounter++;
@@ -272,8 +345,15 @@ void VulkanExampleBase::nextFrame()
 #else
 	auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 #endif
-	frameTimer = (float)tDiff / 1000.0f;
+	frameTimer = (settings.fixedFrameTime > 0.0f) ? settings.fixedFrameTime : (float)tDiff / 1000.0f;
 	camera.update(frameTimer);
+	if (!cameraPath.empty()) {
+		cameraPathTime += frameTimer;
+		// Outside of benchmarks the path is looped
+		if (!benchmark.active && (cameraPathTime > cameraPath.duration())) {
+			cameraPathTime = 0.0f;
+		}
+	}
 	// Convert to clamped timer value
 	if (!paused)
 	{
@@ -299,11 +379,65 @@ void VulkanExampleBase::nextFrame()
 	tPrevEnd = tEnd;
 }
 
+void VulkanExampleBase::runBenchmark()
+{
+	// Scripted camera paths, replayed input and fixed time steps need the per-frame updates of nextFrame
+	if (!cameraPath.empty() || inputRecorder.replaying() || (settings.fixedFrameTime > 0.0f)) {
+		// Every run starts from the same state, regardless of what happened during the warm up
+		const Camera initialCamera = camera;
+		const auto initialMouseState = mouseState;
+		const float initialTimer = timer;
+		const bool initialPaused = paused;
+		benchmark.onStart = [=, this] {
+			camera = initialCamera;
+			mouseState = initialMouseState;
+			timer = initialTimer;
+			paused = initialPaused;
+			cameraPathTime = 0.0f;
+			inputRecorder.rewind();
+		};
+		if (!cameraPath.empty() || inputRecorder.replaying()) {
+			benchmark.finished = [this] {
+				return (!cameraPath.empty() && (cameraPathTime >= cameraPath.duration())) || (inputRecorder.replaying() && inputRecorder.finished());
+			};
+		}
+		if (!cameraPath.empty()) {
+			for (auto& segment : cameraPath.segments) {
+				benchmark.segments.push_back({ .name = segment.name });
+			}
+			benchmark.currentSegment = [this] { return cameraPath.segmentIndex(cameraPathTime); };
+		}
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+		tPrevEnd = lastTimestamp;
+		benchmark.run([=, this] { nextFrame(); }, vulkanDevice->properties);
+	} else {
+		benchmark.run([=, this] { render(); }, vulkanDevice->properties);
+	}
+	vkDeviceWaitIdle(device);
+	if (!benchmark.filename.empty()) {
+		benchmark.saveResults();
+	}
+}
+
 void VulkanExampleBase::renderLoop()
 {
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
+	// Without a window there are no events to process, so either the benchmark or a fixed number of frames is run
+	if (settings.headless) {
+		if (benchmark.active) {
+			runBenchmark();
+		} else {
+			lastTimestamp = std::chrono::high_resolution_clock::now();
+			tPrevEnd = lastTimestamp;
+			for (uint32_t i = 0; i < settings.headlessFrames; i++) {
+				nextFrame();
+			}
+			vkDeviceWaitIdle(device);
+		}
+		return;
+	}
 	if (benchmark.active) {
 #if defined(VK_USE_PLATFORM_WAYLAND_KHR)
 		while (!configured)
@@ -321,11 +455,7 @@ void VulkanExampleBase::renderLoop()
 		if (wl_display_dispatch_pending(display) == -1)
 			return;
 #endif
-		benchmark.run([=, this] { render(); }, vulkanDevice->properties);
-		vkDeviceWaitIdle(device);
-		if (!benchmark.filename.empty()) {
-			benchmark.saveResults();
-		}
+		runBenchmark();
 		return;
 	}
 #endif
@@ -699,6 +829,8 @@ void VulkanExampleBase::prepareFrame(bool waitForFence)
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
 	}
+	// Descriptor heap indices freed when this frame was last active are no longer in use
+	descriptorHeap.beginFrame(currentBuffer);
 	updateOverlay();
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(presentCompleteSemaphores[currentBuffer], currentImageIndex);
@@ -732,15 +864,7 @@ void VulkanExampleBase::submitFrame(bool skipQueueSubmit)
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
 	}
 
-	VkPresentInfoKHR presentInfo{
-		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &renderCompleteSemaphores[currentImageIndex],
-		.swapchainCount = 1,
-		.pSwapchains = &swapChain.swapChain,
-		.pImageIndices = &currentImageIndex
-	};
-	VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+	VkResult result = swapChain.queuePresent(queue, currentImageIndex, renderCompleteSemaphores[currentImageIndex]);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -774,6 +898,17 @@ VulkanExampleBase::VulkanExampleBase()
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("camerapath", { "-cp", "--camerapath" }, 1, "Move the camera along the keyframes of the given file (benchmark runs until the end of the path)");
+	commandLineParser.add("fixedtimestep", { "-fts", "--fixedtimestep" }, 1, "Advance animations by a fixed time step in milliseconds instead of the measured frame time");
+	commandLineParser.add("inputrecord", { "-ir", "--inputrecord" }, 1, "Record window input to the given file");
+	commandLineParser.add("inputreplay", { "-irp", "--inputreplay" }, 1, "Replay window input from the given file");
+	commandLineParser.add("noshadercache", { "-nsc", "--noshadercache" }, 0, "Don't load or store pipeline cache data and shader binaries in examples using the shader cache (cold start)");
+#if !(defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
+	commandLineParser.add("headless", { "--headless" }, 0, "Render to offscreen images instead of a window (no display server required)");
+	commandLineParser.add("headlessframes", { "-hf", "--headlessframes" }, 1, "Number of frames to render in headless mode if not running a benchmark");
+	commandLineParser.add("framedump", { "-fd", "--framedump" }, 1, "Write all frames rendered in headless mode as PPM files to the given directory");
+	commandLineParser.add("framechecksums", { "-fcs", "--framechecksums" }, 0, "Print a checksum for all frames rendered in headless mode");
+#endif
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	commandLineParser.add("resourcepath", { "-rp", "--resourcepath" }, 1, "Set path for dir where assets and shaders folder is present");
 #endif
@@ -832,6 +967,41 @@ VulkanExampleBase::VulkanExampleBase()
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("camerapath")) {
+		std::string filename = commandLineParser.getValueAsString("camerapath", "");
+		if (!cameraPath.loadFromFile(filename)) {
+			vks::tools::exitFatal("Could not load camera path from " + filename + ": " + cameraPath.error, -1);
+		}
+	}
+	if (commandLineParser.isSet("fixedtimestep")) {
+		const std::string value = commandLineParser.getValueAsString("fixedtimestep", "16.667");
+		try {
+			settings.fixedFrameTime = std::max(std::stof(value), 0.0f) / 1000.0f;
+		}
+		catch (const std::exception&) {
+			vks::tools::exitFatal("Invalid fixed time step \"" + value + "\", expected a frame time in milliseconds", -1);
+		}
+	}
+	if (commandLineParser.isSet("inputrecord")) {
+		std::string filename = commandLineParser.getValueAsString("inputrecord", "");
+		if (!inputRecorder.record(filename)) {
+			vks::tools::exitFatal("Could not open " + filename + " for recording input", -1);
+		}
+	}
+	if (commandLineParser.isSet("inputreplay")) {
+		std::string filename = commandLineParser.getValueAsString("inputreplay", "");
+		if (!inputRecorder.replay(filename)) {
+			vks::tools::exitFatal("Could not load recorded input from " + filename + ": " + inputRecorder.error, -1);
+		}
+	}
+#if !(defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
+	if (commandLineParser.isSet("headless")) {
+		settings.headless = true;
+	}
+	if (commandLineParser.isSet("headlessframes")) {
+		settings.headlessFrames = commandLineParser.getValueAsInt("headlessframes", settings.headlessFrames);
+	}
+#endif
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	if(commandLineParser.isSet("resourcepath")) {
 		vks::tools::resourcePath = commandLineParser.getValueAsString("resourcepath", "");
@@ -898,9 +1068,13 @@ VulkanExampleBase::VulkanExampleBase()
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.headless) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.headless) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -933,6 +1107,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.memory, nullptr);
+	shaderCache.savePipelineCache(getPipelineCacheName(), pipelineCache);
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 	for (auto& fence : waitFences) {
@@ -947,6 +1122,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (settings.overlay) {
 		ui.freeResources();
 	}
+	descriptorHeap.destroy();
 	delete vulkanDevice;
 	if (settings.validation) {
 		vks::debug::freeDebugCallback(instance);
@@ -966,22 +1142,26 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.headless) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.headless) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #elif defined(VK_USE_PLATFORM_SCREEN_QNX)
 	screen_destroy_event(screen_event);
 	screen_destroy_window(screen_window);
@@ -1080,7 +1260,9 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	result = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// The swapchain extension is still enabled in headless mode if available, as the offscreen images are transitioned to the present layout like swapchain images
+	const bool useSwapChain = !settings.headless || vulkanDevice->extensionSupported(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	result = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, useSwapChain);
 	if (result != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(result), result);
 		return false;
@@ -1310,6 +1492,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 			}
 		}
 
+		inputRecorder.addKeyPress((uint32_t)wParam);
 		keyPressed((uint32_t)wParam);
 		break;
 	case WM_KEYUP:
@@ -1356,7 +1539,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 	case WM_MOUSEWHEEL:
 	{
 		short wheelDelta = GET_WHEEL_DELTA_WPARAM(wParam);
-		camera.translate(glm::vec3(0.0f, 0.0f, (float)wheelDelta * 0.005f));
+		handleMouseWheel((float)wheelDelta * 0.005f);
 		break;
 	}
 	case WM_MOUSEMOVE:
@@ -1833,8 +2016,7 @@ static CVReturn displayLinkOutputCallback(CVDisplayLinkRef displayLink, const CV
 - (void)scrollWheel:(NSEvent *)event
 {
 	short wheelDelta = [event deltaY];
-	vulkanExample->camera.translate(glm::vec3(0.0f, 0.0f,
-		-(float)wheelDelta * 0.05f * vulkanExample->camera.movementSpeed));
+	vulkanExample->mouseScrolled(-(float)wheelDelta * 0.05f * vulkanExample->camera.movementSpeed);
 }
 
 - (void)windowWillEnterFullScreen:(NSNotification *)notification
@@ -1924,6 +2106,11 @@ void VulkanExampleBase::mouseDragged(float x, float y)
 	handleMouseMove(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
 }
 
+void VulkanExampleBase::mouseScrolled(float translation)
+{
+	handleMouseWheel(translation);
+}
+
 void VulkanExampleBase::windowWillResize(float x, float y)
 {
 	resizing = true;
@@ -2120,6 +2307,7 @@ void VulkanExampleBase::handleEvent(const DFBWindowEvent *event)
 			default:
 				break;
 		}
+		inputRecorder.addKeyPress(event->key_symbol);
 		keyPressed(event->key_symbol);
 		break;
 	case DWET_SIZE:
@@ -2198,7 +2386,7 @@ void VulkanExampleBase::pointerAxis(wl_pointer *pointer, uint32_t time, uint32_t
 	switch (axis)
 	{
 	case REL_X:
-		camera.translate(glm::vec3(0.0f, 0.0f, d * 0.005f));
+		handleMouseWheel(d * 0.005f);
 		break;
 	default:
 		break;
@@ -2253,8 +2441,10 @@ void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard, uint32_t seria
 		break;
 	}
 
-	if (state)
+	if (state) {
+		inputRecorder.addKeyPress(key);
 		keyPressed(key);
+	}
 }
 
 /*static*/void VulkanExampleBase::keyboardModifiersCb(void *data, struct wl_keyboard *keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group)
@@ -2631,6 +2821,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 				quit = true;
 				break;
 		}
+		inputRecorder.addKeyPress(keyEvent->detail);
 		keyPressed(keyEvent->detail);
 	}
 	break;
@@ -2738,6 +2929,7 @@ void VulkanExampleBase::handleEvent()
 
 					if ((keyflags & KEY_DOWN) == KEY_DOWN) {
 						if ((val >= 0x20) && (val <= 0xFF)) {
+							inputRecorder.addKeyPress(val);
 							keyPressed(val);
 						}
 					}
@@ -2823,7 +3015,7 @@ void VulkanExampleBase::handleEvent()
 					break;
 				}
 				if (val != 0) {
-					camera.translate(glm::vec3(0.0f, 0.0f, (float)val * 0.005f));
+					handleMouseWheel((float)val * 0.005f);
 				}
 
 				rc = screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_POSITION, pos);
@@ -2981,7 +3173,7 @@ void VulkanExampleBase::setupDepthStencil()
 		.arrayLayers = 1,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+		.usage = depthStencil.usage
 	};
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
 	VkMemoryRequirements memReqs{};
@@ -3162,6 +3354,13 @@ void VulkanExampleBase::windowResize()
 	prepared = true;
 }
 
+void VulkanExampleBase::handleMouseWheel(float translation)
+{
+	// Recorded as the resulting camera translation, so a replay doesn't depend on the platform's wheel scale
+	inputRecorder.addWheel(translation);
+	camera.translate(glm::vec3(0.0f, 0.0f, translation));
+}
+
 void VulkanExampleBase::handleMouseMove(int32_t x, int32_t y)
 {
 	int32_t dx = (int32_t)mouseState.position.x - x;
@@ -3196,6 +3395,10 @@ void VulkanExampleBase::windowResized() {}
 
 void VulkanExampleBase::createSurface()
 {
+	if (settings.headless) {
+		swapChain.initOffscreen(queue, vulkanDevice->queueFamilyIndices.graphics, commandLineParser.getValueAsString("framedump", ""), commandLineParser.isSet("framechecksums"));
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
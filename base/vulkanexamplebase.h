@@ -68,9 +68,13 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanDescriptorHeap.hpp"
+#include "VulkanShaderCache.hpp"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
+#include "camerapath.hpp"
+#include "inputrecorder.hpp"
 #include "benchmark.hpp"
 
 constexpr uint32_t maxConcurrentFrames{ 2 };
@@ -83,9 +87,13 @@ private:
 	uint32_t destHeight{};
 	bool resizing = false;
 	void handleMouseMove(int32_t x, int32_t y);
+	void handleMouseWheel(float translation);
+	void processInputRecording();
+	void runBenchmark();
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	std::string getPipelineCacheName() const;
 	void createCommandPool();
 	void createSynchronizationPrimitives();
 	void createSurface();
@@ -93,6 +101,8 @@ private:
 	void createCommandBuffers();
 	void destroyCommandBuffers();
 	std::string shaderDir = "glsl";
+	// Simulation time along the camera path
+	float cameraPathTime{ 0.0f };
 protected:
 	// Returns the path to the root of the glsl, hlsl or slang shader directory.
 	std::string getShadersPath() const;
@@ -170,6 +180,10 @@ public:
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice{};
+	/** @brief Bindless descriptor heap, only created by examples that use it, advanced to the current frame by prepareFrame */
+	vks::DescriptorHeap descriptorHeap;
+	/** @brief Persists the pipeline cache between runs, examples using VK_EXT_shader_object can also create their shaders through it to cache their binaries */
+	vks::ShaderCache shaderCache;
 
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
@@ -181,6 +195,14 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Render to offscreen images instead of a window surface, e.g. to run benchmarks without a display server */
+		bool headless = false;
+		/** @brief Number of frames rendered in headless mode if no benchmark is run */
+		uint32_t headlessFrames = 1;
+		/** @brief If greater than zero, frameTimer is set to this value (in seconds) instead of the measured frame time */
+		float fixedFrameTime = 0.0f;
+		/** @brief Load and store pipeline cache data and shader binaries in the cache directory (cache/shaders relative to the working directory), examples opt in by setting this in their constructor */
+		bool shaderCache = false;
 	} settings;
 
 	/** @brief State of gamepad input (only used on Android) */
@@ -211,6 +233,10 @@ public:
 	bool paused = false;
 
 	Camera camera;
+	/** @brief Optional scripted camera path (loaded via command line), overrides the camera's position and rotation each frame */
+	vks::CameraPath cameraPath;
+	/** @brief Records or replays window input (selected via command line) */
+	vks::InputRecorder inputRecorder;
 
 	std::string title = "Vulkan Example";
 	std::string name = "vulkanExample";
@@ -221,6 +247,8 @@ public:
 		VkImage image;
 		VkDeviceMemory memory;
 		VkImageView view;
+		/** @brief Usage flags the image is created with, samples that read the depth buffer (e.g. for a depth pyramid) can add to these in their constructor */
+		VkImageUsageFlags usage{ VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
 	} depthStencil{};
 
 	// OS specific
@@ -301,6 +329,7 @@ public:
 	void* setupWindow(void* view);
 	void displayLinkOutputCb();
 	void mouseDragged(float x, float y);
+	void mouseScrolled(float translation);
 	void windowWillResize(float x, float y);
 	void windowDidResize();
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
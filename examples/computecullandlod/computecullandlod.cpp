@@ -10,6 +10,8 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "VulkanHiZ.hpp"
+#include "VulkanTimestampQuery.hpp"
 
 
 // Total number of objects (^3) in the scene
@@ -45,6 +47,7 @@ public:
 	struct {
 		uint32_t drawCount;						// Total number of indirect draw counts to be issued
 		uint32_t lodCount[MAX_LOD_LEVEL + 1];	// Statistics for number of draws per LOD level (written by compute shader)
+		uint32_t occludedCount;					// Number of objects within the frustum that failed the occlusion test (only written by cull_occlusion.comp)
 	} indirectStats{};
 
 	// Store the indirect draw commands containing index offsets and instance count per object
@@ -85,6 +88,32 @@ public:
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
+	// Objects within the frustum are also tested against a depth pyramid of the previous frame
+	vks::HiZPyramid hiz;
+	bool occlusionCulling{ false };
+	// The pyramid reduction and the occlusion variant of the culling shader are not part of every shader pack, occlusion culling is only offered if their SPIR-V is present
+	bool occlusionAvailable{ false };
+	struct CullPushConstants {
+		glm::mat4 hizViewProjection;
+		glm::vec2 depthSize;
+		float objectRadius;
+		uint32_t occlusionCulling;
+	};
+
+	// GPU times of the scene pass and the pyramid build, accumulated separately with and without occlusion culling
+	vks::TimestampQuery timestamps;
+	enum TimestampScope { ScopeScene = 0, ScopeHiZ = 1 };
+	// Mode each frame in flight was recorded with, -1 if it hasn't been recorded yet
+	std::array<int32_t, maxConcurrentFrames> frameOcclusion{};
+	struct CullStats {
+		double sceneTime{ 0.0 };
+		double hizTime{ 0.0 };
+		double frameTime{ 0.0 };
+		double drawCount{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::array<CullStats, 2> cullStats{};
+
 	uint32_t objectCount = 0;
 
 	VulkanExample() : VulkanExampleBase()
@@ -94,6 +123,14 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setTranslation(glm::vec3(0.5f, 0.0f, 0.0f));
 		camera.movementSpeed = 5.0f;
+		// Subgroup operations for the depth pyramid reduction are core with Vulkan 1.1
+		apiVersion = VK_API_VERSION_1_1;
+		// The depth pyramid is built from the default depth attachment
+		depthStencil.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		commandLineParser.add("occlusion", { "-oc", "--occlusion" }, 0, "Cull objects against a depth pyramid of the previous frame");
+		commandLineParser.parse(args);
+		occlusionCulling = commandLineParser.isSet("occlusion");
+		frameOcclusion.fill(-1);
 	}
 
 	~VulkanExample()
@@ -124,7 +161,8 @@ public:
 				vkDestroySemaphore(device, semaphore.complete, nullptr);
 				vkDestroySemaphore(device, semaphore.ready, nullptr);
 			}
-
+			hiz.destroy();
+			timestamps.destroy();
 		}
 	}
 
@@ -150,7 +188,8 @@ public:
 		// This is shared between graphics and compute
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -420,12 +459,21 @@ public:
 			// Binding 4: LOD info (input)
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT,4),
 		};
+		if (occlusionAvailable) {
+			// Binding 5: Max depth pyramid (input)
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5));
+		}
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
+		// Occlusion test parameters are passed as push constants
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullPushConstants), 0);
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
+		VkDescriptorImageInfo hizDescriptor = hiz.maxDescriptor();
 		for (auto i = 0; i < uniformBuffers.size(); i++) {
 			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[i]));
@@ -439,14 +487,18 @@ public:
 				// Binding 3: Atomic counter (written in shader)
 				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirectDrawCountBuffers[i].descriptor),
 				// Binding 4: LOD info
-				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.lodLevelsBuffers.descriptor)
+				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.lodLevelsBuffers.descriptor),
 			};
+			if (occlusionAvailable) {
+				// Binding 5: Max depth pyramid
+				computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &hizDescriptor));
+			}
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
 		}
 
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + (occlusionAvailable ? "computecullandlod/cull_occlusion.comp.spv" : "computecullandlod/cull.comp.spv"), VK_SHADER_STAGE_COMPUTE_BIT);
 
 		// Use specialization constants to pass max. level of detail (determined by no. of meshes)
 		VkSpecializationMapEntry specializationEntry{};
@@ -509,6 +561,14 @@ public:
 		memcpy(uniformBuffers[currentBuffer].mapped, &uniformData, sizeof(UniformData));
 	}
 
+	// The depth pyramid is built on the graphics queue and read by the culling shader on the compute queue
+	void prepareOcclusionCulling()
+	{
+		hiz.create(vulkanDevice, queue, { vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute });
+		hiz.preparePipeline(loadShader(getShadersPath() + vks::HiZPyramid::shaderFile(vulkanDevice), VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		hiz.setDepthSource(queue, depthStencil.image, depthFormat, width, height);
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -516,10 +576,40 @@ public:
 		prepareBuffers();
 		prepareDescriptorPool();
 		prepareGraphics();
+		occlusionAvailable = vks::tools::fileExists(getShadersPath() + vks::HiZPyramid::shaderFile(vulkanDevice)) && vks::tools::fileExists(getShadersPath() + "computecullandlod/cull_occlusion.comp.spv");
+		if (occlusionAvailable) {
+			prepareOcclusionCulling();
+		} else {
+			occlusionCulling = false;
+		}
 		prepareCompute();
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2, maxConcurrentFrames);
+		if (benchmark.active) {
+			// Reported for the mode selected on the command line
+			benchmark.addMetric("visible objects", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.drawCount / std::max(stats.frameCount, 1u); });
+			if (timestamps.supported) {
+				benchmark.addMetric("scene ms (gpu)", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.sceneTime / std::max(stats.frameCount, 1u); });
+				benchmark.addMetric("hi-z build ms (gpu)", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.hizTime / std::max(stats.frameCount, 1u); });
+			}
+		}
 		prepared = true;
 	}
 
+	void fetchStats()
+	{
+		if (frameOcclusion[currentBuffer] < 0) {
+			return;
+		}
+		CullStats& stats = cullStats[frameOcclusion[currentBuffer]];
+		if (timestamps.fetch(currentBuffer)) {
+			stats.sceneTime += timestamps.durations[ScopeScene];
+			stats.hizTime += timestamps.durations[ScopeHiZ];
+		}
+		stats.frameTime += frameTimer * 1000.0;
+		stats.drawCount += indirectStats.drawCount;
+		stats.frameCount++;
+	}
+
 	void buildGraphicsCommandBuffer()
 	{
 		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
@@ -540,6 +630,9 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+		timestamps.reset(cmdBuffer, currentBuffer);
+		frameOcclusion[currentBuffer] = occlusionCulling ? 1 : 0;
+
 		// Acquire barrier
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
@@ -566,6 +659,8 @@ public:
 				0, nullptr);
 		}
 
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeScene);
+
 		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -601,6 +696,15 @@ public:
 
 		vkCmdEndRenderPass(cmdBuffer);
 
+		timestamps.end(cmdBuffer, currentBuffer, ScopeScene);
+
+		// Build the depth pyramid the next frame's culling pass tests against
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeHiZ);
+		if (occlusionCulling) {
+			hiz.build(cmdBuffer, uniformData.projection * uniformData.modelview);
+		}
+		timestamps.end(cmdBuffer, currentBuffer, ScopeHiZ, occlusionCulling ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
 		// Release barrier
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
@@ -669,6 +773,17 @@ public:
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[currentBuffer], 0, nullptr);
 
+		// The pyramid was built at the end of the previous frame's graphics submission, which the compute submission waits on
+		// It's not available in the first frame after enabling occlusion culling
+		const bool occlusionActive = occlusionCulling && hiz.valid;
+		CullPushConstants pushConstants{
+			.hizViewProjection = hiz.viewProjection,
+			.depthSize = glm::vec2(static_cast<float>(hiz.depthWidth), static_cast<float>(hiz.depthHeight)),
+			.objectRadius = lodModel.dimensions.radius,
+			.occlusionCulling = occlusionActive ? 1u : 0u
+		};
+		vkCmdPushConstants(cmdBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+
 		// Clear the buffer that the compute shader pass will write statistics and draw calls to
 		vkCmdFillBuffer(cmdBuffer, indirectDrawCountBuffers[currentBuffer].buffer, 0, indirectDrawCountBuffers[currentBuffer].descriptor.range, 0);
 
@@ -752,6 +867,7 @@ public:
 		{
 			VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 			VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
+			fetchStats();
 		
 			VulkanExampleBase::prepareFrame(false);
 
@@ -777,13 +893,52 @@ public:
 		}
 	}
 
+	virtual void windowResized()
+	{
+		if (!occlusionAvailable) {
+			return;
+		}
+		// The depth attachment has been recreated with the new size
+		hiz.setDepthSource(queue, depthStencil.image, depthFormat, width, height);
+		VkDescriptorImageInfo hizDescriptor = hiz.maxDescriptor();
+		for (auto& descriptorSet : compute.descriptorSets) {
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &hizDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Freeze frustum", &fixedFrustum);
+			if (!occlusionAvailable) {
+				overlay->text("Occlusion culling: not available (shaders not found)");
+			} else if (overlay->checkBox("Occlusion culling", &occlusionCulling)) {
+				// Don't test against a pyramid from before occlusion culling was disabled
+				hiz.valid = false;
+			}
+		}
+		if (occlusionAvailable && overlay->header("Occlusion culling")) {
+			overlay->text("Depth pyramid: %dx%d, %d levels", hiz.width, hiz.height, hiz.levelCount);
+			overlay->text("Reduction: %s", hiz.subgroupReduction ? "subgroup quads" : "shared memory");
+			// Averages since start for each mode, so both can be compared after toggling
+			const char* modeNames[2] = { "Frustum", "Frustum + occlusion" };
+			for (uint32_t i = 0; i < cullStats.size(); i++) {
+				const CullStats& stats = cullStats[i];
+				if (stats.frameCount == 0) {
+					continue;
+				}
+				overlay->text("%s: %.0f draws, %.2f ms/frame", modeNames[i], stats.drawCount / stats.frameCount, stats.frameTime / stats.frameCount);
+				if (timestamps.supported) {
+					overlay->text("  scene %.3f ms, hi-z build %.3f ms (gpu)", stats.sceneTime / stats.frameCount, stats.hizTime / stats.frameCount);
+				}
+			}
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
+			if (occlusionAvailable) {
+				overlay->text("Occluded objects: %d", indirectStats.occludedCount);
+			}
 			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
 			}
@@ -5,6 +5,7 @@
 * It calculates the particle system movement using two separate compute passes: calculating particle positions and integrating particles
 * For that a shader storage buffer is used which is then used as a vertex buffer for drawing the particle system with a graphics pipeline
 * To optimize performance, the compute shaders use shared memory
+* For large particle counts the forces can also be approximated using a hierarchical grid (implicit octree) that's rebuilt on the GPU for every simulation step
 *
 * Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
 *
@@ -12,6 +13,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanTimestampQuery.hpp"
 
 #if defined(__ANDROID__)
 // Lower particle count on Android for performance reasons
@@ -20,6 +22,15 @@ constexpr auto PARTICLES_PER_ATTRACTOR = 3 * 1024;
 constexpr auto PARTICLES_PER_ATTRACTOR = 4 * 1024;
 #endif
 
+// Resolution of the finest level of the hierarchical grid used for approximating forces
+constexpr uint32_t GRID_RESOLUTION = 64;
+// Each level halves the resolution of the previous one, the coarsest level has 4x4x4 cells
+constexpr int32_t GRID_LEVELS = 5;
+// Number of particles for which forces are compared against the CPU reference
+constexpr uint32_t VALIDATION_SAMPLE_COUNT = 1024;
+// Work group size of the particle compute shaders
+constexpr uint32_t PARTICLE_GROUP_SIZE = 256;
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -34,6 +45,16 @@ public:
 		glm::vec4 vel;														// xyz = velocity, w = gradient texture position
 	};
 	uint32_t numParticles{ 0 };
+	// The particle buffer is padded with massless particles to a multiple of the work group size, these are simulated but never drawn
+	uint32_t numSimulatedParticles{ 0 };
+	// Initial particle state, only kept around for validating the GPU forces against the CPU reference
+	std::vector<Particle> initialParticles;
+
+	// Forces can either be calculated exactly (O(n²)) or approximated using a hierarchical grid (O(n log n))
+	enum SimulationMode { Exact = 0, Grid = 1 };
+	int32_t simulationMode{ SimulationMode::Exact };
+	// The grid based approximation is only available if all of its shaders have been compiled
+	bool gridAvailable{ false };
 
 	// We use a shader storage buffer object to store the particlces
 	// This is updated by the compute pipeline and displayed as a vertex buffer by the graphics pipeline
@@ -71,6 +92,14 @@ public:
 		VkPipelineLayout pipelineLayout;									// Layout of the compute pipeline
 		VkPipeline pipelineCalculate;										// Compute pipeline for N-Body velocity calculation (1st pass)
 		VkPipeline pipelineIntegrate;										// Compute pipeline for euler integration (2nd pass)
+		struct GridPipelines {
+			VkPipeline scatter;												// Accumulates particle masses into the finest grid level
+			VkPipeline resolve;												// Converts the accumulated masses into centers of mass
+			VkPipeline reduce;												// Builds a coarser grid level from the next finer one
+			VkPipeline calculate;											// Approximates the N-Body velocity calculation by traversing the grid levels
+		} gridPipelines{};
+		vks::Buffer gridAccumulation;										// Fixed point mass accumulation for the finest grid level
+		vks::Buffer gridNodes;												// Center of mass and mass for the cells of all grid levels
 		struct UniformData {												// Compute shader uniform block object
 			float deltaT{ 0.0f };											// Frame delta time
 			int32_t particleCount{ 0 };
@@ -78,10 +107,24 @@ public:
 			float gravity{ 0.002f };
 			float power{ 0.75f };
 			float soften{ 0.05f };
+			// Parameters for the grid based approximation
+			float theta{ 0.5f };											// Cells with size / distance below this are treated as a single body
+			int32_t gridLevels{ GRID_LEVELS };
+			int32_t gridResolution{ GRID_RESOLUTION };
+			glm::vec4 gridBounds{ -32.0f, -32.0f, -32.0f, 64.0f };			// xyz = minimum corner, w = edge length, derived from the initial particle extent
+			float fixedPointScale{ 16.0f };									// Scale for the fixed point mass accumulation, derived from the total mass
 		} uniformData;
 		std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;		// Uniform buffer object containing particle system parameters
+		vks::TimestampQuery timestamps;										// GPU time of the simulation step
 	} compute;
 
+	// Simulation timings accumulated for the benchmark summary
+	struct SimulationStats {
+		float lastStepTime{ 0.0f };
+		double totalStepTime{ 0.0 };
+		uint32_t stepCount{ 0 };
+	} simulationStats;
+
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Compute shader N-body system";
@@ -90,6 +133,15 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+
+		// Sample specific command line arguments
+		commandLineParser.add("particlecount", { "-pc", "--particlecount" }, 1, "Set the number of simulated particles");
+		commandLineParser.add("simulationmode", { "-sm", "--simulationmode" }, 1, "Select force calculation (exact or grid)");
+		commandLineParser.add("validateforces", { "-vf", "--validateforces" }, 0, "Validate GPU forces against a CPU reference at startup");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("simulationmode")) {
+			simulationMode = (commandLineParser.getValueAsString("simulationmode", "exact") == "grid") ? SimulationMode::Grid : SimulationMode::Exact;
+		}
 	}
 
 	~VulkanExample()
@@ -108,6 +160,13 @@ public:
 			vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 			vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
 			vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
+			vkDestroyPipeline(device, compute.gridPipelines.scatter, nullptr);
+			vkDestroyPipeline(device, compute.gridPipelines.resolve, nullptr);
+			vkDestroyPipeline(device, compute.gridPipelines.reduce, nullptr);
+			vkDestroyPipeline(device, compute.gridPipelines.calculate, nullptr);
+			compute.gridAccumulation.destroy();
+			compute.gridNodes.destroy();
+			compute.timestamps.destroy();
 			vkDestroyCommandPool(device, compute.commandPool, nullptr);
 			for (auto& buffer : compute.uniformBuffers) {
 				buffer.destroy();
@@ -147,18 +206,27 @@ public:
 		};
 
 		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		if (commandLineParser.isSet("particlecount")) {
+			numParticles = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("particlecount", numParticles), 1));
+		}
+		numSimulatedParticles = (numParticles + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE * PARTICLE_GROUP_SIZE;
+		// Particles are evenly distributed across the attractors
+		const uint32_t particlesPerAttractor = (numParticles + static_cast<uint32_t>(attractors.size()) - 1) / static_cast<uint32_t>(attractors.size());
 
-		// Initial particle positions
-		std::vector<Particle> particleBuffer(numParticles);
+		// Initial particle positions, padding particles are massless and located at the origin
+		std::vector<Particle> particleBuffer(numSimulatedParticles, { glm::vec4(0.0f), glm::vec4(0.0f) });
 
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
 		std::normal_distribution<float> rndDist(0.0f, 1.0f);
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < particlesPerAttractor; j++)
 			{
-				Particle& particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				if (i * particlesPerAttractor + j >= numParticles) {
+					break;
+				}
+				Particle& particle = particleBuffer[i * particlesPerAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -187,7 +255,23 @@ public:
 			}
 		}
 
-		compute.uniformData.particleCount = numParticles;
+		compute.uniformData.particleCount = numSimulatedParticles;
+
+		// The grid covers the initial particle extent with a margin for particles moving outwards, particles leaving it are accounted to the border cells
+		glm::vec3 extentMin(std::numeric_limits<float>::max());
+		glm::vec3 extentMax(std::numeric_limits<float>::lowest());
+		double totalMass = 0.0;
+		for (uint32_t i = 0; i < numParticles; i++) {
+			extentMin = glm::min(extentMin, glm::vec3(particleBuffer[i].pos));
+			extentMax = glm::max(extentMax, glm::vec3(particleBuffer[i].pos));
+			totalMass += std::abs(particleBuffer[i].pos.w);
+		}
+		const glm::vec3 extent = extentMax - extentMin;
+		const float edgeLength = std::max({ extent.x, extent.y, extent.z, 1.0f }) * 2.0f;
+		compute.uniformData.gridBounds = glm::vec4((extentMin + extentMax) * 0.5f - glm::vec3(edgeLength * 0.5f), edgeLength);
+		// A cell's sum (and each of its mass weighted offsets, which are at most half the mass) is bounded by the total mass
+		// Half of the integer range is kept as headroom for the rounding of each particle's contribution
+		compute.uniformData.fixedPointScale = static_cast<float>(std::min(1024.0, 0.5 * std::numeric_limits<int32_t>::max() / std::max(totalMass, 1.0)));
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
 
@@ -233,17 +317,41 @@ public:
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
+
+		if (commandLineParser.isSet("validateforces")) {
+			initialParticles = std::move(particleBuffer);
+		}
+	}
+
+	// Setup the buffers for the hierarchical grid used to approximate forces
+	void prepareGridBuffers()
+	{
+		VkDeviceSize nodeCount = 0;
+		for (int32_t i = 0; i < GRID_LEVELS; i++) {
+			const VkDeviceSize res = GRID_RESOLUTION >> i;
+			nodeCount += res * res * res;
+		}
+		const VkDeviceSize cellCount = GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.gridAccumulation, cellCount * sizeof(int32_t) * 4));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.gridNodes, nodeCount * sizeof(glm::vec4)));
+
+		// The accumulation grid needs to start out cleared, after that it's cleared by the resolve pass of each simulation step
+		// This is done on the compute queue as the grid buffers are only ever accessed by that queue
+		VkCommandBuffer fillCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+		vkCmdFillBuffer(fillCmd, compute.gridAccumulation.buffer, 0, VK_WHOLE_SIZE, 0);
+		vulkanDevice->flushCommandBuffer(fillCmd, compute.queue, compute.commandPool);
 	}
 
 	void prepareDescriptorPool()
 	{
 		// This is shared between graphics and compute
+		// One additional compute set is used for validating forces
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 2 + 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (maxConcurrentFrames + 1) * 3),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 2)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 2 + 1);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -348,6 +456,14 @@ public:
 		// requiring proper synchronization (see the memory barriers in buildComputeCommandBuffer)
 		vkGetDeviceQueue(device, compute.queueFamilyIndex, 0, &compute.queue);
 
+		// Separate command pool as queue family for compute may be different than graphics
+		VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+		cmdPoolInfo.queueFamilyIndex = compute.queueFamilyIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
+
+		prepareGridBuffers();
+
 		// Compute shader uniform buffer block
 		for (auto& buffer : compute.uniformBuffers) {
 			vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(Compute::UniformData));
@@ -362,24 +478,24 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			// Binding 1 : Uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Grid accumulation storage buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Grid nodes storage buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
 		for (auto i = 0; i < compute.uniformBuffers.size(); i++) {
-			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[i]));
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-				// Binding 0 : Particle position storage buffer
-				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &storageBuffer.descriptor),
-				// Binding 1 : Uniform buffer
-				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffers[i].descriptor)
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+			compute.descriptorSets[i] = createComputeDescriptorSet(&storageBuffer.descriptor, &compute.uniformBuffers[i].descriptor);
 		}
 
 		// Create pipelines
+		// The grid reduction pass gets the level to build via push constants
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
@@ -387,8 +503,9 @@ public:
 		// 1st pass
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_calculate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
-		// We want to use as much shared memory for the compute shader invocations as available, so we calculate it based on the device limits and pass it to the shader via specialization constants
-		uint32_t sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		// The size of the shared memory tile is passed to the shader via specialization constants
+		// The shader fills one tile entry per invocation, so the tile must not be larger than the work group
+		uint32_t sharedDataSize = std::min(PARTICLE_GROUP_SIZE, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
 		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
 		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(int32_t), &sharedDataSize);
 		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
@@ -399,11 +516,23 @@ public:
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
-		// Separate command pool as queue family for compute may be different than graphics
-		VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
-		cmdPoolInfo.queueFamilyIndex = compute.queueFamilyIndex;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
+		// Grid based approximation
+		const std::array<std::string, 4> gridShaders = { "particle_grid_scatter", "particle_grid_resolve", "particle_grid_reduce", "particle_calculate_grid" };
+		gridAvailable = std::all_of(gridShaders.begin(), gridShaders.end(), [this](const std::string& name) { return vks::tools::fileExists(getShadersPath() + "computenbody/" + name + ".comp.spv"); });
+		if (gridAvailable) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_grid_scatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.scatter));
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_grid_resolve.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.resolve));
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_grid_reduce.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.reduce));
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_calculate_grid.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.calculate));
+		} else {
+			simulationMode = SimulationMode::Exact;
+		}
+
+		compute.timestamps.create(vulkanDevice, compute.queueFamilyIndex, 1, maxConcurrentFrames);
 
 		// Create command buffers for compute operations
 		for (auto& cmdBuffer : compute.commandBuffers) {
@@ -429,6 +558,96 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
 	}
 
+	VkDescriptorSet createComputeDescriptorSet(VkDescriptorBufferInfo* particleDescriptor, VkDescriptorBufferInfo* uniformDescriptor)
+	{
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
+			// Binding 0 : Particle position storage buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, particleDescriptor),
+			// Binding 1 : Uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, uniformDescriptor),
+			// Binding 2 : Grid accumulation storage buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.gridAccumulation.descriptor),
+			// Binding 3 : Grid nodes storage buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.gridNodes.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+		return descriptorSet;
+	}
+
+	// CPU reference for the exact force calculation, uses the same formula as the particle_calculate compute shader
+	glm::vec3 calculateAcceleration(const std::vector<Particle>& particles, uint32_t index)
+	{
+		const glm::dvec3 position = glm::dvec3(particles[index].pos);
+		glm::dvec3 acceleration(0.0);
+		for (const Particle& other : particles) {
+			const glm::dvec3 len = glm::dvec3(other.pos) - position;
+			acceleration += (double)compute.uniformData.gravity * len * (double)other.pos.w / pow(glm::dot(len, len) + (double)compute.uniformData.soften, (double)compute.uniformData.power);
+		}
+		return glm::vec3(acceleration);
+	}
+
+	// Runs a single force calculation pass for both simulation modes and compares the resulting accelerations against the CPU reference
+	// To keep this independent of queue ownership transfers for the particle buffer, the passes run on a host visible copy of the initial state
+	void validateForces()
+	{
+		const VkDeviceSize bufferSize = initialParticles.size() * sizeof(Particle);
+		vks::Buffer validationBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &validationBuffer, bufferSize));
+		VK_CHECK_RESULT(validationBuffer.map());
+		VkDescriptorSet descriptorSet = createComputeDescriptorSet(&validationBuffer.descriptor, &compute.uniformBuffers[0].descriptor);
+
+		// With a time step of one, the velocity change equals the acceleration
+		Compute::UniformData uniformData = compute.uniformData;
+		uniformData.deltaT = 1.0f;
+		memcpy(compute.uniformBuffers[0].mapped, &uniformData, sizeof(Compute::UniformData));
+
+		// Forces are compared for a subset of particles, as the CPU reference is O(n) per particle
+		const uint32_t sampleCount = std::min(numParticles, VALIDATION_SAMPLE_COUNT);
+		const uint32_t sampleStride = numParticles / sampleCount;
+		std::vector<glm::vec3> reference(sampleCount);
+		for (uint32_t i = 0; i < sampleCount; i++) {
+			reference[i] = calculateAcceleration(initialParticles, i * sampleStride);
+		}
+
+		std::cout << "Validating forces for " << sampleCount << " of " << numParticles << " particles against CPU reference\n";
+		const int32_t activeMode = simulationMode;
+		const std::array<std::string, 2> modeNames = { "exact", "grid" };
+		for (int32_t mode : { SimulationMode::Exact, SimulationMode::Grid }) {
+			if ((mode == SimulationMode::Grid) && !gridAvailable) {
+				continue;
+			}
+			simulationMode = mode;
+			memcpy(validationBuffer.mapped, initialParticles.data(), bufferSize);
+			VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+			recordSimulationStep(cmdBuffer, descriptorSet, false);
+			// Make the results visible to the host
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vulkanDevice->flushCommandBuffer(cmdBuffer, compute.queue, compute.commandPool);
+			const Particle* result = static_cast<Particle*>(validationBuffer.mapped);
+			double maxError = 0.0;
+			double sumError = 0.0;
+			for (uint32_t i = 0; i < sampleCount; i++) {
+				const uint32_t index = i * sampleStride;
+				const glm::vec3 acceleration = glm::vec3(result[index].vel) - glm::vec3(initialParticles[index].vel);
+				const double error = glm::length(acceleration - reference[i]) / std::max(glm::length(reference[i]), 1e-6f);
+				maxError = std::max(maxError, error);
+				sumError += error;
+			}
+			std::cout << modeNames[mode] << ": mean relative error " << sumError / sampleCount << ", max relative error " << maxError << "\n";
+		}
+		simulationMode = activeMode;
+
+		validationBuffer.destroy();
+		initialParticles.clear();
+		initialParticles.shrink_to_fit();
+	}
+
 	void updateComputeUniformBuffers()
 	{
 		compute.uniformData.deltaT = paused ? 0.0f : frameTimer * 0.05f;
@@ -455,6 +674,18 @@ public:
 		prepareStorageBuffers();
 		prepareGraphics();
 		prepareCompute();
+		if (commandLineParser.isSet("validateforces")) {
+			validateForces();
+		}
+		if (benchmark.active) {
+			std::cout << "N-body simulation: " << numParticles << " particles, " << ((simulationMode == SimulationMode::Grid) ? "grid" : "exact") << " force calculation\n";
+			// One simulation step is done per frame
+			benchmark.addMetric("steps/s", [this]() { return benchmark.frameCount / (benchmark.runtime / 1000.0); });
+			if (compute.timestamps.supported) {
+				benchmark.addMetric("step ms (gpu)", [this]() { return simulationStats.totalStepTime / std::max(simulationStats.stepCount, 1u); });
+				benchmark.addMetric("steps/s (gpu)", [this]() { return simulationStats.totalStepTime > 0.0 ? 1000.0 * simulationStats.stepCount / simulationStats.totalStepTime : 0.0; });
+			}
+		}
 		prepared = true;
 	}
 
@@ -555,6 +786,71 @@ public:
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
+	// Makes results of previous compute shader writes visible to following compute shader invocations
+	void computeBarrier(VkCommandBuffer cmdBuffer)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	// Records the commands for a single simulation step using the currently selected force calculation
+	void recordSimulationStep(VkCommandBuffer cmdBuffer, VkDescriptorSet descriptorSet, bool integrate)
+	{
+		const uint32_t particleGroupCount = numSimulatedParticles / PARTICLE_GROUP_SIZE;
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		// First pass: Calculate particle movement
+		// -------------------------------------------------------------------------------------------------------
+		if (simulationMode == SimulationMode::Grid) {
+			// Rebuild the hierarchical grid from the current particle positions
+			// Accumulate particle masses into the finest level
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.scatter);
+			vkCmdDispatch(cmdBuffer, particleGroupCount, 1, 1);
+			computeBarrier(cmdBuffer);
+			// Convert to centers of mass (this also clears the accumulation grid for the next step)
+			const uint32_t cellCount = GRID_RESOLUTION * GRID_RESOLUTION * GRID_RESOLUTION;
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.resolve);
+			vkCmdDispatch(cmdBuffer, (cellCount + 255) / 256, 1, 1);
+			computeBarrier(cmdBuffer);
+			// Build the coarser levels one after another
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.reduce);
+			for (int32_t level = 1; level < GRID_LEVELS; level++) {
+				const uint32_t res = GRID_RESOLUTION >> level;
+				vkCmdPushConstants(cmdBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t), &level);
+				vkCmdDispatch(cmdBuffer, (res * res * res + 255) / 256, 1, 1);
+				computeBarrier(cmdBuffer);
+			}
+			// Approximate forces by traversing the grid
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.calculate);
+			vkCmdDispatch(cmdBuffer, particleGroupCount, 1, 1);
+		} else {
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+			vkCmdDispatch(cmdBuffer, particleGroupCount, 1, 1);
+		}
+
+		if (!integrate) {
+			return;
+		}
+
+		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
+		computeBarrier(cmdBuffer);
+
+		// Second pass: Integrate particles
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdDispatch(cmdBuffer, particleGroupCount, 1, 1);
+	}
+
 	void buildComputeCommandBuffer()
 	{
 		VkCommandBuffer cmdBuffer = compute.commandBuffers[currentBuffer];
@@ -589,35 +885,10 @@ public:
 				0, nullptr);
 		}
 
-		// First pass: Calculate particle movement
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[currentBuffer], 0, nullptr);
-		vkCmdDispatch(cmdBuffer, numParticles / 256, 1, 1);
-
-		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = storageBuffer.buffer;
-		bufferBarrier.size = storageBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		// Transfer ownership if compute and graphics queue family indices differ
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		vkCmdPipelineBarrier(
-			cmdBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			0, nullptr,
-			1, &bufferBarrier,
-			0, nullptr);
-
-		// Second pass: Integrate particles
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(cmdBuffer, numParticles / 256, 1, 1);
+		compute.timestamps.reset(cmdBuffer, currentBuffer);
+		compute.timestamps.begin(cmdBuffer, currentBuffer, 0);
+		recordSimulationStep(cmdBuffer, compute.descriptorSets[currentBuffer], true);
+		compute.timestamps.end(cmdBuffer, currentBuffer, 0);
 
 		// Release barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
@@ -658,6 +929,13 @@ public:
 			VK_CHECK_RESULT(vkWaitForFences(device, 1, &compute.fences[currentBuffer], VK_TRUE, UINT64_MAX));
 			VK_CHECK_RESULT(vkResetFences(device, 1, &compute.fences[currentBuffer]));
 
+			// The previous simulation step using this frame's resources has finished, so its timings are available
+			if (compute.timestamps.fetch(currentBuffer)) {
+				simulationStats.lastStepTime = compute.timestamps.durations[0];
+				simulationStats.totalStepTime += simulationStats.lastStepTime;
+				simulationStats.stepCount++;
+			}
+
 			updateComputeUniformBuffers();
 			buildComputeCommandBuffer();
 
@@ -701,6 +979,26 @@ public:
 			VulkanExampleBase::submitFrame(true);
 		}
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (gridAvailable) {
+				overlay->comboBox("Forces", &simulationMode, { "Exact", "Grid" });
+			} else {
+				overlay->text("Forces: Exact (grid shaders not available)");
+			}
+			if (simulationMode == SimulationMode::Grid) {
+				overlay->sliderFloat("Theta", &compute.uniformData.theta, 0.1f, 1.5f);
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Particles: %d", numParticles);
+			if (compute.timestamps.supported) {
+				overlay->text("Simulation: %.2f ms", simulationStats.lastStepTime);
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
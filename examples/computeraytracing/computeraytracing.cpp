@@ -3,6 +3,7 @@
 * 
 * This samples implements a basic ray tracer with materials and reflections using a compute shader
 * Shader storage buffers are used to pass geometry information for spheres and planes to the computer shader
+* Triangle meshes loaded from glTF are traced using a bounding volume hierarchy that's built on the CPU (see base/bvh.hpp)
 * The compute shader then uses these as the scene geometry for ray tracing and outputs the results to a storage image
 * The graphics part of the sample then displays that image full screen
 * Not to be confused with actual hardware accelerated ray tracing
@@ -13,6 +14,15 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
+#include "bvh.hpp"
+
+// Maximum number of rays traced per pixel: Primary ray and two reflections, each with a shadow ray (see RAYBOUNCES in the compute shader)
+// Rays that miss the scene end a path early, so this is only used as an upper bound if the shader can't count the rays it traces
+constexpr uint32_t RAYS_PER_PIXEL = (1 + 2) * 2;
+// Number of random rays used for validating the BVH against brute force intersection
+constexpr uint32_t VALIDATION_RAY_COUNT = 1000;
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -55,12 +65,30 @@ public:
 		// These need to be per frames in flight, as CPU writes to while GPU reads from
 		std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
 		std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
+		// Flattened BVH nodes and the mesh triangles in BVH leaf order
+		vks::Buffer bvhNodeBuffer;
+		vks::Buffer triangleBuffer;
+		// Number of rays traced by the last dispatch of a frame in flight, written by the BVH shader
+		std::array<vks::Buffer, maxConcurrentFrames> rayCounterBuffers;
+		vks::TimestampQuery timestamps;										// GPU time of the ray tracing dispatch
 	} compute;
 
+	// Triangle mesh that's added to the scene, the BVH is built from the (pre-transformed) triangles of this model
+	vkglTF::Model model;
+	std::vector<vks::bvh::Triangle> meshTriangles;
+	vks::bvh::BVH bvh;
+	// The mesh is only traced if the BVH variant of the shader is available, otherwise the scene only contains spheres and planes
+	bool meshTracing{ false };
+	float lastTraceTime{ 0.0f };
+	double totalTraceTime{ 0.0 };
+	uint32_t traceCount{ 0 };
+	uint32_t lastRayCount{ 0 };
+	uint64_t totalRayCount{ 0 };
+
 	// Definitions for scene objects
 	// The sample uses spheres and planes that are passed to the compute shader via a shader storage buffer
 	// The computer shader uses the object type to select different calculations
-	enum class SceneObjectType { Sphere = 0, Plane = 1 };
+	enum class SceneObjectType { Sphere = 0, Plane = 1, Mesh = 2 };
 	// Spheres and planes are described by different properties, we use a union for this
 	union SceneObjectProperty {
 		glm::vec4 positionAndRadius;
@@ -75,6 +103,15 @@ public:
 		// Due to alignment rules we need to pad to make the element align at 16-bytes
 		glm::ivec2 _pad;
 	};
+	// Triangle layout used by the compute shader, objectIndex references the scene object with the mesh's material
+	struct MeshTriangle {
+		glm::vec3 v0;
+		uint32_t objectIndex;
+		glm::vec3 v1;
+		float _pad0;
+		glm::vec3 v2;
+		float _pad1;
+	};
 
 	VulkanExample() : VulkanExampleBase()
 	{
@@ -86,6 +123,11 @@ public:
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -4.0f));
 		camera.rotationSpeed = 0.0f;
 		camera.movementSpeed = 2.5f;
+
+		// Sample specific command line arguments
+		commandLineParser.add("model", { "-m", "--model" }, 1, "Set the glTF model to ray trace (relative to the asset path)");
+		commandLineParser.add("validatebvh", { "-vb", "--validatebvh" }, 0, "Validate BVH traversal against brute force intersection at startup");
+		commandLineParser.parse(args);
 	}
 
 	~VulkanExample()
@@ -107,6 +149,12 @@ public:
 				buffer.destroy();
 			}
 			compute.objectStorageBuffer.destroy();
+			compute.bvhNodeBuffer.destroy();
+			compute.triangleBuffer.destroy();
+			for (auto& buffer : compute.rayCounterBuffers) {
+				buffer.destroy();
+			}
+			compute.timestamps.destroy();
 			storageImage.destroy();
 		}
 	}
@@ -216,6 +264,75 @@ public:
 		storageImage.device = vulkanDevice;
 	}
 
+	// Load the triangle mesh and build the BVH for it
+	void loadAssets()
+	{
+		const std::string fileName = commandLineParser.getValueAsString("model", "models/chinesedragon.gltf");
+		// The vertex data needs to be kept on the host for building the BVH
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::KeepHostData;
+		model.loadFromFile(getAssetPath() + fileName, vulkanDevice, queue, glTFLoadingFlags);
+
+		// Scale and move the model so it fits in front of the spheres
+		const float targetSize = 1.75f;
+		const glm::vec3 targetCenter = glm::vec3(0.0f, -1.75f, 1.25f);
+		const float scale = targetSize / std::max(std::max(model.dimensions.size.x, model.dimensions.size.y), model.dimensions.size.z);
+		auto transform = [&](const glm::vec3& pos) { return (pos - model.dimensions.center) * scale + targetCenter; };
+		meshTriangles.resize(model.indexData.size() / 3);
+		for (size_t i = 0; i < meshTriangles.size(); i++) {
+			meshTriangles[i].v0 = transform(model.vertexData[model.indexData[i * 3]].pos);
+			meshTriangles[i].v1 = transform(model.vertexData[model.indexData[i * 3 + 1]].pos);
+			meshTriangles[i].v2 = transform(model.vertexData[model.indexData[i * 3 + 2]].pos);
+		}
+		model.vertexData.clear();
+		model.indexData.clear();
+
+		bvh.build(meshTriangles);
+		std::cout << "BVH for " << meshTriangles.size() << " triangles built in " << bvh.stats.buildTime << " ms: " << bvh.stats.nodeCount << " nodes, " << bvh.stats.leafCount << " leaves, depth " << bvh.stats.maxDepth << ", SAH cost " << bvh.stats.sahCost << "\n";
+	}
+
+	// Compares closest hits of the BVH traversal against testing all triangles for random rays through the mesh bounds
+	void validateBVH()
+	{
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
+		glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
+		for (auto& triangle : meshTriangles) {
+			meshMin = glm::min(meshMin, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+			meshMax = glm::max(meshMax, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+		}
+		const glm::vec3 meshCenter = (meshMin + meshMax) * 0.5f;
+		const float meshRadius = glm::length(meshMax - meshMin) * 0.5f;
+
+		std::vector<std::pair<glm::vec3, glm::vec3>> rays(VALIDATION_RAY_COUNT);
+		for (auto& ray : rays) {
+			// Random origins around the mesh aimed at random points inside its bounds
+			const glm::vec3 origin = meshCenter + glm::normalize(glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine))) * meshRadius * 2.0f;
+			const glm::vec3 target = meshCenter + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * (meshMax - meshMin) * 0.5f;
+			ray = { origin, glm::normalize(target - origin) };
+		}
+
+		uint32_t mismatches = 0;
+		std::vector<vks::bvh::Hit> bvhHits(rays.size()), referenceHits(rays.size());
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < rays.size(); i++) {
+			bvh.intersect(meshTriangles, rays[i].first, rays[i].second, bvhHits[i]);
+		}
+		const double bvhTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		tStart = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < rays.size(); i++) {
+			vks::bvh::BVH::intersectBruteForce(meshTriangles, rays[i].first, rays[i].second, referenceHits[i]);
+		}
+		const double referenceTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		for (size_t i = 0; i < rays.size(); i++) {
+			// Different triangles may be reported for hits on shared edges, so compare the hit distances
+			if ((bvhHits[i].triangle == UINT32_MAX) != (referenceHits[i].triangle == UINT32_MAX) || (std::fabs(bvhHits[i].t - referenceHits[i].t) > 1e-5f * std::max(1.0f, referenceHits[i].t))) {
+				mismatches++;
+			}
+		}
+		std::cout << "BVH validation: " << mismatches << " of " << rays.size() << " rays differ from brute force intersection\n";
+		std::cout << "CPU rays/s: BVH " << rays.size() / (bvhTime / 1000.0) << ", brute force " << rays.size() / (referenceTime / 1000.0) << "\n";
+	}
+
 	// Setup and fill the compute shader storage buffes containing object definitions for the raytraced scene
 	void prepareStorageBuffers()
 	{
@@ -259,6 +376,17 @@ public:
 		addPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f);
 		addPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f);
 
+		// The mesh only needs a scene object for its id and material, the geometry is passed separately
+		const uint32_t meshObjectIndex = static_cast<uint32_t>(sceneObjects.size());
+		if (meshTracing) {
+			SceneObject mesh{};
+			mesh.id = currentId++;
+			mesh.diffuse = glm::vec3(0.9f, 0.9f, 0.9f);
+			mesh.specular = 32.0f;
+			mesh.objectType = (uint32_t)SceneObjectType::Mesh;
+			sceneObjects.push_back(mesh);
+		}
+
 		VkDeviceSize storageBufferSize = sceneObjects.size() * sizeof(SceneObject);
 
 		// Copy the data to the device
@@ -271,6 +399,38 @@ public:
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
+
+		if (!meshTracing) {
+			return;
+		}
+
+		// Triangles are reordered to match the BVH leaves, so the shader can access them without an indirection
+		std::vector<MeshTriangle> triangles(meshTriangles.size());
+		for (size_t i = 0; i < triangles.size(); i++) {
+			const vks::bvh::Triangle& triangle = meshTriangles[bvh.triangleIndices[i]];
+			triangles[i] = { triangle.v0, meshObjectIndex, triangle.v1, 0.0f, triangle.v2, 0.0f };
+		}
+		uploadStorageBuffer(compute.bvhNodeBuffer, bvh.nodes.data(), bvh.nodes.size() * sizeof(vks::bvh::Node));
+		uploadStorageBuffer(compute.triangleBuffer, triangles.data(), triangles.size() * sizeof(MeshTriangle));
+
+		// The ray counters are read back and cleared by the host
+		for (auto& buffer : compute.rayCounterBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(uint32_t)));
+			VK_CHECK_RESULT(buffer.map());
+			memset(buffer.mapped, 0, sizeof(uint32_t));
+		}
+	}
+
+	void uploadStorageBuffer(vks::Buffer& buffer, void* data, VkDeviceSize size)
+	{
+		vks::Buffer stagingBuffer;
+		vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, data);
+		vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size);
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = { 0, 0, size };
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
 	}
 
 	// The descriptor pool will be shared between graphics and compute
@@ -280,7 +440,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 4),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxConcurrentFrames * 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 4),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 3);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -387,16 +547,24 @@ public:
 
 		// Setup descriptors
 
-		// The compute pipeline uses one set and four bindings
+		// The compute pipeline uses one set and three bindings, or six bindings if the mesh is traced
 		// Binding 0: Storage image for raytraced output
 		// Binding 1: Uniform buffer with parameters
 		// Binding 2: Shader storage buffer with scene object definitions
+		// Binding 3: Shader storage buffer with the BVH nodes
+		// Binding 4: Shader storage buffer with the mesh triangles
+		// Binding 5: Shader storage buffer with the ray counter
 
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
 		};
+		if (meshTracing) {
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3));
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4));
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5));
+		}
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr,	&compute.descriptorSetLayout));
 
@@ -410,6 +578,11 @@ public:
 				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffers[i].descriptor),
 				vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.objectStorageBuffer.descriptor),
 			};
+			if (meshTracing) {
+				computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.bvhNodeBuffer.descriptor));
+				computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.triangleBuffer.descriptor));
+				computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &compute.rayCounterBuffers[i].descriptor));
+			}
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
 		}
 
@@ -418,8 +591,10 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeraytracing/raytracing.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + (meshTracing ? "computeraytracing/raytracing_bvh.comp.spv" : "computeraytracing/raytracing.comp.spv"), VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+
+		compute.timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.compute, 1, maxConcurrentFrames);
 	}
 
 	void updateUniformBuffers()
@@ -435,11 +610,31 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		meshTracing = vks::tools::fileExists(getShadersPath() + "computeraytracing/raytracing_bvh.comp.spv");
+		if (meshTracing) {
+			loadAssets();
+			// The traversal stack in the shader (BVH_STACK_SIZE) can hold one entry per level, the builder caps the depth accordingly
+			if (bvh.stats.maxDepth >= vks::bvh::BVH::maxStackSize) {
+				std::cout << "BVH depth " << bvh.stats.maxDepth << " exceeds the traversal stack size, falling back to spheres and planes only\n";
+				meshTracing = false;
+			}
+		}
+		if (meshTracing && commandLineParser.isSet("validatebvh")) {
+			validateBVH();
+		}
 		prepareStorageImage();
 		prepareStorageBuffers();
 		setupDescriptorPool();
 		prepareGraphics();
 		prepareCompute();
+		if (benchmark.active && compute.timestamps.supported) {
+			benchmark.addMetric("trace ms (gpu)", [this]() { return totalTraceTime / std::max(traceCount, 1u); });
+			if (meshTracing) {
+				benchmark.addMetric("rays/s (gpu)", [this]() { return totalTraceTime > 0.0 ? (double)totalRayCount / (totalTraceTime / 1000.0) : 0.0; });
+			} else {
+				benchmark.addMetric("rays/s upper bound (gpu)", [this]() { return totalTraceTime > 0.0 ? (double)storageImage.width * storageImage.height * RAYS_PER_PIXEL * traceCount / (totalTraceTime / 1000.0) : 0.0; });
+			}
+		}
 		prepared = true;
 	}
 
@@ -577,7 +772,18 @@ public:
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[currentBuffer], 0, nullptr);
 
+		compute.timestamps.reset(cmdBuffer, currentBuffer);
+		compute.timestamps.begin(cmdBuffer, currentBuffer, 0);
 		vkCmdDispatch(cmdBuffer, storageImage.width / 16, storageImage.height / 16, 1);
+		compute.timestamps.end(cmdBuffer, currentBuffer, 0);
+
+		if (meshTracing) {
+			// Make the ray count visible to the host
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
 
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
@@ -607,6 +813,18 @@ public:
 		// Use a fence to ensure that compute command buffer has finished executing before using it again
 		vkWaitForFences(device, 1, &compute.fences[currentBuffer], VK_TRUE, UINT64_MAX);
 		vkResetFences(device, 1, &compute.fences[currentBuffer]);
+		if (compute.timestamps.fetch(currentBuffer)) {
+			lastTraceTime = compute.timestamps.durations[0];
+			totalTraceTime += lastTraceTime;
+			traceCount++;
+			if (meshTracing) {
+				lastRayCount = *static_cast<uint32_t*>(compute.rayCounterBuffers[currentBuffer].mapped);
+				totalRayCount += lastRayCount;
+			}
+		}
+		if (meshTracing) {
+			memset(compute.rayCounterBuffers[currentBuffer].mapped, 0, sizeof(uint32_t));
+		}
 		buildComputeCommandBuffer();
 
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
@@ -619,6 +837,27 @@ public:
 		buildGraphicsCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Statistics")) {
+			if (meshTracing) {
+				overlay->text("Triangles: %d", (int32_t)meshTriangles.size());
+				overlay->text("BVH nodes: %d", bvh.stats.nodeCount);
+				overlay->text("BVH build: %.2f ms", bvh.stats.buildTime);
+			} else {
+				overlay->text("Mesh tracing unavailable (no BVH shader)");
+			}
+			if (compute.timestamps.supported && (lastTraceTime > 0.0f)) {
+				overlay->text("Trace: %.2f ms", lastTraceTime);
+				if (meshTracing) {
+					overlay->text("Rays: %.1f M/s", (float)lastRayCount / (lastTraceTime * 1000.0f));
+				} else {
+					overlay->text("Rays: < %.1f M/s (upper bound)", (float)storageImage.width * storageImage.height * RAYS_PER_PIXEL / (lastTraceTime * 1000.0f));
+				}
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -5,7 +5,9 @@
 * albedo, normals, world positions are rendered to offscreen images which are then put together and lit
 * in a composition pass
 * Use the dropdown in the ui to switch between the final composition pass or the separate components
-* 
+* The passes and their attachments are declared with a render graph, which derives barriers and attachment memory placement
+* Lights are assigned to the clusters of a froxel grid in a compute pass, so shading only evaluates the lights close to a fragment
+* This scales to thousands of lights and is used by both the deferred composition and a forward shading path
 * 
 * Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
 *
@@ -14,6 +16,9 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRenderGraph.hpp"
+#include "VulkanClusteredLights.hpp"
+#include "VulkanTimestampQuery.hpp"
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -43,17 +48,62 @@ public:
 		glm::vec4 instancePos[3];
 	} uniformDataOffscreen;
 
+	struct UniformDataComposition {
+		glm::vec4 viewPos;
+		int debugDisplayTarget = 0;
+		int clustered = 0;
+	} uniformDataComposition;
+
+	// Layout of deferred.frag, which shades the six original lights without clusters
 	struct Light {
 		glm::vec4 position;
 		glm::vec3 color;
 		float radius;
 	};
-
-	struct UniformDataComposition {
+	struct UniformDataCompositionFixedLights {
 		Light lights[6];
 		glm::vec4 viewPos;
 		int debugDisplayTarget = 0;
-	} uniformDataComposition;
+	} uniformDataCompositionFixedLights;
+
+	// Lights are culled against the clusters of a froxel grid, the grid and the light lists are read by the composition and the forward path
+	vks::ClusteredLights clusteredLights;
+	enum ShadingMode { ShadingDeferred = 0, ShadingDeferredClustered = 1, ShadingForwardClustered = 2 };
+	int32_t shadingMode = ShadingDeferredClustered;
+	// The light culling and clustered shading shaders are not part of every shader pack, the clustered modes are only offered if their SPIR-V is present
+	// Without them, the composition falls back to deferred.frag with the six original lights
+	bool clusteredAvailable = false;
+	bool forwardAvailable = false;
+	static constexpr uint32_t maxLightCount = 10000;
+	// The first six lights are the sample's original lights, the others are small lights moving around the floor
+	int32_t lightCount = 6;
+	struct LightAnimation {
+		glm::vec3 center;
+		float orbitRadius;
+		float speed;
+		float phase;
+		float range;
+		glm::vec4 color;
+	};
+	std::vector<LightAnimation> lightAnimations;
+
+	// GPU times of the G-Buffer and shading passes, accumulated separately for each shading mode
+	vks::TimestampQuery timestamps;
+	enum TimestampScope { ScopeGBuffer = 0, ScopeShading = 1 };
+	// Mode each frame in flight was recorded with, -1 if it hasn't been recorded yet
+	std::array<int32_t, maxConcurrentFrames> frameShadingMode{};
+	struct ShadingStats {
+		double gbufferTime{ 0.0 };
+		double shadingTime{ 0.0 };
+		double cullTime{ 0.0 };
+		double frameTime{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::array<ShadingStats, 3> shadingStats{};
+	// Compare the clusters against the host reference with the next frame's lights
+	bool validateClusters = false;
+	bool validationDone = false;
+	vks::ClusteredLights::ValidationResult validationResult;
 
 	struct UniformBuffers {
 		vks::Buffer offscreen;
@@ -65,6 +115,7 @@ public:
 	struct {
 		VkPipeline offscreen{ VK_NULL_HANDLE };
 		VkPipeline composition{ VK_NULL_HANDLE };
+		VkPipeline forward{ VK_NULL_HANDLE };
 	} pipelines;
 
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
@@ -75,21 +126,23 @@ public:
 	};
 	std::array<DescriptorSets, maxConcurrentFrames> descriptorSets;
 
-	// Framebuffers holding the deferred attachments
-	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-		VkFormat format;
-	};
-	struct FrameBuffer {
-		int32_t width, height;
-		VkFramebuffer frameBuffer;
-		// One attachment for every component required for a deferred rendering setup
-		FrameBufferAttachment position, normal, albedo;
-		FrameBufferAttachment depth;
-		VkRenderPass renderPass;
-	} offScreenFrameBuf{};
+	// The render graph owns the deferred attachments along with the render pass and framebuffer of the G-Buffer pass
+	vks::RenderGraph renderGraph;
+	// One image for every component required for a deferred rendering setup
+	struct {
+		uint32_t position;
+		uint32_t normal;
+		uint32_t albedo;
+		uint32_t depth;
+	} graphImages{};
+	struct {
+		uint32_t gbuffer;
+		uint32_t composition;
+	} graphPasses{};
+	// Note: Instead of using fixed sizes, one could also match the window size and recreate the attachments on resize
+	const uint32_t offscreenSize{ 2048 };
+	// Result of compiling a small graph with known lifetimes without a device
+	bool graphAliasingValid{ false };
 
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler{ VK_NULL_HANDLE };
@@ -105,30 +158,32 @@ public:
 		camera.position = { 2.15f, 0.3f, -8.75f };
 		camera.setRotation(glm::vec3(-0.75f, 12.5f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		commandLineParser.add("lightcount", { "-lc", "--lightcount" }, 1, "Set the number of lights (up to 10000)");
+		commandLineParser.add("shadingmode", { "-sm", "--shadingmode" }, 1, "Shading path: 0 = deferred with all lights, 1 = deferred clustered, 2 = forward clustered");
+		commandLineParser.add("validateclusters", { "-vc", "--validateclusters" }, 0, "Compare the light clusters against a host reference on the first frame");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("lightcount")) {
+			lightCount = std::clamp(commandLineParser.getValueAsInt("lightcount", lightCount), 6, (int32_t)maxLightCount);
+		}
+		if (commandLineParser.isSet("shadingmode")) {
+			shadingMode = std::clamp(commandLineParser.getValueAsInt("shadingmode", shadingMode), 0, 2);
+		}
+		validateClusters = commandLineParser.isSet("validateclusters");
+		frameShadingMode.fill(-1);
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
 			vkDestroySampler(device, colorSampler, nullptr);
-			vkDestroyImageView(device, offScreenFrameBuf.position.view, nullptr);
-			vkDestroyImage(device, offScreenFrameBuf.position.image, nullptr);
-			vkFreeMemory(device, offScreenFrameBuf.position.mem, nullptr);
-			vkDestroyImageView(device, offScreenFrameBuf.normal.view, nullptr);
-			vkDestroyImage(device, offScreenFrameBuf.normal.image, nullptr);
-			vkFreeMemory(device, offScreenFrameBuf.normal.mem, nullptr);
-			vkDestroyImageView(device, offScreenFrameBuf.albedo.view, nullptr);
-			vkDestroyImage(device, offScreenFrameBuf.albedo.image, nullptr);
-			vkFreeMemory(device, offScreenFrameBuf.albedo.mem, nullptr);
-			vkDestroyImageView(device, offScreenFrameBuf.depth.view, nullptr);
-			vkDestroyImage(device, offScreenFrameBuf.depth.image, nullptr);
-			vkFreeMemory(device, offScreenFrameBuf.depth.mem, nullptr);
-			vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+			renderGraph.destroy();
+			clusteredLights.destroy();
+			timestamps.destroy();
 			vkDestroyPipeline(device, pipelines.composition, nullptr);
+			vkDestroyPipeline(device, pipelines.forward, nullptr);
 			vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-			vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
 			textures.model.colorMap.destroy();
 			textures.model.normalMap.destroy();
 			textures.floor.colorMap.destroy();
@@ -149,203 +204,103 @@ public:
 		}
 	};
 
-	// Create a frame buffer attachment
-	void createAttachment(
-		VkFormat format,
-		VkImageUsageFlagBits usage,
-		FrameBufferAttachment *attachment)
+	// Renders the deferred composition or the forward shaded scene to the swapchain, along with the UI
+	void drawSwapchainPass(VkCommandBuffer cmdBuffer)
 	{
-		VkImageAspectFlags aspectMask = 0;
-		VkImageLayout imageLayout;
-
-		attachment->format = format;
-
-		if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		}
-		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (format >= VK_FORMAT_D16_UNORM_S8_UINT)
-				aspectMask |=VK_IMAGE_ASPECT_STENCIL_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentImageIndex];
+
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeShading);
+		if (shadingMode == ShadingForwardClustered) {
+			// Forward path: Render the scene directly, lights are looked up from the same clusters as in the composition
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.forward);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].floor, 0, nullptr);
+			models.floor.draw(cmdBuffer);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].model, 0, nullptr);
+			models.model.bindBuffers(cmdBuffer);
+			vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+		} else {
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].composition, 0, nullptr);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+			// Final composition
+			// This is done by simply drawing a full screen quad
+			// The fragment shader then combines the deferred attachments into the final image
+			// Note: Also used for debug display if debugDisplayTarget > 0
+			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 		}
-
-		assert(aspectMask > 0);
-
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = format;
-		image.extent.width = offScreenFrameBuf.width;
-		image.extent.height = offScreenFrameBuf.height;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
-
-		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
-		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageView.format = format;
-		imageView.subresourceRange = {};
-		imageView.subresourceRange.aspectMask = aspectMask;
-		imageView.subresourceRange.baseMipLevel = 0;
-		imageView.subresourceRange.levelCount = 1;
-		imageView.subresourceRange.baseArrayLayer = 0;
-		imageView.subresourceRange.layerCount = 1;
-		imageView.image = attachment->image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+		timestamps.end(cmdBuffer, currentBuffer, ScopeShading);
+		drawUI(cmdBuffer);
+		vkCmdEndRenderPass(cmdBuffer);
 	}
 
-	// Prepare a new framebuffer and attachments for offscreen rendering (G-Buffer)
-	void prepareOffscreenFramebuffer()
+	// Declare the G-Buffer and composition passes along with the images they write and read
+	// The graph creates the images and derives load/store operations, layout transitions and barriers from these declarations
+	void prepareRenderGraph()
 	{
-		// Note: Instead of using fixed sizes, one could also match the window size and recreate the attachments on resize
-		offScreenFrameBuf.width = 2048;
-		offScreenFrameBuf.height = 2048;
-
 		// Color attachments
-
 		// (World space) Positions
-		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.position);
-
+		graphImages.position = renderGraph.addImage("position", VK_FORMAT_R16G16B16A16_SFLOAT, offscreenSize, offscreenSize);
 		// (World space) Normals
-		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.normal);
-
+		graphImages.normal = renderGraph.addImage("normal", VK_FORMAT_R16G16B16A16_SFLOAT, offscreenSize, offscreenSize);
 		// Albedo (color)
-		createAttachment(
-			VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.albedo);
-
+		graphImages.albedo = renderGraph.addImage("albedo", VK_FORMAT_R8G8B8A8_UNORM, offscreenSize, offscreenSize);
 		// Depth attachment
-
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
 		assert(validDepthFormat);
+		// Depth is only used within the G-Buffer pass, so it's never stored and can live in lazily allocated memory on tile based GPUs
+		graphImages.depth = renderGraph.addImage("depth", attDepthFormat, offscreenSize, offscreenSize);
 
-		createAttachment(
-			attDepthFormat,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			&offScreenFrameBuf.depth);
-
-		// Set up separate renderpass with references to the color and depth attachments
-		std::array<VkAttachmentDescription, 4> attachmentDescs = {};
-
-		// Init attachment properties
-		for (uint32_t i = 0; i < 4; ++i)
-		{
-			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			if (i == 3)
-			{
-				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-			}
-			else
-			{
-				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			}
-		}
-
-		// Formats
-		attachmentDescs[0].format = offScreenFrameBuf.position.format;
-		attachmentDescs[1].format = offScreenFrameBuf.normal.format;
-		attachmentDescs[2].format = offScreenFrameBuf.albedo.format;
-		attachmentDescs[3].format = offScreenFrameBuf.depth.format;
-
-		std::vector<VkAttachmentReference> colorReferences;
-		colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-
-		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 3;
-		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.pColorAttachments = colorReferences.data();
-		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
-		subpass.pDepthStencilAttachment = &depthReference;
-
-		// Use subpass dependencies for attachment layout transitions
-		std::array<VkSubpassDependency, 3> dependencies{};
-
-		// Depth
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-		// Color
-		dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].dstSubpass = 0;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		// Color
-		dependencies[2].srcSubpass = 0;
-		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.pAttachments = attachmentDescs.data();
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 3;
-		renderPassInfo.pDependencies = dependencies.data();
-
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offScreenFrameBuf.renderPass));
-
-		std::array<VkImageView, 4> attachments{};
-		attachments[0] = offScreenFrameBuf.position.view;
-		attachments[1] = offScreenFrameBuf.normal.view;
-		attachments[2] = offScreenFrameBuf.albedo.view;
-		attachments[3] = offScreenFrameBuf.depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = {};
-		fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbufCreateInfo.pNext = NULL;
-		fbufCreateInfo.renderPass = offScreenFrameBuf.renderPass;
-		fbufCreateInfo.pAttachments = attachments.data();
-		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbufCreateInfo.width = offScreenFrameBuf.width;
-		fbufCreateInfo.height = offScreenFrameBuf.height;
-		fbufCreateInfo.layers = 1;
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offScreenFrameBuf.frameBuffer));
+		// First pass: Fill the deferred attachments
+		graphPasses.gbuffer = renderGraph.addPass("G-Buffer", [this](VkCommandBuffer cmdBuffer) {
+			timestamps.begin(cmdBuffer, currentBuffer, ScopeGBuffer);
+			VkViewport viewport = vks::initializers::viewport((float)offscreenSize, (float)offscreenSize, 0.0f, 1.0f);
+			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(offscreenSize, offscreenSize, 0, 0);
+			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			// Floor
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].floor, 0, nullptr);
+			models.floor.draw(cmdBuffer);
+			// Render multiple instances of the model
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].model, 0, nullptr);
+			models.model.bindBuffers(cmdBuffer);
+			vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+			timestamps.end(cmdBuffer, currentBuffer, ScopeGBuffer);
+		});
+		renderGraph.addColorOutput(graphPasses.gbuffer, graphImages.position);
+		renderGraph.addColorOutput(graphPasses.gbuffer, graphImages.normal);
+		renderGraph.addColorOutput(graphPasses.gbuffer, graphImages.albedo);
+		renderGraph.setDepthOutput(graphPasses.gbuffer, graphImages.depth);
+
+		// Second pass: Composition
+		// This pass renders to the swapchain, which is not owned by the graph, so it begins the example's render pass itself
+		graphPasses.composition = renderGraph.addPass("Composition", [this](VkCommandBuffer cmdBuffer) {
+			drawSwapchainPass(cmdBuffer);
+		});
+		renderGraph.addSampledInput(graphPasses.composition, graphImages.position);
+		renderGraph.addSampledInput(graphPasses.composition, graphImages.normal);
+		renderGraph.addSampledInput(graphPasses.composition, graphImages.albedo);
+		renderGraph.setSideEffect(graphPasses.composition);
+
+		renderGraph.create(vulkanDevice);
 
 		// Create sampler to sample from the color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -378,8 +333,9 @@ public:
 	{
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 9)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 3);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -397,18 +353,48 @@ public:
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
 		};
+		if (clusteredAvailable) {
+			// Binding 5 : Cluster parameters
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5));
+			// Binding 6 : Lights
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6));
+			// Binding 7 : Cluster grid
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7));
+			// Binding 8 : Cluster light index list
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8));
+		}
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Sets per frame, just like the buffers themselves
 		// Image descriptors for the offscreen color attachments
-		VkDescriptorImageInfo descriptorPosition = vks::initializers::descriptorImageInfo(colorSampler, offScreenFrameBuf.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		VkDescriptorImageInfo descriptorNormal = vks::initializers::descriptorImageInfo(colorSampler, offScreenFrameBuf.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		VkDescriptorImageInfo descriptorAlbedo = vks::initializers::descriptorImageInfo(colorSampler, offScreenFrameBuf.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo descriptorPosition = vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView(graphImages.position), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo descriptorNormal = vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView(graphImages.normal), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo descriptorAlbedo = vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView(graphImages.albedo), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		// Images do not need to be duplicated per frame, we reuse the same one for each frame
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		for (auto i = 0; i < uniformBuffers.size(); i++) {
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+			// Lights and clusters, used by the composition and by the forward path for the scene
+			auto writeClusterDescriptors = [&](VkDescriptorSet descriptorSet) {
+				std::vector<VkWriteDescriptorSet> clusterWriteDescriptorSets = {
+					// Binding 4 : Fragment shader uniform buffer
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers[i].composition.descriptor),
+				};
+				if (clusteredAvailable) {
+					clusterWriteDescriptorSets.insert(clusterWriteDescriptorSets.end(), {
+						// Binding 5 : Cluster parameters
+						vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &clusteredLights.frames[i].params.descriptor),
+						// Binding 6 : Lights
+						vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &clusteredLights.frames[i].lights.descriptor),
+						// Binding 7 : Cluster grid
+						vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &clusteredLights.grid.descriptor),
+						// Binding 8 : Cluster light index list
+						vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &clusteredLights.indices.descriptor),
+					});
+				}
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(clusterWriteDescriptorSets.size()), clusterWriteDescriptorSets.data(), 0, nullptr);
+			};
 			// Deferred composition
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i].composition));
 			writeDescriptorSets = {
@@ -418,10 +404,9 @@ public:
 				vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &descriptorNormal),
 				// Binding 3 : Albedo texture target
 				vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &descriptorAlbedo),
-				// Binding 4 : Fragment shader uniform buffer
-				vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers[i].composition.descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			writeClusterDescriptors(descriptorSets[i].composition);
 
 			// Offscreen (scene)
 
@@ -436,6 +421,7 @@ public:
 				vks::initializers::writeDescriptorSet(descriptorSets[i].model, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.model.normalMap.descriptor)
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			writeClusterDescriptors(descriptorSets[i].model);
 
 			// Background
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i].floor));
@@ -448,6 +434,7 @@ public:
 				vks::initializers::writeDescriptorSet(descriptorSets[i].floor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.floor.normalMap.descriptor)
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			writeClusterDescriptors(descriptorSets[i].floor);
 		}
 	}
 
@@ -483,7 +470,7 @@ public:
 		// Final fullscreen composition pass pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferred/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (clusteredAvailable ? "deferred/deferred_clustered.frag.spv" : "deferred/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
@@ -493,12 +480,19 @@ public:
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent});
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 
+		// Forward pipeline, renders the scene to the swapchain with the G-Buffer pass' vertex shader
+		if (forwardAvailable) {
+			shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "deferred/forward.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.forward));
+		}
+
 		// Offscreen pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferred/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		// Separate render pass
-		pipelineCI.renderPass = offScreenFrameBuf.renderPass;
+		// Separate render pass created by the render graph
+		pipelineCI.renderPass = renderGraph.renderPass(graphPasses.gbuffer);
 
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
@@ -522,7 +516,7 @@ public:
 			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer.offscreen, sizeof(UniformDataOffscreen)));
 			VK_CHECK_RESULT(buffer.offscreen.map());
 			// Composition
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer.composition, sizeof(UniformDataComposition)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer.composition, clusteredAvailable ? sizeof(UniformDataComposition) : sizeof(UniformDataCompositionFixedLights)));
 			VK_CHECK_RESULT(buffer.composition.map());
 		}
 
@@ -544,65 +538,180 @@ public:
 	// Update lights and parameters passed to the composition shaders
 	void updateUniformBufferComposition()
 	{
+		std::array<vks::ClusteredLights::Light, 6> lights{};
+		// The original lights have a range covering the whole scene, color alpha is the intensity
 		// White
-		uniformDataComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uniformDataComposition.lights[0].color = glm::vec3(1.5f);
-		uniformDataComposition.lights[0].radius = 15.0f * 0.25f;
+		lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 20.0f);
+		lights[0].color = glm::vec4(glm::vec3(1.5f), 15.0f * 0.25f);
 		// Red
-		uniformDataComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uniformDataComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uniformDataComposition.lights[1].radius = 15.0f;
+		lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 20.0f);
+		lights[1].color = glm::vec4(1.0f, 0.0f, 0.0f, 15.0f);
 		// Blue
-		uniformDataComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uniformDataComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uniformDataComposition.lights[2].radius = 5.0f;
+		lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 20.0f);
+		lights[2].color = glm::vec4(0.0f, 0.0f, 2.5f, 5.0f);
 		// Yellow
-		uniformDataComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uniformDataComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uniformDataComposition.lights[3].radius = 2.0f;
+		lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 20.0f);
+		lights[3].color = glm::vec4(1.0f, 1.0f, 0.0f, 2.0f);
 		// Green
-		uniformDataComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uniformDataComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uniformDataComposition.lights[4].radius = 5.0f;
+		lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 20.0f);
+		lights[4].color = glm::vec4(0.0f, 1.0f, 0.2f, 5.0f);
 		// Yellow
-		uniformDataComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uniformDataComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uniformDataComposition.lights[5].radius = 25.0f;
+		lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 20.0f);
+		lights[5].color = glm::vec4(1.0f, 0.7f, 0.3f, 25.0f);
 
 		// Animate the lights
 		if (!paused) {
-			uniformDataComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-			uniformDataComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+			lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
+			lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
 
-			uniformDataComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-			uniformDataComposition.lights[1].position.z = 0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+			lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+			lights[1].position.z = 0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
 
-			uniformDataComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-			uniformDataComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+			lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
+			lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
 
-			uniformDataComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-			uniformDataComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
+			lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
+			lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
 
-			uniformDataComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-			uniformDataComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+			lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
+			lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
 		}
 
 		// Current view position
-		uniformDataComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+		const glm::vec4 viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+
+		if (!clusteredAvailable) {
+			// deferred.frag has no range, the intensity is used as the attenuation radius
+			for (size_t i = 0; i < lights.size(); i++) {
+				Light& light = uniformDataCompositionFixedLights.lights[i];
+				light.position = glm::vec4(glm::vec3(lights[i].position), 0.0f);
+				light.color = glm::vec3(lights[i].color);
+				light.radius = lights[i].color.w;
+			}
+			uniformDataCompositionFixedLights.viewPos = viewPos;
+			uniformDataCompositionFixedLights.debugDisplayTarget = debugDisplayTarget;
+			memcpy(uniformBuffers[currentBuffer].composition.mapped, &uniformDataCompositionFixedLights, sizeof(UniformDataCompositionFixedLights));
+			return;
+		}
 
+		vks::ClusteredLights::Light* clusterLights = clusteredLights.lights(currentBuffer);
+		std::copy(lights.begin(), lights.end(), clusterLights);
+		// Additional lights circle around their center
+		for (int32_t i = 6; i < lightCount; i++) {
+			const LightAnimation& animation = lightAnimations[i];
+			const float angle = glm::radians(animation.phase + animation.speed * timer);
+			clusterLights[i].position = glm::vec4(animation.center + glm::vec3(sin(angle), 0.0f, cos(angle)) * animation.orbitRadius, animation.range);
+			clusterLights[i].color = animation.color;
+		}
+		clusteredLights.update(currentBuffer, camera.matrices.view, camera.matrices.perspective, camera.getNearClip(), camera.getFarClip(), width, height, lightCount);
+
+		uniformDataComposition.viewPos = viewPos;
 		uniformDataComposition.debugDisplayTarget = debugDisplayTarget;
+		uniformDataComposition.clustered = (shadingMode != ShadingDeferred) ? 1 : 0;
 
 		memcpy(uniformBuffers[currentBuffer].composition.mapped, &uniformDataComposition, sizeof(UniformDataComposition));
 	}
 
+	// Create the light clusters and generate the animation of the additional lights
+	void prepareClusteredLights()
+	{
+		// The grid has 16x9x24 clusters, the index list is sized for an average of 256 lights per cluster
+		clusteredLights.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, maxLightCount, maxConcurrentFrames, { 16, 9, 24 }, 256);
+		clusteredLights.preparePipeline(loadShader(getShadersPath() + "base/clustercull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		lightAnimations.resize(maxLightCount);
+		for (auto& animation : lightAnimations) {
+			animation.center = glm::vec3(rndDist(rndEngine) * 30.0f - 15.0f, -0.1f - rndDist(rndEngine) * 1.5f, rndDist(rndEngine) * 30.0f - 15.0f);
+			animation.orbitRadius = 0.25f + rndDist(rndEngine);
+			animation.speed = (rndDist(rndEngine) * 2.0f - 1.0f) * 360.0f;
+			animation.phase = rndDist(rndEngine) * 360.0f;
+			animation.range = 0.5f + rndDist(rndEngine);
+			animation.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
+		}
+	}
+
+	void fetchStats()
+	{
+		if (clusteredAvailable) {
+			clusteredLights.fetchStats(currentBuffer);
+		}
+		if (frameShadingMode[currentBuffer] < 0) {
+			return;
+		}
+		ShadingStats& stats = shadingStats[frameShadingMode[currentBuffer]];
+		if (timestamps.fetch(currentBuffer)) {
+			stats.gbufferTime += timestamps.durations[ScopeGBuffer];
+			stats.shadingTime += timestamps.durations[ScopeShading];
+			if (frameShadingMode[currentBuffer] != ShadingDeferred) {
+				stats.cullTime += clusteredLights.stats.cullTime;
+			}
+		}
+		stats.frameTime += frameTimer * 1000.0;
+		stats.frameCount++;
+	}
+
+	// Compile a chain of passes on the CPU and check pass culling and memory aliasing against the expected result
+	// The first and the last image of the chain have disjoint lifetimes and must share memory, the unused pass must be culled
+	bool verifyRenderGraphAliasing()
+	{
+		vks::RenderGraph graph;
+		std::array<uint32_t, 4> images{};
+		for (uint32_t i = 0; i < images.size(); i++) {
+			images[i] = graph.addImage("image " + std::to_string(i), VK_FORMAT_R8G8B8A8_UNORM, 256, 256);
+		}
+		const uint32_t first = graph.addPass("first", [](VkCommandBuffer) {});
+		graph.addColorOutput(first, images[0]);
+		const uint32_t second = graph.addPass("second", [](VkCommandBuffer) {});
+		graph.addSampledInput(second, images[0]);
+		graph.addColorOutput(second, images[1]);
+		const uint32_t third = graph.addPass("third", [](VkCommandBuffer) {});
+		graph.addSampledInput(third, images[1]);
+		graph.addColorOutput(third, images[2]);
+		graph.setSideEffect(third);
+		const uint32_t unused = graph.addPass("unused", [](VkCommandBuffer) {});
+		graph.addColorOutput(unused, images[3]);
+		graph.compile();
+		const vks::RenderGraph::Stats& stats = graph.stats;
+		const VkDeviceSize imageSize = stats.unaliasedMemory / 3;
+		const bool valid = (stats.passCount == 3) && (stats.culledPassCount == 1) && (stats.unaliasedMemory == imageSize * 3) && (stats.aliasedMemory == imageSize * 2);
+		assert(valid);
+		return valid;
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		prepareOffscreenFramebuffer();
+		graphAliasingValid = verifyRenderGraphAliasing();
+		prepareRenderGraph();
+		clusteredAvailable = vks::tools::fileExists(getShadersPath() + "base/clustercull.comp.spv") && vks::tools::fileExists(getShadersPath() + "deferred/deferred_clustered.frag.spv");
+		forwardAvailable = clusteredAvailable && vks::tools::fileExists(getShadersPath() + "deferred/forward.frag.spv");
+		if (!clusteredAvailable) {
+			shadingMode = ShadingDeferred;
+			lightCount = 6;
+		} else if (!forwardAvailable && (shadingMode == ShadingForwardClustered)) {
+			shadingMode = ShadingDeferredClustered;
+		}
 		prepareUniformBuffers();
+		if (clusteredAvailable) {
+			prepareClusteredLights();
+		}
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2, maxConcurrentFrames);
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			benchmark.addMetric("render graph aliasing valid", [this]() { return graphAliasingValid ? 1.0 : 0.0; });
+			// Reported for the mode selected on the command line
+			if (clusteredAvailable) {
+				benchmark.addMetric("lights per cluster", [this]() { return clusteredLights.stats.averageLightsPerCluster; });
+			}
+			if (timestamps.supported) {
+				benchmark.addMetric("cluster cull ms (gpu)", [this]() { const ShadingStats& stats = shadingStats[shadingMode]; return stats.cullTime / std::max(stats.frameCount, 1u); });
+				benchmark.addMetric("shading ms (gpu)", [this]() { const ShadingStats& stats = shadingStats[shadingMode]; return stats.shadingTime / std::max(stats.frameCount, 1u); });
+			}
+		}
 		prepared = true;
 	}
 
@@ -614,74 +723,25 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
-		// First render pass : Offscreen pass to fill deferred attachments
-		{
-			// Clear values for all attachments written in the fragment shader
-			VkClearValue clearValues[4]{};
-			clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-			clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-			clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-			clearValues[3].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-			renderPassBeginInfo.renderPass = offScreenFrameBuf.renderPass;
-			renderPassBeginInfo.framebuffer = offScreenFrameBuf.frameBuffer;
-			renderPassBeginInfo.renderArea.extent.width = offScreenFrameBuf.width;
-			renderPassBeginInfo.renderArea.extent.height = offScreenFrameBuf.height;
-			renderPassBeginInfo.clearValueCount = 4;
-			renderPassBeginInfo.pClearValues = clearValues;
-
-			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-			VkRect2D scissor = vks::initializers::rect2D(offScreenFrameBuf.width, offScreenFrameBuf.height, 0, 0);
-			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-			// Floor
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].floor, 0, nullptr);
-			models.floor.draw(cmdBuffer);
-			// Render multiple instances of the model
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].model, 0, nullptr);
-			models.model.bindBuffers(cmdBuffer);
-			vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
-			vkCmdEndRenderPass(cmdBuffer);
+		timestamps.reset(cmdBuffer, currentBuffer);
+		frameShadingMode[currentBuffer] = shadingMode;
+		// Assign the lights to clusters before any of the shading passes reads them
+		if (shadingMode != ShadingDeferred) {
+			clusteredLights.cull(cmdBuffer, currentBuffer);
 		}
 
-		// Second render pass: Composition
-		// Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-
-		{
-			VkClearValue clearValues[2]{};
-			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.renderArea.offset.x = 0;
-			renderPassBeginInfo.renderArea.offset.y = 0;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-			renderPassBeginInfo.framebuffer = frameBuffers[currentImageIndex];
-
-			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer].composition, 0, nullptr);
-			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-			// Final composition
-			// This is done by simply drawing a full screen quad
-			// The fragment shader then combines the deferred attachments into the final image
-			// Note: Also used for debug display if debugDisplayTarget > 0
-			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
-			drawUI(cmdBuffer);
-			vkCmdEndRenderPass(cmdBuffer);
+		if (shadingMode == ShadingForwardClustered) {
+			// The forward path doesn't read the G-Buffer, so only the pass rendering to the swapchain is recorded
+			// The G-Buffer scope is kept empty, so its timestamps are still written
+			timestamps.begin(cmdBuffer, currentBuffer, ScopeGBuffer);
+			timestamps.end(cmdBuffer, currentBuffer, ScopeGBuffer);
+			drawSwapchainPass(cmdBuffer);
+		} else {
+			// The graph records the G-Buffer and composition passes
+			// Note: Synchronization between the passes, including the attachment layout transitions, is done by barriers derived by the graph
+			renderGraph.execute(cmdBuffer);
 		}
 
-
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
@@ -690,8 +750,16 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		fetchStats();
 		updateUniformBufferComposition();
 		updateUniformBufferOffscreen();
+		if (validateClusters && clusteredAvailable) {
+			// Validation overwrites the clusters, which may still be read by the other frame in flight
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+			validationResult = clusteredLights.validate(queue, currentBuffer);
+			validationDone = true;
+			validateClusters = false;
+		}
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
@@ -700,6 +768,60 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			overlay->comboBox("Display", &debugDisplayTarget, { "Final composition", "Position", "Normals", "Albedo", "Specular" });
+			// Modes are ordered by the shaders they need, so the unavailable ones are at the end of the list
+			std::vector<std::string> shadingModes = { "Deferred, all lights" };
+			if (clusteredAvailable) {
+				shadingModes.push_back("Deferred, clustered");
+			}
+			if (forwardAvailable) {
+				shadingModes.push_back("Forward, clustered");
+			}
+			overlay->comboBox("Shading", &shadingMode, shadingModes);
+			if (!clusteredAvailable) {
+				overlay->text("Clustered lights: not available (shaders not found)");
+			} else if (overlay->sliderInt("Lights", &lightCount, 6, maxLightCount)) {
+				// Averages are only comparable for the same number of lights
+				shadingStats = {};
+			}
+		}
+		if (clusteredAvailable && overlay->header("Clustered lights")) {
+			const vks::ClusteredLights::Stats& stats = clusteredLights.stats;
+			overlay->text("Grid: %dx%dx%d clusters", clusteredLights.gridSize.x, clusteredLights.gridSize.y, clusteredLights.gridSize.z);
+			if (shadingMode != ShadingDeferred) {
+				overlay->text("Active clusters: %d", stats.activeClusters);
+				overlay->text("Lights per cluster: %.1f avg, %d max", stats.averageLightsPerCluster, stats.maxLightsPerCluster);
+				overlay->text("Index list: %d of %d%s", stats.indexCount, clusteredLights.indexCapacity, stats.overflow ? " (overflow)" : "");
+			}
+			// Averages since start for each mode, so they can be compared after switching
+			const char* modeNames[3] = { "Deferred", "Deferred clustered", "Forward clustered" };
+			for (uint32_t i = 0; i < shadingStats.size(); i++) {
+				const ShadingStats& modeStats = shadingStats[i];
+				if (modeStats.frameCount == 0) {
+					continue;
+				}
+				overlay->text("%s: %.2f ms/frame", modeNames[i], modeStats.frameTime / modeStats.frameCount);
+				if (timestamps.supported) {
+					overlay->text("  cull %.3f, g-buffer %.3f, shading %.3f ms (gpu)", modeStats.cullTime / modeStats.frameCount, modeStats.gbufferTime / modeStats.frameCount, modeStats.shadingTime / modeStats.frameCount);
+				}
+			}
+			if (overlay->button("Validate against host reference")) {
+				validateClusters = true;
+			}
+			if (validationDone) {
+				overlay->text("Mismatched clusters: %d of %d", validationResult.mismatchedClusters, validationResult.clusterCount);
+				overlay->text("Borderline lights: %d", validationResult.borderlineLights);
+				if (validationResult.overflow) {
+					overlay->text("Light index list overflow");
+				}
+			}
+		}
+		if (overlay->header("Render graph")) {
+			const vks::RenderGraph::Stats& stats = renderGraph.stats;
+			overlay->text("Passes: %d (%d culled)", stats.passCount, stats.culledPassCount);
+			overlay->text("Barriers: %d in %d batches", stats.barrierCount, stats.barrierBatchCount);
+			overlay->text("Attachment memory: %.1f MB (%.1f MB unaliased)", (float)stats.aliasedMemory / (1024.0f * 1024.0f), (float)stats.unaliasedMemory / (1024.0f * 1024.0f));
+			overlay->text("Lazily allocated images: %d", stats.lazyImageCount);
+			overlay->text("Aliasing check: %s", graphAliasingValid ? "passed" : "failed");
 		}
 	}
 };
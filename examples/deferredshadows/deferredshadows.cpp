@@ -2,6 +2,7 @@
 * Vulkan Example - Deferred shading with shadows from multiple light sources using geometry shader instancing
 *
 * This sample adds dynamic shadows (using shadow maps) to a deferred rendering setup
+* Additional unshadowed point lights are assigned to clusters of a froxel grid, so the composition only evaluates the ones close to a fragment
 * 
 * Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
 *
@@ -11,6 +12,8 @@
 #include "vulkanexamplebase.h"
 #include "VulkanFrameBuffer.hpp"
 #include "VulkanglTFModel.h"
+#include "VulkanClusteredLights.hpp"
+#include "VulkanTimestampQuery.hpp"
 
 // Must match the LIGHT_COUNT define in the shadow and deferred shaders
 constexpr auto LIGHT_COUNT = 3;
@@ -77,6 +80,25 @@ public:
 		int32_t debugDisplayTarget = 0;
 	} uniformDataComposition;
 
+	// Unshadowed point lights, culled against the clusters of a froxel grid
+	vks::ClusteredLights clusteredLights;
+	// Point lights need the cluster culling and the clustered composition shaders
+	bool clusteredAvailable = false;
+	static constexpr uint32_t maxPointLightCount = 10000;
+	int32_t pointLightCount = 256;
+	struct PointLightAnimation {
+		glm::vec3 center;
+		float height;
+		float speed;
+		float phase;
+		float range;
+		glm::vec4 color;
+	};
+	std::vector<PointLightAnimation> pointLightAnimations;
+	// GPU time of the composition pass
+	vks::TimestampQuery timestamps;
+	float compositionTime{ 0.0f };
+
 	struct UniformBuffers {
 		vks::Buffer offscreen;
 		vks::Buffer composition;
@@ -121,6 +143,11 @@ public:
 		camera.setRotation(glm::vec3(-0.75f, 12.5f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, zNear, zFar);
 		timerSpeed *= 0.25f;
+		commandLineParser.add("pointlights", { "-pl", "--pointlights" }, 1, "Set the number of additional point lights (up to 10000)");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("pointlights")) {
+			pointLightCount = std::clamp(commandLineParser.getValueAsInt("pointlights", pointLightCount), 0, (int32_t)maxPointLightCount);
+		}
 	}
 
 	~VulkanExample()
@@ -134,6 +161,8 @@ public:
 			{
 				delete offscreenframeBuffers.shadow;
 			}
+			clusteredLights.destroy();
+			timestamps.destroy();
 			vkDestroyPipeline(device, pipelines.deferred, nullptr);
 			vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 			vkDestroyPipeline(device, pipelines.shadowpass, nullptr);
@@ -301,7 +330,8 @@ public:
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 16)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 16),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 3)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -321,6 +351,16 @@ public:
 			// Binding 5: Shadow map
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
 		};
+		if (clusteredAvailable) {
+			// Binding 6: Cluster parameters
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6));
+			// Binding 7: Point lights
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7));
+			// Binding 8: Cluster grid
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8));
+			// Binding 9: Cluster light index list
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 9));
+		}
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
@@ -348,6 +388,18 @@ public:
 				// Binding 5: Shadow map
 				vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &descriptorShadowMap),
 			};
+			if (clusteredAvailable) {
+				writeDescriptorSets.insert(writeDescriptorSets.end(), {
+					// Binding 6: Cluster parameters
+					vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6, &clusteredLights.frames[i].params.descriptor),
+					// Binding 7: Point lights
+					vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &clusteredLights.frames[i].lights.descriptor),
+					// Binding 8: Cluster grid
+					vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &clusteredLights.grid.descriptor),
+					// Binding 9: Cluster light index list
+					vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9, &clusteredLights.indices.descriptor),
+				});
+			}
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
 			// Offscreen (scene)
@@ -418,7 +470,7 @@ public:
 		// Final fullscreen composition pass pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (clusteredAvailable ? "deferredshadows/deferred_clustered.frag.spv" : "deferredshadows/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
@@ -540,6 +592,36 @@ public:
 		uniformDataComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
 		uniformDataComposition.debugDisplayTarget = debugDisplayTarget;
 		memcpy(uniformBuffers[currentBuffer].composition.mapped, &uniformDataComposition, sizeof(uniformDataComposition));
+
+		if (!clusteredAvailable) {
+			return;
+		}
+		// Point lights bob up and down at their position
+		vks::ClusteredLights::Light* pointLights = clusteredLights.lights(currentBuffer);
+		for (int32_t i = 0; i < pointLightCount; i++) {
+			const PointLightAnimation& animation = pointLightAnimations[i];
+			const float offset = sin(glm::radians(animation.phase + animation.speed * timer)) * animation.height;
+			pointLights[i].position = glm::vec4(animation.center + glm::vec3(0.0f, offset, 0.0f), animation.range);
+			pointLights[i].color = animation.color;
+		}
+		clusteredLights.update(currentBuffer, camera.matrices.view, camera.matrices.perspective, zNear, zFar, width, height, pointLightCount);
+	}
+
+	void preparePointLights()
+	{
+		clusteredLights.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, maxPointLightCount, maxConcurrentFrames);
+		clusteredLights.preparePipeline(loadShader(getShadersPath() + "base/clustercull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		pointLightAnimations.resize(maxPointLightCount);
+		for (auto& animation : pointLightAnimations) {
+			animation.center = glm::vec3(rndDist(rndEngine) * 24.0f - 12.0f, -0.5f - rndDist(rndEngine) * 2.5f, rndDist(rndEngine) * 24.0f - 12.0f);
+			animation.height = 0.1f + rndDist(rndEngine) * 0.4f;
+			animation.speed = 360.0f + rndDist(rndEngine) * 720.0f;
+			animation.phase = rndDist(rndEngine) * 360.0f;
+			animation.range = 0.75f + rndDist(rndEngine) * 1.25f;
+			animation.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 2.0f);
+		}
 	}
 
 	void updateUniformBufferOffscreen()
@@ -558,8 +640,24 @@ public:
 		shadowSetup();
 		initLights();
 		prepareUniformBuffers();
+		clusteredAvailable = vks::tools::fileExists(getShadersPath() + "base/clustercull.comp.spv") && vks::tools::fileExists(getShadersPath() + "deferredshadows/deferred_clustered.frag.spv");
+		if (clusteredAvailable) {
+			preparePointLights();
+		}
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 1, maxConcurrentFrames);
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			if (clusteredAvailable) {
+				benchmark.addMetric("lights per cluster", [this]() { return clusteredLights.stats.averageLightsPerCluster; });
+			}
+			if (timestamps.supported) {
+				if (clusteredAvailable) {
+					benchmark.addMetric("cluster cull ms (gpu)", [this]() { return clusteredLights.stats.cullTime; });
+				}
+				benchmark.addMetric("composition ms (gpu)", [this]() { return compositionTime; });
+			}
+		}
 		prepared = true;
 	}
 
@@ -571,6 +669,12 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+		timestamps.reset(cmdBuffer, currentBuffer);
+		// Assign the point lights to clusters, read by the composition
+		if (clusteredAvailable) {
+			clusteredLights.cull(cmdBuffer, currentBuffer);
+		}
+
 		// First render pass : Shadow map generation
 		{
 			std::array<VkClearValue, 1> clearValues{};
@@ -651,7 +755,9 @@ public:
 			// Final composition as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
 			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
+			timestamps.begin(cmdBuffer, currentBuffer, 0);
 			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+			timestamps.end(cmdBuffer, currentBuffer, 0);
 			drawUI(cmdBuffer);
 			vkCmdEndRenderPass(cmdBuffer);
 		}
@@ -664,6 +770,12 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		if (clusteredAvailable) {
+			clusteredLights.fetchStats(currentBuffer);
+		}
+		if (timestamps.fetch(currentBuffer)) {
+			compositionTime = timestamps.durations[0];
+		}
 		updateUniformBufferDeferred();
 		updateUniformBufferOffscreen();
 		buildCommandBuffer();
@@ -678,6 +790,21 @@ public:
 			if (overlay->checkBox("Shadows", &shadows)) {
 				uniformDataComposition.useShadows = shadows;
 			}
+			if (clusteredAvailable) {
+				overlay->sliderInt("Point lights", &pointLightCount, 0, maxPointLightCount);
+			} else {
+				overlay->text("Point lights: not available (shaders not found)");
+			}
+		}
+		if (clusteredAvailable && overlay->header("Clustered lights")) {
+			const vks::ClusteredLights::Stats& stats = clusteredLights.stats;
+			overlay->text("Grid: %dx%dx%d clusters", clusteredLights.gridSize.x, clusteredLights.gridSize.y, clusteredLights.gridSize.z);
+			overlay->text("Active clusters: %d", stats.activeClusters);
+			overlay->text("Lights per cluster: %.1f avg, %d max", stats.averageLightsPerCluster, stats.maxLightsPerCluster);
+			overlay->text("Index list: %d of %d%s", stats.indexCount, clusteredLights.indexCapacity, stats.overflow ? " (overflow)" : "");
+			if (timestamps.supported) {
+				overlay->text("Cull %.3f ms, composition %.3f ms (gpu)", stats.cullTime, compositionTime);
+			}
 		}
 	}
 };
@@ -14,11 +14,17 @@
 *
 * The used descriptor type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC then allows to set a dynamic
 * offset used to pass data from the single uniform buffer to the connected shader binding point.
+*
+* The per-object matrices are written directly into the persistently mapped buffer (see base/VulkanDynamicUniformBuffer.hpp),
+* only objects that changed are written and flushed.
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanDynamicUniformBuffer.hpp"
 
+// Default object count, can be changed with the -oc/--objectcount command line argument
 constexpr auto OBJECT_INSTANCES = 125;
+constexpr auto MAX_OBJECT_INSTANCES = 100000;
 
 // Vertex layout for this example
 struct Vertex {
@@ -26,30 +32,6 @@ struct Vertex {
 	float color[3];
 };
 
-// Wrapper functions for aligned memory allocation
-// There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this
-void* alignedAlloc(size_t size, size_t alignment)
-{
-	void *data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-	data = _aligned_malloc(size, alignment);
-#else
-	int res = posix_memalign(&data, alignment, size);
-	if (res != 0)
-		data = nullptr;
-#endif
-	return data;
-}
-
-void alignedFree(void* data)
-{
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-	_aligned_free(data);
-#else
-	free(data);
-#endif
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -59,7 +41,6 @@ public:
 
 	struct UniformBuffers {
 		vks::Buffer view;
-		vks::Buffer dynamic;
 	};
 	std::array<UniformBuffers, maxConcurrentFrames> uniformBuffers;
 
@@ -68,38 +49,50 @@ public:
 		glm::mat4 view;
 	} uboVS;
 
-	// Store random per-object rotations
-	glm::vec3 rotations[OBJECT_INSTANCES];
-	glm::vec3 rotationSpeeds[OBJECT_INSTANCES];
+	uint32_t objectCount{ OBJECT_INSTANCES };
 
-	// One big uniform buffer that contains all matrices
-	// Note that we need to manually allocate the data to cope for GPU-specific uniform buffer offset alignments
-	struct UboDataDynamic {
-		glm::mat4* model{ nullptr };
-	} uboDataDynamic;
+	// Store per-object positions and random rotations
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::vec3> rotationSpeeds;
+
+	// Percentage of objects that are animated, only those need to be written to the uniform buffer
+	int32_t animatedPercentage{ 100 };
+
+	// One big uniform buffer per frame that contains all matrices with the GPU-specific uniform buffer offset alignment
+	vks::DynamicUniformBuffer<glm::mat4> modelMatrices;
+
+	// Accumulated for benchmark output
+	VkDeviceSize totalBytesWritten{ 0 };
+	uint32_t updateCount{ 0 };
 
 	VkPipeline pipeline{ VK_NULL_HANDLE };
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
-	VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 
-	size_t dynamicAlignment{ 0 };
-
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Dynamic uniform buffers";
 		camera.type = Camera::CameraType::lookat;
-		camera.setPosition(glm::vec3(0.0f, 0.0f, -30.0f));
 		camera.setRotation(glm::vec3(0.0f));
-		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+
+		// Sample specific command line arguments
+		commandLineParser.add("objectcount", { "-oc", "--objectcount" }, 1, "Set the number of objects (up to 100k)");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("objectcount")) {
+			objectCount = std::clamp(commandLineParser.getValueAsInt("objectcount", OBJECT_INSTANCES), 1, MAX_OBJECT_INSTANCES);
+		}
+
+		// Move the camera back far enough for the whole grid of objects to be visible
+		const float gridExtent = std::ceil(std::cbrt((float)objectCount)) * 5.0f;
+		camera.setPosition(glm::vec3(0.0f, 0.0f, -std::max(30.0f, gridExtent * 1.25f)));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, std::max(256.0f, gridExtent * 3.0f));
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
-			if (uboDataDynamic.model) {
-				alignedFree(uboDataDynamic.model);
-			}
 			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -107,8 +100,8 @@ public:
 			indexBuffer.destroy();
 			for (auto& buffer : uniformBuffers) {
 				buffer.view.destroy();
-				buffer.dynamic.destroy();
 			}
+			modelMatrices.destroy();
 		}
 	}
 
@@ -172,16 +165,14 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Sets per frame, just like the buffers themselves
-		// Images do not need to be duplicated per frame, we reuse the same one for each frame
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		for (auto i = 0; i < uniformBuffers.size(); i++) {
-			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 				// Binding 0 : Projection/View matrix as uniform buffer
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[currentBuffer].view.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].view.descriptor),
 				// Binding 1 : Instance matrix as dynamic uniform buffer
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &uniformBuffers[currentBuffer].dynamic.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &modelMatrices.buffer(i).descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
@@ -239,24 +230,6 @@ public:
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Allocate data for the dynamic uniform buffer object
-		// We allocate this manually as the alignment of the offset differs between GPUs
-
-		// Calculate required alignment based on minimum device offset alignment
-		size_t minUboAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
-		dynamicAlignment = sizeof(glm::mat4);
-		if (minUboAlignment > 0) {
-			dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
-		}
-
-		size_t bufferSize = OBJECT_INSTANCES * dynamicAlignment;
-
-		uboDataDynamic.model = (glm::mat4*)alignedAlloc(bufferSize, dynamicAlignment);
-		assert(uboDataDynamic.model);
-
-		std::cout << "minUniformBufferOffsetAlignment = " << minUboAlignment << std::endl;
-		std::cout << "dynamicAlignment = " << dynamicAlignment << std::endl;
-
 		for (auto& buffer : uniformBuffers) {
 			// Static shared uniform buffer object with projection and view matrix
 			VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -264,26 +237,30 @@ public:
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				&buffer.view,
 				sizeof(uboVS)));
-
-			// Uniform buffer object with per-object matrices
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&buffer.dynamic,
-				bufferSize));
-
-			// Override descriptor range to [base, base + dynamicAlignment]
-			buffer.dynamic.descriptor.range = dynamicAlignment;
-
 			// Map persistent
 			VK_CHECK_RESULT(buffer.view.map());
-			VK_CHECK_RESULT(buffer.dynamic.map());
 		}
 
-		// Prepare per-object matrices with offsets and random rotations
+		// Uniform buffers with per-object matrices, aligned to the minimum device offset alignment
+		// The memory is not requested to be host coherent, so modified ranges are explicitly flushed
+		modelMatrices.create(vulkanDevice, objectCount, maxConcurrentFrames, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+		std::cout << "minUniformBufferOffsetAlignment = " << vulkanDevice->properties.limits.minUniformBufferOffsetAlignment << std::endl;
+		std::cout << "dynamicAlignment = " << modelMatrices.stride << std::endl;
+
+		// Prepare per-object positions on a grid and random rotations
+		const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt((float)objectCount)));
+		const glm::vec3 offset(5.0f);
+		positions.resize(objectCount);
+		rotations.resize(objectCount);
+		rotationSpeeds.resize(objectCount);
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
 		std::normal_distribution<float> rndDist(-1.0f, 1.0f);
-		for (uint32_t i = 0; i < OBJECT_INSTANCES; i++) {
+		for (uint32_t i = 0; i < objectCount; i++) {
+			const uint32_t x = i / (dim * dim);
+			const uint32_t y = (i / dim) % dim;
+			const uint32_t z = i % dim;
+			positions[i] = -(glm::vec3((float)dim) * offset) / 2.0f + offset / 2.0f + glm::vec3((float)x, (float)y, (float)z) * offset;
 			rotations[i] = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 2.0f * (float)M_PI;
 			rotationSpeeds[i] = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
 		}
@@ -299,35 +276,26 @@ public:
 
 	void updateDynamicUniformBuffer()
 	{
-		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
-		uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
-		glm::vec3 offset(5.0f);
-		for (uint32_t x = 0; x < dim; x++) {
-			for (uint32_t y = 0; y < dim; y++) {
-				for (uint32_t z = 0; z < dim; z++) {
-					const uint32_t index = x * dim * dim + y * dim + z;
-
-					// Aligned offset
-					glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
-
-					// Update rotations
-					rotations[index] += frameTimer * rotationSpeeds[index];
-
-					// Update matrices
-					glm::vec3 pos = glm::vec3(-((dim * offset.x) / 2.0f) + offset.x / 2.0f + x * offset.x, -((dim * offset.y) / 2.0f) + offset.y / 2.0f + y * offset.y, -((dim * offset.z) / 2.0f) + offset.z / 2.0f + z * offset.z);
-					*modelMat = glm::translate(glm::mat4(1.0f), pos);
-					*modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+		// Update rotations of the animated objects and mark them for being written
+		if (!paused) {
+			for (uint32_t i = 0; i < objectCount; i++) {
+				if ((int32_t)(i % 100) < animatedPercentage) {
+					rotations[i] += frameTimer * rotationSpeeds[i];
+					modelMatrices.markDirty(i);
 				}
 			}
 		}
-		memcpy(uniformBuffers[currentBuffer].dynamic.mapped, uboDataDynamic.model, uniformBuffers[currentBuffer].dynamic.size);
-		// Flush to make changes visible to the host
-		VkMappedMemoryRange memoryRange = vks::initializers::mappedMemoryRange();
-		memoryRange.memory = uniformBuffers[currentBuffer].dynamic.memory;
-		memoryRange.size = uniformBuffers[currentBuffer].dynamic.size;
-		vkFlushMappedMemoryRanges(device, 1, &memoryRange);
+		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
+		// Matrices are written straight into this frame's mapped buffer and only the modified ranges are flushed
+		modelMatrices.update(currentBuffer, [this](uint32_t index, glm::mat4& modelMat) {
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), positions[index]);
+			matrix = glm::rotate(matrix, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
+			matrix = glm::rotate(matrix, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
+			matrix = glm::rotate(matrix, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+			modelMat = matrix;
+		});
+		totalBytesWritten += modelMatrices.stats.bytesWritten;
+		updateCount++;
 	}
 
 	void prepare()
@@ -337,6 +305,9 @@ public:
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			benchmark.addMetric("ubo bytes/frame", [this]() { return (double)totalBytesWritten / std::max(updateCount, 1u); });
+		}
 		prepared = true;
 	}
 
@@ -377,11 +348,11 @@ public:
 		vkCmdBindIndexBuffer(cmdBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
 		// Render multiple objects using different model matrices by dynamically offsetting into one uniform buffer
-		for (uint32_t j = 0; j < OBJECT_INSTANCES; j++) {
+		for (uint32_t j = 0; j < objectCount; j++) {
 			// One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-			uint32_t dynamicOffset = j * static_cast<uint32_t>(dynamicAlignment);
+			uint32_t dynamicOffset = modelMatrices.dynamicOffset(j);
 			// Bind the descriptor set for rendering a mesh using the dynamic offset
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 1, &dynamicOffset);
 
 			vkCmdDrawIndexed(cmdBuffer, indexCount, 1, 0, 0, 0);
 		}
@@ -403,6 +374,20 @@ public:
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->sliderInt("Animated objects (%)", &animatedPercentage, 0, 100);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Objects: %d", objectCount);
+			overlay->text("Objects written: %d", modelMatrices.stats.objectsWritten);
+			overlay->text("Bytes written: %.1f KB", (float)modelMatrices.stats.bytesWritten / 1024.0f);
+			overlay->text("Bytes flushed: %.1f KB", (float)modelMatrices.stats.bytesFlushed / 1024.0f);
+			overlay->text("Flushed ranges: %d", modelMatrices.stats.flushCount);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
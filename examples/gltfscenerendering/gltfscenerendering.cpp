@@ -34,8 +34,8 @@ VulkanglTFScene::~VulkanglTFScene()
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
-	for (Material material : materials) {
-		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
+	for (VkPipeline pipeline : pipelines) {
+		vkDestroyPipeline(vulkanDevice->logicalDevice, pipeline, nullptr);
 	}
 }
 
@@ -252,6 +252,7 @@ void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 		}
 		// Pass the final matrix to the vertex shader using push constants
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
+		drawStats.drawList.pushConstants++;
 		for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
 			if (primitive.indexCount > 0) {
 				VulkanglTFScene::Material& material = materials[primitive.materialIndex];
@@ -259,6 +260,9 @@ void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
 				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
 				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+				drawStats.drawList.pipelineBinds++;
+				drawStats.drawList.descriptorSetBinds++;
+				drawStats.drawList.draws++;
 			}
 		}
 	}
@@ -267,6 +271,77 @@ void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 	}
 }
 
+// Add the primitives of a node and it's children to the flattened draw list
+void VulkanglTFScene::addNodeToDrawList(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, const glm::vec3& viewPos)
+{
+	if (!node->visible) {
+		return;
+	}
+	// World matrices are accumulated while walking down the tree, instead of walking up the parent chain for every node
+	const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+	if (node->mesh.primitives.size() > 0) {
+		// Nodes with identical world matrices (e.g. identity) share a matrix, so their primitives can be merged
+		uint32_t matrixIndex = 0;
+		while ((matrixIndex < drawMatrices.size()) && (drawMatrices[matrixIndex] != nodeMatrix)) {
+			matrixIndex++;
+		}
+		if (matrixIndex == drawMatrices.size()) {
+			drawMatrices.push_back(nodeMatrix);
+		}
+		drawStats.traversal.pushConstants++;
+		// Front to back ordering within a material, based on the distance of the node's origin to the viewer
+		const float distance = glm::length(glm::vec3(nodeMatrix[3]) - viewPos);
+		const uint64_t depth = std::min(static_cast<uint64_t>(distance * 256.0f), static_cast<uint64_t>(0xFFFFFF));
+		for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
+			if (primitive.indexCount > 0) {
+				const Material& material = materials[primitive.materialIndex];
+				DrawCommand drawCommand{};
+				drawCommand.sortKey = (static_cast<uint64_t>(material.pipelineIndex & 0xFF) << 56) | (static_cast<uint64_t>(primitive.materialIndex & 0xFFFF) << 40) | (depth << 16) | (matrixIndex & 0xFFFF);
+				drawCommand.firstIndex = primitive.firstIndex;
+				drawCommand.indexCount = primitive.indexCount;
+				drawCommand.materialIndex = primitive.materialIndex;
+				drawCommand.matrixIndex = matrixIndex;
+				drawList.push_back(drawCommand);
+				drawStats.traversal.pipelineBinds++;
+				drawStats.traversal.descriptorSetBinds++;
+				drawStats.traversal.draws++;
+			}
+		}
+	}
+	for (auto& child : node->children) {
+		addNodeToDrawList(child, nodeMatrix, viewPos);
+	}
+}
+
+// Flatten the visible part of the scene graph into a state sorted draw list
+// This only needs to be done if the scene changes (e.g. node visibility) or the viewer moved far enough to change the front to back order
+void VulkanglTFScene::buildDrawList(const glm::vec3& viewPos)
+{
+	drawList.clear();
+	drawMatrices.clear();
+	drawStats.traversal = {};
+	for (auto& node : nodes) {
+		addNodeToDrawList(node, glm::mat4(1.0f), viewPos);
+	}
+	std::stable_sort(drawList.begin(), drawList.end(), [](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+	// Merge consecutive draws that share material and matrix and have adjacent index ranges
+	std::vector<DrawCommand> merged;
+	merged.reserve(drawList.size());
+	for (const DrawCommand& drawCommand : drawList) {
+		if (!merged.empty()) {
+			DrawCommand& last = merged.back();
+			if ((last.materialIndex == drawCommand.materialIndex) && (last.matrixIndex == drawCommand.matrixIndex) && (last.firstIndex + last.indexCount == drawCommand.firstIndex)) {
+				last.indexCount += drawCommand.indexCount;
+				continue;
+			}
+		}
+		merged.push_back(drawCommand);
+	}
+	drawList = std::move(merged);
+	drawListViewPos = viewPos;
+	drawListDirty = false;
+}
+
 // Draw the glTF scene starting at the top-level-nodes
 void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
 {
@@ -274,9 +349,37 @@ void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 	VkDeviceSize offsets[1] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	// Render all nodes at top-level
-	for (auto& node : nodes) {
-		drawNode(commandBuffer, pipelineLayout, node);
+	drawStats.drawList = {};
+	if (!useDrawList) {
+		// Render all nodes at top-level
+		for (auto& node : nodes) {
+			drawNode(commandBuffer, pipelineLayout, node);
+		}
+		return;
+	}
+	// Walk the sorted draw list and only change state if it differs from the previous draw
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	int32_t boundMaterial = -1;
+	int32_t boundMatrix = -1;
+	for (const DrawCommand& drawCommand : drawList) {
+		const Material& material = materials[drawCommand.materialIndex];
+		if (material.pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+			boundPipeline = material.pipeline;
+			drawStats.drawList.pipelineBinds++;
+		}
+		if (static_cast<int32_t>(drawCommand.materialIndex) != boundMaterial) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+			boundMaterial = static_cast<int32_t>(drawCommand.materialIndex);
+			drawStats.drawList.descriptorSetBinds++;
+		}
+		if (static_cast<int32_t>(drawCommand.matrixIndex) != boundMatrix) {
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &drawMatrices[drawCommand.matrixIndex]);
+			boundMatrix = static_cast<int32_t>(drawCommand.matrixIndex);
+			drawStats.drawList.pushConstants++;
+		}
+		vkCmdDrawIndexed(commandBuffer, drawCommand.indexCount, 1, drawCommand.firstIndex, 0, 0);
+		drawStats.drawList.draws++;
 	}
 }
 
@@ -531,9 +634,26 @@ void VulkanExample::preparePipelines()
 	shaderStages[0] = loadShader(getShadersPath() + "gltfscenerendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "gltfscenerendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	// POI: Instead if using a few fixed pipelines, we create one pipeline for each material using the properties of that material
+	// POI: Instead if using a few fixed pipelines, we create one pipeline for each distinct set of material properties
+	struct PipelineState {
+		VkBool32 alphaMask;
+		float alphaMaskCutoff;
+		bool doubleSided;
+	};
+	std::vector<PipelineState> pipelineStates;
 	for (auto &material : glTFScene.materials) {
 
+		// Materials with identical pipeline state reuse an existing pipeline, which reduces the number of pipeline binds
+		const PipelineState pipelineState{ material.alphaMode == "MASK", material.alphaCutOff, material.doubleSided };
+		auto existing = std::find_if(pipelineStates.begin(), pipelineStates.end(), [&pipelineState](const PipelineState& state) {
+			return (state.alphaMask == pipelineState.alphaMask) && (!state.alphaMask || (state.alphaMaskCutoff == pipelineState.alphaMaskCutoff)) && (state.doubleSided == pipelineState.doubleSided);
+		});
+		if (existing != pipelineStates.end()) {
+			material.pipelineIndex = static_cast<uint32_t>(std::distance(pipelineStates.begin(), existing));
+			material.pipeline = glTFScene.pipelines[material.pipelineIndex];
+			continue;
+		}
+
 		struct MaterialSpecializationData {
 			VkBool32 alphaMask;
 			float alphaMaskCutoff;
@@ -554,6 +674,9 @@ void VulkanExample::preparePipelines()
 		rasterizationStateCI.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
+		material.pipelineIndex = static_cast<uint32_t>(glTFScene.pipelines.size());
+		glTFScene.pipelines.push_back(material.pipeline);
+		pipelineStates.push_back(pipelineState);
 	}
 }
 
@@ -624,6 +747,11 @@ void VulkanExample::render()
 {
 	VulkanExampleBase::prepareFrame();
 	updateUniformBuffers();
+	// The draw list is only rebuilt if the scene changed or the viewer moved far enough to affect the front to back order
+	const glm::vec3 viewPos = glm::vec3(camera.viewPos);
+	if (glTFScene.drawListDirty || (glm::length(viewPos - glTFScene.drawListViewPos) > 1.0f)) {
+		glTFScene.buildDrawList(viewPos);
+	}
 	buildCommandBuffer();
 	VulkanExampleBase::submitFrame();
 }
@@ -634,10 +762,12 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 
 		if (overlay->button("All")) {
 			std::for_each(glTFScene.nodes.begin(), glTFScene.nodes.end(), [](VulkanglTFScene::Node* node) { node->visible = true; });
+			glTFScene.drawListDirty = true;
 		}
 		ImGui::SameLine();
 		if (overlay->button("None")) {
 			std::for_each(glTFScene.nodes.begin(), glTFScene.nodes.end(), [](VulkanglTFScene::Node* node) { node->visible = false; });
+			glTFScene.drawListDirty = true;
 		}
 		ImGui::NewLine();
 
@@ -645,10 +775,22 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		ImGui::BeginChild("#nodelist", ImVec2(200.0f * overlay->scale, 340.0f * overlay->scale), false);
 		for (auto& node : glTFScene.nodes)
 		{		
-			overlay->checkBox(node->name.c_str(), &node->visible);
+			if (overlay->checkBox(node->name.c_str(), &node->visible)) {
+				glTFScene.drawListDirty = true;
+			}
 		}
 		ImGui::EndChild();
 	}
+	if (overlay->header("Draw list")) {
+		overlay->checkBox("Sorted draw list", &glTFScene.useDrawList);
+		const VulkanglTFScene::DrawStats& before = glTFScene.drawStats.traversal;
+		const VulkanglTFScene::DrawStats& after = glTFScene.drawStats.drawList;
+		overlay->text("Pipeline binds: %d / %d", before.pipelineBinds, after.pipelineBinds);
+		overlay->text("Descriptor binds: %d / %d", before.descriptorSetBinds, after.descriptorSetBinds);
+		overlay->text("Push constants: %d / %d", before.pushConstants, after.pushConstants);
+		overlay->text("Draws: %d / %d", before.draws, after.draws);
+		overlay->text("(node tree / recorded)");
+	}
 }
 
 VULKAN_EXAMPLE_MAIN()
@@ -97,6 +97,7 @@ public:
 		bool doubleSided = false;
 		VkDescriptorSet descriptorSet;
 		VkPipeline pipeline;
+		uint32_t pipelineIndex;
 	};
 
 	// Contains the texture for a single glTF image
@@ -118,6 +119,40 @@ public:
 	std::vector<Texture> textures;
 	std::vector<Material> materials;
 	std::vector<Node*> nodes;
+	// Materials with the same pipeline state share a pipeline
+	std::vector<VkPipeline> pipelines;
+
+	/*
+		Flattened draw list
+		Built once per scene change instead of walking the node tree for every command buffer
+		The sort key packs pipeline (bits 56..63), material (bits 40..55), view distance (bits 16..39) and node matrix (bits 0..15)
+	*/
+	struct DrawCommand {
+		uint64_t sortKey;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t materialIndex;
+		uint32_t matrixIndex;
+	};
+	std::vector<DrawCommand> drawList;
+	// Pre-computed world space matrices of all visible nodes, nodes with identical matrices share an entry
+	std::vector<glm::mat4> drawMatrices;
+	glm::vec3 drawListViewPos{ 0.0f };
+	bool drawListDirty{ true };
+	bool useDrawList{ true };
+
+	// Number of state changes and draws recorded in the last command buffer
+	struct DrawStats {
+		uint32_t pipelineBinds;
+		uint32_t descriptorSetBinds;
+		uint32_t pushConstants;
+		uint32_t draws;
+	};
+	// Traversal contains the numbers walking the node tree records, drawList contains the numbers actually recorded
+	struct {
+		DrawStats traversal;
+		DrawStats drawList;
+	} drawStats{};
 
 	std::string path;
 
@@ -128,6 +163,8 @@ public:
 	void loadMaterials(tinygltf::Model& input);
 	void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
 	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node);
+	void addNodeToDrawList(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, const glm::vec3& viewPos);
+	void buildDrawList(const glm::vec3& viewPos);
 	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 };
 
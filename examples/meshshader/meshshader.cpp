@@ -1,24 +1,62 @@
 /*
  * Vulkan Example - Basic sample for using mesh and task shader to replace the traditional vertex pipeline
  *
+ * The glTF scene is split into meshlets on the CPU (see base/meshlet.hpp)
+ * A task shader culls the meshlets against the view frustum and their normal cones, a mesh shader then emits the triangles of the visible meshlets
+ * If the meshlet shaders are not available (e.g. for shading languages they have not been ported to), the basic mesh shader triangles are drawn instead
+ *
  * Copyright (C) 2022-2025 by Sascha Willems - www.saschawillems.de
  *
  * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
  */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "meshlet.hpp"
+#include "frustum.hpp"
+
+// Number of meshlets culled by each task shader workgroup, must match the task shader
+#define MESHLETS_PER_TASK 32
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	vkglTF::Model scene;
+	vks::meshlet::Builder meshletBuilder;
+	vks::Frustum frustum;
+	// Result of the CPU side consistency check of the built meshlets
+	bool meshletsValid{ false };
+	// The meshlet task and mesh shaders are optional, without them the sample falls back to the basic mesh shaders
+	bool meshletShadersAvailable{ false };
+
 	struct UniformData {
 		glm::mat4 projection;
 		glm::mat4 model;
 		glm::mat4 view;
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPos;
+		uint32_t meshletCount{ 0 };
+		int32_t frustumCulling{ true };
+		int32_t coneCulling{ true };
 	} uniformData;
 	std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
 
-	uint32_t indexCount{ 0 };
+	// Number of meshlets that passed culling, written by the task shader
+	std::array<vks::Buffer, maxConcurrentFrames> statisticsBuffers;
+	uint32_t visibleMeshlets{ 0 };
+
+	// Vertex and meshlet data read by the task and mesh shaders
+	struct ShaderVertex {
+		glm::vec4 position;
+		glm::vec4 normal;
+	};
+	struct {
+		vks::Buffer vertices;
+		vks::Buffer meshlets;
+		vks::Buffer meshletVertices;
+		vks::Buffer meshletTriangles;
+		vks::Buffer meshletBounds;
+	} storageBuffers;
 
 	VkPipeline pipeline{ VK_NULL_HANDLE };
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
@@ -32,11 +70,13 @@ public:
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Mesh shaders";
-		timerSpeed *= 0.25f;
-		camera.type = Camera::CameraType::lookat;
-		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
-		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
-		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
+		camera.type = Camera::CameraType::firstperson;
+#ifndef __ANDROID__
+		camera.rotationSpeed = 0.25f;
+#endif
+		camera.position = { 1.0f, 0.75f, 0.0f };
+		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 64.0f);
 
 		// The mesh shader extension requires at least Vulkan Core 1.1
 		apiVersion = VK_API_VERSION_1_1;
@@ -66,21 +106,87 @@ public:
 			for (auto& buffer : uniformBuffers) {
 				buffer.destroy();
 			}
+			for (auto& buffer : statisticsBuffers) {
+				buffer.destroy();
+			}
+			storageBuffers.vertices.destroy();
+			storageBuffers.meshlets.destroy();
+			storageBuffers.meshletVertices.destroy();
+			storageBuffers.meshletTriangles.destroy();
+			storageBuffers.meshletBounds.destroy();
 		}
 	}
 
+	// Upload data to a device local storage buffer
+	void createStorageBuffer(vks::Buffer& buffer, void* data, VkDeviceSize size)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, data));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+		vulkanDevice->copyBuffer(&stagingBuffer, &buffer, queue);
+		stagingBuffer.destroy();
+	}
+
+	void loadAssets()
+	{
+		// The meshlet builder works on the host copies of the vertex and index data
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::KeepHostData;
+		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		std::vector<glm::vec3> positions(scene.vertexData.size());
+		std::vector<glm::vec3> normals(scene.vertexData.size());
+		std::vector<ShaderVertex> shaderVertices(scene.vertexData.size());
+		for (size_t i = 0; i < scene.vertexData.size(); i++) {
+			positions[i] = scene.vertexData[i].pos;
+			normals[i] = scene.vertexData[i].normal;
+			shaderVertices[i] = { glm::vec4(scene.vertexData[i].pos, 1.0f), glm::vec4(scene.vertexData[i].normal, 0.0f) };
+		}
+
+		// Split all primitives into meshlets
+		// Alpha masked primitives (foliage) are usually visible from both sides, so they're excluded from back facing cone culling
+		for (vkglTF::Node* node : scene.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				const bool allowConeCulling = primitive->material.alphaMode == vkglTF::Material::ALPHAMODE_OPAQUE;
+				meshletBuilder.build(positions, &normals, scene.indexData.data() + primitive->firstIndex, primitive->indexCount, allowConeCulling);
+			}
+		}
+		meshletsValid = meshletBuilder.validate();
+		const vks::meshlet::BuildStats& stats = meshletBuilder.stats;
+
+		createStorageBuffer(storageBuffers.vertices, shaderVertices.data(), shaderVertices.size() * sizeof(ShaderVertex));
+		createStorageBuffer(storageBuffers.meshlets, meshletBuilder.meshlets.data(), meshletBuilder.meshlets.size() * sizeof(vks::meshlet::Meshlet));
+		createStorageBuffer(storageBuffers.meshletVertices, meshletBuilder.vertices.data(), meshletBuilder.vertices.size() * sizeof(uint32_t));
+		createStorageBuffer(storageBuffers.meshletTriangles, meshletBuilder.triangles.data(), meshletBuilder.triangles.size() * sizeof(uint32_t));
+		createStorageBuffer(storageBuffers.meshletBounds, meshletBuilder.bounds.data(), meshletBuilder.bounds.size() * sizeof(vks::meshlet::Bounds));
+		uniformData.meshletCount = stats.meshletCount;
+
+		// The host copies are no longer required
+		scene.vertexData.clear();
+		scene.indexData.clear();
+	}
+
 	void setupDescriptors()
 	{
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 6),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), maxConcurrentFrames);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT, 6),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayout));
@@ -91,6 +197,12 @@ public:
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.vertices.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.meshlets.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.meshletVertices.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &storageBuffers.meshletTriangles.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.meshletBounds.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &statisticsBuffers[i].descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
@@ -104,7 +216,7 @@ public:
 
 		// Pipeline
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
@@ -130,10 +242,15 @@ public:
 		pipelineCI.pVertexInputState = nullptr;
 
 		// Instead of a vertex shader, we use a mesh and task shader
-		shaderStages[0] = loadShader(getShadersPath() + "meshshader/meshshader.mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT);
-		shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshshader.task.spv", VK_SHADER_STAGE_TASK_BIT_EXT);
+		// The basic mesh shaders only read the matrices at the start of the uniform block and emit unculled triangles with arbitrary winding
+		const std::string shaderName = meshletShadersAvailable ? "meshlet" : "meshshader";
+		if (!meshletShadersAvailable) {
+			rasterizationState.cullMode = VK_CULL_MODE_NONE;
+		}
+		shaderStages[0] = loadShader(getShadersPath() + "meshshader/" + shaderName + ".mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT);
+		shaderStages[1] = loadShader(getShadersPath() + "meshshader/" + shaderName + ".task.spv", VK_SHADER_STAGE_TASK_BIT_EXT);
 
-		shaderStages[2] = loadShader(getShadersPath() + "meshshader/meshshader.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[2] = loadShader(getShadersPath() + "meshshader/" + shaderName + ".frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 	}
 
@@ -144,6 +261,12 @@ public:
 			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(UniformData), &uniformData));
 			VK_CHECK_RESULT(buffer.map());
 		}
+		// The statistics are read on the host once the frame's fence has been signaled
+		for (auto& buffer : statisticsBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(uint32_t)));
+			VK_CHECK_RESULT(buffer.map());
+			memset(buffer.mapped, 0, sizeof(uint32_t));
+		}
 	}
 
 	void updateUniformBuffers()
@@ -151,6 +274,12 @@ public:
 		uniformData.projection = camera.matrices.perspective;
 		uniformData.view = camera.matrices.view;
 		uniformData.model = glm::mat4(1.0f);
+		// Meshlets are culled in world space (vertices are pre-transformed)
+		frustum.update(uniformData.projection * uniformData.view);
+		for (uint32_t i = 0; i < 6; i++) {
+			uniformData.frustumPlanes[i] = frustum.planes[i];
+		}
+		uniformData.cameraPos = glm::inverse(uniformData.view)[3];
 		memcpy(uniformBuffers[currentBuffer].mapped, &uniformData, sizeof(UniformData));
 	}
 
@@ -161,16 +290,25 @@ public:
 		// Get the function pointer of the mesh shader drawing funtion
 		vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
 
+		const std::array<std::string, 3> meshletShaders = { "meshlet.mesh", "meshlet.task", "meshlet.frag" };
+		meshletShadersAvailable = std::all_of(meshletShaders.begin(), meshletShaders.end(), [this](const std::string& name) { return vks::tools::fileExists(getShadersPath() + "meshshader/" + name + ".spv"); });
+
+		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			benchmark.addMetric("meshlet build ms (cpu)", [this]() { return meshletBuilder.stats.buildTime; });
+			benchmark.addMetric("meshlets valid", [this]() { return meshletsValid ? 1.0 : 0.0; });
+			benchmark.addMetric("vertex reuse", [this]() { return static_cast<double>(meshletBuilder.stats.vertexReuse()); });
+		}
 		prepared = true;
 	}
 
 	void buildCommandBuffer()
 	{
 		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
-		
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -189,6 +327,13 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+		// Reset the visible meshlet counter
+		vkCmdFillBuffer(cmdBuffer, statisticsBuffers[currentBuffer].buffer, 0, sizeof(uint32_t), 0);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
 		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -201,13 +346,22 @@ public:
 
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-		// Use mesh and task shader to draw the scene
-		vkCmdDrawMeshTasksEXT(cmdBuffer, 1, 1, 1);
+		if (meshletShadersAvailable) {
+			// Each task shader workgroup culls a batch of meshlets and launches one mesh shader workgroup per visible meshlet
+			vkCmdDrawMeshTasksEXT(cmdBuffer, (uniformData.meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK, 1, 1);
+		} else {
+			vkCmdDrawMeshTasksEXT(cmdBuffer, 1, 1, 1);
+		}
 
 		drawUI(cmdBuffer);
 
 		vkCmdEndRenderPass(cmdBuffer);
 
+		// Make the visible meshlet count available to the host
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
@@ -216,10 +370,37 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		visibleMeshlets = *static_cast<uint32_t*>(statisticsBuffers[currentBuffer].mapped);
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (meshletShadersAvailable) {
+				overlay->checkBox("Frustum culling", &uniformData.frustumCulling);
+				overlay->checkBox("Normal cone culling", &uniformData.coneCulling);
+			} else {
+				overlay->text("Meshlet shaders not found, drawing with the basic mesh shaders");
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const vks::meshlet::BuildStats& stats = meshletBuilder.stats;
+			overlay->text("Meshlets: %d", stats.meshletCount);
+			overlay->text("Validation: %s", meshletsValid ? "passed" : "failed");
+			if (meshletShadersAvailable) {
+				overlay->text("Visible meshlets: %d", visibleMeshlets);
+			}
+			overlay->text("Triangles: %d", stats.triangleCount);
+			overlay->text("Avg. vertices: %.1f", stats.averageVertices());
+			overlay->text("Avg. triangles: %.1f", stats.averageTriangles());
+			overlay->text("Vertex reuse: %.2f", stats.vertexReuse());
+			overlay->text("Cone cullable: %d", stats.coneCullableCount);
+			overlay->text("Build time: %.2f ms", stats.buildTime);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
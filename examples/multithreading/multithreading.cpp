@@ -10,6 +10,8 @@
 
 #include "threadpool.hpp"
 #include "frustum.hpp"
+#include "VulkanHiZ.hpp"
+#include "VulkanTimestampQuery.hpp"
 
 #include "VulkanglTFModel.h"
 
@@ -67,6 +69,7 @@ public:
 		float deltaT;
 		float stateT = 0;
 		bool visible = true;
+		bool occluded = false;
 	};
 
 	struct ThreadData {
@@ -85,6 +88,48 @@ public:
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
+	// Occlusion culling: all objects are tested against the depth pyramid of a frame on the GPU
+	// The results are read back once the frame's fence has been signaled and skip recording occluded objects in the next frame using the same resources
+	vks::HiZPyramid hiz;
+	bool occlusionCulling{ false };
+	// The pyramid reduction and the culling shader are not part of every shader pack, occlusion culling is only offered if their SPIR-V is present
+	bool occlusionAvailable{ false };
+	struct OcclusionCulling {
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		// Bounding spheres (xyz = center, w = radius) written by the recording threads
+		std::array<vks::Buffer, maxConcurrentFrames> boundsBuffers;
+		// One visibility flag per object written by the culling shader
+		std::array<vks::Buffer, maxConcurrentFrames> visibilityBuffers;
+		std::array<bool, maxConcurrentFrames> resultsValid{};
+	} occlusion;
+	struct OcclusionPushConstants {
+		glm::mat4 viewProjection;
+		glm::vec2 depthSize;
+		uint32_t objectCount;
+	};
+
+	// Draw counts of the last recorded frame
+	uint32_t drawCount{ 0 };
+	uint32_t occludedCount{ 0 };
+
+	// GPU times of the scene pass and the occlusion pass (pyramid build and test), accumulated separately with and without occlusion culling
+	vks::TimestampQuery timestamps;
+	enum TimestampScope { ScopeScene = 0, ScopeOcclusion = 1 };
+	// Mode each frame in flight was recorded with, -1 if it hasn't been recorded yet
+	std::array<int32_t, maxConcurrentFrames> frameOcclusion{};
+	struct CullStats {
+		double sceneTime{ 0.0 };
+		double occlusionTime{ 0.0 };
+		double recordTime{ 0.0 };
+		double frameTime{ 0.0 };
+		double drawCount{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::array<CullStats, 2> cullStats{};
+
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase()
@@ -106,6 +151,14 @@ public:
 		threadPool.setThreadCount(numThreads);
 		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		// Subgroup operations for the depth pyramid reduction are core with Vulkan 1.1
+		apiVersion = VK_API_VERSION_1_1;
+		// The depth pyramid is built from the default depth attachment
+		depthStencil.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		commandLineParser.add("occlusion", { "-oc", "--occlusion" }, 0, "Skip recording objects that were occluded in the depth pyramid of an earlier frame");
+		commandLineParser.parse(args);
+		occlusionCulling = commandLineParser.isSet("occlusion");
+		frameOcclusion.fill(-1);
 	}
 
 	~VulkanExample()
@@ -120,6 +173,17 @@ public:
 				}
 				vkDestroyCommandPool(device, thread.commandPool, nullptr);
 			}
+			vkDestroyPipeline(device, occlusion.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, occlusion.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, occlusion.descriptorSetLayout, nullptr);
+			for (auto& buffer : occlusion.boundsBuffers) {
+				buffer.destroy();
+			}
+			for (auto& buffer : occlusion.visibilityBuffers) {
+				buffer.destroy();
+			}
+			hiz.destroy();
+			timestamps.destroy();
 		}
 	}
 
@@ -181,10 +245,20 @@ public:
 	{
 		ThreadData *thread = &threadData[threadIndex];
 		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		const uint32_t objectIndex = threadIndex * numObjectsPerThread + cmdBufferIndex;
+
+		// Bounds for this frame's occlusion test, written for all objects as the test also has to find the ones that become visible again
+		if (occlusionCulling) {
+			static_cast<glm::vec4*>(occlusion.boundsBuffers[currentBuffer].mapped)[objectIndex] = glm::vec4(objectData->pos, models.ufo.dimensions.radius * objectData->scale);
+		}
 
 		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
 		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
 
+		// Result of the occlusion test from the last frame that used this frame's resources
+		objectData->occluded = objectData->visible && occlusionCulling && occlusion.resultsValid[currentBuffer] && (static_cast<uint32_t*>(occlusion.visibilityBuffers[currentBuffer].mapped)[objectIndex] == 0);
+		objectData->visible = objectData->visible && !objectData->occluded;
+
 		if (!objectData->visible)
 		{
 			return;
@@ -355,6 +429,85 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.starsphere));
 	}
 
+	// The culling shader reads the bounds written on the host and writes visibility flags that are read back on the host
+	void prepareOcclusionCulling()
+	{
+		hiz.create(vulkanDevice, queue);
+		hiz.preparePipeline(loadShader(getShadersPath() + vks::HiZPyramid::shaderFile(vulkanDevice), VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		hiz.setDepthSource(queue, depthStencil.image, depthFormat, width, height);
+
+		const uint32_t objectCount = numThreads * numObjectsPerThread;
+		for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &occlusion.boundsBuffers[i], objectCount * sizeof(glm::vec4)));
+			VK_CHECK_RESULT(occlusion.boundsBuffers[i].map());
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &occlusion.visibilityBuffers[i], objectCount * sizeof(uint32_t)));
+			VK_CHECK_RESULT(occlusion.visibilityBuffers[i].map());
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 2)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Max depth pyramid
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Object bounds
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Visibility flags
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &occlusion.descriptorSetLayout));
+
+		VkDescriptorImageInfo hizDescriptor = hiz.maxDescriptor();
+		for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &occlusion.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &occlusion.descriptorSets[i]));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &hizDescriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &occlusion.boundsBuffers[i].descriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &occlusion.visibilityBuffers[i].descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(OcclusionPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&occlusion.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &occlusion.pipelineLayout));
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(occlusion.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "multithreading/occlusion.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &occlusion.pipeline));
+	}
+
+	// Builds the depth pyramid from this frame's depth and tests the bounds of all objects against it
+	void recordOcclusionCulling(VkCommandBuffer cmdBuffer)
+	{
+		hiz.build(cmdBuffer, matrices.projection * matrices.view);
+
+		const uint32_t objectCount = numThreads * numObjectsPerThread;
+		OcclusionPushConstants pushConstants{
+			.viewProjection = hiz.viewProjection,
+			.depthSize = glm::vec2(static_cast<float>(hiz.depthWidth), static_cast<float>(hiz.depthHeight)),
+			.objectCount = objectCount
+		};
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pipelineLayout, 0, 1, &occlusion.descriptorSets[currentBuffer], 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, occlusion.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionPushConstants), &pushConstants);
+		vkCmdDispatch(cmdBuffer, (objectCount + 63) / 64, 1, 1);
+
+		// Make the visibility flags available to the host once the frame's fence has been signaled
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		occlusion.resultsValid[currentBuffer] = true;
+	}
+
 	void updateMatrices()
 	{
 		matrices.projection = camera.matrices.perspective;
@@ -368,10 +521,38 @@ public:
 		loadAssets();
 		preparePipelines();
 		prepareMultiThreadedRenderer();
+		occlusionAvailable = vks::tools::fileExists(getShadersPath() + vks::HiZPyramid::shaderFile(vulkanDevice)) && vks::tools::fileExists(getShadersPath() + "multithreading/occlusion.comp.spv");
+		if (occlusionAvailable) {
+			prepareOcclusionCulling();
+		} else {
+			occlusionCulling = false;
+		}
 		updateMatrices();
+		timestamps.create(vulkanDevice, swapChain.queueNodeIndex, 2, maxConcurrentFrames);
+		if (benchmark.active) {
+			// Reported for the mode selected on the command line
+			benchmark.addMetric("visible objects", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.drawCount / std::max(stats.frameCount, 1u); });
+			benchmark.addMetric("command buffer recording ms (cpu)", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.recordTime / std::max(stats.frameCount, 1u); });
+			if (timestamps.supported) {
+				benchmark.addMetric("scene ms (gpu)", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.sceneTime / std::max(stats.frameCount, 1u); });
+				benchmark.addMetric("occlusion ms (gpu)", [this]() { const CullStats& stats = cullStats[occlusionCulling ? 1 : 0]; return stats.occlusionTime / std::max(stats.frameCount, 1u); });
+			}
+		}
 		prepared = true;
 	}
 
+	void fetchStats()
+	{
+		if (frameOcclusion[currentBuffer] < 0) {
+			return;
+		}
+		CullStats& stats = cullStats[frameOcclusion[currentBuffer]];
+		if (timestamps.fetch(currentBuffer)) {
+			stats.sceneTime += timestamps.durations[ScopeScene];
+			stats.occlusionTime += timestamps.durations[ScopeOcclusion];
+		}
+	}
+
 	// Updates the secondary command buffers using a thread pool
 	// and puts them into the primary command buffer that's
 	// lat submitted to the queue for rendering
@@ -400,6 +581,10 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[currentBuffer], &cmdBufInfo));
 
+		timestamps.reset(cmdBuffer, currentBuffer);
+		frameOcclusion[currentBuffer] = occlusionCulling ? 1 : 0;
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeScene);
+
 		// The primary command buffer does not contain any rendering commands
 		// These are stored (and retrieved) from the secondary command buffers
 		vkCmdBeginRenderPass(drawCmdBuffers[currentBuffer], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
@@ -426,11 +611,17 @@ public:
 
 		threadPool.wait();
 
-		// Only submit if object is within the current view frustum
+		// Only submit if object is within the current view frustum and not occluded
+		drawCount = 0;
+		occludedCount = 0;
 		for (uint32_t t = 0; t < numThreads; t++) {
 			for (uint32_t i = 0; i < numObjectsPerThread; i++) {
 				if (threadData[t].objectData[i].visible) {
 					commandBuffers.push_back(threadData[t].commandBuffer[currentBuffer][i]);
+					drawCount++;
+				}
+				if (threadData[t].objectData[i].occluded) {
+					occludedCount++;
 				}
 			}
 		}
@@ -445,6 +636,14 @@ public:
 
 		vkCmdEndRenderPass(drawCmdBuffers[currentBuffer]);
 
+		timestamps.end(cmdBuffer, currentBuffer, ScopeScene);
+
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeOcclusion);
+		if (occlusionCulling) {
+			recordOcclusionCulling(cmdBuffer);
+		}
+		timestamps.end(cmdBuffer, currentBuffer, ScopeOcclusion, occlusionCulling ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[currentBuffer]));
 	}
 
@@ -454,18 +653,64 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		fetchStats();
+		auto tStart = std::chrono::high_resolution_clock::now();
 		updateCommandBuffer();
+		CullStats& stats = cullStats[occlusionCulling ? 1 : 0];
+		stats.recordTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		stats.drawCount += drawCount;
+		stats.frameTime += frameTimer * 1000.0;
+		stats.frameCount++;
 		updateMatrices();
 		VulkanExampleBase::submitFrame();
 	}
 
+	virtual void windowResized()
+	{
+		if (!occlusionAvailable) {
+			return;
+		}
+		// The depth attachment has been recreated with the new size
+		hiz.setDepthSource(queue, depthStencil.image, depthFormat, width, height);
+		VkDescriptorImageInfo hizDescriptor = hiz.maxDescriptor();
+		for (auto& descriptorSet : occlusion.descriptorSets) {
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &hizDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+		occlusion.resultsValid.fill(false);
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Draws: %d", drawCount);
+			overlay->text("Occluded: %d", occludedCount);
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			if (!occlusionAvailable) {
+				overlay->text("Occlusion culling: not available (shaders not found)");
+			} else if (overlay->checkBox("Occlusion culling", &occlusionCulling)) {
+				// Results from before occlusion culling was disabled don't match the current bounds
+				occlusion.resultsValid.fill(false);
+			}
+		}
+		if (occlusionAvailable && overlay->header("Occlusion culling")) {
+			overlay->text("Depth pyramid: %dx%d, %d levels", hiz.width, hiz.height, hiz.levelCount);
+			overlay->text("Reduction: %s", hiz.subgroupReduction ? "subgroup quads" : "shared memory");
+			// Averages since start for each mode, so both can be compared after toggling
+			const char* modeNames[2] = { "Frustum", "Frustum + occlusion" };
+			for (uint32_t i = 0; i < cullStats.size(); i++) {
+				const CullStats& stats = cullStats[i];
+				if (stats.frameCount == 0) {
+					continue;
+				}
+				overlay->text("%s: %.0f draws, recording %.3f ms, %.2f ms/frame", modeNames[i], stats.drawCount / stats.frameCount, stats.recordTime / stats.frameCount, stats.frameTime / stats.frameCount);
+				if (timestamps.supported) {
+					overlay->text("  scene %.3f ms, occlusion %.3f ms (gpu)", stats.sceneTime / stats.frameCount, stats.occlusionTime / stats.frameCount);
+				}
+			}
 		}
 
 	}
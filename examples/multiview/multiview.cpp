@@ -2,6 +2,8 @@
 * Vulkan Example - Multiview (VK_KHR_multiview)
 *
 * Uses VK_KHR_multiview for simultaneously rendering to multiple views and displays these with barrel distortion using a fragment shader
+* The scene is culled once against a volume enclosing both views and recorded once (vks::MultiviewRenderer)
+* For comparison the views can also be rendered in separate passes, with culling and command recording done for each view
 *
 * Copyright (C) 2018-2025 by Sascha Willems - www.saschawillems.de
 *
@@ -10,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMultiviewRenderer.hpp"
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -24,8 +27,28 @@ public:
 		VkRenderPass renderPass{ VK_NULL_HANDLE };
 		VkDescriptorImageInfo descriptor{ VK_NULL_HANDLE };
 		VkSampler sampler{ VK_NULL_HANDLE };
+		// Used when rendering the views in separate passes, one non-multiview framebuffer per layer
+		VkRenderPass separateRenderPass{ VK_NULL_HANDLE };
+		std::array<VkImageView, 2> colorLayerViews{};
+		std::array<VkImageView, 2> depthLayerViews{};
+		std::array<VkFramebuffer, 2> separateFrameBuffers{};
 	} multiviewPass;
 
+	vks::MultiviewRenderer multiviewRenderer;
+
+	enum ViewMode { SinglePass = 0, SeparatePasses = 1 };
+	int32_t viewMode{ SinglePass };
+	const std::vector<std::string> viewModeNames = { "Single pass (multiview)", "One pass per view" };
+	// Rendering the views in separate passes needs a vertex shader that doesn't use gl_ViewIndex
+	bool separatePassesAvailable{ false };
+	// CPU time spent on culling and recording the scene, accumulated per mode so they can be compared after switching
+	struct ModeStats {
+		uint32_t frameCount{ 0 };
+		double cpuTime{ 0.0 };
+		uint32_t draws{ 0 };
+	};
+	std::array<ModeStats, 2> modeStats{};
+
 	vkglTF::Model scene;
 
 	struct UniformData {
@@ -37,6 +60,7 @@ public:
 	std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
 
 	VkPipeline pipeline{ VK_NULL_HANDLE };
+	VkPipeline separatePassPipeline{ VK_NULL_HANDLE };
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
@@ -70,23 +94,41 @@ public:
 		physicalDeviceMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
 		physicalDeviceMultiviewFeatures.multiview = VK_TRUE;
 		deviceCreatepNextChain = &physicalDeviceMultiviewFeatures;
+
+		commandLineParser.add("viewmode", { "-vm", "--viewmode" }, 1, "View rendering: 0 = single multiview pass culled against all views, 1 = one pass per view");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("viewmode")) {
+			viewMode = std::clamp(commandLineParser.getValueAsInt("viewmode", viewMode), 0, 1);
+		}
+	}
+
+	void destroyMultiviewAttachments()
+	{
+		vkDestroyImageView(device, multiviewPass.color.view, nullptr);
+		vkDestroyImage(device, multiviewPass.color.image, nullptr);
+		vkFreeMemory(device, multiviewPass.color.memory, nullptr);
+		vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
+		vkDestroyImage(device, multiviewPass.depth.image, nullptr);
+		vkFreeMemory(device, multiviewPass.depth.memory, nullptr);
+		vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
+		vkDestroySampler(device, multiviewPass.sampler, nullptr);
+		vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
+		vkDestroyRenderPass(device, multiviewPass.separateRenderPass, nullptr);
+		for (uint32_t i = 0; i < 2; i++) {
+			vkDestroyImageView(device, multiviewPass.colorLayerViews[i], nullptr);
+			vkDestroyImageView(device, multiviewPass.depthLayerViews[i], nullptr);
+			vkDestroyFramebuffer(device, multiviewPass.separateFrameBuffers[i], nullptr);
+		}
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
 			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipeline(device, separatePassPipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-			vkDestroyImageView(device, multiviewPass.color.view, nullptr);
-			vkDestroyImage(device, multiviewPass.color.image, nullptr);
-			vkFreeMemory(device, multiviewPass.color.memory, nullptr);
-			vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
-			vkDestroyImage(device, multiviewPass.depth.image, nullptr);
-			vkFreeMemory(device, multiviewPass.depth.memory, nullptr);
-			vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
-			vkDestroySampler(device, multiviewPass.sampler, nullptr);
-			vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
+			destroyMultiviewAttachments();
 			for (auto& pipeline : viewDisplayPipelines) {
 				vkDestroyPipeline(device, pipeline, nullptr);
 			}
@@ -137,7 +179,7 @@ public:
 			depthStencilView.flags = 0;
 			depthStencilView.subresourceRange = {};
 			depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			if (vks::tools::formatHasStencil(depthFormat)) {
 				depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 			}
 			depthStencilView.subresourceRange.baseMipLevel = 0;
@@ -285,6 +327,9 @@ public:
 			renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
 			renderPassCI.pDependencies = dependencies.data();
 
+			// Same render pass without multiview for rendering the views in separate passes
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &multiviewPass.separateRenderPass));
+
 			/*
 				Setup multiview info for the renderpass
 			*/
@@ -330,11 +375,43 @@ public:
 			framebufferCI.layers = 1;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewPass.frameBuffer));
 		}
+
+		/*
+			Framebuffers for rendering the views in separate passes, these use views of a single layer
+		*/
+		for (uint32_t i = 0; i < multiviewLayerCount; i++) {
+			VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCI.format = swapChain.colorFormat;
+			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, i, 1 };
+			imageViewCI.image = multiviewPass.color.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &multiviewPass.colorLayerViews[i]));
+			imageViewCI.format = depthFormat;
+			imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (vks::tools::formatHasStencil(depthFormat)) {
+				imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+			imageViewCI.image = multiviewPass.depth.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &multiviewPass.depthLayerViews[i]));
+
+			VkImageView attachments[2] = { multiviewPass.colorLayerViews[i], multiviewPass.depthLayerViews[i] };
+			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+			framebufferCI.renderPass = multiviewPass.separateRenderPass;
+			framebufferCI.attachmentCount = 2;
+			framebufferCI.pAttachments = attachments;
+			framebufferCI.width = width;
+			framebufferCI.height = height;
+			framebufferCI.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewPass.separateFrameBuffers[i]));
+		}
 	}
 
 	void loadAssets()
 	{
 		scene.loadFromFile(getAssetPath() + "models/sampleroom.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY);
+		// Primitive bounds are stored before the vertices are flipped at load time
+		multiviewRenderer.addModel(scene, 0, glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)));
+		multiviewRenderer.setViewCount(2);
 	}
 
 	void prepareDescriptors()
@@ -355,6 +432,10 @@ public:
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		// The view index is passed as a push constant when rendering the views in separate passes
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(int32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 		updateDescriptors();
@@ -376,7 +457,7 @@ public:
 		}
 	}
 	
-	void preparePipelines()
+	void getMultiviewProperties()
 	{
 		/*
 			Display multi view features and properties
@@ -405,7 +486,12 @@ public:
 		std::cout << "Multiview properties:" << std::endl;
 		std::cout << "\tmaxMultiviewViewCount = " << extProps.maxMultiviewViewCount << std::endl;
 		std::cout << "\tmaxMultiviewInstanceIndex = " << extProps.maxMultiviewInstanceIndex << std::endl;
+		// Checked against the number of views when they are set up in loadAssets
+		multiviewRenderer.maxViewCount = extProps.maxMultiviewViewCount;
+	}
 
+	void preparePipelines()
+	{
 		/*
 			Create graphics pipeline
 		*/
@@ -441,6 +527,14 @@ public:
 		pipelineCI.pStages = shaderStages.data();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 
+		// Pipeline for rendering the views in separate passes, selects the view matrices with a push constant instead of gl_ViewIndex
+		if (separatePassesAvailable) {
+			shaderStages[0] = loadShader(getShadersPath() + "multiview/multiview_separate.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.renderPass = multiviewPass.separateRenderPass;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &separatePassPipeline));
+			pipelineCI.renderPass = multiviewPass.renderPass;
+		}
+
 		/*
 			Full screen pass
 		*/
@@ -528,34 +622,39 @@ public:
 		uniformData.projection[1] = glm::frustum(left, right, bottom, top, zNear, zFar);
 		uniformData.modelview[1] = rotM * transM;
 
+		for (uint32_t i = 0; i < 2; i++) {
+			multiviewRenderer.views[i] = { uniformData.projection[i], uniformData.modelview[i] };
+		}
+		multiviewRenderer.update();
+
 		memcpy(uniformBuffers[currentBuffer].mapped, &uniformData, sizeof(UniformData));
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		separatePassesAvailable = vks::tools::fileExists(getShadersPath() + "multiview/multiview_separate.vert.spv");
+		if (!separatePassesAvailable) {
+			viewMode = SinglePass;
+		}
+		getMultiviewProperties();
 		loadAssets();
 		prepareMultiview();
 		prepareUniformBuffers();
 		prepareDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			// Reported for the mode selected on the command line, run with both modes to get the recording cost saved by the single pass
+			benchmark.addMetric("scene cull + record ms (cpu)", [this]() { const ModeStats& stats = modeStats[viewMode]; return stats.cpuTime / std::max(stats.frameCount, 1u); });
+			benchmark.addMetric("scene draws", [this]() { const ModeStats& stats = modeStats[viewMode]; return (double)stats.draws / std::max(stats.frameCount, 1u); });
+		}
 		prepared = true;
 	}
 
 	// SRS - Recreate and update Multiview resources when window size has changed
 	virtual void windowResized()
 	{
-		vkDestroyImageView(device, multiviewPass.color.view, nullptr);
-		vkDestroyImage(device, multiviewPass.color.image, nullptr);
-		vkFreeMemory(device, multiviewPass.color.memory, nullptr);
-		vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
-		vkDestroyImage(device, multiviewPass.depth.image, nullptr);
-		vkFreeMemory(device, multiviewPass.depth.memory, nullptr);
-
-		vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
-		vkDestroySampler(device, multiviewPass.sampler, nullptr);
-		vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
-
+		destroyMultiviewAttachments();
 		prepareMultiview();
 		updateDescriptors();
 		
@@ -583,7 +682,9 @@ public:
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
 		// Update the layered multiview image attachment with the scene from two different viewpors
-		{
+		multiviewRenderer.resetStats();
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		if (viewMode == SinglePass) {
 			renderPassBeginInfo.renderPass = multiviewPass.renderPass;
 			renderPassBeginInfo.framebuffer = multiviewPass.frameBuffer;
 
@@ -595,10 +696,36 @@ public:
 
 			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
 			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			scene.draw(cmdBuffer);
+			// Culled once against the union of both views and recorded once, the draws are broadcast to both views
+			multiviewRenderer.cull(vks::MultiviewRenderer::AllViews);
+			multiviewRenderer.record(cmdBuffer);
 
 			vkCmdEndRenderPass(cmdBuffer);
+		} else {
+			// Each view is culled and recorded in a pass of its own, which is what the single pass saves on the CPU
+			for (int32_t i = 0; i < 2; i++) {
+				renderPassBeginInfo.renderPass = multiviewPass.separateRenderPass;
+				renderPassBeginInfo.framebuffer = multiviewPass.separateFrameBuffers[i];
+
+				vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+				vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+				vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, separatePassPipeline);
+				vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(int32_t), &i);
+				multiviewRenderer.cull(i);
+				multiviewRenderer.record(cmdBuffer);
+
+				vkCmdEndRenderPass(cmdBuffer);
+			}
 		}
+		ModeStats& stats = modeStats[viewMode];
+		stats.cpuTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		stats.draws += multiviewRenderer.stats.draws;
+		stats.frameCount++;
 
 		// Display the multiview images
 		{
@@ -649,6 +776,25 @@ public:
 		if (overlay->header("Settings")) {
 			overlay->sliderFloat("Eye separation", &eyeSeparation, -1.0f, 1.0f);
 			overlay->sliderFloat("Barrel distortion", &uniformData.distortionAlpha, -0.6f, 0.6f);
+			if (separatePassesAvailable) {
+				overlay->comboBox("Views", &viewMode, viewModeNames);
+			} else {
+				overlay->text("One pass per view: not available (shader not found)");
+			}
+			overlay->checkBox("Culling", &multiviewRenderer.cullingEnabled);
+		}
+		if (overlay->header("Statistics")) {
+			const vks::MultiviewRenderer::Stats& stats = multiviewRenderer.stats;
+			overlay->text("Primitives: %d", multiviewRenderer.objectCount());
+			overlay->text("Visible: %d, draws: %d", stats.visible, stats.draws);
+			overlay->text("Cull %.3f ms, record %.3f ms (cpu)", stats.cullTime, stats.recordTime);
+			// Averages since start for each mode, so they can be compared after switching
+			for (uint32_t i = 0; i < modeStats.size(); i++) {
+				if (modeStats[i].frameCount == 0) {
+					continue;
+				}
+				overlay->text("%s: %.3f ms, %d draws", viewModeNames[i].c_str(), modeStats[i].cpuTime / modeStats[i].frameCount, modeStats[i].draws / modeStats[i].frameCount);
+			}
 		}
 	}
 
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Order Independent Transparency rendering using linked lists
+* Vulkan Example - Order Independent Transparency rendering using linked lists, weighted blending or a k-buffer
 *
 * Copyright by Sascha Willems - www.saschawillems.de
 * Copyright by Daemyung Jang  - dm86.jang@gmail.com
@@ -9,8 +9,11 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define NODE_COUNT 20
+// Needs to match the k-buffer size in kbuffer.glsl
+#define KBUFFER_SIZE 8
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -24,24 +27,72 @@ public:
 		glm::vec4 color;
 		float depth{ 0.0f };
 		uint32_t next{ 0 };
+		// The node array in the shader uses std430 layout, which pads the struct to the alignment of its vec4
+		uint32_t padding[2]{};
 	};
 
+	// The linked list needs memory for all fragments of a pixel and drops fragments once the node buffer is full
+	// Weighted blending and the k-buffer use a fixed amount of memory per pixel instead
+	enum OitMode { OitLinkedList = 0, OitWeightedBlended = 1, OitKBuffer = 2 };
+	int32_t oitMode = OitLinkedList;
+	// The shaders of the weighted blended and k-buffer modes are not part of every shader pack, modes are only offered if their SPIR-V is present
+	std::array<bool, 3> modeShadersAvailable{ true, false, false };
+
 	struct {
 		uint32_t count{ 0 };
 		uint32_t maxNodeCount{ 0 };
 	} geometrySBO;
 
+	struct FrameBufferAttachment {
+		VkImage image{ VK_NULL_HANDLE };
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkImageView view{ VK_NULL_HANDLE };
+		VkDescriptorImageInfo descriptor{};
+	};
+
+	// Only the resources of the active mode are allocated, they're recreated when switching modes
 	struct GeometryPass {
+		int32_t mode{ -1 };
 		VkRenderPass renderPass{ VK_NULL_HANDLE };
 		VkFramebuffer framebuffer{ VK_NULL_HANDLE };
 		vks::Buffer geometry;
+		// Linked list
 		vks::Texture headIndex;
 		vks::Buffer linkedList;
+		// Weighted blending, also used by the k-buffer to merge the fragments that don't fit
+		VkRenderPass blendRenderPass{ VK_NULL_HANDLE };
+		VkFramebuffer blendFramebuffer{ VK_NULL_HANDLE };
+		FrameBufferAttachment accumulation;
+		FrameBufferAttachment revealage;
+		// K-buffer
+		vks::Buffer kbufferDepths;
+		vks::Buffer kbufferColors;
 	} geometryPass;
+	VkSampler colorSampler{ VK_NULL_HANDLE };
+
+	// Copies of the fragment counter, read on the host once the frame's fence has been signaled
+	std::array<vks::Buffer, maxConcurrentFrames> counterReadbacks;
+
+	// GPU times of the geometry and resolve passes, accumulated separately for each mode
+	vks::TimestampQuery timestamps;
+	enum TimestampScope { ScopeGeometry = 0, ScopeResolve = 1 };
+	// Mode each frame in flight was recorded with, -1 if it hasn't been recorded yet
+	std::array<int32_t, maxConcurrentFrames> frameOitMode{};
+	struct OitStats {
+		double geometryTime{ 0.0 };
+		double resolveTime{ 0.0 };
+		double frameTime{ 0.0 };
+		uint32_t frameCount{ 0 };
+		// Fragments dropped by the linked list or merged by the k-buffer's tail blend in the last frame
+		uint32_t overflow{ 0 };
+		uint32_t maxOverflow{ 0 };
+	};
+	std::array<OitStats, 3> oitStats{};
 
 	struct RenderPassUniformData {
 		glm::mat4 projection;
 		glm::mat4 view;
+		glm::uvec2 screenSize;
 	} renderPassUniformData;
 	std::array<vks::Buffer, maxConcurrentFrames> renderPassUniformBuffer;
 
@@ -63,6 +114,11 @@ public:
 	struct {
 		VkPipeline geometry{ VK_NULL_HANDLE };
 		VkPipeline color{ VK_NULL_HANDLE };
+		VkPipeline weightedGeometry{ VK_NULL_HANDLE };
+		VkPipeline weightedColor{ VK_NULL_HANDLE };
+		VkPipeline kbufferDepth{ VK_NULL_HANDLE };
+		VkPipeline kbufferGeometry{ VK_NULL_HANDLE };
+		VkPipeline kbufferColor{ VK_NULL_HANDLE };
 	} pipelines;
 
 	struct DescriptorSets {
@@ -80,6 +136,12 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -6.0f));
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
 		camera.setPerspective(60.0f, (float) width / (float) height, 0.1f, 256.0f);
+		commandLineParser.add("oitmode", { "-om", "--oitmode" }, 1, "Transparency mode: 0 = linked list, 1 = weighted blended, 2 = k-buffer with tail blending");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("oitmode")) {
+			oitMode = std::clamp(commandLineParser.getValueAsInt("oitmode", oitMode), 0, 2);
+		}
+		frameOitMode.fill(-1);
 	}
 
 	~VulkanExample()
@@ -87,14 +149,24 @@ public:
 		if (device) {
 			vkDestroyPipeline(device, pipelines.geometry, nullptr);
 			vkDestroyPipeline(device, pipelines.color, nullptr);
+			vkDestroyPipeline(device, pipelines.weightedGeometry, nullptr);
+			vkDestroyPipeline(device, pipelines.weightedColor, nullptr);
+			vkDestroyPipeline(device, pipelines.kbufferDepth, nullptr);
+			vkDestroyPipeline(device, pipelines.kbufferGeometry, nullptr);
+			vkDestroyPipeline(device, pipelines.kbufferColor, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.geometry, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.color, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.geometry, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.color, nullptr);
 			destroyGeometryPass();
+			vkDestroySampler(device, colorSampler, nullptr);
 			for (auto& buffer : renderPassUniformBuffer) {
 				buffer.destroy();
 			}
+			for (auto& buffer : counterReadbacks) {
+				buffer.destroy();
+			}
+			timestamps.destroy();
 		}
 	}
 
@@ -122,10 +194,95 @@ public:
 			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(RenderPassUniformData)));
 			VK_CHECK_RESULT(buffer.map());
 		}
+		for (auto& buffer : counterReadbacks) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(uint32_t)));
+			VK_CHECK_RESULT(buffer.map());
+			memset(buffer.mapped, 0, sizeof(uint32_t));
+		}
+	}
+
+	// Memory required by the per pixel resources of a mode
+	VkDeviceSize modeMemorySize(int32_t mode, uint32_t width, uint32_t height)
+	{
+		const VkDeviceSize pixelCount = (VkDeviceSize)width * height;
+		// RGBA16F accumulation and R16F revealage targets
+		const VkDeviceSize blendTargetSize = pixelCount * (8 + 2);
+		switch (mode) {
+		case OitLinkedList:
+			return pixelCount * (sizeof(uint32_t) + NODE_COUNT * sizeof(Node));
+		case OitWeightedBlended:
+			return blendTargetSize;
+		case OitKBuffer:
+			// Depth and packed color for each slot
+			return pixelCount * KBUFFER_SIZE * 2 * sizeof(uint32_t) + blendTargetSize;
+		}
+		return 0;
+	}
+
+	// Size of each of the two k-buffer storage buffers, which a single descriptor needs to be able to address
+	VkDeviceSize kbufferSize(uint32_t width, uint32_t height)
+	{
+		return (VkDeviceSize)width * height * KBUFFER_SIZE * sizeof(uint32_t);
+	}
+
+	// The k-buffer can't be split like the linked list's node buffer, as slots are addressed by pixel, so it's not available at resolutions it doesn't fit at
+	bool modeAvailable(int32_t mode)
+	{
+		if (!modeShadersAvailable[mode]) {
+			return false;
+		}
+		if (mode == OitKBuffer) {
+			return kbufferSize(width, height) <= vulkanDevice->properties.limits.maxStorageBufferRange;
+		}
+		return true;
+	}
+
+	void createBlendAttachment(VkFormat format, FrameBufferAttachment* attachment)
+	{
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &attachment->image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->memory, 0));
+
+		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
+		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewInfo.format = format;
+		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageViewInfo.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewInfo, nullptr, &attachment->view));
+
+		attachment->descriptor = { colorSampler, attachment->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	}
+
+	void destroyBlendAttachment(FrameBufferAttachment* attachment)
+	{
+		vkDestroyImageView(device, attachment->view, nullptr);
+		vkDestroyImage(device, attachment->image, nullptr);
+		vkFreeMemory(device, attachment->memory, nullptr);
+		*attachment = {};
 	}
 
 	void prepareGeometryPass()
 	{
+		if (!modeAvailable(oitMode)) {
+			oitMode = modeAvailable(OitWeightedBlended) ? OitWeightedBlended : OitLinkedList;
+		}
+		geometryPass.mode = oitMode;
+
 		VkSubpassDescription subpassDescription = {};
 		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
@@ -147,6 +304,9 @@ public:
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.framebuffer));
 
+		// The weighted blend render pass is also needed for pipeline creation, so it's created for all modes
+		prepareBlendRenderPass();
+
 		// Create a buffer for GeometrySBO
 		vks::Buffer stagingBuffer;
 	
@@ -158,14 +318,15 @@ public:
 		VK_CHECK_RESULT(stagingBuffer.map());
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&geometryPass.geometry,
 			sizeof(geometrySBO)));
 
 		// Set up GeometrySBO data.
 		geometrySBO.count = 0;
-		geometrySBO.maxNodeCount = NODE_COUNT * width * height;
+		// The node buffer can't be larger than what a single storage buffer descriptor can address
+		geometrySBO.maxNodeCount = (uint32_t)std::min((VkDeviceSize)NODE_COUNT * width * height, (VkDeviceSize)vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(Node));
 		memcpy(stagingBuffer.mapped, &geometrySBO, sizeof(geometrySBO));
 
 		// Copy data to device
@@ -176,7 +337,23 @@ public:
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
-		
+
+		switch (geometryPass.mode) {
+		case OitLinkedList:
+			prepareLinkedList();
+			break;
+		case OitWeightedBlended:
+			prepareBlendTargets();
+			break;
+		case OitKBuffer:
+			prepareBlendTargets();
+			prepareKBuffer();
+			break;
+		}
+	}
+
+	void prepareLinkedList()
+	{
 		// Create a texture for HeadIndex.
 		// This image will track the head index of each fragment.
 		geometryPass.headIndex.device = vulkanDevice;
@@ -270,19 +447,99 @@ public:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
+	void prepareBlendRenderPass()
+	{
+		// Accumulation and revealage targets for weighted blending, read by the resolve pass
+		std::array<VkAttachmentDescription, 2> attachments{};
+		attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		attachments[1].format = VK_FORMAT_R16_SFLOAT;
+		for (auto& attachment : attachments) {
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		std::array<VkAttachmentReference, 2> colorReferences = {
+			VkAttachmentReference{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			VkAttachmentReference{ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }
+		};
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+
+		// The targets are read by the resolve pass of the previous frame and of this frame
+		// The k-buffer also writes colors to a storage buffer in this pass, so shader writes are made visible too
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &geometryPass.blendRenderPass));
+	}
+
+	void prepareBlendTargets()
+	{
+		createBlendAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, &geometryPass.accumulation);
+		createBlendAttachment(VK_FORMAT_R16_SFLOAT, &geometryPass.revealage);
+
+		std::array<VkImageView, 2> attachments = { geometryPass.accumulation.view, geometryPass.revealage.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = geometryPass.blendRenderPass;
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.blendFramebuffer));
+	}
+
+	void prepareKBuffer()
+	{
+		// Nearest depths and their packed colors, KBUFFER_SIZE slots per pixel
+		// Both are cleared at the start of every frame
+		// The mode is only selected if the buffers fit into maxStorageBufferRange
+		const VkDeviceSize size = kbufferSize(width, height);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &geometryPass.kbufferDepths, size));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &geometryPass.kbufferColors, size));
+	}
+
 	void setupDescriptors()
 	{
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxConcurrentFrames),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 7),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxConcurrentFrames * 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 2),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Layouts
+		// The layouts contain the bindings of all modes, only those used by the active mode are written
 
 		// Create a geometry descriptor set layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
@@ -294,6 +551,10 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
 			// LinkedListSBO
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+			// KBufferDepthSBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// KBufferColorSBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.geometry));
@@ -304,6 +565,14 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			// LinkedListSBO
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Weighted blend accumulation
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			// Weighted blend revealage
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+			// KBufferDepthSBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// KBufferColorSBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
 		};
 		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.color));
@@ -322,24 +591,44 @@ public:
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 				// Binding 0: renderPassUniformData
 				vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &renderPassUniformBuffer[i].descriptor),
-				// Binding 2: GeometrySBO
+				// Binding 1: GeometrySBO
 				vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &geometryPass.geometry.descriptor),
-				// Binding 3: headIndexImage
-				vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &geometryPass.headIndex.descriptor),
-				// Binding 4: LinkedListSBO
-				vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &geometryPass.linkedList.descriptor)
 			};
+			if (geometryPass.mode == OitLinkedList) {
+				// Binding 2: headIndexImage
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &geometryPass.headIndex.descriptor));
+				// Binding 3: LinkedListSBO
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &geometryPass.linkedList.descriptor));
+			}
+			if (geometryPass.mode == OitKBuffer) {
+				// Binding 4: KBufferDepthSBO
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &geometryPass.kbufferDepths.descriptor));
+				// Binding 5: KBufferColorSBO
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &geometryPass.kbufferColors.descriptor));
+			}
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
 			// Update a color descriptor set
 			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.color, 1);
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i].color));
-			writeDescriptorSets = {
+			writeDescriptorSets.clear();
+			if (geometryPass.mode == OitLinkedList) {
 				// Binding 0: headIndexImage
-				vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &geometryPass.headIndex.descriptor),
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &geometryPass.headIndex.descriptor));
 				// Binding 1: LinkedListSBO
-				vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &geometryPass.linkedList.descriptor)
-			};
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &geometryPass.linkedList.descriptor));
+			} else {
+				// Binding 2: Weighted blend accumulation
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &geometryPass.accumulation.descriptor));
+				// Binding 3: Weighted blend revealage
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &geometryPass.revealage.descriptor));
+			}
+			if (geometryPass.mode == OitKBuffer) {
+				// Binding 4: KBufferDepthSBO
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &geometryPass.kbufferDepths.descriptor));
+				// Binding 5: KBufferColorSBO
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i].color, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &geometryPass.kbufferColors.descriptor));
+			}
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
 	}
@@ -389,6 +678,45 @@ public:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
 
+		// Create the k-buffer depth pipeline, which also doesn't need any output attachment
+		if (modeShadersAvailable[OitKBuffer]) {
+			shaderStages[1] = loadShader(getShadersPath() + "oit/kbufferdepth.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kbufferDepth));
+		}
+
+		// Create the weighted blend pipelines
+		// Colors are added to the accumulation target, while the revealage target is multiplied by (1 - alpha)
+		std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates{};
+		blendAttachmentStates[0].colorWriteMask = 0xf;
+		blendAttachmentStates[0].blendEnable = VK_TRUE;
+		blendAttachmentStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+		blendAttachmentStates[1].blendEnable = VK_TRUE;
+		blendAttachmentStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		blendAttachmentStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(blendAttachmentStates.size()), blendAttachmentStates.data());
+		pipelineCI.renderPass = geometryPass.blendRenderPass;
+
+		if (modeShadersAvailable[OitWeightedBlended]) {
+			shaderStages[1] = loadShader(getShadersPath() + "oit/weightedgeometry.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedGeometry));
+		}
+
+		// The k-buffer's second pass merges the fragments that didn't fit using the same blend state
+		if (modeShadersAvailable[OitKBuffer]) {
+			shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffergeometry.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kbufferGeometry));
+		}
+
 		// Create a color pipeline
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
@@ -414,26 +742,99 @@ public:
 		rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+
+		// Resolve pipelines for the other modes
+		if (modeShadersAvailable[OitWeightedBlended]) {
+			shaderStages[1] = loadShader(getShadersPath() + "oit/weightedcolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedColor));
+		}
+		if (modeShadersAvailable[OitKBuffer]) {
+			shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffercolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kbufferColor));
+		}
 	}
 
 	void updateUniformBuffers()
 	{
 		renderPassUniformData.projection = camera.matrices.perspective;
 		renderPassUniformData.view = camera.matrices.view;
+		renderPassUniformData.screenSize = glm::uvec2(width, height);
 		memcpy(renderPassUniformBuffer[currentBuffer].mapped, &renderPassUniformData, sizeof(RenderPassUniformData));
 	}
 
+	void prepareColorSampler()
+	{
+		// The weighted blend targets are read with texel fetches, so no filtering is required
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = samplerInfo.addressModeU;
+		samplerInfo.addressModeW = samplerInfo.addressModeU;
+		samplerInfo.maxLod = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &colorSampler));
+	}
+
 	void prepare() override
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
+		prepareColorSampler();
+		const std::string shadersPath = getShadersPath();
+		modeShadersAvailable[OitWeightedBlended] = vks::tools::fileExists(shadersPath + "oit/weightedgeometry.frag.spv") && vks::tools::fileExists(shadersPath + "oit/weightedcolor.frag.spv");
+		modeShadersAvailable[OitKBuffer] = vks::tools::fileExists(shadersPath + "oit/kbufferdepth.frag.spv") && vks::tools::fileExists(shadersPath + "oit/kbuffergeometry.frag.spv") && vks::tools::fileExists(shadersPath + "oit/kbuffercolor.frag.spv");
 		prepareGeometryPass();
 		setupDescriptors();
 		preparePipelines();
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2, maxConcurrentFrames);
+		if (benchmark.active) {
+			// Reported for the mode selected on the command line, run with different window sizes to compare resolutions
+			benchmark.addMetric("oit memory MB", [this]() { return (double)modeMemorySize(oitMode, width, height) / (1024.0 * 1024.0); });
+			benchmark.addMetric("overflowing fragments", [this]() { return (double)oitStats[oitMode].maxOverflow; });
+			if (timestamps.supported) {
+				benchmark.addMetric("geometry ms (gpu)", [this]() { const OitStats& stats = oitStats[oitMode]; return stats.geometryTime / std::max(stats.frameCount, 1u); });
+				benchmark.addMetric("resolve ms (gpu)", [this]() { const OitStats& stats = oitStats[oitMode]; return stats.resolveTime / std::max(stats.frameCount, 1u); });
+			}
+		}
 		prepared = true;
 	}
 
+	void drawScene(VkCommandBuffer cmdBuffer)
+	{
+		ObjectData objectData;
+
+		models.sphere.bindBuffers(cmdBuffer);
+		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
+		for (int32_t x = 0; x < 5; x++)
+		{
+			for (int32_t y = 0; y < 5; y++)
+			{
+				for (int32_t z = 0; z < 5; z++)
+				{
+					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
+					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
+					objectData.model = T * S;
+					vkCmdPushConstants(cmdBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+					models.sphere.draw(cmdBuffer);
+				}
+			}
+		}
+
+		models.cube.bindBuffers(cmdBuffer);
+		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
+			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+			objectData.model = T * S;
+			vkCmdPushConstants(cmdBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+			models.cube.draw(cmdBuffer);
+		}
+	}
+
 	void buildCommandBuffer()
 	{
 		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
@@ -455,84 +856,102 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+		timestamps.reset(cmdBuffer, currentBuffer);
+		frameOitMode[currentBuffer] = geometryPass.mode;
+
 		// Update dynamic viewport state
 		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
 		// Update dynamic scissor state
 		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		VkClearColorValue clearColor;
-		clearColor.uint32[0] = 0xffffffff;
+		// The per pixel resources are shared by all frames, so the previous frame's passes need to be done before clearing them
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
 
-		VkImageSubresourceRange subresRange = {};
+		if (geometryPass.mode == OitLinkedList) {
+			VkClearColorValue clearColor;
+			clearColor.uint32[0] = 0xffffffff;
 
-		subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresRange.levelCount = 1;
-		subresRange.layerCount = 1;
+			VkImageSubresourceRange subresRange = {};
 
-		vkCmdClearColorImage(cmdBuffer, geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+			subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresRange.levelCount = 1;
+			subresRange.layerCount = 1;
+
+			vkCmdClearColorImage(cmdBuffer, geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+		}
+		if (geometryPass.mode == OitKBuffer) {
+			// Empty depth slots are marked with the largest value, empty colors are fully transparent
+			vkCmdFillBuffer(cmdBuffer, geometryPass.kbufferDepths.buffer, 0, VK_WHOLE_SIZE, 0xffffffff);
+			vkCmdFillBuffer(cmdBuffer, geometryPass.kbufferColors.buffer, 0, VK_WHOLE_SIZE, 0);
+		}
 
 		// Clear previous geometry pass data
 		vkCmdFillBuffer(cmdBuffer, geometryPass.geometry.buffer, 0, sizeof(uint32_t), 0);
 
-		// We need a barrier to make sure all writes are finished before starting to write again
+		// We need a barrier to make sure all writes are finished before the geometry passes start writing again
 		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
 		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
-
-		// Begin the geometry render pass
-		renderPassBeginInfo.renderPass = geometryPass.renderPass;
-		renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
-		renderPassBeginInfo.clearValueCount = 0;
-		renderPassBeginInfo.pClearValues = nullptr;
-
-		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-		uint32_t dynamicOffset = 0;
-		models.sphere.bindBuffers(cmdBuffer);
-
-		// Render the scene
-		ObjectData objectData;
-
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets[currentBuffer].geometry, 0, nullptr);
-		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
-		for (int32_t x = 0; x < 5; x++)
-		{
-			for (int32_t y = 0; y < 5; y++)
-			{
-				for (int32_t z = 0; z < 5; z++)
-				{
-					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
-					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-					objectData.model = T * S;
-					vkCmdPushConstants(cmdBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-					models.sphere.draw(cmdBuffer);
-				}
-			}
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeGeometry);
+
+		// Linked list and the k-buffer depths are written in the geometry render pass without any output attachments
+		if (geometryPass.mode != OitWeightedBlended) {
+			renderPassBeginInfo.renderPass = geometryPass.renderPass;
+			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+			renderPassBeginInfo.clearValueCount = 0;
+			renderPassBeginInfo.pClearValues = nullptr;
+
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPass.mode == OitLinkedList ? pipelines.geometry : pipelines.kbufferDepth);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets[currentBuffer].geometry, 0, nullptr);
+			drawScene(cmdBuffer);
+			vkCmdEndRenderPass(cmdBuffer);
 		}
 
-		models.cube.bindBuffers(cmdBuffer);
-		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-		for (uint32_t x = 0; x < 2; x++)
-		{
-			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
-			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-			objectData.model = T * S;
-			vkCmdPushConstants(cmdBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-			models.cube.draw(cmdBuffer);
+		if (geometryPass.mode == OitKBuffer) {
+			// The second pass reads the sorted depths written by the first one
+			memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 		}
 
-		vkCmdEndRenderPass(cmdBuffer);
+		// Weighted blending and the k-buffer's second pass write to the accumulation and revealage targets
+		if (geometryPass.mode != OitLinkedList) {
+			VkClearValue blendClearValues[2];
+			blendClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			blendClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+			renderPassBeginInfo.renderPass = geometryPass.blendRenderPass;
+			renderPassBeginInfo.framebuffer = geometryPass.blendFramebuffer;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = blendClearValues;
+
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPass.mode == OitWeightedBlended ? pipelines.weightedGeometry : pipelines.kbufferGeometry);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets[currentBuffer].geometry, 0, nullptr);
+			drawScene(cmdBuffer);
+			vkCmdEndRenderPass(cmdBuffer);
+		}
 
-		// Make a pipeline barrier to guarantee the geometry pass is done
-		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		timestamps.end(cmdBuffer, currentBuffer, ScopeGeometry);
 
-		// We need a barrier to make sure all writes are finished before starting to write again
+		// We need a barrier to make sure all writes are finished before resolving them and reading back the fragment counter
 		memoryBarrier = vks::initializers::memoryBarrier();
 		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// The counter holds all fragments written to the linked list or the fragments merged by the k-buffer's tail blend
+		VkBufferCopy copyRegion = { 0, 0, sizeof(uint32_t) };
+		vkCmdCopyBuffer(cmdBuffer, geometryPass.geometry.buffer, counterReadbacks[currentBuffer].buffer, 1, &copyRegion);
+		memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 		// Begin the color render pass
 		renderPassBeginInfo.renderPass = renderPass;
@@ -541,31 +960,74 @@ public:
 		renderPassBeginInfo.pClearValues = clearValues;
 
 		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
+		timestamps.begin(cmdBuffer, currentBuffer, ScopeResolve);
+		const VkPipeline colorPipelines[3] = { pipelines.color, pipelines.weightedColor, pipelines.kbufferColor };
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipelines[geometryPass.mode]);
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets[currentBuffer].color, 0, nullptr);
 		vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+		timestamps.end(cmdBuffer, currentBuffer, ScopeResolve);
 		drawUI(cmdBuffer);
 		vkCmdEndRenderPass(cmdBuffer);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
+	void fetchStats()
+	{
+		if (frameOitMode[currentBuffer] < 0) {
+			return;
+		}
+		OitStats& stats = oitStats[frameOitMode[currentBuffer]];
+		if (timestamps.fetch(currentBuffer)) {
+			stats.geometryTime += timestamps.durations[ScopeGeometry];
+			stats.resolveTime += timestamps.durations[ScopeResolve];
+		}
+		const uint32_t counter = *static_cast<uint32_t*>(counterReadbacks[currentBuffer].mapped);
+		switch (frameOitMode[currentBuffer]) {
+		case OitLinkedList:
+			// The counter keeps increasing after the node buffer is full, every fragment beyond that has been dropped
+			stats.overflow = counter > geometrySBO.maxNodeCount ? counter - geometrySBO.maxNodeCount : 0;
+			break;
+		case OitKBuffer:
+			stats.overflow = counter;
+			break;
+		default:
+			stats.overflow = 0;
+		}
+		stats.maxOverflow = std::max(stats.maxOverflow, stats.overflow);
+		stats.frameTime += frameTimer * 1000.0;
+		stats.frameCount++;
+	}
+
 	void render() override
 	{
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		fetchStats();
+		if (geometryPass.mode != oitMode) {
+			// Only the resources of the active mode are allocated, so they need to be recreated after switching
+			VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+			recreateGeometryPass();
+		}
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
 
-	void windowResized() override
+	void recreateGeometryPass()
 	{
 		destroyGeometryPass();
 		prepareGeometryPass();
 		vkResetDescriptorPool(device, descriptorPool, 0);
 		updateDescriptors();
+	}
+
+	void windowResized() override
+	{
+		recreateGeometryPass();
+		// Averages are only comparable for the same resolution
+		oitStats = {};
 		resized = false;
 	}
 
@@ -573,9 +1035,66 @@ public:
 	{
 		vkDestroyRenderPass(device, geometryPass.renderPass, nullptr);
 		vkDestroyFramebuffer(device, geometryPass.framebuffer, nullptr);
+		vkDestroyRenderPass(device, geometryPass.blendRenderPass, nullptr);
 		geometryPass.geometry.destroy();
-		geometryPass.headIndex.destroy();
-		geometryPass.linkedList.destroy();
+		if (geometryPass.mode == OitLinkedList) {
+			geometryPass.headIndex.destroy();
+			geometryPass.linkedList.destroy();
+		}
+		if (geometryPass.mode == OitWeightedBlended || geometryPass.mode == OitKBuffer) {
+			vkDestroyFramebuffer(device, geometryPass.blendFramebuffer, nullptr);
+			geometryPass.blendFramebuffer = VK_NULL_HANDLE;
+			destroyBlendAttachment(&geometryPass.accumulation);
+			destroyBlendAttachment(&geometryPass.revealage);
+		}
+		if (geometryPass.mode == OitKBuffer) {
+			geometryPass.kbufferDepths.destroy();
+			geometryPass.kbufferColors.destroy();
+		}
+	}
+
+	void OnUpdateUIOverlay(vks::UIOverlay* overlay) override
+	{
+		const char* modeNames[3] = { "Linked list", "Weighted blended", "K-buffer" };
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Mode", &oitMode, { modeNames[0], modeNames[1], modeNames[2] }) && !modeAvailable(oitMode)) {
+				oitMode = geometryPass.mode;
+			}
+			for (int32_t i = OitWeightedBlended; i <= OitKBuffer; i++) {
+				if (!modeShadersAvailable[i]) {
+					overlay->text("%s: not available (shaders not found)", modeNames[i]);
+				} else if (!modeAvailable(i)) {
+					overlay->text("%s: not available (exceeds maxStorageBufferRange)", modeNames[i]);
+				}
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const OitStats& stats = oitStats[geometryPass.mode];
+			if (geometryPass.mode == OitLinkedList) {
+				overlay->text("Nodes: %d", geometrySBO.maxNodeCount);
+				overlay->text("Dropped fragments: %d (max %d)", stats.overflow, stats.maxOverflow);
+			}
+			if (geometryPass.mode == OitKBuffer) {
+				overlay->text("Layers: %d", KBUFFER_SIZE);
+				overlay->text("Tail blended fragments: %d (max %d)", stats.overflow, stats.maxOverflow);
+			}
+			// Memory of the per pixel resources, the GPU times are measured at the current resolution
+			for (uint32_t i = 0; i < oitStats.size(); i++) {
+				overlay->text("%s: %.1f MB", modeNames[i], (float)modeMemorySize(i, width, height) / (1024.0f * 1024.0f));
+				overlay->text("  1080p %.1f MB, 4K %.1f MB", (float)modeMemorySize(i, 1920, 1080) / (1024.0f * 1024.0f), (float)modeMemorySize(i, 3840, 2160) / (1024.0f * 1024.0f));
+			}
+			// Averages since start for each mode, so they can be compared after switching
+			for (uint32_t i = 0; i < oitStats.size(); i++) {
+				const OitStats& modeStats = oitStats[i];
+				if (modeStats.frameCount == 0) {
+					continue;
+				}
+				overlay->text("%s: %.2f ms/frame", modeNames[i], modeStats.frameTime / modeStats.frameCount);
+				if (timestamps.supported) {
+					overlay->text("  geometry %.3f, resolve %.3f ms (gpu)", modeStats.geometryTime / modeStats.frameCount, modeStats.resolveTime / modeStats.frameCount);
+				}
+			}
+		}
 	}
 };
 
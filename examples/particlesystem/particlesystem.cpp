@@ -3,6 +3,9 @@
 * 
 * This sample renders a particle system that is updated on the host (by the CPU) and rendered by the GPU using a vertex buffer
 *
+* Particles are stored as a structure of arrays and updated in parallel using a thread pool with branch free loops the compiler can vectorize
+* For correct blending they're sorted back to front with a parallel radix sort and then written straight into the mapped vertex buffer
+*
 * Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -10,8 +13,11 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
 
+// Default particle count, can be changed with the -pc/--particlecount command line argument
 constexpr auto PARTICLE_COUNT = 512;
+constexpr auto MAX_PARTICLE_COUNT = 1024 * 1024;
 
 constexpr auto FLAME_RADIUS = 8.0f;
 
@@ -20,15 +26,35 @@ constexpr auto FLAME_RADIUS = 8.0f;
 constexpr auto PARTICLE_TYPE_FLAME = 0;
 constexpr auto PARTICLE_TYPE_SMOKE = 1;
 
-struct Particle {
+// Particle state is stored as a structure of arrays, so the update loops can process multiple particles at once
+struct ParticleStreams {
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	// Particles are always gray, so a single channel is sufficient
+	std::vector<float> color;
+	std::vector<float> alpha;
+	std::vector<float> size;
+	std::vector<float> rotation;
+	std::vector<float> rotationSpeed;
+	std::vector<uint32_t> type;
+
+	void resize(size_t count)
+	{
+		for (auto* stream : { &posX, &posY, &posZ, &velX, &velY, &velZ, &color, &alpha, &size, &rotation, &rotationSpeed }) {
+			stream->resize(count);
+		}
+		type.resize(count);
+	}
+};
+
+// Per-vertex data as read by the particle vertex shader
+struct ParticleVertex {
 	glm::vec4 pos;
 	glm::vec4 color;
 	float alpha;
 	float size;
 	float rotation;
 	uint32_t type;
-	glm::vec4 vel;
-	float rotationSpeed;
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -99,7 +125,37 @@ public:
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 
-	std::vector<Particle> particles{};
+	ParticleStreams particles{};
+	uint32_t particleCount{ PARTICLE_COUNT };
+
+	// The simulation is split into one chunk per thread
+	vks::ThreadPool threadPool;
+	uint32_t numThreads{ 1 };
+	// Each thread uses its own random engine for respawning particles
+	std::vector<std::default_random_engine> threadRndEngines;
+
+	// Back to front sorting using a parallel LSD radix sort on the particles' view space depth
+	struct DepthSort {
+		bool enabled{ true };
+		// Double buffered keys (depth converted to sortable integers) and particle indices
+		std::array<std::vector<uint32_t>, 2> keys;
+		std::array<std::vector<uint32_t>, 2> indices;
+		// Index of the buffer holding the sorted result
+		uint32_t current{ 0 };
+		// One 256 entry histogram per thread
+		std::vector<std::array<uint32_t, 256>> histograms;
+	} depthSort;
+
+	// CPU timings in milliseconds
+	struct Timings {
+		double update{ 0.0 };
+		double sort{ 0.0 };
+		double upload{ 0.0 };
+		// Accumulated for benchmark output
+		double totalUpdate{ 0.0 };
+		double totalSort{ 0.0 };
+		uint32_t frameCount{ 0 };
+	} timings;
 
 	std::default_random_engine rndEngine;
 
@@ -112,6 +168,21 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+
+		// Sample specific command line arguments
+		commandLineParser.add("particlecount", { "-pc", "--particlecount" }, 1, "Set the number of simulated particles (up to 1M)");
+		commandLineParser.add("nosort", { "-ns", "--nosort" }, 0, "Disable back to front sorting of the particles");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("particlecount")) {
+			particleCount = std::clamp(commandLineParser.getValueAsInt("particlecount", PARTICLE_COUNT), 1, MAX_PARTICLE_COUNT);
+		}
+		depthSort.enabled = !commandLineParser.isSet("nosort");
+
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		threadPool.setThreadCount(numThreads);
+		for (uint32_t i = 0; i < numThreads; i++) {
+			threadRndEngines.emplace_back(benchmark.active ? i : (unsigned)time(nullptr) + i);
+		}
 	}
 
 	~VulkanExample()
@@ -146,121 +217,290 @@ public:
 		};
 	}
 
-	float rnd(float range)
+	float rnd(std::default_random_engine& engine, float range)
 	{
 		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
+		return rndDist(engine);
 	}
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
+	void initParticle(uint32_t index, glm::vec3 emitterPos, std::default_random_engine& engine)
 	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		particles.velX[index] = 0.0f;
+		particles.velY[index] = minVel.y + rnd(engine, maxVel.y - minVel.y);
+		particles.velZ[index] = 0.0f;
+		particles.alpha[index] = rnd(engine, 0.75f);
+		particles.size[index] = 1.0f + rnd(engine, 0.5f);
+		particles.color[index] = 1.0f;
+		particles.type[index] = PARTICLE_TYPE_FLAME;
+		particles.rotation[index] = rnd(engine, 2.0f * float(M_PI));
+		particles.rotationSpeed[index] = rnd(engine, 2.0f) - rnd(engine, 2.0f);
 
 		// Get random sphere point
-		float theta = rnd(2.0f * float(M_PI));
-		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
-		float r = rnd(FLAME_RADIUS);
+		float theta = rnd(engine, 2.0f * float(M_PI));
+		float phi = rnd(engine, float(M_PI)) - float(M_PI) / 2.0f;
+		float r = rnd(engine, FLAME_RADIUS);
 
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		particles.posX[index] = r * cos(theta) * cos(phi) + emitterPos.x;
+		particles.posY[index] = r * sin(phi) + emitterPos.y;
+		particles.posZ[index] = r * sin(theta) * cos(phi) + emitterPos.z;
 	}
 
 	// Change the type of a particle, e.g. from flame to smoke
-	void transitionParticle(Particle *particle)
+	void transitionParticle(uint32_t index, std::default_random_engine& engine)
 	{
-		switch (particle->type)
+		switch (particles.type[index])
 		{
 		case PARTICLE_TYPE_FLAME:
 			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
+			if (rnd(engine, 1.0f) < 0.05f)
 			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
+				particles.alpha[index] = 0.0f;
+				particles.color[index] = 0.25f + rnd(engine, 0.25f);
+				particles.posX[index] *= 0.5f;
+				particles.posZ[index] *= 0.5f;
+				particles.velX[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				particles.velY[index] = (minVel.y * 2) + rnd(engine, maxVel.y - minVel.y);
+				particles.velZ[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				particles.size[index] = 1.0f + rnd(engine, 0.5f);
+				particles.rotationSpeed[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				particles.type[index] = PARTICLE_TYPE_SMOKE;
 			}
 			else
 			{
-				initParticle(particle, emitterPos);
+				initParticle(index, emitterPos, engine);
 			}
 			break;
 		case PARTICLE_TYPE_SMOKE:
 			// Respawn at end of life
-			initParticle(particle, emitterPos);
+			initParticle(index, emitterPos, engine);
 			break;
 		}
 	}
 
+	// Run a function for evenly sized ranges of the particles, one per thread, and wait for all of them to finish
+	void parallelFor(const std::function<void(uint32_t thread, uint32_t first, uint32_t last)>& function)
+	{
+		for (uint32_t t = 0; t < numThreads; t++) {
+			const uint32_t first = static_cast<uint32_t>((uint64_t)particleCount * t / numThreads);
+			const uint32_t last = static_cast<uint32_t>((uint64_t)particleCount * (t + 1) / numThreads);
+			threadPool.threads[t]->addJob([=, &function] { function(t, first, last); });
+		}
+		threadPool.wait();
+	}
+
 	// Initialize the particle system and create vertex buffers for rendering the particles
 	void prepareParticles()
 	{
 		// We store particles in CPU memory
-		particles.resize(PARTICLE_COUNT);
-		for (auto& particle : particles) {
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+		particles.resize(particleCount);
+		for (uint32_t i = 0; i < particleCount; i++) {
+			initParticle(i, emitterPos, rndEngine);
+			particles.alpha[i] = 1.0f - (abs(particles.posY[i]) / (FLAME_RADIUS * 2.0f));
 		}
 
+		for (uint32_t i = 0; i < 2; i++) {
+			depthSort.keys[i].resize(particleCount);
+			depthSort.indices[i].resize(particleCount);
+		}
+		depthSort.histograms.resize(numThreads);
+		std::iota(depthSort.indices[0].begin(), depthSort.indices[0].end(), 0);
+
 		// One buffer per concurrent frame, so we can update one frame while the other is still rendering
 		for (auto& buffer : particleBuffers) {
-			buffer.size = particles.size() * sizeof(Particle);
+			buffer.size = particleCount * sizeof(ParticleVertex);
 
 			VK_CHECK_RESULT(vulkanDevice->createBuffer(
 				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				buffer.size,
 				&buffer.buffer,
-				&buffer.memory,
-				particles.data()));
+				&buffer.memory));
 
 			// Map the memory and store the pointer for reuse
 			VK_CHECK_RESULT(vkMapMemory(device, buffer.memory, 0, buffer.size, 0, &buffer.mappedMemory));
+			writeVertices(buffer.mappedMemory, false);
+		}
+	}
+
+	// Convert a float into an unsigned integer with the same ordering
+	static uint32_t sortableKey(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(uint32_t));
+		return bits ^ ((bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u);
+	}
+
+	// Advance the simulation for a range of particles
+	void simulate(uint32_t first, uint32_t last, std::default_random_engine& engine)
+	{
+		const float particleTimer = frameTimer * 0.45f;
+		// The per-type rates are blended instead of branching on the type, so this loop can be vectorized
+		// Flame particles only have a vertical velocity, so moving them along all axes gives the same result as the original per-type update
+		{
+			const float* __restrict velX = particles.velX.data();
+			const float* __restrict velY = particles.velY.data();
+			const float* __restrict velZ = particles.velZ.data();
+			const float* __restrict rotationSpeed = particles.rotationSpeed.data();
+			const uint32_t* __restrict type = particles.type.data();
+			float* __restrict posX = particles.posX.data();
+			float* __restrict posY = particles.posY.data();
+			float* __restrict posZ = particles.posZ.data();
+			float* __restrict color = particles.color.data();
+			float* __restrict alpha = particles.alpha.data();
+			float* __restrict size = particles.size.data();
+			float* __restrict rotation = particles.rotation.data();
+
+			for (uint32_t i = first; i < last; i++) {
+				const float smoke = static_cast<float>(type[i] == PARTICLE_TYPE_SMOKE);
+				const float moveRate = particleTimer * 3.5f + smoke * (frameTimer - particleTimer * 3.5f);
+				posX[i] -= velX[i] * moveRate;
+				posY[i] -= velY[i] * moveRate;
+				posZ[i] -= velZ[i] * moveRate;
+				alpha[i] += particleTimer * (2.5f - smoke * 1.25f);
+				size[i] += particleTimer * (-0.5f + smoke * 0.625f);
+				color[i] -= particleTimer * smoke * 0.05f;
+				rotation[i] += particleTimer * rotationSpeed[i];
+			}
+		}
+
+		// If a particle has faded out, turn it into the other type (e.g. flame to smoke and vice versa)
+		for (uint32_t i = first; i < last; i++) {
+			if (particles.alpha[i] > 2.0f) {
+				transitionParticle(i, engine);
+			}
+		}
+	}
+
+	// Calculate the view space depth of a range of particles as keys for sorting
+	void calculateSortKeys(uint32_t first, uint32_t last)
+	{
+		const glm::mat4& view = camera.matrices.view;
+		const float* __restrict posX = particles.posX.data();
+		const float* __restrict posY = particles.posY.data();
+		const float* __restrict posZ = particles.posZ.data();
+		uint32_t* __restrict keys = depthSort.keys[0].data();
+		uint32_t* __restrict indices = depthSort.indices[0].data();
+		// The camera looks down the negative z-axis, so sorting ascending by view space z gives back to front order
+		for (uint32_t i = first; i < last; i++) {
+			const float depth = view[0][2] * posX[i] + view[1][2] * posY[i] + view[2][2] * posZ[i] + view[3][2];
+			keys[i] = sortableKey(depth);
+			indices[i] = i;
+		}
+	}
+
+	// Parallel least significant digit radix sort with 8 bit digits, the result is stable
+	void sortParticles()
+	{
+		depthSort.current = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8) {
+			const uint32_t src = depthSort.current;
+			const uint32_t dst = 1 - src;
+
+			// Count digits for each thread's range
+			parallelFor([&](uint32_t thread, uint32_t first, uint32_t last) {
+				auto& histogram = depthSort.histograms[thread];
+				histogram.fill(0);
+				const uint32_t* keys = depthSort.keys[src].data();
+				for (uint32_t i = first; i < last; i++) {
+					histogram[(keys[i] >> shift) & 0xFF]++;
+				}
+			});
+
+			// Skip the pass if all keys share the same digit (e.g. the upper bits of nearby depths)
+			bool skipPass = false;
+			for (uint32_t digit = 0; digit < 256 && !skipPass; digit++) {
+				uint32_t count = 0;
+				for (auto& histogram : depthSort.histograms) {
+					count += histogram[digit];
+				}
+				skipPass = (count == particleCount);
+			}
+			if (skipPass) {
+				continue;
+			}
+
+			// Turn the counts into scatter offsets, ordered by digit first and thread second to keep the sort stable
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; digit++) {
+				for (auto& histogram : depthSort.histograms) {
+					const uint32_t count = histogram[digit];
+					histogram[digit] = offset;
+					offset += count;
+				}
+			}
+
+			// Scatter keys and indices into the other buffer
+			parallelFor([&](uint32_t thread, uint32_t first, uint32_t last) {
+				auto& offsets = depthSort.histograms[thread];
+				const uint32_t* srcKeys = depthSort.keys[src].data();
+				const uint32_t* srcIndices = depthSort.indices[src].data();
+				uint32_t* dstKeys = depthSort.keys[dst].data();
+				uint32_t* dstIndices = depthSort.indices[dst].data();
+				for (uint32_t i = first; i < last; i++) {
+					const uint32_t target = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+					dstKeys[target] = srcKeys[i];
+					dstIndices[target] = srcIndices[i];
+				}
+			});
+
+			depthSort.current = dst;
+		}
+	}
+
+	// Write a range of particles to the vertex buffer, optionally in sorted order
+	void writeVertices(uint32_t first, uint32_t last, void* mapped, bool sorted)
+	{
+		ParticleVertex* vertices = static_cast<ParticleVertex*>(mapped);
+		const uint32_t* order = depthSort.indices[depthSort.current].data();
+		// The vertex buffer is host coherent and possibly write combined, so vertices are written sequentially and never read back
+		for (uint32_t i = first; i < last; i++) {
+			const uint32_t index = sorted ? order[i] : i;
+			ParticleVertex& vertex = vertices[i];
+			vertex.pos = glm::vec4(particles.posX[index], particles.posY[index], particles.posZ[index], 0.0f);
+			vertex.color = glm::vec4(particles.color[index]);
+			vertex.alpha = particles.alpha[index];
+			vertex.size = particles.size[index];
+			vertex.rotation = particles.rotation[index];
+			vertex.type = particles.type[index];
 		}
 	}
 
+	void writeVertices(void* mapped, bool sorted)
+	{
+		writeVertices(0, particleCount, mapped, sorted);
+	}
+
 	// Update the state of all particles
 	void updateParticles()
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particles) {
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// If a particle has faded out, turn it into the other type (e.g. flame to smoke and vice versa)
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const bool sort = depthSort.enabled;
+		parallelFor([&](uint32_t thread, uint32_t first, uint32_t last) {
+			simulate(first, last, threadRndEngines[thread]);
+			if (sort) {
+				calculateSortKeys(first, last);
 			}
+		});
+		auto tUpdate = std::chrono::high_resolution_clock::now();
+
+		if (sort) {
+			sortParticles();
 		}
-		
-		// Copy the updated particles to the vertex buffer for the next frame to be updated
-		size_t size = particles.size() * sizeof(Particle);
-		memcpy(particleBuffers[currentBuffer].mappedMemory, particles.data(), size);
+		auto tSort = std::chrono::high_resolution_clock::now();
+
+		// Write the updated particles directly to the vertex buffer for the next frame to be updated
+		void* mapped = particleBuffers[currentBuffer].mappedMemory;
+		parallelFor([&](uint32_t thread, uint32_t first, uint32_t last) {
+			writeVertices(first, last, mapped, sort);
+		});
+		auto tUpload = std::chrono::high_resolution_clock::now();
+
+		timings.update = std::chrono::duration<double, std::milli>(tUpdate - tStart).count();
+		timings.sort = std::chrono::duration<double, std::milli>(tSort - tUpdate).count();
+		timings.upload = std::chrono::duration<double, std::milli>(tUpload - tSort).count();
+		timings.totalUpdate += timings.update + timings.upload;
+		timings.totalSort += timings.sort;
+		timings.frameCount++;
 	}
 
 	void loadAssets()
@@ -392,15 +632,15 @@ public:
 		{
 			// Vertex input state
 			VkVertexInputBindingDescription vertexInputBinding =
-				vks::initializers::vertexInputBindingDescription(0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX);
+				vks::initializers::vertexInputBindingDescription(0, sizeof(ParticleVertex), VK_VERTEX_INPUT_RATE_VERTEX);
 
 			std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, pos)),	// Location 0: Position
-				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, color)),	// Location 1: Color
-				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(Particle, alpha)),			// Location 2: Alpha
-				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(Particle, size)),			// Location 3: Size
-				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(Particle, rotation)),		// Location 4: Rotation
-				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(Particle, type)),				// Location 5: Particle type
+				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(ParticleVertex, pos)),	// Location 0: Position
+				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(ParticleVertex, color)),	// Location 1: Color
+				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, alpha)),			// Location 2: Alpha
+				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, size)),			// Location 3: Size
+				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, rotation)),		// Location 4: Rotation
+				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(ParticleVertex, type)),				// Location 5: Particle type
 			};
 
 			VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -484,6 +724,10 @@ public:
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			benchmark.addMetric("particle update ms (cpu)", [this]() { return timings.totalUpdate / std::max(timings.frameCount, 1u); });
+			benchmark.addMetric("particle sort ms (cpu)", [this]() { return timings.totalSort / std::max(timings.frameCount, 1u); });
+		}
 		prepared = true;
 	}
 
@@ -530,7 +774,7 @@ public:
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &uniformBuffers[currentBuffer].particlesDescriptor, 0, nullptr);
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &particleBuffers[currentBuffer].buffer, offsets);
-		vkCmdDraw(cmdBuffer, static_cast<uint32_t>(particles.size()), 1, 0, 0);
+		vkCmdDraw(cmdBuffer, particleCount, 1, 0, 0);
 
 		drawUI(cmdBuffer);
 
@@ -552,6 +796,20 @@ public:
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Depth sort", &depthSort.enabled);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Particles: %d", particleCount);
+			overlay->text("Threads: %d", numThreads);
+			overlay->text("Update: %.3f ms", timings.update);
+			overlay->text("Sort: %.3f ms", timings.sort);
+			overlay->text("Upload: %.3f ms", timings.upload);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -12,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanImageCache.hpp"
 
 struct Material {
 	// Parameter block used as push constant block
@@ -82,6 +83,20 @@ public:
 	};
 	std::array<DescriptorSets, maxConcurrentFrames> descriptorSets{};
 
+	// Generated image based lighting maps are stored on disk keyed by a hash of the environment map and generation parameters
+	vks::ImageCache iblCache;
+	bool regenerateIBL{ false };
+	uint64_t environmentHash{ 0 };
+	struct IBLStats {
+		std::chrono::high_resolution_clock::time_point start;
+		// CPU time spent in prepare() for loading or setting up the generation of the maps
+		double setupTime{ 0.0 };
+		// Time until the maps can be used (loaded from the cache or GPU generation has finished)
+		double readyTime{ 0.0 };
+		bool warmCache{ true };
+		bool ready{ false };
+	} iblStats;
+
 	// Default materials to select from
 	std::vector<Material> materials;
 	int32_t materialIndex = 0;
@@ -120,11 +135,17 @@ public:
 		objectNames = { "Sphere", "Teapot", "Torusknot", "Venus" };
 
 		materialIndex = 9;
+
+		commandLineParser.add("regenerateibl", { "-ribl", "--regenerateibl" }, 0, "Ignore cached image based lighting maps and generate them again");
+		commandLineParser.parse(args);
+		regenerateIBL = commandLineParser.isSet("regenerateibl");
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
+			// Outstanding generation jobs still reference the textures
+			iblCache.destroy();
 			vkDestroyPipeline(device, pipelines.skybox, nullptr);
 			vkDestroyPipeline(device, pipelines.pbr, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -161,6 +182,7 @@ public:
 		}
 		// HDR cubemap
 		textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/pisa_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+		environmentHash = vks::ImageCache::hashFile(getAssetPath() + "textures/hdr/pisa_cube.ktx");
 	}
 
 	void setupDescriptors()
@@ -288,36 +310,47 @@ public:
 		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
 		const int32_t dim = 512;
 
-		// Image
-		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
-		imageCI.imageType = VK_IMAGE_TYPE_2D;
-		imageCI.format = format;
-		imageCI.extent.width = dim;
-		imageCI.extent.height = dim;
-		imageCI.extent.depth = 1;
-		imageCI.mipLevels = 1;
-		imageCI.arrayLayers = 1;
-		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, textures.lutBrdf.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lutBrdf.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, textures.lutBrdf.image, textures.lutBrdf.deviceMemory, 0));
-		// Image view
-		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
-		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewCI.format = format;
-		viewCI.subresourceRange = {};
-		viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewCI.subresourceRange.levelCount = 1;
-		viewCI.subresourceRange.layerCount = 1;
-		viewCI.image = textures.lutBrdf.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.lutBrdf.view));
+		// The LUT doesn't depend on the environment, so it's only keyed by the generation shader and the image parameters
+		const std::string cacheFile = iblCache.filename("brdflut", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbribl/genbrdflut.frag.spv"), format, dim));
+		const bool cached = !regenerateIBL && iblCache.contains(cacheFile);
+		if (cached) {
+			textures.lutBrdf.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			// Replaced by the clamping sampler created below
+			vkDestroySampler(device, textures.lutBrdf.sampler, nullptr);
+		} else {
+			iblStats.warmCache = false;
+
+			// Image
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = format;
+			imageCI.extent.width = dim;
+			imageCI.extent.height = dim;
+			imageCI.extent.depth = 1;
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, textures.lutBrdf.image, &memReqs);
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lutBrdf.deviceMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, textures.lutBrdf.image, textures.lutBrdf.deviceMemory, 0));
+			// Image view
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = format;
+			viewCI.subresourceRange = {};
+			viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewCI.subresourceRange.levelCount = 1;
+			viewCI.subresourceRange.layerCount = 1;
+			viewCI.image = textures.lutBrdf.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.lutBrdf.view));
+		}
 		// Sampler
 		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
 		samplerCI.magFilter = VK_FILTER_LINEAR;
@@ -336,6 +369,10 @@ public:
 		textures.lutBrdf.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.lutBrdf.device = vulkanDevice;
 
+		if (cached) {
+			return;
+		}
+
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
 		// Color attachment
@@ -468,20 +505,21 @@ public:
 		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 		vkCmdEndRenderPass(cmdBuf);
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkQueueWaitIdle(queue);
-
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.lutBrdf.image, format, dim, dim, 1, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Generate an irradiance cube map from the environment cube map
@@ -493,6 +531,21 @@ public:
 		const int32_t dim = 64;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			// Sampling deltas
+			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
+			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
+		} pushBlock;
+
+		// Keyed by the environment map, the filter shader and all parameters affecting the result
+		const std::string cacheFile = iblCache.filename("irradiancecube", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbribl/irradiancecube.frag.spv", environmentHash), format, dim, numMips, pushBlock.deltaPhi, pushBlock.deltaTheta));
+		if (!regenerateIBL && iblCache.contains(cacheFile)) {
+			textures.irradianceCube.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			return;
+		}
+		iblStats.warmCache = false;
+
 		// Pre-filtered cube map
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -505,7 +558,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -676,13 +729,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			// Sampling deltas
-			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -845,22 +891,24 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.irradianceCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
+			vkFreeMemory(device, offscreen.memory, nullptr);
+			vkDestroyImageView(device, offscreen.view, nullptr);
+			vkDestroyImage(device, offscreen.image, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Prefilter environment cubemap
@@ -873,6 +921,20 @@ public:
 		const int32_t dim = 512;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			float roughness;
+			uint32_t numSamples = 32u;
+		} pushBlock;
+
+		// Keyed by the environment map, the filter shader and all parameters affecting the result
+		const std::string cacheFile = iblCache.filename("prefilteredcube", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbribl/prefilterenvmap.frag.spv", environmentHash), format, dim, numMips, pushBlock.numSamples));
+		if (!regenerateIBL && iblCache.contains(cacheFile)) {
+			textures.prefilteredCube.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			return;
+		}
+		iblStats.warmCache = false;
+
 		// Pre-filtered cube map
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -885,7 +947,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -1056,12 +1118,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			float roughness;
-			uint32_t numSamples = 32u;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -1225,22 +1281,24 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.prefilteredCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
+			vkFreeMemory(device, offscreen.memory, nullptr);
+			vkDestroyImageView(device, offscreen.view, nullptr);
+			vkDestroyImage(device, offscreen.image, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -1285,9 +1343,13 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		// Image based lighting maps are either loaded from the cache or generated without blocking startup
+		iblStats.start = std::chrono::high_resolution_clock::now();
+		iblCache.create(vulkanDevice, "cache/pbribl/");
 		generateBRDFLUT();
 		generateIrradianceCube();
 		generatePrefilteredCube();
+		iblStats.setupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - iblStats.start).count();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
@@ -1360,6 +1422,12 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		// Finish generation jobs (release resources and write cache files) once the GPU is done with them
+		if (!iblStats.ready && iblCache.update()) {
+			iblStats.ready = true;
+			iblStats.readyTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - iblStats.start).count();
+			std::cout << "Image based lighting maps ready after " << iblStats.readyTime << " ms (" << (iblStats.warmCache ? "warm" : "cold") << " cache, " << iblStats.setupTime << " ms setup)" << std::endl;
+		}
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
@@ -1374,6 +1442,13 @@ public:
 			overlay->inputFloat("Gamma", &uniformDataParams.gamma, 0.1f, 2);
 			overlay->checkBox("Skybox", &displaySkybox);
 		}
+		if (overlay->header("Statistics")) {
+			overlay->text("IBL cache: %s", iblStats.warmCache ? "warm" : "cold");
+			overlay->text("IBL setup: %.2f ms", iblStats.setupTime);
+			if (iblStats.ready) {
+				overlay->text("IBL ready: %.2f ms", iblStats.readyTime);
+			}
+		}
 	}
 
 };
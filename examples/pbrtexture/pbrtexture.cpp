@@ -10,6 +10,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanImageCache.hpp"
+#include "VulkanKTX2.hpp"
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -68,6 +70,24 @@ public:
 	};
 	std::array<DescriptorSets, maxConcurrentFrames> descriptorSets{};
 
+	// Generated image based lighting maps are stored on disk keyed by a hash of the environment map and generation parameters
+	vks::ImageCache iblCache;
+	bool regenerateIBL{ false };
+	// Load the object texture maps from KTX2 files (if present) instead of KTX1 to compare size, load time and memory
+	bool useKTX2{ false };
+	// Result of parsing and decoding a KTX2 file built in memory, the asset pack only ships KTX1 files
+	bool ktx2ParserValid{ false };
+	uint64_t environmentHash{ 0 };
+	struct IBLStats {
+		std::chrono::high_resolution_clock::time_point start;
+		// CPU time spent in prepare() for loading or setting up the generation of the maps
+		double setupTime{ 0.0 };
+		// Time until the maps can be used (loaded from the cache or GPU generation has finished)
+		double readyTime{ 0.0 };
+		bool warmCache{ true };
+		bool ready{ false };
+	} iblStats;
+
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Textured PBR with IBL";
@@ -77,11 +97,19 @@ public:
 		camera.rotationSpeed = 0.25f;
 		camera.setRotation({ -7.75f, 150.25f, 0.0f });
 		camera.setPosition({ 0.7f, 0.1f, 1.7f });
+
+		commandLineParser.add("regenerateibl", { "-ribl", "--regenerateibl" }, 0, "Ignore cached image based lighting maps and generate them again");
+		commandLineParser.add("ktx2", { "-ktx2", "--ktx2" }, 0, "Load the object textures from KTX2 files (transcoded to the best compressed format the device supports)");
+		commandLineParser.parse(args);
+		regenerateIBL = commandLineParser.isSet("regenerateibl");
+		useKTX2 = commandLineParser.isSet("ktx2");
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
+			// Outstanding generation jobs still reference the textures
+			iblCache.destroy();
 			vkDestroyPipeline(device, pipelines.skybox, nullptr);
 			vkDestroyPipeline(device, pipelines.pbr, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -108,6 +136,20 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// Transcoded KTX2 textures use the best of these formats that's available
+		enabledFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC;
+		enabledFeatures.textureCompressionASTC_LDR = deviceFeatures.textureCompressionASTC_LDR;
+		enabledFeatures.textureCompressionETC2 = deviceFeatures.textureCompressionETC2;
+	}
+
+	// Returns the KTX2 version of a texture map if requested and available, the KTX1 file otherwise
+	std::string textureMapFile(const std::string& name)
+	{
+		const std::string filename = getAssetPath() + "models/cerberus/" + name;
+		if (useKTX2 && vks::tools::fileExists(filename + ".ktx2")) {
+			return filename + ".ktx2";
+		}
+		return filename + ".ktx";
 	}
 
 	void loadAssets()
@@ -116,11 +158,12 @@ public:
 		models.skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.object.loadFromFile(getAssetPath() + "models/cerberus/cerberus.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
-		textures.albedoMap.loadFromFile(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.normalMap.loadFromFile(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.aoMap.loadFromFile(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-		textures.metallicMap.loadFromFile(getAssetPath() + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-		textures.roughnessMap.loadFromFile(getAssetPath() + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+		environmentHash = vks::ImageCache::hashFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx");
+		textures.albedoMap.loadFromFile(textureMapFile("albedo"), VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		textures.normalMap.loadFromFile(textureMapFile("normal"), VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		textures.aoMap.loadFromFile(textureMapFile("ao"), VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+		textures.metallicMap.loadFromFile(textureMapFile("metallic"), VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+		textures.roughnessMap.loadFromFile(textureMapFile("roughness"), VK_FORMAT_R8_UNORM, vulkanDevice, queue);
 	}
 
 	void setupDescriptors()
@@ -234,36 +277,47 @@ public:
 		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
 		const int32_t dim = 512;
 
-		// Image
-		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
-		imageCI.imageType = VK_IMAGE_TYPE_2D;
-		imageCI.format = format;
-		imageCI.extent.width = dim;
-		imageCI.extent.height = dim;
-		imageCI.extent.depth = 1;
-		imageCI.mipLevels = 1;
-		imageCI.arrayLayers = 1;
-		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, textures.lutBrdf.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lutBrdf.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, textures.lutBrdf.image, textures.lutBrdf.deviceMemory, 0));
-		// Image view
-		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
-		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewCI.format = format;
-		viewCI.subresourceRange = {};
-		viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewCI.subresourceRange.levelCount = 1;
-		viewCI.subresourceRange.layerCount = 1;
-		viewCI.image = textures.lutBrdf.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.lutBrdf.view));
+		// The LUT doesn't depend on the environment, so it's only keyed by the generation shader and the image parameters
+		const std::string cacheFile = iblCache.filename("brdflut", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbrtexture/genbrdflut.frag.spv"), format, dim));
+		const bool cached = !regenerateIBL && iblCache.contains(cacheFile);
+		if (cached) {
+			textures.lutBrdf.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			// Replaced by the clamping sampler created below
+			vkDestroySampler(device, textures.lutBrdf.sampler, nullptr);
+		} else {
+			iblStats.warmCache = false;
+
+			// Image
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = format;
+			imageCI.extent.width = dim;
+			imageCI.extent.height = dim;
+			imageCI.extent.depth = 1;
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, textures.lutBrdf.image, &memReqs);
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lutBrdf.deviceMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, textures.lutBrdf.image, textures.lutBrdf.deviceMemory, 0));
+			// Image view
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = format;
+			viewCI.subresourceRange = {};
+			viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewCI.subresourceRange.levelCount = 1;
+			viewCI.subresourceRange.layerCount = 1;
+			viewCI.image = textures.lutBrdf.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.lutBrdf.view));
+		}
 		// Sampler
 		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
 		samplerCI.magFilter = VK_FILTER_LINEAR;
@@ -282,6 +336,10 @@ public:
 		textures.lutBrdf.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.lutBrdf.device = vulkanDevice;
 
+		if (cached) {
+			return;
+		}
+
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
 		// Color attachment
@@ -414,20 +472,21 @@ public:
 		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 		vkCmdEndRenderPass(cmdBuf);
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkQueueWaitIdle(queue);
-
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.lutBrdf.image, format, dim, dim, 1, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Generate an irradiance cube map from the environment cube map
@@ -439,6 +498,21 @@ public:
 		const int32_t dim = 64;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			// Sampling deltas
+			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
+			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
+		} pushBlock;
+
+		// Keyed by the environment map, the filter shader and all parameters affecting the result
+		const std::string cacheFile = iblCache.filename("irradiancecube", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbrtexture/irradiancecube.frag.spv", environmentHash), format, dim, numMips, pushBlock.deltaPhi, pushBlock.deltaTheta));
+		if (!regenerateIBL && iblCache.contains(cacheFile)) {
+			textures.irradianceCube.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			return;
+		}
+		iblStats.warmCache = false;
+
 		// Pre-filtered cube map
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -451,7 +525,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -622,13 +696,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			// Sampling deltas
-			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -791,22 +858,24 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.irradianceCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
+			vkFreeMemory(device, offscreen.memory, nullptr);
+			vkDestroyImageView(device, offscreen.view, nullptr);
+			vkDestroyImage(device, offscreen.image, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Prefilter environment cubemap
@@ -819,6 +888,20 @@ public:
 		const int32_t dim = 512;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			float roughness;
+			uint32_t numSamples = 32u;
+		} pushBlock;
+
+		// Keyed by the environment map, the filter shader and all parameters affecting the result
+		const std::string cacheFile = iblCache.filename("prefilteredcube", vks::ImageCache::hashValues(vks::ImageCache::hashFile(getShadersPath() + "pbrtexture/prefilterenvmap.frag.spv", environmentHash), format, dim, numMips, pushBlock.numSamples));
+		if (!regenerateIBL && iblCache.contains(cacheFile)) {
+			textures.prefilteredCube.loadFromFile(cacheFile, format, vulkanDevice, queue);
+			return;
+		}
+		iblStats.warmCache = false;
+
 		// Pre-filtered cube map
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -831,7 +914,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -1002,12 +1085,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			float roughness;
-			uint32_t numSamples = 32u;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -1171,22 +1248,24 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		iblCache.recordSave(cmdBuf, cacheFile, textures.prefilteredCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Submit without waiting, temporary resources are released once the GPU has finished (see render)
+		iblCache.submit(queue, cmdBuf, [=, this]() {
+			vkDestroyRenderPass(device, renderpass, nullptr);
+			vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
+			vkFreeMemory(device, offscreen.memory, nullptr);
+			vkDestroyImageView(device, offscreen.view, nullptr);
+			vkDestroyImage(device, offscreen.image, nullptr);
+			vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		});
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -1228,16 +1307,75 @@ public:
 		memcpy(uniformBuffers[currentBuffer].params.mapped, &uniformDataParams, sizeof(UniformDataParams));
 	}
 
+	// Builds a minimal 4x4 RGBA8 KTX2 file in memory, checks that it's parsed and decoded unchanged and that a zero pixel width or a wrong level size is rejected
+	bool verifyKTX2Parsing()
+	{
+		const uint32_t levelIndexOffset = 80;
+		const uint32_t levelDataOffset = levelIndexOffset + sizeof(vks::ktx2::Level);
+		const uint32_t levelSize = 4 * 4 * 4;
+		std::vector<uint8_t> bytes(levelDataOffset + levelSize, 0);
+		auto write = [&bytes](size_t offset, auto value) { memcpy(bytes.data() + offset, &value, sizeof(value)); };
+		memcpy(bytes.data(), vks::ktx2::identifier, sizeof(vks::ktx2::identifier));
+		write(12, (uint32_t)VK_FORMAT_R8G8B8A8_UNORM);
+		write(16, (uint32_t)1);
+		write(20, (uint32_t)4);
+		write(24, (uint32_t)4);
+		write(36, (uint32_t)1);
+		write(40, (uint32_t)1);
+		write(levelIndexOffset, vks::ktx2::Level{ levelDataOffset, levelSize, levelSize });
+		for (uint32_t i = 0; i < levelSize; i++) {
+			bytes[levelDataOffset + i] = static_cast<uint8_t>(i);
+		}
+		const std::vector<uint8_t> levelData(bytes.begin() + levelDataOffset, bytes.end());
+
+		std::string error;
+		vks::ktx2::File zeroWidthFile;
+		std::vector<uint8_t> zeroWidthBytes = bytes;
+		memset(zeroWidthBytes.data() + 20, 0, sizeof(uint32_t));
+		if (zeroWidthFile.parse(std::move(zeroWidthBytes), error)) {
+			return false;
+		}
+		vks::ktx2::File levelSizeFile;
+		std::vector<uint8_t> levelSizeBytes = bytes;
+		const vks::ktx2::Level wrongSizeLevel{ levelDataOffset, levelSize, levelSize * 2 };
+		memcpy(levelSizeBytes.data() + levelIndexOffset, &wrongSizeLevel, sizeof(vks::ktx2::Level));
+		if (levelSizeFile.parse(std::move(levelSizeBytes), error)) {
+			return false;
+		}
+
+		vks::ktx2::File file;
+		if (!file.parse(std::move(bytes), error) || (file.width != 4) || (file.height != 4) || (file.levelCount != 1) || (file.vkFormat != VK_FORMAT_R8G8B8A8_UNORM) || file.isBasis()) {
+			return false;
+		}
+		std::vector<uint8_t> decoded(levelSize);
+		if (!vks::ktx2::decodeLevels(file, VK_FORMAT_UNDEFINED, decoded.data(), { 0 }, decoded.size(), error)) {
+			return false;
+		}
+		return decoded == levelData;
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		ktx2ParserValid = verifyKTX2Parsing();
 		loadAssets();
+		// Image based lighting maps are either loaded from the cache or generated without blocking startup
+		iblStats.start = std::chrono::high_resolution_clock::now();
+		iblCache.create(vulkanDevice, "cache/pbrtexture/");
 		generateBRDFLUT();
 		generateIrradianceCube();
 		generatePrefilteredCube();
+		iblStats.setupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - iblStats.start).count();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			benchmark.addMetric("texture load ms", [this]() { return textureMapStats().loadTime; });
+			benchmark.addMetric("texture file kb", [this]() { return (double)textureMapStats().fileSize / 1024.0; });
+			benchmark.addMetric("texture vram kb", [this]() { return (double)textureMapStats().memorySize / 1024.0; });
+			benchmark.addMetric("ktx2 maps", [this]() { return (double)ktx2MapCount(); });
+			benchmark.addMetric("ktx2 parser valid", [this]() { return ktx2ParserValid ? 1.0 : 0.0; });
+		}
 		prepared = true;
 	}
 
@@ -1298,11 +1436,60 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		// Finish generation jobs (release resources and write cache files) once the GPU is done with them
+		if (!iblStats.ready && iblCache.update()) {
+			iblStats.ready = true;
+			iblStats.readyTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - iblStats.start).count();
+			std::cout << "Image based lighting maps ready after " << iblStats.readyTime << " ms (" << (iblStats.warmCache ? "warm" : "cold") << " cache, " << iblStats.setupTime << " ms setup)" << std::endl;
+		}
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
 	}
 
+	const char* textureFormatName(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return "BC7";
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			return "ASTC 4x4";
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+			return "ETC2 RGBA";
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return "RGBA8";
+		default:
+			return "other";
+		}
+	}
+
+	// Accumulated load statistics of the object texture maps
+	vks::Texture::LoadStats textureMapStats()
+	{
+		vks::Texture::LoadStats total{};
+		for (vks::Texture* texture : { &textures.albedoMap, &textures.normalMap, &textures.aoMap, &textures.metallicMap, &textures.roughnessMap }) {
+			total.fileSize += texture->loadStats.fileSize;
+			total.memorySize += texture->loadStats.memorySize;
+			total.loadTime += texture->loadStats.loadTime;
+			total.transcoded |= texture->loadStats.transcoded;
+		}
+		return total;
+	}
+
+	// Number of object texture maps that were actually loaded from KTX2 files
+	uint32_t ktx2MapCount()
+	{
+		uint32_t count = 0;
+		for (vks::Texture* texture : { &textures.albedoMap, &textures.normalMap, &textures.aoMap, &textures.metallicMap, &textures.roughnessMap }) {
+			count += texture->loadStats.ktx2 ? 1 : 0;
+		}
+		return count;
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
@@ -1310,6 +1497,30 @@ public:
 			overlay->inputFloat("Gamma", &uniformDataParams.gamma, 0.1f, 2);
 			overlay->checkBox("Skybox", &displaySkybox);
 		}
+		if (overlay->header("Statistics")) {
+			overlay->text("IBL cache: %s", iblStats.warmCache ? "warm" : "cold");
+			overlay->text("IBL setup: %.2f ms", iblStats.setupTime);
+			if (iblStats.ready) {
+				overlay->text("IBL ready: %.2f ms", iblStats.readyTime);
+			}
+		}
+		if (overlay->header("Texture maps")) {
+			const vks::Texture::LoadStats stats = textureMapStats();
+			// Requested KTX2 files fall back to KTX1 if they're missing, so the container is reported from what was loaded
+			const uint32_t ktx2Maps = ktx2MapCount();
+			if (ktx2Maps == 0) {
+				overlay->text("Container: KTX1%s", useKTX2 ? " (no KTX2 files found)" : "");
+			} else if (ktx2Maps == 5) {
+				overlay->text("Container: KTX2%s", stats.transcoded ? " (transcoded)" : "");
+			} else {
+				overlay->text("Container: KTX2 for %d of 5 maps%s", ktx2Maps, stats.transcoded ? " (transcoded)" : "");
+			}
+			overlay->text("KTX2 parser check: %s", ktx2ParserValid ? "passed" : "failed");
+			overlay->text("Albedo format: %s", textureFormatName(textures.albedoMap.loadStats.format));
+			overlay->text("File size: %.2f MB", (double)stats.fileSize / (1024.0 * 1024.0));
+			overlay->text("VRAM: %.2f MB", (double)stats.memorySize / (1024.0 * 1024.0));
+			overlay->text("Load time: %.2f ms", stats.loadTime);
+		}
 	}
 };
 
@@ -9,11 +9,12 @@
 #include "VulkanRaytracingSample.h"
 #define VK_GLTF_MATERIAL_IDS
 #include "VulkanglTFModel.h"
+#include "VulkanAccelerationStructureBuilder.hpp"
 
 class VulkanExample : public VulkanRaytracingSample
 {
 public:
-	AccelerationStructure bottomLevelAS{};
+	vks::AccelerationStructureBuilder accelerationStructureBuilder;
 	AccelerationStructure topLevelAS{};
 
 	vks::Buffer vertexBuffer;
@@ -81,7 +82,7 @@ public:
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 			deleteStorageImage();
-			deleteAccelerationStructure(bottomLevelAS);
+			accelerationStructureBuilder.destroy();
 			deleteAccelerationStructure(topLevelAS);
 			vertexBuffer.destroy();
 			indexBuffer.destroy();
@@ -147,10 +148,8 @@ public:
 		
 		// Build
 		// One geometry per glTF node, so we can index materials using gl_GeometryIndexEXT
-		std::vector<uint32_t> maxPrimitiveCounts{};
 		std::vector<VkAccelerationStructureGeometryKHR> geometries{};
 		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRangeInfos{};
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> pBuildRangeInfos{};
 		std::vector<GeometryNode> geometryNodes{};
 		for (auto node : model.linearNodes) {
 			if (node->mesh) {
@@ -177,7 +176,6 @@ public:
 						geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
 						geometry.geometry.triangles.transformData = transformBufferDeviceAddress;
 						geometries.push_back(geometry);
-						maxPrimitiveCounts.push_back(primitive->indexCount / 3);
 
 						VkAccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
 						buildRangeInfo.firstVertex = 0;
@@ -196,9 +194,6 @@ public:
 				}
 			}
 		}
-		for (auto& rangeInfo : buildRangeInfos) {
-			pBuildRangeInfos.push_back(&rangeInfo);
-		}
 
 		vks::Buffer stagingBuffer;
 
@@ -219,57 +214,19 @@ public:
 
 		stagingBuffer.destroy();
 	
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo{};
-		accelerationStructureBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = static_cast<uint32_t>(geometries.size());
-		accelerationStructureBuildGeometryInfo.pGeometries = geometries.data();
-		
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
-		accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-		vkGetAccelerationStructureBuildSizesKHR(
-			device,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			maxPrimitiveCounts.data(),
-			&accelerationStructureBuildSizesInfo);
-
-		createAccelerationStructureBuffer(bottomLevelAS, accelerationStructureBuildSizesInfo);
-
-		VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
-		accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-		accelerationStructureCreateInfo.buffer = bottomLevelAS.buffer;
-		accelerationStructureCreateInfo.size = accelerationStructureBuildSizesInfo.accelerationStructureSize;
-		accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &bottomLevelAS.handle);
-
-		// Create a small scratch buffer used during build of the bottom level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		accelerationStructureBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationStructureBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-		accelerationStructureBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
-		const VkAccelerationStructureBuildRangeInfoKHR* buildOffsetInfo = buildRangeInfos.data();
-
-		// Build the acceleration structure on the device via a one-time command buffer submission
-		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vkCmdBuildAccelerationStructuresKHR(
-			commandBuffer,
-			1,
-			&accelerationStructureBuildGeometryInfo,
-			pBuildRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
-
-		VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
-		accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-		accelerationDeviceAddressInfo.accelerationStructure = bottomLevelAS.handle;
-		bottomLevelAS.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
-
-		deleteScratchBuffer(scratchBuffer);
+		// Build and compact the acceleration structure using the batched builder from the base
+		// The builder suballocates storage and scratch memory and submits all builds with a single command buffer
+		accelerationStructureBuilder.create(vulkanDevice);
+		vks::AccelerationStructureBuilder::BottomLevelInput input{};
+		input.geometries = geometries;
+		input.buildRanges = buildRangeInfos;
+		input.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationStructureBuilder.add(input);
+		accelerationStructureBuilder.build(queue, true);
+
+		const auto& stats = accelerationStructureBuilder.stats;
+		std::cout << "Bottom level acceleration structure built in " << stats.buildTime << " ms (" << stats.batchCount << " batch, " << stats.scratchSize / 1024 << " KB scratch), compacted in " << stats.compactionTime << " ms\n";
+		std::cout << "Acceleration structure memory: " << stats.memoryBeforeCompaction / 1024 << " KB before, " << stats.memoryAfterCompaction / 1024 << " KB after compaction\n";
 	}
 
 	/*
@@ -289,7 +246,7 @@ public:
 		instance.mask = 0xFF;
 		instance.instanceShaderBindingTableRecordOffset = 0;
 		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-		instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
+		instance.accelerationStructureReference = accelerationStructureBuilder.accelerationStructures[0].deviceAddress;
 
 		// Buffer for instance data
 		vks::Buffer instancesBuffer;
@@ -31,37 +31,17 @@ public:
 	VkPhysicalDeviceShaderObjectFeaturesEXT enabledShaderObjectFeaturesEXT{};
 	VkPhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRenderingFeaturesKHR{};
 
-	PFN_vkCreateShadersEXT vkCreateShadersEXT{ VK_NULL_HANDLE };
 	PFN_vkDestroyShaderEXT vkDestroyShaderEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdBindShadersEXT vkCmdBindShadersEXT{ VK_NULL_HANDLE };
-	PFN_vkGetShaderBinaryDataEXT vkGetShaderBinaryDataEXT{ VK_NULL_HANDLE };
 
 	// VK_EXT_shader_objects requires render passes to be dynamic
 	PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR{ VK_NULL_HANDLE };
 	PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR{ VK_NULL_HANDLE };
 
-	// With VK_EXT_shader_object pipeline state must be set at command buffer creation using these functions
-	PFN_vkCmdSetAlphaToCoverageEnableEXT vkCmdSetAlphaToCoverageEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetColorWriteMaskEXT vkCmdSetColorWriteMaskEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamplesEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetSampleMaskEXT vkCmdSetSampleMaskEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetScissorWithCountEXT vkCmdSetScissorWithCountEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT{ VK_NULL_HANDLE };
-	PFN_vkCmdSetViewportWithCountEXT vkCmdSetViewportWithCountEXT{ VK_NULL_HANDLE };
-
-	// VK_EXT_vertex_input_dynamic_state
-	PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT{ VK_NULL_HANDLE };
+	// With VK_EXT_shader_object pipeline state must be set at command buffer creation, this replaces the state baked into a pipeline
+	vks::ShaderObjectState shaderObjectState;
+
+	// Time from the start of prepare until the example is ready to render, includes shader creation
+	double startupTime{ 0.0 };
 
 	VulkanExample() : VulkanExampleBase()
 	{
@@ -96,6 +76,9 @@ public:
 		enabledDynamicRenderingFeaturesKHR.pNext = &enabledShaderObjectFeaturesEXT;
 
 		deviceCreatepNextChain = &enabledDynamicRenderingFeaturesKHR;
+
+		// Shader binaries and pipeline cache data are stored in cache/shaders, so warm starts skip compiling the SPIR-V
+		settings.shaderCache = true;
 	}
 
 	~VulkanExample()
@@ -131,6 +114,8 @@ public:
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		// The bindings are part of the shader binaries' cache key
+		shaderCache.addSetLayout(descriptorSetLayout, descriptorLayout);
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 		// Sets per frame, just like the buffers themselves
@@ -144,122 +129,62 @@ public:
 		}
 	}
 
-	// Loads a binary shader file
-	void _loadShader(std::string filename, char* &code, size_t &size) {
-		// @todo: Android
-		std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
-		if (is.is_open())
-		{
-			size = is.tellg();
-			is.seekg(0, std::ios::beg);
-			code = new char[size];
-			is.read(code, size);
-			is.close();
-			assert(size > 0);
-		}
-		else
-		{
-			vks::tools::exitFatal("Error: Could not open shader " + filename, VK_ERROR_UNKNOWN);
-		}
-	}
-
 	void createShaderObjects()
 	{
-		size_t shaderCodeSizes[2]{};
-		char* shaderCodes[2]{};
+		// Binaries stored by an earlier run are loaded by the shader cache if they match the device, the driver and the SPIR-V, otherwise the SPIR-V is compiled and the binaries are stored for the next start
+		const std::vector<char> vertexCode = vks::ShaderCache::readSpirv(getShadersPath() + "shaderobjects/phong.vert.spv");
+		const std::vector<char> fragmentCode = vks::ShaderCache::readSpirv(getShadersPath() + "shaderobjects/phong.frag.spv");
 
 		VkShaderCreateInfoEXT shaderCreateInfos[2]{};
+		// VS
+		shaderCreateInfos[0].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+		shaderCreateInfos[0].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
+		shaderCreateInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderCreateInfos[0].nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderCreateInfos[0].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+		shaderCreateInfos[0].pCode = vertexCode.data();
+		shaderCreateInfos[0].codeSize = vertexCode.size();
+		shaderCreateInfos[0].pName = "main";
+		shaderCreateInfos[0].setLayoutCount = 1;
+		shaderCreateInfos[0].pSetLayouts = &descriptorSetLayout;
+		// FS
+		shaderCreateInfos[1].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+		shaderCreateInfos[1].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
+		shaderCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderCreateInfos[1].nextStage = 0;
+		shaderCreateInfos[1].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+		shaderCreateInfos[1].pCode = fragmentCode.data();
+		shaderCreateInfos[1].codeSize = fragmentCode.size();
+		shaderCreateInfos[1].pName = "main";
+		shaderCreateInfos[1].setLayoutCount = 1;
+		shaderCreateInfos[1].pSetLayouts = &descriptorSetLayout;
+
+		VK_CHECK_RESULT(shaderCache.createShaders(2, shaderCreateInfos, shaders));
+	}
 
-		// With VK_EXT_shader_object we can generate an implementation dependent binary file that's faster to load
-		// So we check if the binray files exist and if we can load it instead of the SPIR-V
-		bool binaryShadersLoaded = false;
-
-		if (vks::tools::fileExists(getShadersPath() + "shaderobjects/phong.vert.bin") && vks::tools::fileExists(getShadersPath() + "shaderobjects/phong.frag.bin")) {
-			// VS
-			_loadShader(getShadersPath() + "shaderobjects/phong.vert.bin", shaderCodes[0], shaderCodeSizes[0]);
-			shaderCreateInfos[0].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
-			shaderCreateInfos[0].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
-			shaderCreateInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-			shaderCreateInfos[0].nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			shaderCreateInfos[0].codeType = VK_SHADER_CODE_TYPE_BINARY_EXT;
-			shaderCreateInfos[0].pCode = shaderCodes[0];
-			shaderCreateInfos[0].codeSize = shaderCodeSizes[0];
-			shaderCreateInfos[0].pName = "main";
-			shaderCreateInfos[0].setLayoutCount = 1;
-			shaderCreateInfos[0].pSetLayouts = &descriptorSetLayout;
-
-			// FS
-			_loadShader(getShadersPath() + "shaderobjects/phong.frag.bin", shaderCodes[1], shaderCodeSizes[1]);
-			shaderCreateInfos[1].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
-			shaderCreateInfos[1].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
-			shaderCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			shaderCreateInfos[1].nextStage = 0;
-			shaderCreateInfos[1].codeType = VK_SHADER_CODE_TYPE_BINARY_EXT;
-			shaderCreateInfos[1].pCode = shaderCodes[1];
-			shaderCreateInfos[1].codeSize = shaderCodeSizes[1];
-			shaderCreateInfos[1].pName = "main";
-			shaderCreateInfos[1].setLayoutCount = 1;
-			shaderCreateInfos[1].pSetLayouts = &descriptorSetLayout;
-
-			VkResult result = vkCreateShadersEXT(device, 2, shaderCreateInfos, nullptr, shaders);
-			// If the function returns e.g. VK_ERROR_INCOMPATIBLE_SHADER_BINARY_EXT, the binary file is no longer (or not at all) compatible with the current implementation
-			if (result == VK_SUCCESS) {
-				binaryShadersLoaded = true;
-			} else {
-				std::cout << "Could not load binary shader files (" << vks::tools::errorString(result) << ", loading SPIR - V instead\n";
-			}
-		}
+	void prepareShaderObjectState()
+	{
+		shaderObjectState.create(device);
+		shaderObjectState.vertexBindings = {
+			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT, nullptr, 0, sizeof(vkglTF::Vertex), VK_VERTEX_INPUT_RATE_VERTEX, 1 }
+		};
+		shaderObjectState.vertexAttributes = {
+			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, pos) },
+			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, normal) },
+			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vkglTF::Vertex, color) }
+		};
+	}
 
-		// If the binary files weren't present, or we could not load them, we load from SPIR-V
-		if (!binaryShadersLoaded) {
-			// VS
-			_loadShader(getShadersPath() + "shaderobjects/phong.vert.spv", shaderCodes[0], shaderCodeSizes[0]);
-			shaderCreateInfos[0].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
-			shaderCreateInfos[0].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
-			shaderCreateInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-			shaderCreateInfos[0].nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			shaderCreateInfos[0].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
-			shaderCreateInfos[0].pCode = shaderCodes[0];
-			shaderCreateInfos[0].codeSize = shaderCodeSizes[0];
-			shaderCreateInfos[0].pName = "main";
-			shaderCreateInfos[0].setLayoutCount = 1;
-			shaderCreateInfos[0].pSetLayouts = &descriptorSetLayout;
-
-			// FS
-			_loadShader(getShadersPath() + "shaderobjects/phong.frag.spv", shaderCodes[1], shaderCodeSizes[1]);
-			shaderCreateInfos[1].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
-			shaderCreateInfos[1].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
-			shaderCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			shaderCreateInfos[1].nextStage = 0;
-			shaderCreateInfos[1].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
-			shaderCreateInfos[1].pCode = shaderCodes[1];
-			shaderCreateInfos[1].codeSize = shaderCodeSizes[1];
-			shaderCreateInfos[1].pName = "main";
-			shaderCreateInfos[1].setLayoutCount = 1;
-			shaderCreateInfos[1].pSetLayouts = &descriptorSetLayout;
-
-			VK_CHECK_RESULT(vkCreateShadersEXT(device, 2, shaderCreateInfos, nullptr, shaders));
-
-			// Store the binary shader files so we can try to load them at the next start
-			size_t dataSize{ 0 };
-			char* data{ nullptr };
-			std::fstream is;
-
-			vkGetShaderBinaryDataEXT(device, shaders[0], &dataSize, nullptr);
-			data = new char[dataSize];
-			vkGetShaderBinaryDataEXT(device, shaders[0], &dataSize, data);
-			is.open(getShadersPath() + "shaderobjects/phong.vert.bin", std::ios::binary | std::ios::out);
-			is.write(data, dataSize);
-			is.close();
-			delete[] data;
-
-			vkGetShaderBinaryDataEXT(device, shaders[1], &dataSize, nullptr);
-			data = new char[dataSize];
-			vkGetShaderBinaryDataEXT(device, shaders[1], &dataSize, data);
-			is.open(getShadersPath() + "shaderobjects/phong.frag.bin", std::ios::binary | std::ios::out);
-			is.write(data, dataSize);
-			is.close();
-			delete[] data;
+	void addStartupMetrics()
+	{
+		// The UI is not available with shader objects, so the startup statistics are only reported by the benchmark
+		if (benchmark.active) {
+			benchmark.addMetric("startup ms", [this]() { return startupTime; });
+			benchmark.addMetric("shader creation warm ms", [this]() { return shaderCache.stats.warmTime; });
+			benchmark.addMetric("shader creation cold ms", [this]() { return shaderCache.stats.coldTime; });
+			benchmark.addMetric("shader binaries loaded", [this]() { return (double)shaderCache.stats.hits; });
+			benchmark.addMetric("shader binaries rejected", [this]() { return (double)shaderCache.stats.rejected; });
+			benchmark.addMetric("pipeline cache data loaded", [this]() { return shaderCache.stats.pipelineCacheLoaded ? 1.0 : 0.0; });
 		}
 	}
 
@@ -281,42 +206,22 @@ public:
 
 	void prepare()
 	{
+		const auto tStart = std::chrono::high_resolution_clock::now();
 		VulkanExampleBase::prepare();
 
 		// As this is an extension, we need to explicitly load the function pointers for the shader object commands used in this sample
-
-		vkCreateShadersEXT = reinterpret_cast<PFN_vkCreateShadersEXT>(vkGetDeviceProcAddr(device, "vkCreateShadersEXT"));
+		// Shader creation and the dynamic state functions are loaded by the shader cache and the shader object state
 		vkDestroyShaderEXT = reinterpret_cast<PFN_vkDestroyShaderEXT>(vkGetDeviceProcAddr(device, "vkDestroyShaderEXT"));
-		vkCmdBindShadersEXT = reinterpret_cast<PFN_vkCmdBindShadersEXT>(vkGetDeviceProcAddr(device, "vkCmdBindShadersEXT"));
-		vkGetShaderBinaryDataEXT = reinterpret_cast<PFN_vkGetShaderBinaryDataEXT>(vkGetDeviceProcAddr(device, "vkGetShaderBinaryDataEXT"));
-
 		vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
 		vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
 
-		vkCmdSetAlphaToCoverageEnableEXT = reinterpret_cast<PFN_vkCmdSetAlphaToCoverageEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetAlphaToCoverageEnableEXT"));
-		vkCmdSetColorBlendEnableEXT = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
-		vkCmdSetColorWriteMaskEXT = reinterpret_cast<PFN_vkCmdSetColorWriteMaskEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT"));
-		vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
-		vkCmdSetDepthBiasEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthBiasEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthBiasEnableEXT"));
-		vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
-		vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
-		vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
-		vkCmdSetFrontFaceEXT = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
-		vkCmdSetPolygonModeEXT = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT"));
-		vkCmdSetPrimitiveRestartEnableEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT"));
-		vkCmdSetPrimitiveTopologyEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
-		vkCmdSetRasterizationSamplesEXT = reinterpret_cast<PFN_vkCmdSetRasterizationSamplesEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT"));
-		vkCmdSetRasterizerDiscardEnableEXT = reinterpret_cast<PFN_vkCmdSetRasterizerDiscardEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizerDiscardEnableEXT"));
-		vkCmdSetSampleMaskEXT = reinterpret_cast<PFN_vkCmdSetSampleMaskEXT>(vkGetDeviceProcAddr(device, "vkCmdSetSampleMaskEXT"));
-		vkCmdSetScissorWithCountEXT = reinterpret_cast<PFN_vkCmdSetScissorWithCountEXT>(vkGetDeviceProcAddr(device, "vkCmdSetScissorWithCountEXT"));
-		vkCmdSetStencilTestEnableEXT = reinterpret_cast<PFN_vkCmdSetStencilTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetStencilTestEnableEXT"));
-		vkCmdSetVertexInputEXT = reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT"));
-		vkCmdSetViewportWithCountEXT = reinterpret_cast<PFN_vkCmdSetViewportWithCountEXT>(vkGetDeviceProcAddr(device, "vkCmdSetViewportWithCountEXT"));;
-
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptors();
 		createShaderObjects();
+		prepareShaderObjectState();
+		startupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		addStartupMetrics();
 		prepared = true;
 	}
 
@@ -381,58 +286,16 @@ public:
 		// Begin dynamic rendering
 		vkCmdBeginRenderingKHR(cmdBuffer, &renderingInfo);
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-
 		// No more pipelines required, everything is bound at command buffer level
 		// This also means that we need to explicitly set a lot of the state to be spec compliant
-
-		vkCmdSetViewportWithCountEXT(cmdBuffer, 1, &viewport);
-		vkCmdSetScissorWithCountEXT(cmdBuffer, 1, &scissor);
-		vkCmdSetCullModeEXT(cmdBuffer, VK_CULL_MODE_BACK_BIT);
-		vkCmdSetFrontFaceEXT(cmdBuffer, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-		vkCmdSetDepthTestEnableEXT(cmdBuffer, VK_TRUE);
-		vkCmdSetDepthWriteEnableEXT(cmdBuffer, VK_TRUE);
-		vkCmdSetDepthCompareOpEXT(cmdBuffer, VK_COMPARE_OP_LESS_OR_EQUAL);
-		vkCmdSetPrimitiveTopologyEXT(cmdBuffer, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-		vkCmdSetRasterizerDiscardEnableEXT(cmdBuffer, VK_FALSE);
-		vkCmdSetPolygonModeEXT(cmdBuffer, VK_POLYGON_MODE_FILL);
-		vkCmdSetRasterizationSamplesEXT(cmdBuffer, VK_SAMPLE_COUNT_1_BIT);
-		vkCmdSetAlphaToCoverageEnableEXT(cmdBuffer, VK_FALSE);
-		vkCmdSetDepthBiasEnableEXT(cmdBuffer, VK_FALSE);
-		vkCmdSetStencilTestEnableEXT(cmdBuffer, VK_FALSE);
-		vkCmdSetPrimitiveRestartEnableEXT(cmdBuffer, VK_FALSE);
-
-		const uint32_t sampleMask = 0xFF;
-		vkCmdSetSampleMaskEXT(cmdBuffer, VK_SAMPLE_COUNT_1_BIT, &sampleMask);
-
-		const VkBool32 colorBlendEnables = false;
-		const VkColorComponentFlags colorBlendComponentFlags = 0xf;
-		const VkColorBlendEquationEXT colorBlendEquation{};
-		vkCmdSetColorBlendEnableEXT(cmdBuffer, 0, 1, &colorBlendEnables);
-		vkCmdSetColorWriteMaskEXT(cmdBuffer, 0, 1, &colorBlendComponentFlags);
-
-		VkVertexInputBindingDescription2EXT vertexInputBinding{};
-		vertexInputBinding.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
-		vertexInputBinding.binding = 0;
-		vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		vertexInputBinding.stride = sizeof(vkglTF::Vertex);
-		vertexInputBinding.divisor = 1;
-
-		std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes = {
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, pos) },
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, normal) },
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vkglTF::Vertex, color) }
-		};
-
-		vkCmdSetVertexInputEXT(cmdBuffer, 1, &vertexInputBinding, 3, vertexAttributes.data());
+		shaderObjectState.record(cmdBuffer, width, height);
 
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
 		scene.bindBuffers(cmdBuffer);
 
 		// Binding the shaders
 		VkShaderStageFlagBits stages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
-		vkCmdBindShadersEXT(cmdBuffer, 2, stages, shaders);
+		shaderObjectState.bindShaders(cmdBuffer, 2, stages, shaders);
 		scene.draw(cmdBuffer);
 
 		// @todo: Currently disabled, the UI needs to be adopted to work with shader objects
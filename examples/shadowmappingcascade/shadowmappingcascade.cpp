@@ -11,12 +11,16 @@
 	This results in a better shadow map resolution distribution that can be tweaked even further by increasing
 	the number of frustum splits.
 
-	A further optimization could be done using a geometry shader to do a single-pass render for the depth map
-	cascades instead of multiple passes (geometry shaders are not supported on all target devices).
+	Cascade fitting, culling and rendering is done by the vks::CascadedShadowMap class. Cascades are snapped to the
+	shadow map texel grid for stable shadow edges, their depth range is fitted to the scene bounds and scene objects
+	are culled per cascade. Cascades are rendered with a small guard band and keep their content as long as their frustum
+	split stays inside it, so with a slowly moving camera only some cascades need to be rendered again each frame.
+	If multiview is supported, all cascades can be rendered in a single pass with one view per cascade layer.
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanCascadedShadowMap.hpp"
 
 #if defined(__ANDROID__)
 #define SHADOWMAP_DIM 2048
@@ -34,8 +38,6 @@ public:
 	bool colorCascades = false;
 	bool filterPCF = false;
 
-	float cascadeSplitLambda = 0.95f;
-
 	float zNear = 0.5f;
 	float zFar = 48.0f;
 
@@ -46,6 +48,18 @@ public:
 		vkglTF::Model tree;
 	} models;
 
+	// Scene objects with world space bounding spheres for per-cascade culling
+	struct SceneObject {
+		vkglTF::Model* model;
+		glm::vec3 position;
+		glm::vec3 center;
+		float radius;
+		uint32_t drawCount;
+	};
+	std::vector<SceneObject> sceneObjects;
+	glm::vec3 sceneMin{ FLT_MAX };
+	glm::vec3 sceneMax{ -FLT_MAX };
+
 	struct UniformDataVertex {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -87,37 +101,16 @@ public:
 
 	// Resources of the depth map generation pass
 	struct DepthPass {
-		VkRenderPass renderPass;
-		VkPipelineLayout pipelineLayout;
-		VkPipeline pipeline;
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		// Renders all cascades at once using the view index to select the cascade matrix
+		VkPipeline pipelineMultiview{ VK_NULL_HANDLE };
 	} depthPass;
 
-	// Layered depth image containing the shadow cascade depths
-	struct DepthImage {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-		VkSampler sampler;
-		void destroy(VkDevice device) const {
-			vkDestroyImageView(device, view, nullptr);
-			vkDestroyImage(device, image, nullptr);
-			vkFreeMemory(device, mem, nullptr);
-			vkDestroySampler(device, sampler, nullptr);
-		}
-	} depth;
-
-	// Contains all resources required for a single shadow map cascade
-	struct Cascade {
-		VkFramebuffer frameBuffer;
-		VkImageView view;
-		float splitDepth;
-		glm::mat4 viewProjMatrix;
-		void destroy(VkDevice device) const {
-			vkDestroyImageView(device, view, nullptr);
-			vkDestroyFramebuffer(device, frameBuffer, nullptr);
-		}
-	};
-	std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
+	// Layered depth image, render passes and matrices of the shadow cascades
+	vks::CascadedShadowMap shadowMap;
+
+	VkPhysicalDeviceMultiviewFeaturesKHR physicalDeviceMultiviewFeatures{};
 
 	VulkanExample() : VulkanExampleBase()
 	{
@@ -129,17 +122,18 @@ public:
 		camera.setPosition(glm::vec3(-0.12f, 1.14f, -2.25f));
 		camera.setRotation(glm::vec3(-17.0f, 7.0f, 0.0f));
 		timer = 0.2f;
+		// Multiview (for single pass cascade rendering) is core with Vulkan 1.1
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
 	{
-		for (auto& cascade : cascades) {
-			cascade.destroy(device);
-		}
-		depth.destroy(device);
-		vkDestroyRenderPass(device, depthPass.renderPass, nullptr);
+		shadowMap.destroy();
 		vkDestroyPipeline(device, pipelines.debugShadowMap, nullptr);
 		vkDestroyPipeline(device, depthPass.pipeline, nullptr);
+		if (depthPass.pipelineMultiview != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, depthPass.pipelineMultiview, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.sceneShadow, nullptr);
 		vkDestroyPipeline(device, pipelines.sceneShadowPCF, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -159,182 +153,75 @@ public:
 		enabledFeatures.depthClamp = deviceFeatures.depthClamp;
 	}
 
+	virtual void getEnabledExtensions()
+	{
+		// Multiview is optional, cascades are rendered with one pass per layer if it's not supported
+		VkPhysicalDeviceMultiviewFeaturesKHR supportedMultiviewFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR };
+		VkPhysicalDeviceFeatures2 deviceFeatures2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supportedMultiviewFeatures };
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		if (supportedMultiviewFeatures.multiview) {
+			physicalDeviceMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+			physicalDeviceMultiviewFeatures.multiview = VK_TRUE;
+			deviceCreatepNextChain = &physicalDeviceMultiviewFeatures;
+		}
+	}
+
 	/*
-		Render the example scene to acommand buffer using the supplied pipeline layout and for the selected shadow cascade index
-		Used by the scene rendering and depth pass generation command buffer
+		Render the example scene to a command buffer using the supplied pipeline layout
+		If a shadow cascade index is passed, only objects overlapping that cascade are drawn (used by the depth pass)
+		With CascadedShadowMap::AllCascades, objects are culled against the union of all cascades (multiview depth pass)
+		Returns the number of draw calls
 	*/
-	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t cascadeIndex = 0) {
+	uint32_t renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t cascadeIndex = 0, bool cull = false) {
 		// We use push constants for passing shadow cascade info to the shaders
-		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
+		PushConstBlock pushConstBlock = { glm::vec4(0.0f), (cascadeIndex == vks::CascadedShadowMap::AllCascades) ? 0 : cascadeIndex };
 
 		// Set 0 contains the vertex and fragment shader uniform buffers, set 1 for images will be set by the glTF model class at draw time
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
 
-		// Floor
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
-
-		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
-
-		for (auto& position : positions) {
-			pushConstBlock.position = glm::vec4(position, 0.0f);
+		uint32_t drawCount = 0;
+		for (auto& object : sceneObjects) {
+			if (cull) {
+				const bool visible = (cascadeIndex == vks::CascadedShadowMap::AllCascades) ? shadowMap.isVisibleAny(object.center, object.radius) : shadowMap.isVisible(cascadeIndex, object.center, object.radius);
+				if (!visible) {
+					continue;
+				}
+			}
+			pushConstBlock.position = glm::vec4(object.position, 0.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			// This will also bind the texture images to set 1
-			models.tree.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
-		}
-	}
-
-	/*
-		Setup resources used by the depth pass
-		The depth image is layered with each layer storing one shadow map cascade
-	*/
-	void prepareDepthPass()
-	{
-		VkFormat depthFormat = vulkanDevice->getSupportedDepthFormat(true);
-
-		/*
-			Depth map renderpass
-		*/
-
-		VkAttachmentDescription attachmentDescription{};
-		attachmentDescription.format = depthFormat;
-		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 0;
-		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 0;
-		subpass.pDepthStencilAttachment = &depthReference;
-
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		VkRenderPassCreateInfo renderPassCreateInfo = vks::initializers::renderPassCreateInfo();
-		renderPassCreateInfo.attachmentCount = 1;
-		renderPassCreateInfo.pAttachments = &attachmentDescription;
-		renderPassCreateInfo.subpassCount = 1;
-		renderPassCreateInfo.pSubpasses = &subpass;
-		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
-		renderPassCreateInfo.pDependencies = dependencies.data();
-
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
-
-		/*
-			Layered depth image and views
-		*/
-
-		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.extent.width = SHADOWMAP_DIM;
-		imageInfo.extent.height = SHADOWMAP_DIM;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = SHADOW_MAP_CASCADE_COUNT;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.format = depthFormat;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &depth.image));
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, depth.image, depth.mem, 0));
-		// Full depth map view (all layers)
-		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-		viewInfo.format = depthFormat;
-		viewInfo.subresourceRange = {};
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = SHADOW_MAP_CASCADE_COUNT;
-		viewInfo.image = depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &depth.view));
-
-		// One image view and framebuffer per cascade
-		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			// Image view for this cascade's layer (inside the depth map)
-			// This view is used to render to that specific depth image layer
-			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-			viewInfo.format = depthFormat;
-			viewInfo.subresourceRange = {};
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			viewInfo.subresourceRange.baseMipLevel = 0;
-			viewInfo.subresourceRange.levelCount = 1;
-			viewInfo.subresourceRange.baseArrayLayer = i;
-			viewInfo.subresourceRange.layerCount = 1;
-			viewInfo.image = depth.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &cascades[i].view));
-			// Framebuffer
-			VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
-			framebufferInfo.renderPass = depthPass.renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = &cascades[i].view;
-			framebufferInfo.width = SHADOWMAP_DIM;
-			framebufferInfo.height = SHADOWMAP_DIM;
-			framebufferInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
+			object.model->draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
+			drawCount += object.drawCount;
 		}
-
-		// Shared sampler for cascade depth reads
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeV = sampler.addressModeU;
-		sampler.addressModeW = sampler.addressModeU;
-		sampler.mipLodBias = 0.0f;
-		sampler.maxAnisotropy = 1.0f;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
+		return drawCount;
 	}
 
-
 	void loadAssets()
 	{
 		uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
 		models.terrain.loadFromFile(getAssetPath() + "models/terrain_gridlines.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.tree.loadFromFile(getAssetPath() + "models/oaktree.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		// Floor and trees with their world space bounds
+		const std::vector<std::pair<vkglTF::Model*, glm::vec3>> objects = {
+			{ &models.terrain, glm::vec3(0.0f, 0.0f, 0.0f) },
+			{ &models.tree, glm::vec3(0.0f, 0.0f, 0.0f) },
+			{ &models.tree, glm::vec3(1.25f, 0.25f, 1.25f) },
+			{ &models.tree, glm::vec3(-1.25f, -0.2f, 1.25f) },
+			{ &models.tree, glm::vec3(1.25f, 0.1f, -1.25f) },
+			{ &models.tree, glm::vec3(-1.25f, -0.25f, -1.25f) },
+		};
+		for (auto& [model, position] : objects) {
+			SceneObject object{ .model = model, .position = position, .center = model->dimensions.center + position, .radius = model->dimensions.radius, .drawCount = 0 };
+			for (auto& node : model->linearNodes) {
+				if (node->mesh) {
+					object.drawCount += static_cast<uint32_t>(node->mesh->primitives.size());
+				}
+			}
+			sceneObjects.push_back(object);
+			sceneMin = glm::min(sceneMin, model->dimensions.min + position);
+			sceneMax = glm::max(sceneMax, model->dimensions.max + position);
+		}
 	}
 
 	void setupLayoutsAndDescriptors()
@@ -365,7 +252,7 @@ public:
 
 		// Sets per frame, just like the buffers themselves
 		// Images do not need to be duplicated per frame, we reuse the same one for each frame
-		VkDescriptorImageInfo depthMapDescriptor = vks::initializers::descriptorImageInfo(depth.sampler, depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo depthMapDescriptor = vks::initializers::descriptorImageInfo(shadowMap.sampler, shadowMap.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		for (auto i = 0; i < uniformBuffers.size(); i++) {
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
@@ -463,8 +350,14 @@ public:
 		// Enable depth clamp (if available)
 		rasterizationState.depthClampEnable = deviceFeatures.depthClamp;
 		pipelineCI.layout = depthPass.pipelineLayout;
-		pipelineCI.renderPass = depthPass.renderPass;
+		pipelineCI.renderPass = shadowMap.renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &depthPass.pipeline));
+		// Single pass variant for the multiview render pass
+		if (shadowMap.multiviewSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingcascade/depthpass_multiview.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.renderPass = shadowMap.multiviewRenderPass;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &depthPass.pipelineMultiview));
+		}
 	}
 
 	void prepareUniformBuffers()
@@ -497,90 +390,10 @@ public:
 		}
 	}
 
-	/*
-		Calculate frustum split depths and matrices for the shadow map cascades
-		Based on https://johanmedestrom.wordpress.com/2016/03/18/opengl-cascaded-shadow-maps/
-	*/
+	// Fit the shadow cascades to the current camera frustum and light direction
 	void updateCascades()
 	{
-		float cascadeSplits[SHADOW_MAP_CASCADE_COUNT];
-
-		float nearClip = camera.getNearClip();
-		float farClip = camera.getFarClip();
-		float clipRange = farClip - nearClip;
-
-		float minZ = nearClip;
-		float maxZ = nearClip + clipRange;
-
-		float range = maxZ - minZ;
-		float ratio = maxZ / minZ;
-
-		// Calculate split depths based on view camera frustum
-		// Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
-		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			float p = (i + 1) / static_cast<float>(SHADOW_MAP_CASCADE_COUNT);
-			float log = minZ * std::pow(ratio, p);
-			float uniform = minZ + range * p;
-			float d = cascadeSplitLambda * (log - uniform) + uniform;
-			cascadeSplits[i] = (d - nearClip) / clipRange;
-		}
-
-		// Calculate orthographic projection matrix for each cascade
-		float lastSplitDist = 0.0;
-		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			float splitDist = cascadeSplits[i];
-
-			glm::vec3 frustumCorners[8] = {
-				glm::vec3(-1.0f,  1.0f, 0.0f),
-				glm::vec3( 1.0f,  1.0f, 0.0f),
-				glm::vec3( 1.0f, -1.0f, 0.0f),
-				glm::vec3(-1.0f, -1.0f, 0.0f),
-				glm::vec3(-1.0f,  1.0f,  1.0f),
-				glm::vec3( 1.0f,  1.0f,  1.0f),
-				glm::vec3( 1.0f, -1.0f,  1.0f),
-				glm::vec3(-1.0f, -1.0f,  1.0f),
-			};
-
-			// Project frustum corners into world space
-			glm::mat4 invCam = glm::inverse(camera.matrices.perspective * camera.matrices.view);
-			for (uint32_t j = 0; j < 8; j++) {
-				glm::vec4 invCorner = invCam * glm::vec4(frustumCorners[j], 1.0f);
-				frustumCorners[j] = invCorner / invCorner.w;
-			}
-
-			for (uint32_t j = 0; j < 4; j++) {
-				glm::vec3 dist = frustumCorners[j + 4] - frustumCorners[j];
-				frustumCorners[j + 4] = frustumCorners[j] + (dist * splitDist);
-				frustumCorners[j] = frustumCorners[j] + (dist * lastSplitDist);
-			}
-
-			// Get frustum center
-			glm::vec3 frustumCenter = glm::vec3(0.0f);
-			for (uint32_t j = 0; j < 8; j++) {
-				frustumCenter += frustumCorners[j];
-			}
-			frustumCenter /= 8.0f;
-
-			float radius = 0.0f;
-			for (uint32_t j = 0; j < 8; j++) {
-				float distance = glm::length(frustumCorners[j] - frustumCenter);
-				radius = glm::max(radius, distance);
-			}
-			radius = std::ceil(radius * 16.0f) / 16.0f;
-
-			glm::vec3 maxExtents = glm::vec3(radius);
-			glm::vec3 minExtents = -maxExtents;
-
-			glm::vec3 lightDir = normalize(-lightPos);
-			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
-
-			// Store split distance and matrix in cascade
-			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
-			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
-
-			lastSplitDist = cascadeSplits[i];
-		}
+		shadowMap.update(camera.matrices.view, camera.matrices.perspective, camera.getNearClip(), camera.getFarClip(), normalize(-lightPos), sceneMin, sceneMax);
 	}
 
 	void updateLight()
@@ -597,7 +410,7 @@ public:
 		*/
 		std::vector<glm::mat4> cascadeViewProjMatrices(SHADOW_MAP_CASCADE_COUNT);
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			cascadeViewProjMatrices[i] = cascades[i].viewProjMatrix;
+			cascadeViewProjMatrices[i] = shadowMap.cascades[i].viewProjMatrix;
 		}
 		memcpy(uniformBuffers[currentBuffer].cascadeViewProjMatrices.mapped, cascadeViewProjMatrices.data(), sizeof(glm::mat4) * SHADOW_MAP_CASCADE_COUNT);
 
@@ -610,7 +423,7 @@ public:
 		uniformDataVertex.lightDir = normalize(-lightPos);
 		memcpy(uniformBuffers[currentBuffer].vertex.mapped, &uniformDataVertex, sizeof(UniformDataVertex));
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			uniformDataFragment.cascadeSplits[i] = cascades[i].splitDepth;
+			uniformDataFragment.cascadeSplits[i] = shadowMap.cascades[i].splitDepth;
 		}
 		uniformDataFragment.inverseViewMat = glm::inverse(camera.matrices.view);
 		uniformDataFragment.lightDir = normalize(-lightPos);
@@ -622,9 +435,11 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		// The single pass path also needs the multiview variant of the depth pass vertex shader
+		const bool multiview = physicalDeviceMultiviewFeatures.multiview && vks::tools::fileExists(getShadersPath() + "shadowmappingcascade/depthpass_multiview.vert.spv");
+		shadowMap.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, SHADOWMAP_DIM, SHADOW_MAP_CASCADE_COUNT, maxConcurrentFrames, multiview);
 		updateLight();
 		updateCascades();
-		prepareDepthPass();
 		prepareUniformBuffers();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
@@ -642,37 +457,14 @@ public:
 		/*
 			Generate depth map cascades
 
-			Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-			Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
+			Either one pass per changed cascade rendering only the objects overlapping that cascade,
+			or a single multiview pass rendering all cascade layers at once
 		*/
-		{
-			VkClearValue clearValues[1]{};
-			clearValues[0].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-			renderPassBeginInfo.renderPass = depthPass.renderPass;
-			renderPassBeginInfo.renderArea.offset.x = 0;
-			renderPassBeginInfo.renderArea.offset.y = 0;
-			renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-			renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-			renderPassBeginInfo.clearValueCount = 1;
-			renderPassBeginInfo.pClearValues = clearValues;
-
-			VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-			// One pass per cascade
-			for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
-				renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
-				vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-				renderScene(cmdBuffer, depthPass.pipelineLayout, j);
-				vkCmdEndRenderPass(cmdBuffer);
-			}
-		}
+		shadowMap.render(cmdBuffer, currentBuffer, [this](VkCommandBuffer commandBuffer, uint32_t cascadeIndex) {
+			const bool multiview = (cascadeIndex == vks::CascadedShadowMap::AllCascades);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, multiview ? depthPass.pipelineMultiview : depthPass.pipeline);
+			return renderScene(commandBuffer, depthPass.pipelineLayout, cascadeIndex, true);
+		});
 
 		/*
 			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
@@ -732,6 +524,8 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		// The frame's fence has been waited on, so its shadow pass timings are available
+		shadowMap.fetchStats(currentBuffer);
 		if (!paused || camera.updated) {
 			updateLight();
 		}
@@ -744,9 +538,17 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->sliderFloat("Split lambda", &cascadeSplitLambda, 0.1f, 1.0f)) {
+			if (overlay->sliderFloat("Split lambda", &shadowMap.splitLambda, 0.1f, 1.0f)) {
 				updateCascades();
 			}
+			overlay->checkBox("Stable cascades", &shadowMap.stabilize);
+			overlay->checkBox("Skip unchanged cascades", &shadowMap.skipUnchanged);
+			if (shadowMap.skipUnchanged) {
+				overlay->sliderFloat("Cache guard band", &shadowMap.cacheGuardBand, 0.0f, 0.5f);
+			}
+			if (shadowMap.multiviewSupported) {
+				overlay->checkBox("Single pass (multiview)", &shadowMap.useMultiview);
+			}
 			overlay->checkBox("Color cascades", &colorCascades);
 			overlay->checkBox("Display depth map", &displayDepthMap);
 			if (displayDepthMap) {
@@ -754,6 +556,27 @@ public:
 			}
 			overlay->checkBox("PCF filtering", &filterPCF);
 		}
+		if (overlay->header("Statistics")) {
+			if (shadowMap.multiviewActive()) {
+				// A multiview pass renders all cascades with the same draws
+				const vks::CascadedShadowMap::Cascade& cascade = shadowMap.cascades[0];
+				if (cascade.rendered) {
+					overlay->text("All cascades: %d draws", cascade.drawCount);
+				} else {
+					overlay->text("All cascades: unchanged");
+				}
+			} else {
+				for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+					const vks::CascadedShadowMap::Cascade& cascade = shadowMap.cascades[i];
+					if (cascade.rendered) {
+						overlay->text("Cascade %d: %d draws, %.3f ms", i, cascade.drawCount, cascade.gpuTime);
+					} else {
+						overlay->text("Cascade %d: unchanged", i);
+					}
+				}
+			}
+			overlay->text("Shadow passes: %.3f ms", shadowMap.gpuTime);
+		}
 	}
 };
 
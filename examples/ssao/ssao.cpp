@@ -8,9 +8,15 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanglTFGpuScene.hpp"
+#include "VulkanTemporal.hpp"
+#include "VulkanTimestampQuery.hpp"
+#include "VulkanParallelRecorder.hpp"
 
 #define SSAO_KERNEL_SIZE 64
 #define SSAO_RADIUS 0.3f
+// With temporal accumulation the kernel is spread over this many frames
+#define SSAO_TEMPORAL_FRAMES 4
 
 // We use a smaller noise kernel size on Android due to lower computational power
 #if defined(__ANDROID__)
@@ -24,13 +30,66 @@ class VulkanExample : public VulkanExampleBase
 public:
 	vks::Texture2D ssaoNoise;
 	vkglTF::Model scene;
+	const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+
+	// GPU driven rendering of the G-Buffer pass: primitives are culled in a compute shader and drawn with indirect draws
+	vkglTF::GpuScene gpuScene;
+	bool gpuDrivenSupported{ false };
+	// The indirect G-Buffer and culling shaders are optional, without them the sample only records draws on the CPU
+	bool gpuDrivenShadersAvailable{ false };
+	bool gpuDriven{ false };
+	VkPhysicalDeviceVulkan12Features enabledFeatures12{};
+
+	// Scene textures in the base class' descriptor heap, materials are selected by indices passed as push constants instead of per-material descriptor sets
+	bool descriptorHeapSupported{ false };
+	// The bindless G-Buffer shader is optional, without it the sample keeps using per-material descriptor sets
+	bool bindlessShaderAvailable{ false };
+	bool bindlessRequested{ false };
+	bool bindless{ false };
+
+	// The G-Buffer pass' draw list can be split into chunks that are recorded into secondary command buffers on multiple threads
+	vks::ParallelRecorder parallelRecorder;
+	bool parallelRecording{ false };
+	int32_t recordingThreadCount{ 1 };
+	int32_t maxRecordingThreadCount{ 1 };
+	std::vector<vkglTF::DrawStats> chunkDrawStats;
+	// CPU time for recording the scene, index 0 is recording into the primary command buffer, other indices are the number of recording threads
+	struct RecordingStats {
+		double recordTime{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::vector<RecordingStats> recordingStats;
+
+	// SSAO evaluates a quarter of the kernel per frame and accumulates the results in a reprojected history
+	vks::TemporalAccumulation temporal;
+	bool temporalEnabled{ false };
+	// The velocity writing G-Buffer shaders and the temporal SSAO and resolve shaders are optional, the G-Buffer pass of the base shaders leaves the velocity attachment untouched
+	bool velocityShadersAvailable{ false };
+	bool temporalAvailable{ false };
+
+	// GPU times of the SSAO passes, accumulated separately with and without temporal accumulation
+	vks::TimestampQuery timestamps;
+	enum TimestampScope { ScopeSSAO = 0, ScopeResolve = 1, ScopeBlur = 2 };
+	std::array<int32_t, maxConcurrentFrames> frameTemporal{};
+	struct EffectStats {
+		double ssaoTime{ 0.0 };
+		double resolveTime{ 0.0 };
+		double blurTime{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::array<EffectStats, 2> effectStats{};
 
 	struct UBOSceneParams {
 		glm::mat4 projection;
-		glm::mat4 model;
+		glm::mat4 model{ 1.0f };
 		glm::mat4 view;
 		float nearPlane = 0.1f;
 		float farPlane = 64.0f;
+		glm::vec2 _pad;
+		// Unjittered matrices of this and the last frame for the velocity buffer, placed after the members read by the base G-Buffer shaders
+		glm::mat4 previousModel;
+		glm::mat4 viewProjection;
+		glm::mat4 previousViewProjection;
 	} uboSceneParams;
 
 	struct UBOSSAOParams {
@@ -38,10 +97,14 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Only read by the temporal SSAO shader
+		int32_t kernelOffset = 0;
+		int32_t kernelStride = 1;
 	} uboSSAOParams;
 
 	struct {
 		VkPipelineLayout gBuffer{ VK_NULL_HANDLE };
+		VkPipelineLayout gBufferIndirect{ VK_NULL_HANDLE };
 		VkPipelineLayout ssao{ VK_NULL_HANDLE };
 		VkPipelineLayout ssaoBlur{ VK_NULL_HANDLE };
 		VkPipelineLayout composition{ VK_NULL_HANDLE };
@@ -49,8 +112,10 @@ public:
 
 	struct {
 		VkPipeline offscreen{ VK_NULL_HANDLE };
+		VkPipeline offscreenIndirect{ VK_NULL_HANDLE };
 		VkPipeline composition{ VK_NULL_HANDLE };
 		VkPipeline ssao{ VK_NULL_HANDLE };
+		VkPipeline ssaoTemporal{ VK_NULL_HANDLE };
 		VkPipeline ssaoBlur{ VK_NULL_HANDLE };
 	} pipelines;
 
@@ -66,6 +131,9 @@ public:
 		VkDescriptorSet ssao{ VK_NULL_HANDLE };
 		VkDescriptorSet ssaoBlur{ VK_NULL_HANDLE };
 		VkDescriptorSet composition{ VK_NULL_HANDLE };
+		// Read the resolved SSAO from one of the two temporal history images instead
+		std::array<VkDescriptorSet, 2> ssaoBlurTemporal{};
+		std::array<VkDescriptorSet, 2> compositionTemporal{};
 	};
 	std::array<DescriptorSets, maxConcurrentFrames> descriptorSets;
 
@@ -107,7 +175,7 @@ public:
 
 	struct {
 		struct Offscreen : public FrameBuffer {
-			FrameBufferAttachment position, normal, albedo, depth;
+			FrameBufferAttachment position, normal, albedo, depth, velocity;
 		} offscreen;
 		struct SSAO : public FrameBuffer {
 			FrameBufferAttachment color;
@@ -127,6 +195,22 @@ public:
 		camera.position = { 1.0f, 0.75f, 0.0f };
 		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, uboSceneParams.nearPlane, uboSceneParams.farPlane);
+		// Indirect draw count and descriptor indexing are core with Vulkan 1.2
+		apiVersion = VK_API_VERSION_1_2;
+		commandLineParser.add("gpudriven", { "-gd", "--gpudriven" }, 0, "Render the G-Buffer pass with GPU culling and indirect draws");
+		commandLineParser.add("bindless", { "-bl", "--bindless" }, 0, "Access the scene's textures through a bindless descriptor heap");
+		commandLineParser.add("temporal", { "-ta", "--temporal" }, 0, "Spread the SSAO kernel over several frames with temporal accumulation");
+		commandLineParser.add("recordthreads", { "-rt", "--recordthreads" }, 1, "Record the G-Buffer pass into secondary command buffers on the given number of threads");
+		commandLineParser.parse(args);
+		gpuDriven = commandLineParser.isSet("gpudriven");
+		maxRecordingThreadCount = std::max(static_cast<int32_t>(std::thread::hardware_concurrency()), 1);
+		recordingStats.resize(maxRecordingThreadCount + 1);
+		if (commandLineParser.isSet("recordthreads")) {
+			parallelRecording = true;
+			recordingThreadCount = std::clamp(commandLineParser.getValueAsInt("recordthreads", recordingThreadCount), 1, maxRecordingThreadCount);
+		}
+		bindlessRequested = commandLineParser.isSet("bindless");
+		temporalEnabled = commandLineParser.isSet("temporal");
 	}
 
 	~VulkanExample()
@@ -137,16 +221,20 @@ public:
 			frameBuffers.offscreen.normal.destroy(device);
 			frameBuffers.offscreen.albedo.destroy(device);
 			frameBuffers.offscreen.depth.destroy(device);
+			frameBuffers.offscreen.velocity.destroy(device);
 			frameBuffers.ssao.color.destroy(device);
 			frameBuffers.ssaoBlur.color.destroy(device);
 			frameBuffers.offscreen.destroy(device);
 			frameBuffers.ssao.destroy(device);
 			frameBuffers.ssaoBlur.destroy(device);
 			vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+			vkDestroyPipeline(device, pipelines.offscreenIndirect, nullptr);
 			vkDestroyPipeline(device, pipelines.composition, nullptr);
 			vkDestroyPipeline(device, pipelines.ssao, nullptr);
+			vkDestroyPipeline(device, pipelines.ssaoTemporal, nullptr);
 			vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.gBufferIndirect, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
@@ -160,12 +248,54 @@ public:
 				buffer.ssaoParams.destroy();
 			}
 			ssaoNoise.destroy();
+			gpuScene.destroy();
+			temporal.destroy();
+			timestamps.destroy();
+			parallelRecorder.destroy();
 		}
 	}
 
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// Required by the GPU driven path
+		enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+	}
+
+	void getEnabledExtensions()
+	{
+		velocityShadersAvailable = vks::tools::fileExists(getShadersPath() + "ssao/gbuffer_velocity.vert.spv") && vks::tools::fileExists(getShadersPath() + "ssao/gbuffer_velocity.frag.spv");
+		temporalAvailable = velocityShadersAvailable && vks::tools::fileExists(getShadersPath() + "ssao/ssao_temporal.frag.spv") && vks::tools::fileExists(getShadersPath() + "ssao/temporal_resolve.comp.spv");
+		temporalEnabled = temporalEnabled && temporalAvailable;
+		// The GPU driven path needs bindless textures and a first instance for the indirect draws, the draw count is optional
+		if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+			return;
+		}
+		VkPhysicalDeviceVulkan12Features supportedFeatures12{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceFeatures2 deviceFeatures2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supportedFeatures12 };
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		const std::array<std::string, 3> gpuDrivenShaders = { "gbuffer_indirect.vert", "gbuffer_indirect.frag", "cull.comp" };
+		gpuDrivenShadersAvailable = std::all_of(gpuDrivenShaders.begin(), gpuDrivenShaders.end(), [this](const std::string& name) { return vks::tools::fileExists(getShadersPath() + "ssao/" + name + ".spv"); });
+		gpuDrivenSupported = gpuDrivenShadersAvailable && deviceFeatures.drawIndirectFirstInstance && supportedFeatures12.runtimeDescriptorArray && supportedFeatures12.shaderSampledImageArrayNonUniformIndexing && supportedFeatures12.descriptorBindingVariableDescriptorCount && supportedFeatures12.descriptorBindingPartiallyBound;
+		if (gpuDrivenSupported) {
+			enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			enabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+			enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			enabledFeatures12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			enabledFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+			enabledFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+			deviceCreatepNextChain = &enabledFeatures12;
+		}
+		gpuDriven = gpuDriven && gpuDrivenSupported;
+		// The descriptor heap needs update after bind for sampled images and storage buffers
+		descriptorHeapSupported = vks::DescriptorHeap::getRequiredFeatures(supportedFeatures12, enabledFeatures12);
+		if (descriptorHeapSupported) {
+			deviceCreatepNextChain = &enabledFeatures12;
+		}
+		// The bindless fragment shader reads the clip space positions of the velocity writing vertex shader
+		bindlessShaderAvailable = velocityShadersAvailable && vks::tools::fileExists(getShadersPath() + "ssao/gbuffer_bindless.frag.spv");
+		bindless = bindlessRequested && descriptorHeapSupported && bindlessShaderAvailable;
 	}
 
 	// Create a frame buffer attachment
@@ -253,6 +383,7 @@ public:
 		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height);			// Normals
 		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);			// Albedo (color)
 		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);			// Depth
+		createAttachment(VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.velocity, width, height);		// Velocity
 
 		// SSAO
 		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);				// Color
@@ -260,11 +391,14 @@ public:
 		// SSAO blur
 		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
 
+		// Temporal history at SSAO resolution, accumulated as float so small per-frame contributions don't get lost to 8 bit quantization
+		temporal.create(vulkanDevice, queue, VK_FORMAT_R32_SFLOAT, ssaoWidth, ssaoHeight);
+
 		// Render passes
 
 		// G-Buffer creation
 		{
-			std::array<VkAttachmentDescription, 4> attachmentDescs = {};
+			std::array<VkAttachmentDescription, 5> attachmentDescs = {};
 
 			// Init attachment properties
 			for (uint32_t i = 0; i < static_cast<uint32_t>(attachmentDescs.size()); i++)
@@ -282,11 +416,13 @@ public:
 			attachmentDescs[1].format = frameBuffers.offscreen.normal.format;
 			attachmentDescs[2].format = frameBuffers.offscreen.albedo.format;
 			attachmentDescs[3].format = frameBuffers.offscreen.depth.format;
+			attachmentDescs[4].format = frameBuffers.offscreen.velocity.format;
 
 			std::vector<VkAttachmentReference> colorReferences;
 			colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
 			colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
 			colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			colorReferences.push_back({ 4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
 
 			VkAttachmentReference depthReference = {};
 			depthReference.attachment = 3;
@@ -335,11 +471,12 @@ public:
 			renderPassInfo.pDependencies = dependencies.data();
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.offscreen.renderPass));
 
-			std::array<VkImageView, 4> attachments{};
+			std::array<VkImageView, 5> attachments{};
 			attachments[0] = frameBuffers.offscreen.position.view;
 			attachments[1] = frameBuffers.offscreen.normal.view;
 			attachments[2] = frameBuffers.offscreen.albedo.view;
 			attachments[3] = frameBuffers.offscreen.depth.view;
+			attachments[4] = frameBuffers.offscreen.velocity.view;
 
 			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
 			fbufCreateInfo.renderPass = frameBuffers.offscreen.renderPass;
@@ -484,18 +621,26 @@ public:
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
-		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+		// The model adds its textures and mesh buffers to the heap instead of creating descriptor sets
+		if (bindless) {
+			descriptorHeap.create(vulkanDevice, maxConcurrentFrames);
+			vkglTF::descriptorHeap = &descriptorHeap;
+		}
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
+		vkglTF::descriptorHeap = nullptr;
+		if (gpuDrivenSupported) {
+			gpuScene.create(vulkanDevice, &scene, queue, gltfLoadingFlags, maxConcurrentFrames, enabledFeatures12.drawIndirectCount, enabledFeatures.multiDrawIndirect);
+		}
 	}
 
 	void setupDescriptors()
 	{
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 10)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames * 22)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 4);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames * 8);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		VkDescriptorSetAllocateInfo descriptorAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, nullptr, 1);
@@ -546,6 +691,7 @@ public:
 		VkDescriptorImageInfo albedoImgDescriptor = vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		VkDescriptorImageInfo ssaoImgDescriptor = vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		VkDescriptorImageInfo ssaoBlurImgDescriptor = vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoBlur.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		std::array<VkDescriptorImageInfo, 2> historyImgDescriptors = { temporal.descriptor(0), temporal.descriptor(1) };
 
 		// Sets per frame, just like the buffers themselves
 		// Images do not need to be duplicated per frame, we reuse the same one for each frame
@@ -590,6 +736,24 @@ public:
 				vks::initializers::writeDescriptorSet(descriptorSets[i].composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers[i].ssaoParams.descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// Temporal accumulation: blur and composition read the history image the resolve pass wrote in that frame
+			for (uint32_t j = 0; j < 2; j++) {
+				descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets[i].ssaoBlurTemporal[j]));
+				descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.composition;
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets[i].compositionTemporal[j]));
+				writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSets[i].ssaoBlurTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &historyImgDescriptors[j]),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &positionImgDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &normalImgDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &albedoImgDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &historyImgDescriptors[j]),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &ssaoBlurImgDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i].compositionTemporal[j], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers[i].ssaoParams.descriptor),
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			}
 		}
 	}
 
@@ -598,10 +762,25 @@ public:
 		// Layouts
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
 
-		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.gBuffer, vkglTF::descriptorSetLayoutImage };
+		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.gBuffer, bindless ? descriptorHeap.descriptorSetLayout : vkglTF::descriptorSetLayoutImage };
 		pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
 		pipelineLayoutCreateInfo.setLayoutCount = 2;
+		// With the descriptor heap, the glTF model passes the heap indices of each primitive's textures and buffers as push constants
+		VkPushConstantRange heapIndicesPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vkglTF::HeapIndices), 0);
+		if (bindless) {
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &heapIndicesPushConstantRange;
+		}
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBuffer));
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+		if (gpuDrivenSupported) {
+			const std::vector<VkDescriptorSetLayout> indirectSetLayouts = { descriptorSetLayouts.gBuffer, gpuScene.descriptorSetLayout };
+			pipelineLayoutCreateInfo.pSetLayouts = indirectSetLayouts.data();
+			pipelineLayoutCreateInfo.setLayoutCount = 2;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBufferIndirect));
+		}
 
 		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssao;
 		pipelineLayoutCreateInfo.setLayoutCount = 1;
@@ -664,6 +843,12 @@ public:
 		shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
+		// With temporal accumulation, each frame only evaluates an interleaved subset of the kernel
+		if (temporalAvailable) {
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao_temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoTemporal));
+		}
 
 		// SSAO blur pipeline
 		pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
@@ -679,17 +864,38 @@ public:
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
-		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates = {
+		// The base G-Buffer shaders don't write velocity, so writes to that attachment are masked
+		std::array<VkPipelineColorBlendAttachmentState, 4> blendAttachmentStates = {
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
+			vks::initializers::pipelineColorBlendAttachmentState(velocityShadersAvailable ? 0xf : 0x0, VK_FALSE)
 		};
 		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
-		shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[0] = loadShader(getShadersPath() + (velocityShadersAvailable ? "ssao/gbuffer_velocity.vert.spv" : "ssao/gbuffer.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT);
+		if (bindless) {
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer_bindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		} else {
+			shaderStages[1] = loadShader(getShadersPath() + (velocityShadersAvailable ? "ssao/gbuffer_velocity.frag.spv" : "ssao/gbuffer.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
+
+		// Fill G-Buffer pipeline for the GPU driven path, instance data and materials are fetched from the GPU scene's buffers
+		if (gpuDrivenSupported) {
+			blendAttachmentStates[3].colorWriteMask = 0xf;
+			pipelineCreateInfo.layout = pipelineLayouts.gBufferIndirect;
+			shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer_indirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer_indirect.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreenIndirect));
+			gpuScene.prepareCullPipeline(loadShader(getShadersPath() + "ssao/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		}
+
+		// Temporal resolve, reprojects the SSAO history with the G-Buffer's velocity
+		if (temporalAvailable) {
+			temporal.prepareResolvePipeline(loadShader(getShadersPath() + "ssao/temporal_resolve.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), frameBuffers.ssao.color.view, frameBuffers.offscreen.velocity.view, colorSampler, pipelineCache);
+		}
 	}
 
 	float lerp(float a, float b, float f)
@@ -734,14 +940,24 @@ public:
 
 	void updateUniformBuffers()
 	{
+		// Velocity is always written, the jittered projection is only used while accumulating
+		temporal.update(camera.matrices.perspective, camera.matrices.view, width, height);
+
 		// Scene
-		uboSceneParams.projection = camera.matrices.perspective;
+		uboSceneParams.projection = temporalEnabled ? temporal.jitteredProjection : camera.matrices.perspective;
 		uboSceneParams.view = camera.matrices.view;
+		// The scene is static, objects with animated transforms need to pass their model matrix from the last frame
+		uboSceneParams.previousModel = uboSceneParams.model;
 		uboSceneParams.model = glm::mat4(1.0f);
+		uboSceneParams.viewProjection = temporal.viewProjection;
+		uboSceneParams.previousViewProjection = temporal.previousViewProjection;
 		uniformBuffers[currentBuffer].sceneParams.copyTo(&uboSceneParams, sizeof(uboSceneParams));
 
 		// SSAO parameters
 		uboSSAOParams.projection = camera.matrices.perspective;
+		// Interleaved subsets keep the distribution of the kernel (samples get scaled up with their index), after SSAO_TEMPORAL_FRAMES frames all samples have been taken
+		uboSSAOParams.kernelStride = temporalEnabled ? SSAO_TEMPORAL_FRAMES : 1;
+		uboSSAOParams.kernelOffset = temporalEnabled ? static_cast<int32_t>(temporal.frameIndex % SSAO_TEMPORAL_FRAMES) : 0;
 		uniformBuffers[currentBuffer].ssaoParams.copyTo(&uboSSAOParams, sizeof(uboSSAOParams));
 	}
 
@@ -753,9 +969,69 @@ public:
 		prepareBuffers();
 		setupDescriptors();
 		preparePipelines();
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 3, maxConcurrentFrames);
+		parallelRecorder.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, recordingThreadCount, maxConcurrentFrames);
+		if (benchmark.active) {
+			// Reported for the thread count selected on the command line, run with different counts to see how recording scales
+			benchmark.addMetric("scene recording ms (cpu)", [this]() { const RecordingStats& stats = recordingStats[parallelRecording ? recordingThreadCount : 0]; return stats.recordTime / std::max(stats.frameCount, 1u); });
+		}
+		if (benchmark.active && timestamps.supported) {
+			// Reported for the mode selected on the command line
+			benchmark.addMetric("ssao ms (gpu)", [this]() { const EffectStats& stats = effectStats[temporalEnabled ? 1 : 0]; return stats.ssaoTime / std::max(stats.frameCount, 1u); });
+			benchmark.addMetric("temporal resolve ms (gpu)", [this]() { const EffectStats& stats = effectStats[temporalEnabled ? 1 : 0]; return stats.resolveTime / std::max(stats.frameCount, 1u); });
+			benchmark.addMetric("ssao blur ms (gpu)", [this]() { const EffectStats& stats = effectStats[temporalEnabled ? 1 : 0]; return stats.blurTime / std::max(stats.frameCount, 1u); });
+		}
 		prepared = true;
 	}
 
+	// Records the G-Buffer scene draws into secondary command buffers on multiple threads, the render pass must have been started with secondary command buffer contents
+	void recordSceneParallel(VkCommandBuffer cmdBuffer)
+	{
+		// The fence for this frame has been waited on, so the command buffers recorded from this frame's pools are no longer in use
+		parallelRecorder.beginFrame(currentBuffer);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = frameBuffers.offscreen.renderPass;
+		inheritanceInfo.framebuffer = frameBuffers.offscreen.frameBuffer;
+
+		const uint32_t renderFlags = vkglTF::RenderFlags::BindImages;
+		// Builds the draw list on this thread before the recording threads read it
+		const uint32_t commandCount = scene.getDrawCommandCount(renderFlags);
+		// Each chunk writes its own stats, so the threads never write to the same memory
+		chunkDrawStats.assign(parallelRecorder.threadCount * parallelRecorder.chunksPerThread, {});
+
+		const std::vector<VkCommandBuffer>& commandBuffers = parallelRecorder.record(currentBuffer, inheritanceInfo, commandCount, [this, renderFlags](VkCommandBuffer commandBuffer, uint32_t chunk, uint32_t firstCommand, uint32_t commandCount) {
+			// Secondary command buffers don't inherit any state from the primary command buffer
+			VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(frameBuffers.offscreen.width, frameBuffers.offscreen.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets[currentBuffer].gBuffer, 0, nullptr);
+			scene.drawRange(commandBuffer, firstCommand, commandCount, chunkDrawStats[chunk], renderFlags, pipelineLayouts.gBuffer);
+		});
+		if (!commandBuffers.empty()) {
+			vkCmdExecuteCommands(cmdBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		}
+
+		for (const vkglTF::DrawStats& stats : chunkDrawStats) {
+			scene.drawStats.draws += stats.draws;
+			scene.drawStats.descriptorSetBinds += stats.descriptorSetBinds;
+			scene.drawStats.pushConstantUpdates += stats.pushConstantUpdates;
+		}
+	}
+
+	void fetchTimestamps()
+	{
+		if (timestamps.fetch(currentBuffer)) {
+			EffectStats& stats = effectStats[frameTemporal[currentBuffer]];
+			stats.ssaoTime += timestamps.durations[ScopeSSAO];
+			stats.resolveTime += timestamps.durations[ScopeResolve];
+			stats.blurTime += timestamps.durations[ScopeBlur];
+			stats.frameCount++;
+		}
+	}
+
 	void buildCommandBuffer()
 	{
 		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
@@ -764,16 +1040,25 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+		timestamps.reset(cmdBuffer, currentBuffer);
+		frameTemporal[currentBuffer] = temporalEnabled ? 1 : 0;
+
+		// Cull the scene on the GPU, this writes the indirect draw commands for the G-Buffer pass
+		if (gpuDriven) {
+			gpuScene.cull(cmdBuffer, currentBuffer, camera.matrices.perspective * camera.matrices.view);
+		}
+
 		/*
 			Offscreen SSAO generation
 		*/
 		{
 			// Clear values for all attachments written in the fragment shader
-			std::array<VkClearValue, 4> clearValues{};
+			std::array<VkClearValue, 5> clearValues{};
 			clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 			clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 			clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 			clearValues[3].depthStencil = { 1.0f, 0 };
+			clearValues[4].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 
 			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 			renderPassBeginInfo.renderPass = frameBuffers.offscreen.renderPass;
@@ -784,21 +1069,40 @@ public:
 			renderPassBeginInfo.pClearValues = clearValues.data();
 
 			/*
-				First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
+				First pass: Fill G-Buffer components (positions+depth, normals, albedo, velocity) using MRT
 			*/
 
-			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			// With parallel recording, the scene is drawn by secondary command buffers only
+			const bool recordParallel = parallelRecording && !gpuDriven;
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, recordParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-
 			VkRect2D scissor = vks::initializers::rect2D(frameBuffers.offscreen.width, frameBuffers.offscreen.height, 0, 0);
-			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			if (!recordParallel) {
+				vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+			}
 
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets[currentBuffer].gBuffer, 0, nullptr);
-			scene.draw(cmdBuffer, vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+			scene.resetDrawStats();
+			const auto tRecordStart = std::chrono::high_resolution_clock::now();
+			if (recordParallel) {
+				recordSceneParallel(cmdBuffer);
+			} else if (gpuDriven) {
+				// The number of commands recorded is independent of the number of primitives in the scene
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenIndirect);
+				const std::array<VkDescriptorSet, 2> sets = { descriptorSets[currentBuffer].gBuffer, gpuScene.descriptorSet };
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferIndirect, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+				gpuScene.draw(cmdBuffer);
+			} else {
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets[currentBuffer].gBuffer, 0, nullptr);
+				scene.draw(cmdBuffer, vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+			}
+			if (!gpuDriven) {
+				RecordingStats& stats = recordingStats[recordParallel ? parallelRecorder.threadCount : 0];
+				stats.recordTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tRecordStart).count();
+				stats.frameCount++;
+			}
 
 			vkCmdEndRenderPass(cmdBuffer);
 
@@ -816,6 +1120,7 @@ public:
 			renderPassBeginInfo.clearValueCount = 2;
 			renderPassBeginInfo.pClearValues = clearValues.data();
 
+			timestamps.begin(cmdBuffer, currentBuffer, ScopeSSAO);
 			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
@@ -824,10 +1129,22 @@ public:
 			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
 			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets[currentBuffer].ssao, 0, nullptr);
-			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, temporalEnabled ? pipelines.ssaoTemporal : pipelines.ssao);
 			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 
 			vkCmdEndRenderPass(cmdBuffer);
+			timestamps.end(cmdBuffer, currentBuffer, ScopeSSAO);
+
+			/*
+				Temporal resolve: blend this frame's partial kernel with the reprojected history
+			*/
+
+			// The scope is written in both modes so the timestamps of a frame are always complete
+			timestamps.begin(cmdBuffer, currentBuffer, ScopeResolve);
+			if (temporalEnabled) {
+				temporal.resolve(cmdBuffer);
+			}
+			timestamps.end(cmdBuffer, currentBuffer, ScopeResolve);
 
 			/*
 				Third pass: SSAO blur
@@ -838,6 +1155,7 @@ public:
 			renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
 			renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
 
+			timestamps.begin(cmdBuffer, currentBuffer, ScopeBlur);
 			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
@@ -845,11 +1163,13 @@ public:
 			scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
 			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets[currentBuffer].ssaoBlur, 0, nullptr);
+			VkDescriptorSet ssaoBlurSet = temporalEnabled ? descriptorSets[currentBuffer].ssaoBlurTemporal[temporal.outputIndex()] : descriptorSets[currentBuffer].ssaoBlur;
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &ssaoBlurSet, 0, nullptr);
 			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
 			vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 
 			vkCmdEndRenderPass(cmdBuffer);
+			timestamps.end(cmdBuffer, currentBuffer, ScopeBlur);
 		}
 
 		/*
@@ -880,7 +1200,8 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets[currentBuffer].composition, 0, nullptr);
+			VkDescriptorSet compositionSet = temporalEnabled ? descriptorSets[currentBuffer].compositionTemporal[temporal.outputIndex()] : descriptorSets[currentBuffer].composition;
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &compositionSet, 0, nullptr);
 
 			// Final composition pass
 			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
@@ -900,6 +1221,16 @@ public:
 			return;
 		}
 		VulkanExampleBase::prepareFrame();
+		// The fence for this frame has been signaled, so the draw count of its last culling pass is available
+		if (gpuDriven) {
+			gpuScene.fetchDrawCount(currentBuffer);
+		}
+		fetchTimestamps();
+		// Changing the thread count recreates all command pools, so none of their command buffers may be in use
+		if (parallelRecording && (static_cast<uint32_t>(recordingThreadCount) != parallelRecorder.threadCount)) {
+			vkDeviceWaitIdle(device);
+			parallelRecorder.setThreadCount(recordingThreadCount);
+		}
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
@@ -912,6 +1243,79 @@ public:
 			overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur);
 			overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly);
 		}
+		if (overlay->header("Temporal accumulation")) {
+			if (!temporalAvailable) {
+				overlay->text("Not available (temporal shaders not found)");
+			} else {
+				if (overlay->checkBox("Enable", &temporalEnabled)) {
+					temporal.reset();
+				}
+				overlay->checkBox("Camera jitter", &temporal.jitter);
+				overlay->sliderFloat("History weight", &temporal.historyWeight, 0.5f, 0.98f);
+			}
+			overlay->text("Kernel samples per frame: %d", temporalEnabled ? SSAO_KERNEL_SIZE / SSAO_TEMPORAL_FRAMES : SSAO_KERNEL_SIZE);
+			if (timestamps.supported) {
+				// Averages since start for each mode, so both can be compared after toggling
+				const char* modeNames[2] = { "Full kernel", "Temporal" };
+				for (uint32_t i = 0; i < effectStats.size(); i++) {
+					const EffectStats& stats = effectStats[i];
+					if (stats.frameCount == 0) {
+						continue;
+					}
+					overlay->text("%s: ssao %.3f ms, resolve %.3f ms, blur %.3f ms", modeNames[i], stats.ssaoTime / stats.frameCount, stats.resolveTime / stats.frameCount, stats.blurTime / stats.frameCount);
+				}
+			}
+		}
+		if (overlay->header("GPU driven rendering")) {
+			if (gpuDrivenSupported) {
+				overlay->checkBox("Enable", &gpuDriven);
+				overlay->checkBox("Frustum culling", &gpuScene.frustumCulling);
+				overlay->text("Draw count buffer: %s", gpuScene.drawIndirectCount ? "yes" : "no");
+			} else {
+				overlay->text(gpuDrivenShadersAvailable ? "Not supported by this device" : "Not available (indirect shaders not found)");
+			}
+		}
+		if (!gpuDriven && overlay->header("Parallel recording")) {
+			overlay->checkBox("Enable", &parallelRecording);
+			overlay->sliderInt("Threads", &recordingThreadCount, 1, maxRecordingThreadCount);
+			if (parallelRecording) {
+				overlay->text("Secondary command buffers: %d", parallelRecorder.stats.chunks);
+			}
+			// Averages since start for each thread count, so they can be compared after changing it
+			for (uint32_t i = 0; i < recordingStats.size(); i++) {
+				const RecordingStats& stats = recordingStats[i];
+				if (stats.frameCount == 0) {
+					continue;
+				}
+				if (i == 0) {
+					overlay->text("Primary only: %.3f ms (cpu)", stats.recordTime / stats.frameCount);
+				} else {
+					overlay->text("%d thread(s): %.3f ms (cpu)", i, stats.recordTime / stats.frameCount);
+				}
+			}
+		}
+		if (overlay->header("Statistics")) {
+			if (gpuDriven) {
+				overlay->text("Primitives: %d", static_cast<uint32_t>(gpuScene.instances.size()));
+				overlay->text("Visible: %d", gpuScene.drawCount);
+				overlay->text("CPU draw calls: %d", gpuScene.multiDrawIndirect ? 1 : static_cast<uint32_t>(gpuScene.instances.size()));
+			} else {
+				overlay->text("CPU draw calls: %d", scene.drawStats.draws);
+				overlay->text("Descriptor binds: %d", scene.drawStats.descriptorSetBinds);
+				if (bindless) {
+					overlay->text("Push constant updates: %d", scene.drawStats.pushConstantUpdates);
+				}
+			}
+		}
+		if (bindlessRequested && overlay->header("Descriptor heap")) {
+			if (bindless) {
+				overlay->text("Textures: %d / %d", descriptorHeap.stats.used[vks::DescriptorHeap::Textures], descriptorHeap.stats.capacity[vks::DescriptorHeap::Textures]);
+				overlay->text("Storage buffers: %d / %d", descriptorHeap.stats.used[vks::DescriptorHeap::StorageBuffers], descriptorHeap.stats.capacity[vks::DescriptorHeap::StorageBuffers]);
+				overlay->text("Descriptor writes: %d", descriptorHeap.stats.descriptorWrites);
+			} else {
+				overlay->text(bindlessShaderAvailable ? "Not supported by this device" : "Not available (bindless shader not found)");
+			}
+		}
 	}
 };
 
@@ -10,6 +10,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMipGenerator.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -23,8 +24,21 @@ public:
 		uint32_t width{ 0 };
 		uint32_t height{ 0 };
 		uint32_t mipLevels{ 0 };
+		VkFormat format{ VK_FORMAT_UNDEFINED };
 	} texture;
 
+	// Generates the mip chain in a single compute dispatch, or with one blit per level for comparison
+	vks::MipGenerator mipGenerator;
+	// The compute shader is not part of every shader pack, without its SPIR-V all chains are generated with blits
+	bool computeAvailable{ false };
+	int32_t mipMethod{ 0 };
+	// The texture stores sRGB encoded colors in an UNORM image, so filtering them in linear space is more accurate
+	bool srgbFilter{ true };
+	bool regenerateMips{ false };
+	vks::MipGenerator::Method usedMipMethod{ vks::MipGenerator::Method::Compute };
+	// Time from reading the file until the mip chain is done, in milliseconds
+	double textureLoadTime{ 0.0 };
+
 	// To demonstrate mip mapping and filtering this example uses separate samplers
 	std::vector<std::string> samplerNames{ "No mip maps" , "Mip maps (bilinear)" , "Mip maps (anisotropic)" };
 	std::vector<VkSampler> samplers{};
@@ -56,12 +70,18 @@ public:
 		camera.movementSpeed = 2.5f;
 		camera.rotationSpeed = 0.5f;
 		timerSpeed *= 0.05f;
+		commandLineParser.add("blitmips", { "-bm", "--blitmips" }, 0, "Generate the mip chain with blits instead of the compute shader");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("blitmips")) {
+			mipMethod = 1;
+		}
 	}
 
 	~VulkanExample()
 	{
 		if (device) {
 			destroyTextureImage(texture);
+			mipGenerator.destroy();
 			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -81,9 +101,10 @@ public:
 		}
 	}
 
-	// Loads a full sized image from disk, generates a Vulkan image (texture) from it and creates a full mip chain using blits
+	// Loads a full sized image from disk, generates a Vulkan image (texture) from it and creates a full mip chain using a compute shader or blits
 	void loadTextureAndGenerateMips(std::string filename, VkFormat format)
 	{
+		auto tStart = std::chrono::high_resolution_clock::now();
 		ktxResult result;
 		ktxTexture* ktxTexture;
 
@@ -119,13 +140,7 @@ public:
 		// numLevels = 1 + floor(log2(max(w, h, d)))
 		// Calculated as log2(max(width, height, depth))c + 1 (see specs)
 		texture.mipLevels = static_cast<uint32_t>(floor(log2(std::max(texture.width, texture.height))) + 1);
-
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-		// Mip-chain generation requires support for blit source and destination
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		texture.format = format;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
@@ -163,7 +178,9 @@ public:
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { texture.width, texture.height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// The mip generator writes the levels as storage images and needs transfer usage for the blit fallback
+		imageCreateInfo.usage = mipGenerator.imageUsage(format) | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.flags = mipGenerator.imageCreateFlags(format);
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -202,18 +219,6 @@ public:
 
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-		// Transition first mip level to transfer source for read during blit
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			texture.image,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			subresourceRange);
-
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		// Clean up staging resources
@@ -222,89 +227,8 @@ public:
 		ktxTexture_Destroy(ktxTexture);
 
 		// Generate the mip chain
-		// ---------------------------------------------------------------
-		// We copy down the whole mip chain doing a blit from mip-1 to mip
-		// An alternative way would be to always blit from the first mip level and sample that one down
-		VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Copy down mips from n-1 to n
-		for (uint32_t i = 1; i < texture.mipLevels; i++)
-		{
-			VkImageBlit imageBlit{};
-
-			// Source
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i-1;
-			imageBlit.srcOffsets[1].x = int32_t(texture.width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(texture.height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			// Destination
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(texture.width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(texture.height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
-			// Prepare current mip level as image blit destination
-			vks::tools::insertImageMemoryBarrier(
-				blitCmd,
-				texture.image,
-				0,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				mipSubRange);
-
-			// Blit from previous level
-			vkCmdBlitImage(
-				blitCmd,
-				texture.image,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				texture.image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageBlit,
-				VK_FILTER_LINEAR);
-
-			// Prepare current mip level as image blit source for next level
-			vks::tools::insertImageMemoryBarrier(
-				blitCmd,
-				texture.image,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_TRANSFER_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				mipSubRange);
-		}
-
-		// After the loop, all mip layers are in TRANSFER_SRC layout, so transition all to SHADER_READ
-		subresourceRange.levelCount = texture.mipLevels;
-		vks::tools::insertImageMemoryBarrier(
-			blitCmd,
-			texture.image,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
-		// ---------------------------------------------------------------
+		generateMips(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		textureLoadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 
 		// Create some samplers with different settings that can be selected via the UI
 		samplers.resize(3);
@@ -352,6 +276,15 @@ public:
 		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 	}
 
+	// Generate all levels from the first one, which is in the given layout
+	void generateMips(VkImageLayout level0Layout)
+	{
+		const uint32_t filter = srgbFilter ? vks::MipGenerator::FilterSRGB : 0;
+		const vks::MipGenerator::Method method = (mipMethod == 0) ? vks::MipGenerator::Method::Compute : vks::MipGenerator::Method::Blit;
+		// Falls back to blits if the format can't be written as a storage image
+		usedMipMethod = mipGenerator.generate(queue, texture.image, texture.format, texture.width, texture.height, texture.mipLevels, filter, method, level0Layout);
+	}
+
 	// Free all Vulkan resources used a texture object
 	void destroyTextureImage(Texture texture)
 	{
@@ -362,6 +295,13 @@ public:
 
 	void loadAssets()
 	{
+		mipGenerator.create(vulkanDevice, queue);
+		computeAvailable = vks::tools::fileExists(getShadersPath() + "base/mipgen.comp.spv");
+		if (computeAvailable) {
+			mipGenerator.preparePipeline(loadShader(getShadersPath() + "base/mipgen.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		} else {
+			mipMethod = 1;
+		}
 		model.loadFromFile(getAssetPath() + "models/tunnel_cylinder.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY);
 		loadTextureAndGenerateMips(getAssetPath() + "textures/metalplate_nomips_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM);
 	}
@@ -481,6 +421,14 @@ public:
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		if (benchmark.active) {
+			// Reported for the method selected on the command line
+			benchmark.addMetric("texture load ms", [this]() { return textureLoadTime; });
+			benchmark.addMetric("mip chain ms (gpu)", [this]() {
+				const vks::MipGenerator::Stats& stats = mipGenerator.stats;
+				return (usedMipMethod == vks::MipGenerator::Method::Compute) ? stats.computeGpuTime / std::max(stats.computeChainCount, 1u) : stats.blitGpuTime / std::max(stats.blitChainCount, 1u);
+			});
+		}
 		prepared = true;
 	}
 
@@ -531,6 +479,12 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		if (regenerateMips) {
+			// The texture may still be sampled by the other frame in flight
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+			generateMips(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			regenerateMips = false;
+		}
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
@@ -546,6 +500,25 @@ public:
 				updateUniformBuffers();
 			}
 		}
+		if (overlay->header("Mip generation")) {
+			if (computeAvailable) {
+				regenerateMips |= overlay->comboBox("Method", &mipMethod, { "Compute (single pass)", "Blit" });
+				regenerateMips |= overlay->checkBox("sRGB filtering", &srgbFilter);
+			} else {
+				overlay->text("Compute: not available (shader not found)");
+			}
+			regenerateMips |= overlay->button("Regenerate");
+			overlay->text("Texture load time: %.2f ms", textureLoadTime);
+			overlay->text("Last chain: %s", (usedMipMethod == vks::MipGenerator::Method::Compute) ? "compute" : "blit");
+			// Averages for all chains generated with each method, so they can be compared after switching
+			const vks::MipGenerator::Stats& stats = mipGenerator.stats;
+			if (stats.computeChainCount > 0) {
+				overlay->text("Compute: %.3f ms (gpu), %.2f ms (cpu)", stats.computeGpuTime / stats.computeChainCount, stats.computeTime / stats.computeChainCount);
+			}
+			if (stats.blitChainCount > 0) {
+				overlay->text("Blit: %.3f ms (gpu), %.2f ms (cpu)", stats.blitGpuTime / stats.blitChainCount, stats.blitTime / stats.blitChainCount);
+			}
+		}
 	}
 };
 
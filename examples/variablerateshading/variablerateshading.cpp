@@ -21,17 +21,34 @@ VulkanExample::VulkanExample() : VulkanExampleBase()
 	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	enabledDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
 	enabledDeviceExtensions.push_back(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+
+	commandLineParser.add("vrsmode", { "-vrsmode", "--vrsmode" }, 1, "Shading rate mode (fixed, radial, adaptive)");
+	commandLineParser.add("blitmips", { "-bm", "--blitmips" }, 0, "Generate the mip chains of the scene's images with blits instead of the compute shader");
+	commandLineParser.parse(args);
+	if (commandLineParser.isSet("vrsmode")) {
+		const std::string mode = commandLineParser.getValueAsString("vrsmode", "adaptive");
+		shadingRateMode = (mode == "fixed") ? Fixed : ((mode == "radial") ? Radial : Adaptive);
+	}
 }
 
 VulkanExample::~VulkanExample()
 {
 	vkDestroyPipeline(device, pipelines.masked, nullptr);
 	vkDestroyPipeline(device, pipelines.opaque, nullptr);
+	vkDestroyRenderPass(device, uiRenderPass, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-	vkDestroyImageView(device, shadingRateImage.view, nullptr);
-	vkDestroyImage(device, shadingRateImage.image, nullptr);
-	vkFreeMemory(device, shadingRateImage.memory, nullptr);
+	vkDestroyPipeline(device, adaptiveShadingRate.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, adaptiveShadingRate.pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, adaptiveShadingRate.descriptorSetLayout, nullptr);
+	destroyShadingRateImage();
+	destroyHistoryImage();
+	vkDestroySampler(device, history.sampler, nullptr);
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+	}
+	timestamps.destroy();
+	mipGenerator.destroy();
 	for (auto& buffer : uniformBuffers) {
 		buffer.destroy();
 	}
@@ -40,6 +57,8 @@ VulkanExample::~VulkanExample()
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// Used to compare the fragment shader invocations of the different shading rate modes
+	enabledFeatures.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
 	// POI
 	enabledPhysicalDeviceShadingRateImageFeaturesKHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
 	enabledPhysicalDeviceShadingRateImageFeaturesKHR.attachmentFragmentShadingRate = VK_TRUE;
@@ -56,12 +75,18 @@ void VulkanExample::handleResize()
 {
 	vkDeviceWaitIdle(device);
 	// Invalidate the shading rate image, will be recreated in the renderpass setup
-	vkDestroyImageView(device, shadingRateImage.view, nullptr);
-	vkDestroyImage(device, shadingRateImage.image, nullptr);
-	vkFreeMemory(device, shadingRateImage.memory, nullptr);
+	destroyShadingRateImage();
 	prepareShadingRateImage();
+	// The history of the last frame has to match the new shading rate image size
+	if (history.image != VK_NULL_HANDLE) {
+		destroyHistoryImage();
+		prepareHistoryImage();
+		updateAdaptiveDescriptorSet();
+	}
 	// Recreate the render pass and update it with the new fragment shading rate image resolution
 	vkDestroyRenderPass(device, renderPass, nullptr);
+	vkDestroyRenderPass(device, uiRenderPass, nullptr);
+	uiRenderPass = VK_NULL_HANDLE;
 	setupRenderPass();
 	resized = false;
 }
@@ -212,12 +237,31 @@ void VulkanExample::setupRenderPass()
 	renderPassCI.pDependencies = dependencies.data();
 
 	VK_CHECK_RESULT(vkCreateRenderPass2KHR(device, &renderPassCI, nullptr, &renderPass));
+
+	// The adaptive mode copies the scene to the history before the UI is drawn, the UI is then drawn in a second pass that loads the scene's color output
+	// Only load operations and initial layouts differ, so the render passes stay compatible with the pipelines and frame buffers
+	if (adaptiveSupported) {
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		VK_CHECK_RESULT(vkCreateRenderPass2KHR(device, &renderPassCI, nullptr, &uiRenderPass));
+	}
 }
 
 void VulkanExample::loadAssets()
 {
 	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
+	// The glTF loader uses the mip generator for all images without mips, the filter is selected by the material slot the image is used in
+	mipGenerator.create(vulkanDevice, queue);
+	mipComputeAvailable = vks::tools::fileExists(getShadersPath() + "base/mipgen.comp.spv");
+	if (mipComputeAvailable) {
+		mipGenerator.preparePipeline(loadShader(getShadersPath() + "base/mipgen.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+	}
+	mipGenerator.preferredMethod = commandLineParser.isSet("blitmips") ? vks::MipGenerator::Method::Blit : vks::MipGenerator::Method::Compute;
+	vkglTF::mipGenerator = &mipGenerator;
 	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices);
+	vkglTF::mipGenerator = nullptr;
 }
 
 void VulkanExample::setupDescriptors()
@@ -225,8 +269,11 @@ void VulkanExample::setupDescriptors()
 	// Pool
 	const std::vector<VkDescriptorPoolSize> poolSizes = {
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
+		// Adaptive shading rate pass
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
 	};
-	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames);
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames + 1);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 	// Descriptor set layout
@@ -279,12 +326,22 @@ void VulkanExample::prepareShadingRateImage()
 		throw std::runtime_error("Selected shading rate attachment image format does not fragment shading rate");
 	}
 
+	// The adaptive mode writes the shading rate image from a compute shader and needs to copy the color output of the last frame, which requires storage support for the shading rate format and blitting from the swapchain images
+	VkFormatProperties swapChainFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &swapChainFormatProperties);
+	adaptiveShaderAvailable = vks::tools::fileExists(getShadersPath() + "variablerateshading/shadingrate.comp.spv");
+	adaptiveSupported = adaptiveShaderAvailable && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && (swapChainFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) && (swapChain.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	if (!adaptiveSupported && (shadingRateMode == Adaptive)) {
+		shadingRateMode = Radial;
+	}
+
 	// Shading rate image size depends on shading rate texel size
 	// For each texel in the target image, there is a corresponding shading texel size width x height block in the shading rate image
 	VkExtent3D imageExtent{};
 	imageExtent.width = static_cast<uint32_t>(ceil(width / (float)physicalDeviceShadingRateImageProperties.maxFragmentShadingRateAttachmentTexelSize.width));
 	imageExtent.height = static_cast<uint32_t>(ceil(height / (float)physicalDeviceShadingRateImageProperties.maxFragmentShadingRateAttachmentTexelSize.height));
 	imageExtent.depth = 1;
+	shadingRateImage.extent = imageExtent;
 
 	VkImageCreateInfo imageCI{};
 	imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -298,6 +355,9 @@ void VulkanExample::prepareShadingRateImage()
 	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageCI.usage = VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (adaptiveSupported) {
+		imageCI.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &shadingRateImage.image));
 	VkMemoryRequirements memReqs{};
 	vkGetImageMemoryRequirements(device, shadingRateImage.image, &memReqs);
@@ -326,12 +386,10 @@ void VulkanExample::prepareShadingRateImage()
 
 	// Fragment sizes are encoded in a single texel as follows:
 	// size(w) = 2^((texel/4) & 3)
-	// size(h)h = 2^(texel & 3)
-
-	// Populate it with the lowest possible shading rate
-	uint8_t  val = (4 >> 1) | (4 << 1);
-	uint8_t* shadingRatePatternData = new uint8_t[bufferSize];
-	memset(shadingRatePatternData, val, bufferSize);
+	// size(h) = 2^(texel & 3)
+	auto encodeShadingRate = [](VkExtent2D fragmentSize) {
+		return static_cast<uint8_t>((static_cast<uint32_t>(std::log2(fragmentSize.width)) << 2) | static_cast<uint32_t>(std::log2(fragmentSize.height)));
+	};
 
 	// Get a list of available shading rate patterns
 	std::vector<VkPhysicalDeviceFragmentShadingRateKHR> fragmentShadingRates{};
@@ -345,25 +403,38 @@ void VulkanExample::prepareShadingRateImage()
 		}
 		vkGetPhysicalDeviceFragmentShadingRatesKHR(physicalDevice, &fragmentShadingRatesCount, fragmentShadingRates.data());
 	}
+
+	// Rates used by the adaptive mode: 1x1 and 2x2 are always supported with attachment shading rates, 4x4 is optional
+	shadingRateLevels = { encodeShadingRate({ 1, 1 }), encodeShadingRate({ 2, 2 }), encodeShadingRate({ 2, 2 }) };
+	for (const VkPhysicalDeviceFragmentShadingRateKHR& fragmentShadingRate : fragmentShadingRates) {
+		if ((fragmentShadingRate.fragmentSize.width == 4) && (fragmentShadingRate.fragmentSize.height == 4)) {
+			shadingRateLevels[2] = encodeShadingRate({ 4, 4 });
+		}
+	}
+
 	// Create a circular pattern from the available list of fragment shading rates with decreasing sampling rates outwards (max. range, pattern)
 	// Shading rates returned by vkGetPhysicalDeviceFragmentShadingRatesKHR are ordered from largest to smallest
-	std::map<float, uint8_t> patternLookup{};
+	// The ranges are stored in ascending order, so the lookup for each texel stops at the first matching range
+	std::vector<std::pair<float, uint8_t>> patternLookup{};
 	float range = 25.0f / static_cast<uint32_t>(fragmentShadingRates.size());
 	float currentRange = 8.0f;
 	for (size_t i = fragmentShadingRates.size() - 1; i > 0; i--) {
-		uint32_t rate_v = fragmentShadingRates[i].fragmentSize.width == 1 ? 0 : (fragmentShadingRates[i].fragmentSize.width >> 1);
-		uint32_t rate_h = fragmentShadingRates[i].fragmentSize.height == 1 ? 0 : (fragmentShadingRates[i].fragmentSize.height << 1);
-		patternLookup[currentRange] = rate_v | rate_h;
+		patternLookup.push_back({ currentRange, encodeShadingRate(fragmentShadingRates[i].fragmentSize) });
 		currentRange += range;
 	}
 
-	uint8_t* ptrData = shadingRatePatternData;
+	// Texels outside of all ranges get the lowest possible shading rate
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &shadingRateImage.radialPattern, bufferSize));
+	VK_CHECK_RESULT(shadingRateImage.radialPattern.map());
+	uint8_t* ptrData = static_cast<uint8_t*>(shadingRateImage.radialPattern.mapped);
+	const uint8_t lowestRate = encodeShadingRate(fragmentShadingRates.front().fragmentSize);
 	for (uint32_t y = 0; y < imageExtent.height; y++) {
 		for (uint32_t x = 0; x < imageExtent.width; x++) {
 			const float deltaX = (static_cast<float>(imageExtent.width) / 2.0f - static_cast<float>(x)) / imageExtent.width * 100.0f;
 			const float deltaY = (static_cast<float>(imageExtent.height) / 2.0f - static_cast<float>(y)) / imageExtent.height * 100.0f;
 			const float dist = std::sqrt(deltaX * deltaX + deltaY * deltaY);
-			for (auto pattern : patternLookup) {
+			*ptrData = lowestRate;
+			for (const auto& pattern : patternLookup) {
 				if (dist < pattern.first) {
 					*ptrData = pattern.second;
 					break;
@@ -374,71 +445,165 @@ void VulkanExample::prepareShadingRateImage()
 	}
 
 	// Copy the shading rate pattern to the shading rate image
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-
-	VkBufferCreateInfo bufferCreateInfo{};
-	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCreateInfo.size = bufferSize;
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
-	VkMemoryAllocateInfo memAllocInfo{};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memReqs = {};
-	vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
-
-	uint8_t* mapped;
-	VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void**)&mapped));
-	memcpy(mapped, shadingRatePatternData, bufferSize);
-	vkUnmapMemory(device, stagingMemory);
-
-	delete[] shadingRatePatternData;
-
-	// Upload
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 	VkImageSubresourceRange subresourceRange = {};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
-	{
-		VkImageMemoryBarrier imageMemoryBarrier{};
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.srcAccessMask = 0;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.image = shadingRateImage.image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-	}
+	vks::tools::insertImageMemoryBarrier(copyCmd, shadingRateImage.image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, subresourceRange);
+	uploadRadialPattern(copyCmd);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+}
+
+void VulkanExample::destroyShadingRateImage()
+{
+	vkDestroyImageView(device, shadingRateImage.view, nullptr);
+	vkDestroyImage(device, shadingRateImage.image, nullptr);
+	vkFreeMemory(device, shadingRateImage.memory, nullptr);
+	shadingRateImage.radialPattern.destroy();
+	shadingRateImage.image = VK_NULL_HANDLE;
+}
+
+// Records the upload of the radial pattern, used by the radial mode and as a fallback for the adaptive mode until a history is available
+void VulkanExample::uploadRadialPattern(VkCommandBuffer commandBuffer)
+{
+	VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vks::tools::insertImageMemoryBarrier(commandBuffer, shadingRateImage.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
 	VkBufferImageCopy bufferCopyRegion{};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	bufferCopyRegion.imageSubresource.layerCount = 1;
-	bufferCopyRegion.imageExtent.width = imageExtent.width;
-	bufferCopyRegion.imageExtent.height = imageExtent.height;
-	bufferCopyRegion.imageExtent.depth = 1;
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, shadingRateImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-	{
-		VkImageMemoryBarrier imageMemoryBarrier{};
-		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
-		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.dstAccessMask = 0;
-		imageMemoryBarrier.image = shadingRateImage.image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	bufferCopyRegion.imageExtent = shadingRateImage.extent;
+	vkCmdCopyBufferToImage(commandBuffer, shadingRateImage.radialPattern.buffer, shadingRateImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vks::tools::insertImageMemoryBarrier(commandBuffer, shadingRateImage.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, subresourceRange);
+	shadingRateImage.containsRadialPattern = true;
+}
+
+// The history image stores the last frame's color at a resolution of 4x4 texels per shading rate texel
+void VulkanExample::prepareHistoryImage()
+{
+	history.extent = { shadingRateImage.extent.width * 4, shadingRateImage.extent.height * 4 };
+	VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+	imageCI.imageType = VK_IMAGE_TYPE_2D;
+	imageCI.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageCI.extent = { history.extent.width, history.extent.height, 1 };
+	imageCI.mipLevels = 1;
+	imageCI.arrayLayers = 1;
+	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &history.image));
+	VkMemoryRequirements memReqs{};
+	vkGetImageMemoryRequirements(device, history.image, &memReqs);
+	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &history.memory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, history.image, history.memory, 0));
+
+	VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+	viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCI.format = imageCI.format;
+	viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	viewCI.image = history.image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &history.view));
+
+	if (history.sampler == VK_NULL_HANDLE) {
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxLod = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &history.sampler));
 	}
-	vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+	history.valid = false;
+}
+
+void VulkanExample::destroyHistoryImage()
+{
+	vkDestroyImageView(device, history.view, nullptr);
+	vkDestroyImage(device, history.image, nullptr);
+	vkFreeMemory(device, history.memory, nullptr);
+	history.image = VK_NULL_HANDLE;
+	history.valid = false;
+}
+
+void VulkanExample::prepareAdaptiveShadingRate()
+{
+	prepareHistoryImage();
 
-	vkFreeMemory(device, stagingMemory, nullptr);
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		// Binding 0: Downsampled color of the last frame
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		// Binding 1: Shading rate image
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &adaptiveShadingRate.descriptorSetLayout));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &adaptiveShadingRate.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &adaptiveShadingRate.descriptorSet));
+	updateAdaptiveDescriptorSet();
+
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&adaptiveShadingRate.descriptorSetLayout, 1);
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &adaptiveShadingRate.pipelineLayout));
+
+	VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(adaptiveShadingRate.pipelineLayout, 0);
+	computePipelineCreateInfo.stage = loadShader(getShadersPath() + "variablerateshading/shadingrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &adaptiveShadingRate.pipeline));
+}
+
+void VulkanExample::updateAdaptiveDescriptorSet()
+{
+	if (adaptiveShadingRate.descriptorSet == VK_NULL_HANDLE) {
+		return;
+	}
+	VkDescriptorImageInfo historyDescriptor = vks::initializers::descriptorImageInfo(history.sampler, history.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	VkDescriptorImageInfo shadingRateDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(adaptiveShadingRate.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &historyDescriptor),
+		vks::initializers::writeDescriptorSet(adaptiveShadingRate.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &shadingRateDescriptor),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+void VulkanExample::prepareStatistics()
+{
+	timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2, maxConcurrentFrames);
+	if (deviceFeatures.pipelineStatisticsQuery) {
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		queryPoolInfo.queryCount = maxConcurrentFrames;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsQueryPool));
+	}
+}
+
+// Results of a frame are read once its fence has been signaled, so this never stalls
+void VulkanExample::fetchStatistics()
+{
+	ModeStats& stats = modeStats[frameShadingRateModes[currentBuffer]];
+	bool fetched = false;
+	if (timestamps.fetch(currentBuffer)) {
+		stats.sceneTime += timestamps.durations[0];
+		stats.rateTime += timestamps.durations[1];
+		fetched = true;
+	}
+	if ((statisticsQueryPool != VK_NULL_HANDLE) && statisticsWritten[currentBuffer]) {
+		uint64_t fragmentInvocations{ 0 };
+		if (vkGetQueryPoolResults(device, statisticsQueryPool, currentBuffer, 1, sizeof(uint64_t), &fragmentInvocations, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			stats.fragmentInvocations += (double)fragmentInvocations;
+			fetched = true;
+		}
+	}
+	if (fetched) {
+		stats.frameCount++;
+	}
 }
 
 void VulkanExample::preparePipelines()
@@ -517,6 +682,18 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	if (adaptiveSupported) {
+		prepareAdaptiveShadingRate();
+	}
+	prepareStatistics();
+	if (benchmark.active) {
+		benchmark.addMetric("fragment invocations", [this]() { const ModeStats& stats = modeStats[shadingRateMode]; return stats.fragmentInvocations / std::max(stats.frameCount, 1u); });
+		benchmark.addMetric("scene ms (gpu)", [this]() { const ModeStats& stats = modeStats[shadingRateMode]; return stats.sceneTime / std::max(stats.frameCount, 1u); });
+		benchmark.addMetric("shading rate ms (gpu)", [this]() { const ModeStats& stats = modeStats[shadingRateMode]; return stats.rateTime / std::max(stats.frameCount, 1u); });
+		// Run with and without --blitmips to compare the methods
+		benchmark.addMetric("scene mip chains ms (gpu)", [this]() { return mipGenerator.stats.computeGpuTime + mipGenerator.stats.blitGpuTime; });
+		benchmark.addMetric("scene mip chains ms (cpu)", [this]() { return mipGenerator.stats.computeTime + mipGenerator.stats.blitTime; });
+	}
 	prepared = true;
 }
 
@@ -545,6 +722,38 @@ void VulkanExample::buildCommandBuffer()
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
 	VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+	timestamps.reset(cmdBuffer, currentBuffer);
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(cmdBuffer, statisticsQueryPool, currentBuffer, 1);
+	}
+	frameShadingRateModes[currentBuffer] = shadingRateMode;
+
+	// Update the shading rate image for this frame
+	timestamps.begin(cmdBuffer, currentBuffer, 1);
+	if ((shadingRateMode == Adaptive) && history.valid) {
+		// Generate the rates from the last frame's color and the camera motion since then
+		const VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, shadingRateImage.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+		const glm::mat4 viewProjection = camera.matrices.perspective * camera.matrices.view;
+		PushConstants pushConstants{};
+		pushConstants.reprojection = adaptiveShadingRate.previousViewProjection * glm::inverse(viewProjection);
+		pushConstants.thresholds = glm::vec4(adaptiveShadingRate.lowContrast, adaptiveShadingRate.highContrast, adaptiveShadingRate.motionThreshold, 0.0f);
+		pushConstants.rates = glm::uvec4(shadingRateLevels[0], shadingRateLevels[1], shadingRateLevels[2], 0);
+		pushConstants.screenSize = glm::vec2((float)width, (float)height);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, adaptiveShadingRate.pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, adaptiveShadingRate.pipelineLayout, 0, 1, &adaptiveShadingRate.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, adaptiveShadingRate.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(cmdBuffer, (shadingRateImage.extent.width + 7) / 8, (shadingRateImage.extent.height + 7) / 8, 1);
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, shadingRateImage.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, subresourceRange);
+		shadingRateImage.containsRadialPattern = false;
+	} else if ((shadingRateMode != Fixed) && !shadingRateImage.containsRadialPattern) {
+		// The adaptive mode falls back to the radial pattern until a history of the last frame is available
+		uploadRadialPattern(cmdBuffer);
+	}
+	timestamps.end(cmdBuffer, currentBuffer, 1);
+
+	timestamps.begin(cmdBuffer, currentBuffer, 0);
 	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
@@ -554,7 +763,7 @@ void VulkanExample::buildCommandBuffer()
 	VkExtent2D fragmentSize = { 1, 1 };
 	VkFragmentShadingRateCombinerOpKHR combinerOps[2]{};
 	// The combiners determine how the different shading rate values for the pipeline, primitives and attachment are combined
-	if (enableShadingRate)
+	if (shadingRateMode != Fixed)
 	{
 		// If shading rate from attachment is enabled, we set the combiner, so that the values from the attachment are used
 		// Combiner for pipeline (A) and primitive (B) - Not used in this sample
@@ -571,13 +780,49 @@ void VulkanExample::buildCommandBuffer()
 	vkCmdSetFragmentShadingRateKHR(cmdBuffer, &fragmentSize, combinerOps);
 
 	// Render the scene
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkCmdBeginQuery(cmdBuffer, statisticsQueryPool, currentBuffer, 0);
+	}
 	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
 	scene.draw(cmdBuffer, vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
 	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
 	scene.draw(cmdBuffer, vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkCmdEndQuery(cmdBuffer, statisticsQueryPool, currentBuffer);
+		statisticsWritten[currentBuffer] = true;
+	}
+	timestamps.end(cmdBuffer, currentBuffer, 0);
+
+	// Keep a downsampled copy of this frame's color output for generating the next frame's shading rates
+	// The copy is taken before the UI is drawn, so the overlay doesn't affect the contrast and motion estimation
+	// Execution order of the submissions on the graphics queue makes sure that the next frame's compute pass reads it after this copy
+	if (shadingRateMode == Adaptive) {
+		vkCmdEndRenderPass(cmdBuffer);
+		const VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkImage swapChainImage = swapChain.images[currentImageIndex];
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, swapChainImage, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, history.image, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.srcOffsets[1] = { (int32_t)width, (int32_t)height, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.dstOffsets[1] = { (int32_t)history.extent.width, (int32_t)history.extent.height, 1 };
+		vkCmdBlitImage(cmdBuffer, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, swapChainImage, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, subresourceRange);
+		vks::tools::insertImageMemoryBarrier(cmdBuffer, history.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+		adaptiveShadingRate.previousViewProjection = camera.matrices.perspective * camera.matrices.view;
+		history.valid = true;
+		// The UI pass transitions the swapchain image to the present layout
+		VkRenderPassBeginInfo uiRenderPassBeginInfo = renderPassBeginInfo;
+		uiRenderPassBeginInfo.renderPass = uiRenderPass;
+		vkCmdBeginRenderPass(cmdBuffer, &uiRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	} else {
+		history.valid = false;
+	}
 
 	drawUI(cmdBuffer);
 	vkCmdEndRenderPass(cmdBuffer);
+
 	VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 }
 
@@ -586,6 +831,7 @@ void VulkanExample::render()
 	if (!prepared)
 		return;
 	VulkanExampleBase::prepareFrame();
+	fetchStatistics();
 	updateUniformBuffers();
 	buildCommandBuffer();
 	VulkanExampleBase::submitFrame();
@@ -593,8 +839,43 @@ void VulkanExample::render()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	overlay->checkBox("Enable shading rate", &enableShadingRate);
+	std::vector<std::string> modes = { "Fixed (1x1)", "Radial" };
+	if (adaptiveSupported) {
+		modes.push_back("Adaptive");
+	}
+	overlay->comboBox("Shading rate", &shadingRateMode, modes);
+	if (!adaptiveShaderAvailable) {
+		overlay->text("Adaptive: not available (shader not found)");
+	}
 	overlay->checkBox("Color shading rates", &colorShadingRate);
+	if ((shadingRateMode == Adaptive) && overlay->header("Adaptive")) {
+		overlay->sliderFloat("Low contrast", &adaptiveShadingRate.lowContrast, 0.0f, 0.5f);
+		overlay->sliderFloat("High contrast", &adaptiveShadingRate.highContrast, 0.0f, 1.0f);
+		overlay->sliderFloat("Motion (px)", &adaptiveShadingRate.motionThreshold, 0.0f, 64.0f);
+	}
+	if (overlay->header("Statistics")) {
+		// Averages per mode since startup, so modes can be compared by switching between them
+		const char* names[] = { "Fixed", "Radial", "Adaptive" };
+		for (uint32_t i = 0; i < modeStats.size(); i++) {
+			const ModeStats& stats = modeStats[i];
+			if (stats.frameCount == 0) {
+				continue;
+			}
+			overlay->text("%s: %.2f M frag. invocations", names[i], stats.fragmentInvocations / stats.frameCount / 1000000.0);
+			overlay->text("%s: %.3f ms scene, %.3f ms rates", names[i], stats.sceneTime / stats.frameCount, stats.rateTime / stats.frameCount);
+		}
+		// Totals for all images of the scene, mip chains are only generated at load time
+		const vks::MipGenerator::Stats& mipStats = mipGenerator.stats;
+		if (!mipComputeAvailable) {
+			overlay->text("Compute mips: not available (shader not found)");
+		}
+		if (mipStats.computeChainCount > 0) {
+			overlay->text("Compute mips: %d chains, %.3f ms (gpu), %.2f ms (cpu)", mipStats.computeChainCount, mipStats.computeGpuTime, mipStats.computeTime);
+		}
+		if (mipStats.blitChainCount > 0) {
+			overlay->text("Blit mips: %d chains, %.3f ms (gpu), %.2f ms (cpu)", mipStats.blitChainCount, mipStats.blitGpuTime, mipStats.blitTime);
+		}
+	}
 }
 
 VULKAN_EXAMPLE_MAIN()
@@ -8,21 +8,86 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
+#include "VulkanMipGenerator.hpp"
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	vkglTF::Model scene;
+	// Generates the mip chains of the scene's images, alpha weighted for the masked foliage and renormalized for the normal maps
+	vks::MipGenerator mipGenerator;
+	// The compute shader is not part of every shader pack, without its SPIR-V all chains are generated with blits
+	bool mipComputeAvailable{ false };
 
 	struct ShadingRateImage {
 		VkImage image{ VK_NULL_HANDLE };
 		VkDeviceMemory memory;
 		VkImageView view;
+		VkExtent3D extent;
+		// Radial pattern generated on the CPU, kept for restoring the image after it has been written by the adaptive pass
+		vks::Buffer radialPattern;
+		bool containsRadialPattern{ false };
 	} shadingRateImage;
 
-	bool enableShadingRate = true;
+	// Fixed: Shading rate attachment is ignored, everything is shaded at 1x1
+	// Radial: Static pattern with coarser rates towards the edges of the screen
+	// Adaptive: Rates are generated by a compute shader each frame from the luminance contrast and motion of the last frame
+	enum ShadingRateMode { Fixed = 0, Radial = 1, Adaptive = 2 };
+	int32_t shadingRateMode{ Adaptive };
 	bool colorShadingRate = false;
 
+	// Encoded shading rates from fine to coarse used by the adaptive pass
+	std::array<uint32_t, 3> shadingRateLevels{};
+	bool adaptiveSupported{ false };
+	// The shading rate compute shader is not part of every shader pack, the adaptive mode is only offered if its SPIR-V is present
+	bool adaptiveShaderAvailable{ false };
+	// Compatible with the scene render pass, but keeps the color attachment so the UI can be drawn after the scene was copied to the history
+	VkRenderPass uiRenderPass{ VK_NULL_HANDLE };
+
+	// Downsampled copy of the last frame's color output, read by the adaptive shading rate pass
+	struct History {
+		VkImage image{ VK_NULL_HANDLE };
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkImageView view{ VK_NULL_HANDLE };
+		VkSampler sampler{ VK_NULL_HANDLE };
+		VkExtent2D extent{};
+		bool valid{ false };
+	} history;
+
+	struct AdaptiveShadingRate {
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		// Tiles with a luminance contrast below the low threshold get the coarsest rate, below the high threshold the medium rate
+		float lowContrast{ 0.05f };
+		float highContrast{ 0.2f };
+		// Tiles moving faster than this (in pixels per frame) are shaded one step coarser
+		float motionThreshold{ 8.0f };
+		glm::mat4 previousViewProjection{ 1.0f };
+	} adaptiveShadingRate;
+
+	struct PushConstants {
+		glm::mat4 reprojection;
+		glm::vec4 thresholds;
+		glm::uvec4 rates;
+		glm::vec2 screenSize;
+	};
+
+	// Fragment shader invocations of the scene (pipeline statistics) and GPU times of the shading rate generation and the scene per frame
+	VkQueryPool statisticsQueryPool{ VK_NULL_HANDLE };
+	std::array<bool, maxConcurrentFrames> statisticsWritten{};
+	std::array<int32_t, maxConcurrentFrames> frameShadingRateModes{};
+	vks::TimestampQuery timestamps;
+	struct ModeStats {
+		double fragmentInvocations{ 0.0 };
+		double sceneTime{ 0.0 };
+		double rateTime{ 0.0 };
+		uint32_t frameCount{ 0 };
+	};
+	std::array<ModeStats, 3> modeStats{};
+
 	struct UniformData {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -56,6 +121,14 @@ public:
 	void buildCommandBuffer();
 	void loadAssets();
 	void prepareShadingRateImage();
+	void destroyShadingRateImage();
+	void uploadRadialPattern(VkCommandBuffer commandBuffer);
+	void prepareHistoryImage();
+	void destroyHistoryImage();
+	void prepareAdaptiveShadingRate();
+	void updateAdaptiveDescriptorSet();
+	void prepareStatistics();
+	void fetchStatistics();
 	void setupDescriptors();
 	void preparePipelines();
 	void prepareUniformBuffers();
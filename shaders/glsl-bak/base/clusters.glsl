@@ -0,0 +1,93 @@
+// Clustered light culling, shared by the culling pass (base/clustercull.comp) and the shading passes
+// Math needs to stay in sync with the host reference in base/VulkanClusteredLights.hpp
+
+// Bindings are selected by the including shader
+#if !defined(CLUSTER_BINDING_PARAMS) || !defined(CLUSTER_BINDING_LIGHTS)
+#error "CLUSTER_BINDING_PARAMS and CLUSTER_BINDING_LIGHTS need to be defined before including clusters.glsl"
+#endif
+
+struct ClusterLight {
+	// xyz = world space position, w = range
+	vec4 position;
+	// rgb = color, a = intensity
+	vec4 color;
+};
+
+layout (binding = CLUSTER_BINDING_PARAMS) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	// xyz = number of clusters per axis, w = number of lights
+	uvec4 gridSize;
+	// xy = size of the render target in pixels, z = near plane, w = far plane
+	vec4 screenDepth;
+	uint indexCapacity;
+} clusterParams;
+
+layout (std430, binding = CLUSTER_BINDING_LIGHTS) readonly buffer ClusterLights {
+	ClusterLight clusterLights[];
+};
+
+// Shading passes only read the culling results, the culling pass declares them writable itself
+#if defined(CLUSTER_BINDING_GRID) && defined(CLUSTER_BINDING_INDICES)
+layout (std430, binding = CLUSTER_BINDING_GRID) readonly buffer ClusterGrid {
+	uvec2 clusterGrid[];
+};
+layout (std430, binding = CLUSTER_BINDING_INDICES) readonly buffer ClusterIndices {
+	uint clusterLightIndices[];
+};
+#endif
+
+// View space depth at the near side of a slice, slices are distributed exponentially between the near and the far plane
+float clusterSliceDepth(uint slice)
+{
+	return clusterParams.screenDepth.z * pow(clusterParams.screenDepth.w / clusterParams.screenDepth.z, float(slice) / float(clusterParams.gridSize.z));
+}
+
+uint clusterSlice(float viewDepth)
+{
+	// Fragments without geometry (e.g. G-Buffer background with a zero position) can be at or behind the camera, log() would return NaN for them
+	viewDepth = max(viewDepth, clusterParams.screenDepth.z);
+	float slice = floor(log(viewDepth / clusterParams.screenDepth.z) / log(clusterParams.screenDepth.w / clusterParams.screenDepth.z) * float(clusterParams.gridSize.z));
+	return uint(clamp(slice, 0.0, float(clusterParams.gridSize.z - 1u)));
+}
+
+// Index of the cluster containing a fragment, viewDepth is the (positive) distance along the view direction, depths in front of the near plane map to the first slice
+uint clusterIndex(vec2 fragCoord, float viewDepth)
+{
+	uvec2 tile = min(uvec2(fragCoord / clusterParams.screenDepth.xy * vec2(clusterParams.gridSize.xy)), clusterParams.gridSize.xy - 1u);
+	return (clusterSlice(viewDepth) * clusterParams.gridSize.y + tile.y) * clusterParams.gridSize.x + tile.x;
+}
+
+vec3 clusterUnproject(vec2 ndc, float viewDepth)
+{
+	vec4 p = clusterParams.inverseProjection * vec4(ndc, 1.0, 1.0);
+	vec3 ray = p.xyz / p.w;
+	return ray * (viewDepth / -ray.z);
+}
+
+// View space bounds of a cluster
+void clusterBounds(uint cluster, out vec3 aabbMin, out vec3 aabbMax)
+{
+	uvec3 gridSize = clusterParams.gridSize.xyz;
+	uvec3 c = uvec3(cluster % gridSize.x, (cluster / gridSize.x) % gridSize.y, cluster / (gridSize.x * gridSize.y));
+	vec2 ndcMin = vec2(c.xy) / vec2(gridSize.xy) * 2.0 - 1.0;
+	vec2 ndcMax = vec2(c.xy + 1u) / vec2(gridSize.xy) * 2.0 - 1.0;
+	float depths[2] = float[](clusterSliceDepth(c.z), clusterSliceDepth(c.z + 1u));
+	aabbMin = vec3(3.402823e38);
+	aabbMax = vec3(-3.402823e38);
+	for (int d = 0; d < 2; d++) {
+		for (int i = 0; i < 4; i++) {
+			vec3 p = clusterUnproject(vec2(((i & 1) != 0) ? ndcMax.x : ndcMin.x, ((i & 2) != 0) ? ndcMax.y : ndcMin.y), depths[d]);
+			aabbMin = min(aabbMin, p);
+			aabbMax = max(aabbMax, p);
+		}
+	}
+}
+
+// Inverse square falloff, windowed so it reaches zero at the light's range (which is what lights are culled against)
+float clusterLightAttenuation(float dist, float range)
+{
+	float x = dist / range;
+	float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+	return window * window / (dist * dist + 1.0);
+}
@@ -0,0 +1,164 @@
+// Builds the min/max depth pyramid in a single dispatch
+// Each workgroup reduces a 64x64 tile of the depth attachment to the first six levels, the last workgroup to finish reduces the remaining levels
+// Level 0 has half the resolution of the depth attachment, level sizes are rounded up and reads are clamped to the edge,
+// so texels at the right and bottom of odd sized levels cover the remaining pixels
+
+layout (local_size_x = 256) in;
+
+layout (binding = 0) uniform sampler2D samplerDepth;
+// Only constant indices are used for the level arrays, so no dynamic indexing features are required
+layout (binding = 1, r32f) uniform coherent image2D minLevels[16];
+layout (binding = 2, r32f) uniform coherent image2D maxLevels[16];
+layout (binding = 3) coherent buffer Counter
+{
+	uint finishedGroups;
+};
+
+layout (push_constant) uniform PushConsts {
+	ivec2 depthSize;
+	uint levelCount;
+	uint groupCount;
+} params;
+
+shared vec2 sharedDepth[256];
+shared bool lastGroup;
+
+#define LEVEL_CASE_STORE(i) case i: imageStore(minLevels[i], texel, vec4(value.x)); imageStore(maxLevels[i], texel, vec4(value.y)); break;
+#define LEVEL_CASE_LOAD(i) case i: return vec2(imageLoad(minLevels[i], texel).r, imageLoad(maxLevels[i], texel).r);
+
+// Size of a level, the rounded up sizes of the chain are the same as rounding up the size divided by the level's texel footprint
+ivec2 levelSize(uint level)
+{
+	return (params.depthSize + ivec2((2 << level) - 1)) >> (level + 1);
+}
+
+void storeLevel(uint level, ivec2 texel, vec2 value)
+{
+	if ((level >= params.levelCount) || any(greaterThanEqual(texel, levelSize(level)))) {
+		return;
+	}
+	switch (int(level)) {
+		LEVEL_CASE_STORE(0) LEVEL_CASE_STORE(1) LEVEL_CASE_STORE(2) LEVEL_CASE_STORE(3)
+		LEVEL_CASE_STORE(4) LEVEL_CASE_STORE(5) LEVEL_CASE_STORE(6) LEVEL_CASE_STORE(7)
+		LEVEL_CASE_STORE(8) LEVEL_CASE_STORE(9) LEVEL_CASE_STORE(10) LEVEL_CASE_STORE(11)
+		LEVEL_CASE_STORE(12) LEVEL_CASE_STORE(13) LEVEL_CASE_STORE(14) LEVEL_CASE_STORE(15)
+	}
+}
+
+vec2 loadLevel(uint level, ivec2 texel)
+{
+	switch (int(level)) {
+		LEVEL_CASE_LOAD(0) LEVEL_CASE_LOAD(1) LEVEL_CASE_LOAD(2) LEVEL_CASE_LOAD(3)
+		LEVEL_CASE_LOAD(4) LEVEL_CASE_LOAD(5) LEVEL_CASE_LOAD(6) LEVEL_CASE_LOAD(7)
+		LEVEL_CASE_LOAD(8) LEVEL_CASE_LOAD(9) LEVEL_CASE_LOAD(10) LEVEL_CASE_LOAD(11)
+		LEVEL_CASE_LOAD(12) LEVEL_CASE_LOAD(13) LEVEL_CASE_LOAD(14) LEVEL_CASE_LOAD(15)
+	}
+	return vec2(1.0, 0.0);
+}
+
+// x = min depth, y = max depth
+vec2 reduce(vec2 a, vec2 b)
+{
+	return vec2(min(a.x, b.x), max(a.y, b.y));
+}
+
+// Morton order: bits 0, 2, 4, 6 are x and bits 1, 3, 5, 7 are y, so each group of four consecutive indices forms a 2x2 square
+ivec2 mortonDecode(uint index)
+{
+	uvec2 v = uvec2(index, index >> 1) & 0x55u;
+	v = (v | (v >> 1)) & 0x33u;
+	v = (v | (v >> 2)) & 0x0fu;
+	return ivec2(v);
+}
+
+void main()
+{
+	const uint index = gl_LocalInvocationIndex;
+	const ivec2 tile = ivec2(gl_WorkGroupID.xy);
+
+	// Levels 0 and 1: Each invocation reduces a 4x4 block of depth pixels, which are 2x2 texels of level 0 and a single texel of level 1
+	const ivec2 level1Texel = tile * 16 + mortonDecode(index);
+	vec2 value = vec2(1.0, 0.0);
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			const ivec2 level0Texel = level1Texel * 2 + ivec2(x, y);
+			vec2 level0 = vec2(1.0, 0.0);
+			for (int py = 0; py < 2; py++) {
+				for (int px = 0; px < 2; px++) {
+					level0 = reduce(level0, vec2(texelFetch(samplerDepth, min(level0Texel * 2 + ivec2(px, py), params.depthSize - 1), 0).r));
+				}
+			}
+			storeLevel(0, level0Texel, level0);
+			value = reduce(value, level0);
+		}
+	}
+	storeLevel(1, level1Texel, value);
+
+	// Levels 2 to 5: Each step combines four values that are adjacent in Morton order, the results are compacted for the next step
+	for (uint level = 2; level < 6; level++) {
+		// Number of input values: 256, 64, 16, 4
+		const uint count = 256u >> (2u * (level - 2u));
+#if defined(HIZ_SUBGROUP)
+		// Assumes invocations are assigned to subgroups in local invocation order, so a quad holds one 2x2 square
+		if (index < count) {
+			value = reduce(value, subgroupQuadSwapHorizontal(value));
+			value = reduce(value, subgroupQuadSwapVertical(value));
+			if ((index & 3u) == 0u) {
+				sharedDepth[index >> 2] = value;
+			}
+		}
+		barrier();
+		if (index < count / 4u) {
+			value = sharedDepth[index];
+		}
+		barrier();
+#else
+		if (index < count) {
+			sharedDepth[index] = value;
+		}
+		barrier();
+		if (index < count / 4u) {
+			value = reduce(reduce(sharedDepth[index * 4u], sharedDepth[index * 4u + 1u]), reduce(sharedDepth[index * 4u + 2u], sharedDepth[index * 4u + 3u]));
+		}
+		barrier();
+#endif
+		if (index < count / 4u) {
+			storeLevel(level, tile * int(16u >> (level - 1u)) + mortonDecode(index), value);
+		}
+	}
+
+	if (params.levelCount <= 6u) {
+		return;
+	}
+
+	// Remaining levels: The last workgroup to finish has all of level 5 available and reduces the rest of the chain
+	memoryBarrierImage();
+	barrier();
+	if (index == 0u) {
+		lastGroup = (atomicAdd(finishedGroups, 1u) == params.groupCount - 1u);
+		if (lastGroup) {
+			// Reset for the next build
+			atomicExchange(finishedGroups, 0u);
+		}
+	}
+	barrier();
+	if (!lastGroup) {
+		return;
+	}
+	for (uint level = 6; level < params.levelCount; level++) {
+		const ivec2 size = levelSize(level);
+		const ivec2 previousSize = levelSize(level - 1u);
+		for (int i = int(index); i < size.x * size.y; i += 256) {
+			const ivec2 texel = ivec2(i % size.x, i / size.x);
+			vec2 levelValue = vec2(1.0, 0.0);
+			for (int y = 0; y < 2; y++) {
+				for (int x = 0; x < 2; x++) {
+					levelValue = reduce(levelValue, loadLevel(level - 1u, min(texel * 2 + ivec2(x, y), previousSize - 1)));
+				}
+			}
+			storeLevel(level, texel, levelValue);
+		}
+		memoryBarrierImage();
+		barrier();
+	}
+}
@@ -0,0 +1,42 @@
+// Occlusion tests against a max depth pyramid built by base/hiz.comp
+// Bounds are projected with the view projection matrix the pyramid was built with, the test reads the level where the
+// projected rectangle spans at most two texels per axis and compares the nearest depth of the bounds against the farthest depth in that area
+// Bounds that are off screen or cross the near plane are reported as visible, frustum culling has to handle these
+
+bool hizVisibleAABB(sampler2D pyramid, mat4 viewProjection, vec2 depthSize, vec3 aabbMin, vec3 aabbMax)
+{
+	vec3 ndcMin = vec3(3.4e38);
+	vec3 ndcMax = vec3(-3.4e38);
+	for (int i = 0; i < 8; i++) {
+		const vec3 corner = mix(aabbMin, aabbMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		const vec4 clip = viewProjection * vec4(corner, 1.0);
+		if (clip.w <= 0.0) {
+			return true;
+		}
+		const vec3 ndc = clip.xyz / clip.w;
+		ndcMin = min(ndcMin, ndc);
+		ndcMax = max(ndcMax, ndc);
+	}
+	if (any(lessThan(ndcMax.xy, vec2(-1.0))) || any(greaterThan(ndcMin.xy, vec2(1.0)))) {
+		return true;
+	}
+
+	// Pixel rectangle covered by the bounds in the depth attachment
+	const ivec2 pixelMin = clamp(ivec2((ndcMin.xy * 0.5 + 0.5) * depthSize), ivec2(0), ivec2(depthSize) - 1);
+	const ivec2 pixelMax = clamp(ivec2((ndcMax.xy * 0.5 + 0.5) * depthSize), ivec2(0), ivec2(depthSize) - 1);
+	// Texels of level n cover 2^(n+1) pixels per axis, so a rectangle smaller than that spans at most two texels
+	const int extent = max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y);
+	const int level = clamp(findMSB(extent), 0, textureQueryLevels(pyramid) - 1);
+	const ivec2 texelMin = pixelMin >> (level + 1);
+	const ivec2 texelMax = pixelMax >> (level + 1);
+	const float maxDepth = max(
+		max(texelFetch(pyramid, texelMin, level).r, texelFetch(pyramid, ivec2(texelMax.x, texelMin.y), level).r),
+		max(texelFetch(pyramid, ivec2(texelMin.x, texelMax.y), level).r, texelFetch(pyramid, texelMax, level).r));
+	return ndcMin.z <= maxDepth;
+}
+
+bool hizVisibleSphere(sampler2D pyramid, mat4 viewProjection, vec2 depthSize, vec3 center, float radius)
+{
+	// The box enclosing the sphere is a conservative stand-in
+	return hizVisibleAABB(pyramid, viewProjection, depthSize, center - vec3(radius), center + vec3(radius));
+}
@@ -63,6 +63,9 @@ for root, dirs, files in os.walk(dir_path):
             # Same goes for samples that use ray queries
             if root.endswith("rayquery") and file.endswith(".frag"):
                 add_params = add_params + " --target-env vulkan1.2"
+            # Shader variants using subgroup operations
+            if file.endswith("_subgroup.comp"):
+                add_params = add_params + " --target-env vulkan1.1"
             # Mesh and task shader also require different settings
             if file.endswith(".mesh") or file.endswith(".task"):
                 add_params = add_params + " --target-env spirv1.4"
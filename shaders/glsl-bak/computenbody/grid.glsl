@@ -0,0 +1,69 @@
+/* Copyright (c) 2025, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+// Shared declarations for the hierarchical grid (implicit octree) used by the approximate N-body simulation
+// Level 0 is the finest level with gridResolution^3 cells, each further level halves the resolution
+
+struct Particle
+{
+	vec4 pos;
+	vec4 vel;
+};
+
+layout (binding = 1) uniform UBO 
+{
+	float deltaT;
+	int particleCount;
+	float gravity;
+	float power;
+	float soften;
+	// Opening angle criterion, cells with size / distance < theta are treated as a single body
+	float theta;
+	int gridLevels;
+	int gridResolution;
+	// xyz = minimum corner of the simulation domain, w = edge length
+	vec4 gridBounds;
+	// Masses and positions are accumulated with integer atomics, so they are stored as fixed point values
+	// The scale is derived from the total mass so that no cell's sum can overflow
+	float fixedPointScale;
+} ubo;
+
+#define MAX_GRID_LEVELS 8
+
+uint levelResolution(int level)
+{
+	return uint(ubo.gridResolution) >> level;
+}
+
+uint levelOffset(int level)
+{
+	uint offset = 0;
+	for (int i = 0; i < level; i++) {
+		uint res = levelResolution(i);
+		offset += res * res * res;
+	}
+	return offset;
+}
+
+uint cellIndex(uvec3 cell, uint res)
+{
+	return cell.x + cell.y * res + cell.z * res * res;
+}
+
+uvec3 cellCoord(uint index, uint res)
+{
+	return uvec3(index % res, (index / res) % res, index / (res * res));
+}
+
+float cellSize(int level)
+{
+	return ubo.gridBounds.w / float(levelResolution(level));
+}
+
+vec3 cellCenter(uvec3 cell, int level)
+{
+	return ubo.gridBounds.xyz + (vec3(cell) + 0.5) * cellSize(level);
+}
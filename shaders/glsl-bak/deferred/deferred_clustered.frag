@@ -0,0 +1,105 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (binding = 1) uniform sampler2D samplerposition;
+layout (binding = 2) uniform sampler2D samplerNormal;
+layout (binding = 3) uniform sampler2D samplerAlbedo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+layout (binding = 4) uniform UBO 
+{
+	vec4 viewPos;
+	int displayDebugTarget;
+	// Only evaluate the lights of the fragment's cluster instead of all lights
+	int clustered;
+} ubo;
+
+#define CLUSTER_BINDING_PARAMS 5
+#define CLUSTER_BINDING_LIGHTS 6
+#define CLUSTER_BINDING_GRID 7
+#define CLUSTER_BINDING_INDICES 8
+#include "../base/clusters.glsl"
+
+vec3 shadeLight(ClusterLight light, vec3 fragPos, vec3 N, vec3 V, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+	if (dist >= light.position.w) {
+		return vec3(0.0);
+	}
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation
+	float atten = light.color.a * clusterLightAttenuation(dist, light.position.w);
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+void main() 
+{
+	// Get G-Buffer values
+	vec3 fragPos = texture(samplerposition, inUV).rgb;
+	vec3 normal = texture(samplerNormal, inUV).rgb;
+	vec4 albedo = texture(samplerAlbedo, inUV);
+	
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				outFragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				outFragcolor.rgb = normal;
+				break;
+			case 3: 
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				outFragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	// Render-target composition
+
+	#define ambient 0.0
+	
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * ambient;
+
+	vec3 N = normalize(normal);
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered > 0) {
+		float viewDepth = -(clusterParams.view * vec4(fragPos, 1.0)).z;
+		uvec2 cluster = clusterGrid[clusterIndex(gl_FragCoord.xy, viewDepth)];
+		for (uint i = 0; i < cluster.y; i++) {
+			fragcolor += shadeLight(clusterLights[clusterLightIndices[cluster.x + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		for (uint i = 0; i < clusterParams.gridSize.w; i++) {
+			fragcolor += shadeLight(clusterLights[i], fragPos, N, V, albedo);
+		}
+	}
+   
+  outFragcolor = vec4(fragcolor, 1.0);	
+}
\ No newline at end of file
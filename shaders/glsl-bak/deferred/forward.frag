@@ -0,0 +1,65 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Forward shading path, lights are looked up from the same clusters as in the deferred composition
+
+layout (binding = 1) uniform sampler2D samplerColor;
+layout (binding = 2) uniform sampler2D samplerNormalMap;
+
+layout (binding = 4) uniform UBO 
+{
+	vec4 viewPos;
+	int displayDebugTarget;
+	int clustered;
+} ubo;
+
+#define CLUSTER_BINDING_PARAMS 5
+#define CLUSTER_BINDING_LIGHTS 6
+#define CLUSTER_BINDING_GRID 7
+#define CLUSTER_BINDING_INDICES 8
+#include "../base/clusters.glsl"
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// Same inputs as written to the G-Buffer by mrt.frag
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(inTangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	N = normalize(TBN * normalize(texture(samplerNormalMap, inUV).xyz * 2.0 - vec3(1.0)));
+	vec4 albedo = texture(samplerColor, inUV);
+
+	vec3 V = normalize(ubo.viewPos.xyz - inWorldPos);
+	vec3 fragcolor = vec3(0.0);
+
+	float viewDepth = -(clusterParams.view * vec4(inWorldPos, 1.0)).z;
+	uvec2 cluster = clusterGrid[clusterIndex(gl_FragCoord.xy, viewDepth)];
+	for (uint i = 0; i < cluster.y; i++) {
+		ClusterLight light = clusterLights[clusterLightIndices[cluster.x + i]];
+		vec3 L = light.position.xyz - inWorldPos;
+		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+		L = normalize(L);
+		float atten = light.color.a * clusterLightAttenuation(dist, light.position.w);
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+		// Specular part, specular map values are stored in the alpha channel of the color map
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+		fragcolor += diff + spec;
+	}
+
+	outFragColor = vec4(fragcolor, 1.0);
+}
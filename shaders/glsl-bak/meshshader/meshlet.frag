@@ -0,0 +1,25 @@
+/* Copyright (c) 2025, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#version 450
+ 
+layout (location = 0) in VertexInput {
+	vec3 normal;
+	vec3 color;
+	vec3 viewVec;
+} vertexInput;
+
+layout(location = 0) out vec4 outFragColor;
+
+void main()
+{
+	vec3 N = normalize(vertexInput.normal);
+	vec3 L = normalize(vec3(0.25, -1.0, 0.5));
+	vec3 V = normalize(vertexInput.viewVec);
+	float diffuse = max(dot(N, -L), 0.0);
+	float ambient = 0.25 + 0.25 * max(dot(N, V), 0.0);
+	outFragColor = vec4(vertexInput.color * (ambient + diffuse * 0.75), 1.0);
+}
@@ -0,0 +1,38 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection[2];
+	mat4 modelview[2];
+	vec4 lightPos;
+} ubo;
+
+// Used when rendering the views in separate passes without multiview, selects the view instead of gl_ViewIndex
+layout (push_constant) uniform PushConsts {
+	int viewIndex;
+} pushConsts;
+
+void main() 
+{
+	outColor = inColor;
+	outNormal = mat3(ubo.modelview[pushConsts.viewIndex]) * inNormal;
+
+	vec4 pos = vec4(inPos.xyz, 1.0);
+	vec4 worldPos = ubo.modelview[pushConsts.viewIndex] * pos;
+		
+	vec3 lPos = vec3(ubo.modelview[pushConsts.viewIndex] * ubo.lightPos);
+	outLightVec = lPos - worldPos.xyz;
+	outViewVec = -worldPos.xyz;	
+
+	gl_Position = ubo.projection[pushConsts.viewIndex] * worldPos;
+}
@@ -0,0 +1,12 @@
+// Fixed size per pixel fragment buffer (k-buffer) shared by the k-buffer passes
+
+// Number of nearest fragments per pixel that are stored and sorted, all fragments behind those are merged by the tail blend
+#define KBUFFER_SIZE 8
+// Depth value of an empty slot, larger than the bits of any depth in [0, 1]
+#define KBUFFER_EMPTY 0xffffffffu
+
+// Slots are stored layer by layer, so neighbouring pixels access neighbouring memory
+uint kbufferSlot(uvec2 pixel, uint layer, uvec2 screenSize)
+{
+	return layer * screenSize.x * screenSize.y + pixel.y * screenSize.x + pixel.x;
+}
@@ -0,0 +1,46 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "kbuffer.glsl"
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 2) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 3) uniform sampler2D samplerRevealage;
+
+layout (set = 0, binding = 4) readonly buffer KBufferDepthSBO
+{
+    uint depths[];
+};
+
+layout (set = 0, binding = 5) readonly buffer KBufferColorSBO
+{
+    uint colors[];
+};
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    uvec2 screenSize = uvec2(textureSize(samplerAccumulation, 0));
+
+    // The merged tail lies behind all stored fragments, so it is composited over the background first
+    vec4 accumulation = texelFetch(samplerAccumulation, texel, 0);
+    float revealage = texelFetch(samplerRevealage, texel, 0).r;
+    vec3 tail = accumulation.rgb / max(accumulation.a, 1e-5);
+    vec3 color = mix(tail, vec3(0.025), revealage);
+
+    // The k-buffer is already sorted front to back, so blend its slots from back to front
+    for (int i = KBUFFER_SIZE - 1; i >= 0; i--)
+    {
+        uint slot = kbufferSlot(uvec2(texel), uint(i), screenSize);
+        if (depths[slot] == KBUFFER_EMPTY)
+        {
+            continue;
+        }
+        vec4 fragment = unpackUnorm4x8(colors[slot]);
+        color = mix(color, fragment.rgb, fragment.a);
+    }
+
+    outFragColor = vec4(color, 1.0);
+}
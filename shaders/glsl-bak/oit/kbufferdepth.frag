@@ -0,0 +1,37 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "kbuffer.glsl"
+
+layout (early_fragment_tests) in;
+
+layout (set = 0, binding = 0) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+    uvec2 screenSize;
+} renderPassUBO;
+
+layout (set = 0, binding = 4) buffer KBufferDepthSBO
+{
+    uint depths[];
+};
+
+void main()
+{
+    // First pass: keep the nearest depths of each pixel sorted in the k-buffer
+    // Each atomic min keeps the smaller value in the slot and carries the larger one on to the next slot
+    // Positive floats compare like their bits, so the depth can be stored as an uint
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    for (uint i = 0; i < KBUFFER_SIZE; i++)
+    {
+        uint previous = atomicMin(depths[kbufferSlot(pixel, i, renderPassUBO.screenSize)], depth);
+        if (previous == KBUFFER_EMPTY)
+        {
+            break;
+        }
+        depth = max(previous, depth);
+    }
+}
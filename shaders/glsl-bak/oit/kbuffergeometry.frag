@@ -0,0 +1,76 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "kbuffer.glsl"
+#include "weightedblend.glsl"
+
+layout (early_fragment_tests) in;
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+layout (set = 0, binding = 0) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+    uvec2 screenSize;
+} renderPassUBO;
+
+layout (set = 0, binding = 1) buffer GeometrySBO
+{
+    uint count;
+    uint maxNodeCount;
+};
+
+layout (set = 0, binding = 4) readonly buffer KBufferDepthSBO
+{
+    uint depths[];
+};
+
+layout (set = 0, binding = 5) buffer KBufferColorSBO
+{
+    uint colors[];
+};
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    // Second pass: fragments that made it into the k-buffer store their color in the slot of their depth
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    uint color = packUnorm4x8(pushConsts.color);
+    bool stored = false;
+    for (uint i = 0; i < KBUFFER_SIZE; i++)
+    {
+        uint slot = kbufferSlot(pixel, i, renderPassUBO.screenSize);
+        uint slotDepth = depths[slot];
+        if (slotDepth > depth)
+        {
+            break;
+        }
+        // Fragments with equal depths claim separate slots, colors are cleared to zero each frame
+        if (slotDepth == depth && atomicCompSwap(colors[slot], 0u, color) == 0u)
+        {
+            stored = true;
+            break;
+        }
+    }
+
+    if (stored)
+    {
+        outAccumulation = vec4(0.0);
+        outRevealage = 0.0;
+        return;
+    }
+
+    // Tail blend: fragments behind the k nearest are merged order independently and composited behind the sorted ones
+    atomicAdd(count, 1);
+    float weight = weightedBlendWeight(1.0 / gl_FragCoord.w, pushConsts.color.a);
+    outAccumulation = vec4(pushConsts.color.rgb * pushConsts.color.a, pushConsts.color.a) * weight;
+    outRevealage = pushConsts.color.a;
+}
@@ -0,0 +1,8 @@
+// Weighted blended order independent transparency (McGuire and Bavoil, 2013)
+
+// Depth weight of equation 7 from the paper, using the view space depth of the fragment
+// Nearer fragments get a higher weight, so they dominate the weighted average of overlapping colors
+float weightedBlendWeight(float viewDepth, float alpha)
+{
+	return alpha * clamp(10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0) + pow(viewDepth / 200.0, 6.0)), 1e-2, 3e3);
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 2) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 3) uniform sampler2D samplerRevealage;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(samplerAccumulation, texel, 0);
+    float revealage = texelFetch(samplerRevealage, texel, 0).r;
+
+    // Weighted average of all transparent colors, covering the background by the product of their alphas
+    vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+    vec3 background = vec3(0.025);
+    outFragColor = vec4(mix(average, background, revealage), 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "weightedblend.glsl"
+
+layout (early_fragment_tests) in;
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    // Order independent: colors are summed weighted by depth and coverage, the revealage is multiplied by (1 - alpha) through the blend state
+    float weight = weightedBlendWeight(1.0 / gl_FragCoord.w, pushConsts.color.a);
+    outAccumulation = vec4(pushConsts.color.rgb * pushConsts.color.a, pushConsts.color.a) * weight;
+    outRevealage = pushConsts.color.a;
+}
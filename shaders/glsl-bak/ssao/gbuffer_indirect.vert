@@ -0,0 +1,66 @@
+#version 450
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inNormal;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	float nearPlane;
+	float farPlane;
+	mat4 previousModel;
+	mat4 viewProjection;
+	mat4 previousViewProjection;
+} ubo;
+
+struct Instance 
+{
+	mat4 model;
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+	uint materialIndex;
+	uint pad;
+};
+
+layout (set = 1, binding = 0, std430) readonly buffer Instances 
+{
+	Instance instances[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outColor;
+layout (location = 3) out vec3 outPos;
+layout (location = 4) flat out uint outMaterialIndex;
+layout (location = 5) out vec4 outCurrentPos;
+layout (location = 6) out vec4 outPreviousPos;
+
+void main() 
+{
+	// The first instance of the indirect draw command selects the instance
+	Instance instance = instances[gl_InstanceIndex];
+	mat4 model = ubo.model * instance.model;
+
+	gl_Position = ubo.projection * ubo.view * model * inPos;
+	
+	outUV = inUV;
+
+	// Vertex position in view space
+	outPos = vec3(ubo.view * model * inPos);
+
+	// Normal in view space
+	mat3 normalMatrix = transpose(inverse(mat3(ubo.view * model)));
+	outNormal = normalMatrix * inNormal;
+
+	outColor = inColor;
+	outMaterialIndex = instance.materialIndex;
+
+	// Unjittered clip space positions of this and the last frame for the velocity buffer
+	outCurrentPos = ubo.viewProjection * model * inPos;
+	outPreviousPos = ubo.previousViewProjection * ubo.previousModel * instance.model * inPos;
+}
@@ -0,0 +1,193 @@
+/*
+* Offline texture baking tool
+*
+* Decodes source images, generates their mip chains on the CPU and block compresses them into KTX files that can be loaded with vks::Texture2D::loadFromFile
+* Images are baked in parallel, each image's levels are split into rows / block rows for the remaining threads
+* Only runs on the CPU, no Vulkan device (or loader) is required
+*
+* Usage: assetbaker --input <image or directory> --output <directory> [--codec bc7|bc5|astc|rgba8] [--filter box|kaiser] [--normalmap] [--linear] [--threads n] [--force]
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <mutex>
+#include <cassert>
+#include <cstring>
+#include <cctype>
+#define STB_IMAGE_IMPLEMENTATION
+#include "texturebaker.hpp"
+#include "CommandLineParser.hpp"
+
+namespace fs = std::filesystem;
+
+static double secondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool isSourceImage(const fs::path& path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return (extension == ".png") || (extension == ".jpg") || (extension == ".jpeg") || (extension == ".tga") || (extension == ".bmp");
+}
+
+static void printStage(const std::string& name, const vks::baker::StageStats& stage)
+{
+	std::cout << "  " << std::left << std::setw(10) << name << std::right
+		<< std::setw(10) << std::fixed << std::setprecision(1) << (double)stage.pixels / 1.0e6 << " MPixels"
+		<< std::setw(10) << std::setprecision(3) << stage.time << " s"
+		<< std::setw(10) << std::setprecision(1) << stage.mpixelsPerSecond() << " MPixels/s\n";
+}
+
+int main(int argc, char* argv[])
+{
+	CommandLineParser commandLineParser;
+	commandLineParser.add("help", { "--help" }, false, "Show help");
+	commandLineParser.add("input", { "-i", "--input" }, true, "Source image or directory of source images (png, jpg, tga, bmp)");
+	commandLineParser.add("output", { "-o", "--output" }, true, "Directory the KTX files are written to");
+	commandLineParser.add("codec", { "-c", "--codec" }, true, "Output format: bc7 (default), bc5, astc (4x4) or rgba8");
+	commandLineParser.add("filter", { "-f", "--filter" }, true, "Mip filter: kaiser (default) or box");
+	commandLineParser.add("normalmap", { "-n", "--normalmap" }, false, "Sources are tangent space normal maps (linear, renormalized per level, defaults to bc5)");
+	commandLineParser.add("linear", { "-l", "--linear" }, false, "Sources store linear data instead of sRGB colors");
+	commandLineParser.add("maxlevels", { "--maxlevels" }, true, "Limit the number of mip levels");
+	commandLineParser.add("threads", { "-t", "--threads" }, true, "Number of worker threads (default: all hardware threads)");
+	commandLineParser.add("force", { "--force" }, false, "Bake all images, even if their output is newer than the source");
+	commandLineParser.parse(argc, argv);
+	if (commandLineParser.isSet("help") || !commandLineParser.isSet("input") || !commandLineParser.isSet("output")) {
+		commandLineParser.printHelp();
+		std::cout << "\n";
+		return commandLineParser.isSet("help") ? 0 : 1;
+	}
+
+	vks::baker::Settings settings{};
+	settings.normalMap = commandLineParser.isSet("normalmap");
+	settings.srgb = !commandLineParser.isSet("linear") && !settings.normalMap;
+	settings.alphaWeighted = !settings.normalMap;
+	settings.maxLevels = commandLineParser.getValueAsInt("maxlevels", 0);
+	const std::string codec = commandLineParser.getValueAsString("codec", settings.normalMap ? "bc5" : "bc7");
+	if (codec == "bc7") {
+		settings.codec = vks::baker::Codec::BC7;
+	} else if (codec == "bc5") {
+		settings.codec = vks::baker::Codec::BC5;
+	} else if (codec == "astc") {
+		settings.codec = vks::baker::Codec::ASTC4x4;
+	} else if (codec == "rgba8") {
+		settings.codec = vks::baker::Codec::RGBA8;
+	} else {
+		std::cerr << "Unknown codec \"" << codec << "\"\n";
+		return 1;
+	}
+	if (settings.codec == vks::baker::Codec::BC5) {
+		// BC5 only has two unsigned normalized channels
+		settings.srgb = false;
+	}
+	settings.mipFilter = (commandLineParser.getValueAsString("filter", "kaiser") == "box") ? vks::baker::MipFilter::Box : vks::baker::MipFilter::Kaiser;
+	const bool force = commandLineParser.isSet("force");
+
+	// Collect the images to bake, skipping those with an up to date output
+	const fs::path input = commandLineParser.getValueAsString("input", "");
+	const fs::path outputDirectory = commandLineParser.getValueAsString("output", "");
+	std::vector<fs::path> sources;
+	std::error_code ec;
+	if (fs::is_directory(input, ec)) {
+		for (const auto& entry : fs::directory_iterator(input, ec)) {
+			if (entry.is_regular_file() && isSourceImage(entry.path())) {
+				sources.push_back(entry.path());
+			}
+		}
+		std::sort(sources.begin(), sources.end());
+	} else if (fs::exists(input, ec)) {
+		sources.push_back(input);
+	} else {
+		std::cerr << "Input \"" << input.string() << "\" does not exist\n";
+		return 1;
+	}
+	std::vector<std::pair<fs::path, fs::path>> jobs;
+	for (const auto& source : sources) {
+		const fs::path output = outputDirectory / source.filename().replace_extension(".ktx");
+		if (!force && fs::exists(output, ec) && (fs::last_write_time(output, ec) >= fs::last_write_time(source, ec))) {
+			continue;
+		}
+		jobs.push_back({ source, output });
+	}
+	std::cout << "Baking " << jobs.size() << " of " << sources.size() << " images to " << outputDirectory.string() << " (format " << codec << ", VkFormat " << vks::baker::vkFormat(settings.codec, settings.srgb) << ")\n";
+	if (jobs.empty()) {
+		return 0;
+	}
+
+	// Images are distributed over the threads first, the remaining threads help with the rows and blocks of each image
+	const uint32_t threadCount = commandLineParser.getValueAsInt("threads", std::max(std::thread::hardware_concurrency(), 1u));
+	const uint32_t imageThreadCount = std::min(threadCount, static_cast<uint32_t>(jobs.size()));
+	const uint32_t levelThreadCount = std::max(threadCount / imageThreadCount, 1u);
+
+	vks::baker::Stats totals{};
+	std::atomic<uint32_t> failures{ 0 };
+	std::mutex outputMutex;
+	const auto tStart = std::chrono::high_resolution_clock::now();
+
+	vks::baker::parallelFor(static_cast<uint32_t>(jobs.size()), imageThreadCount, [&](uint32_t index) {
+		const auto& [source, output] = jobs[index];
+		vks::baker::Stats stats{};
+		std::string error;
+
+		auto tStage = std::chrono::high_resolution_clock::now();
+		vks::baker::Image image;
+		if (!vks::baker::decode(source.string(), settings, image, error)) {
+			std::lock_guard<std::mutex> lock(outputMutex);
+			std::cerr << "Could not decode " << source.string() << ": " << error << "\n";
+			failures++;
+			return;
+		}
+		const uint32_t width = image.width;
+		const uint32_t height = image.height;
+		stats.decode = { secondsSince(tStage), static_cast<uint64_t>(width) * height };
+
+		tStage = std::chrono::high_resolution_clock::now();
+		std::vector<vks::baker::Image> levels = vks::baker::generateMips(std::move(image), settings, levelThreadCount);
+		uint64_t chainPixels = 0;
+		for (const auto& level : levels) {
+			chainPixels += static_cast<uint64_t>(level.width) * level.height;
+		}
+		stats.mips = { secondsSince(tStage), chainPixels - static_cast<uint64_t>(width) * height };
+
+		tStage = std::chrono::high_resolution_clock::now();
+		std::vector<std::vector<uint8_t>> levelData(levels.size());
+		for (size_t i = 0; i < levels.size(); i++) {
+			levelData[i] = vks::baker::compress(vks::baker::quantize(levels[i], settings), levels[i].width, levels[i].height, settings.codec, levelThreadCount);
+			// Release the float data as soon as possible, large sources need a lot of memory
+			levels[i] = {};
+		}
+		stats.compress = { secondsSince(tStage), chainPixels };
+
+		tStage = std::chrono::high_resolution_clock::now();
+		const bool written = vks::baker::writeKTX(output.string(), settings.codec, settings.srgb, width, height, levelData);
+		stats.write = { secondsSince(tStage), chainPixels };
+
+		std::lock_guard<std::mutex> lock(outputMutex);
+		if (!written) {
+			std::cerr << "Could not write " << output.string() << "\n";
+			failures++;
+			return;
+		}
+		totals.add(stats);
+		std::cout << source.filename().string() << " -> " << output.filename().string() << " (" << width << "x" << height << ", " << levelData.size() << " levels)\n";
+	});
+
+	const double totalTime = secondsSince(tStart);
+	const uint64_t totalPixels = totals.compress.pixels;
+	std::cout << "\nThroughput per stage (time summed over " << imageThreadCount << " image threads with " << levelThreadCount << " level thread(s) each):\n";
+	printStage("decode", totals.decode);
+	printStage("mips", totals.mips);
+	printStage("compress", totals.compress);
+	printStage("write", totals.write);
+	std::cout << "Total: " << std::fixed << std::setprecision(1) << (double)totalPixels / 1.0e6 << " MPixels in " << std::setprecision(3) << totalTime << " s ("
+		<< std::setprecision(1) << (totalTime > 0.0 ? (double)totalPixels / totalTime / 1.0e6 : 0.0) << " MPixels/s)\n";
+
+	return failures > 0 ? 1 : 0;
+}